@@ -63,6 +63,9 @@ public:
   /// Initialization: Minimum number of inliers after RANSAC.
   static size_t& initMinInliers() { return getInstance().init_min_inliers; }
 
+  /// Initialization: Number of threads of the homography and essential matrix RANSAC, including the tracking thread.
+  static size_t& initRansacNumThreads() { return getInstance().init_ransac_num_threads; }
+
   /// Maximum level of the Lucas Kanade tracker.
   static size_t& kltMaxLevel() { return getInstance().klt_max_level; }
 
@@ -84,6 +87,14 @@ public:
   /// Number of iterations in structure optimization.
   static size_t& structureOptimNumIter() { return getInstance().structureoptim_num_iter; }
 
+  /// Number of threads in structure optimization, including the tracking thread.
+  static size_t& structureOptimNumThreads() { return getInstance().structureoptim_num_threads; }
+
+  /// Time budget of structure optimization in microseconds. If set, the points
+  /// that were not optimized for the longest time are optimized until the
+  /// budget is used up, instead of structureOptimMaxPts. Set to 0 to disable.
+  static double& structureOptimBudget() { return getInstance().structureoptim_budget; }
+
   /// Reprojection threshold after bundle adjustment.
   static double& lobaThresh() { return getInstance().loba_thresh; }
 
@@ -93,6 +104,18 @@ public:
   /// Number of iterations in the local bundle adjustment.
   static size_t& lobaNumIter() { return getInstance().loba_num_iter; }
 
+  /// Number of threads of the local bundle adjustment without g2o, including the calling thread.
+  static size_t& lobaNumThreads() { return getInstance().loba_num_threads; }
+
+  /// Run the local bundle adjustment without g2o in a background thread. The
+  /// result is applied at the beginning of a later frame.
+  static bool& lobaAsync() { return getInstance().loba_async; }
+
+  /// Number of keyframes in the sliding window of the local bundle adjustment
+  /// without g2o. Older keyframes are marginalized. 0 to optimize the core
+  /// keyframes instead.
+  static size_t& lobaWindowNKfs() { return getInstance().loba_window_n_kfs; }
+
   /// Minimum distance between two keyframes. Relative to the average height in the map.
   static double& kfSelectMinDist() { return getInstance().kfselect_mindist; }
 
@@ -119,6 +142,24 @@ public:
   /// If within one frame, this amount of features are dropped. Tracking quality is bad.
   static int& qualityMaxFtsDrop() { return getInstance().quality_max_drop_fts; }
 
+  /// Number of past frames kept to update the seeds of a new keyframe (stereo only).
+  static size_t& replayMaxFrames() { return getInstance().replay_max_frames; }
+
+  /// Memory budget in megabytes of the past frames kept for the depth filter.
+  static double& replayMaxMBytes() { return getInstance().replay_max_mbytes; }
+
+  /// Update the seeds in the tracking thread, such that runs on the same input are reproducible.
+  static bool& depthFilterDeterministic() { return getInstance().depth_filter_deterministic; }
+
+  /// Number of images that wait for the asynchronous ingestion of the frame handler.
+  static size_t& ingestionQueueSize() { return getInstance().ingestion_queue_size; }
+
+  /// If the ingestion queue is full, drop the oldest image. Otherwise the caller waits.
+  static bool& ingestionLatestWins() { return getInstance().ingestion_latest_wins; }
+
+  /// Build the pyramids and reproject the map of the stereo cameras in parallel, one thread per camera.
+  static bool& stereoParallelCameras() { return getInstance().stereo_parallel_cameras; }
+
 private:
   Config();
   Config(Config const&);
@@ -133,6 +174,7 @@ private:
   double init_min_disparity;
   size_t init_min_tracked;
   size_t init_min_inliers;
+  size_t init_ransac_num_threads;
   size_t klt_max_level;
   size_t klt_min_level;
   double reproj_thresh;
@@ -140,9 +182,14 @@ private:
   size_t poseoptim_num_iter;
   size_t structureoptim_max_pts;
   size_t structureoptim_num_iter;
+  size_t structureoptim_num_threads;
+  double structureoptim_budget;
   double loba_thresh;
   double loba_robust_huber_width;
   size_t loba_num_iter;
+  size_t loba_num_threads;
+  bool loba_async;
+  size_t loba_window_n_kfs;
   double kfselect_mindist;
   double triang_min_corner_score;
   size_t triang_half_patch_size;
@@ -152,6 +199,12 @@ private:
   size_t max_fts;
   size_t quality_min_fts;
   int quality_max_drop_fts;
+  size_t replay_max_frames;
+  double replay_max_mbytes;
+  bool depth_filter_deterministic;
+  size_t ingestion_queue_size;
+  bool ingestion_latest_wins;
+  bool stereo_parallel_cameras;
 };
 
 } // namespace svo
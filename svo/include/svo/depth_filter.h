@@ -17,13 +17,19 @@
 #ifndef SVO_DEPTH_FILTER_H_
 #define SVO_DEPTH_FILTER_H_
 
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <thread>
 #include <condition_variable>
 #include <vikit/performance_monitor.h>
 #include <svo/global.h>
 #include <vilib/feature_detection/detector_base_gpu.h>
 #include <svo/matcher.h>
+#include <svo/epoch_reclaimer.h>
+#include <svo/worker_pool.h>
+#include <svo/spsc_queue.h>
+#include <svo/replay_buffer.h>
 
 namespace svo {
 
@@ -31,23 +37,120 @@ class Frame;
 class Feature;
 class Point;
 
-/// A seed is a probabilistic depth estimate for a single pixel.
-struct Seed
+/// Seeds are probabilistic depth estimates for single pixels. The states of all
+/// seeds are stored in contiguous arrays (structure of arrays), such that the
+/// Bayesian update can be applied to a whole batch of measurements at once. The
+/// features of the seeds are kept in a separate array.
+class SeedStore
 {
-    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+public:
+  static int seed_counter;
+  std::vector<int> id;                        //!< Seed ID, only used for visualization.
+  std::vector<std::unique_ptr<Feature>> ftr;  //!< Feature in the keyframe for which the depth should be computed.
+  std::vector<float> a;                       //!< a of Beta distribution: When high, probability of inlier is large.
+  std::vector<float> b;                       //!< b of Beta distribution: When high, probability of outlier is large.
+  std::vector<float> mu;                      //!< Mean of normal distribution.
+  std::vector<float> z_range;                 //!< Max range of the possible depth.
+  std::vector<float> sigma2;                  //!< Variance of normal distribution.
+  std::vector<int> birth;                     //!< Frame count of the filter when the seed was created.
+  std::vector<uint16_t> n_failed;             //!< Consecutive searches without a match.
+
+  inline size_t size() const { return mu.size(); }
+  inline bool empty() const { return mu.empty(); }
+
+  /// Add a new seed.
+  void add(std::unique_ptr<Feature> feature, float depth_mean, float depth_min, int birth_frame = 0);
+
+  /// Quality of seed i, low values are unlikely to converge. Combines the
+  /// inlier probability, the variance reduction which is still needed for
+  /// convergence and the number of consecutive failed searches.
+  float quality(size_t i, double convergence_sigma2_thresh) const;
+
+  /// Remove all seeds i for which remove(i) is true. The order of the remaining
+  /// seeds is preserved. Returns the number of removed seeds.
+  template<class F>
+  size_t removeIf(F remove)
+  {
+    size_t j=0;
+    for(size_t i=0; i<size(); ++i)
+    {
+      if(remove(i))
+        continue;
+      if(i != j)
+      {
+        id[j] = id[i];
+        ftr[j] = std::move(ftr[i]);
+        a[j] = a[i];
+        b[j] = b[i];
+        mu[j] = mu[i];
+        z_range[j] = z_range[i];
+        sigma2[j] = sigma2[i];
+        birth[j] = birth[i];
+        n_failed[j] = n_failed[i];
+      }
+      ++j;
+    }
+    const size_t n_removed = size()-j;
+    resize(j);
+    return n_removed;
+  }
+
+  void clear() { resize(0); }
+
+private:
+  void resize(size_t n);
+};
+
+/// Seeds which were initialized in the same keyframe. Removing the keyframe or
+/// aging out drops the whole batch at once, and all seeds of a batch share the
+/// relative pose to a new frame.
+struct SeedBatch
+{
+  static int counter;
+  int id;                     //!< Batch id is the id of the keyframe for which the seeds were created.
+  FramePtr frame;             //!< Keyframe of the seeds, kept alive as long as the batch exists.
+  SeedStore seeds;
+};
+
+/// Sparse grid of the inverse depths of the map points observed in a keyframe.
+/// New seeds look up the points in the cells around them to start with a prior
+/// close to the depth of their neighbourhood instead of the scene depth.
+class DepthPriorGrid
+{
+public:
+  /// Inverse depth of a map point at a pixel of the keyframe.
+  struct Sample
+  {
+    float x;
+    float y;
+    float inv_depth;
+  };
+  typedef std::vector<Sample> Samples;
 
-    static int batch_counter;
-    static int seed_counter;
-    int batch_id;                //!< Batch id is the id of the keyframe for which the seed was created.
-    int id;                      //!< Seed ID, only used for visualization.
-    std::unique_ptr<Feature> ftr;//!< Feature in the keyframe for which the depth should be computed.
-    float a;                     //!< a of Beta distribution: When high, probability of inlier is large.
-    float b;                     //!< b of Beta distribution: When high, probability of outlier is large.
-    float mu;                    //!< Mean of normal distribution.
-    float z_range;               //!< Max range of the possible depth.
-    float sigma2;                //!< Variance of normal distribution.
-    Matrix2d patch_cov;          //!< Patch covariance in reference image.
-    Seed(std::unique_ptr<Feature> ftr, float depth_mean, float depth_min);
+  DepthPriorGrid() : cell_size_(1), n_cols_(0), n_rows_(0) {}
+
+  /// Reset the grid for an image of the given size, keeps the allocated cells.
+  void reset(int width, int height, int cell_size);
+
+  /// Insert the inverse depth of a point at pixel px.
+  void insert(const Vector2d& px, float inv_depth);
+
+  /// Collect the map points observed in the frame. Reads the map, hence call
+  /// from the thread which owns it.
+  static void collect(const Frame& frame, Samples& samples);
+
+  /// Reset the grid for an image of the given size and insert the samples.
+  void build(const Samples& samples, int width, int height, int cell_size);
+
+  /// Mean and variance of the inverse depths in the 3x3 cells around px.
+  /// Returns false if there are less than min_points.
+  bool lookup(const Vector2d& px, size_t min_points, float& mu, float& sigma2) const;
+
+private:
+  int cell_size_;
+  int n_cols_;
+  int n_rows_;
+  std::vector<std::vector<float>> cells_;
 };
 
 /// Depth filter implements the Bayesian Update proposed in:
@@ -74,6 +177,17 @@ public:
     int max_n_kfs;                              //!< maximum number of keyframes for which we maintain seeds.
     double sigma_i_sq;                          //!< image noise.
     double seed_convergence_sigma2_thresh;      //!< threshold on depth uncertainty for convergence.
+    int n_threads;                              //!< number of workers which update the seeds in parallel, including the filter thread.
+    double seed_update_budget_ms;               //!< time budget to update the seeds with a frame, 0 means unlimited.
+    size_t command_queue_size;                  //!< capacity of the queue to the filter thread.
+    size_t max_queued_frames;                   //!< new frames are dropped if more commands are queued.
+    bool stereo_seed_init;                      //!< initialize new seeds by matching them in the second view of a stereo keyframe.
+    double stereo_skip_replay_ratio;            //!< skip the history replay if this fraction of the new seeds was initialized by stereo.
+    bool depth_prior_from_map;                  //!< initialize new seeds from the map points observed around them in the keyframe.
+    int depth_prior_cell_size;                  //!< cell size in pixels of the depth prior grid.
+    size_t depth_prior_min_points;              //!< minimum number of neighbouring points for a depth prior.
+    size_t replay_frames_per_step;              //!< history frames replayed to new seeds before checking for new commands.
+    size_t max_n_seeds;                         //!< maximum number of seeds, the least promising are evicted. 0 means unlimited.
     Options()
     : check_ftr_angle(false),
       epi_search_1d(false),
@@ -81,53 +195,135 @@ public:
       use_photometric_disparity_error(false),
       max_n_kfs(3),
       sigma_i_sq(5e-4),
-      seed_convergence_sigma2_thresh(200.0)
+      seed_convergence_sigma2_thresh(200.0),
+      n_threads(2),
+      seed_update_budget_ms(0.0),
+      command_queue_size(16),
+      max_queued_frames(3),
+      stereo_seed_init(true),
+      stereo_skip_replay_ratio(0.5),
+      depth_prior_from_map(false),
+      depth_prior_cell_size(32),
+      depth_prior_min_points(3),
+      replay_frames_per_step(2),
+      max_n_seeds(0)
     {}
   } options_;
 
+  /// Statistics of the last update of the seeds with a frame.
+  struct UpdateStats
+  {
+    size_t n_updated;       //!< Seeds which were updated with a measurement.
+    size_t n_failed;        //!< Seeds for which no match was found.
+    size_t n_skipped;       //!< Visible seeds which were not measured because the time budget was used up.
+    size_t n_invisible;     //!< Seeds which do not project into the frame.
+    size_t n_converged;     //!< Seeds which converged and were handed over as candidates.
+    double time_ms;
+    UpdateStats() : n_updated(0), n_failed(0), n_skipped(0), n_invisible(0), n_converged(0), time_ms(0.0) {}
+  };
+
+  /// Lifetimes in frames of the seeds which left the filter, by outcome. Bin k
+  /// counts the lifetimes in [2^k-1, 2^(k+1)-1), the last bin all longer ones.
+  struct SeedHistogram
+  {
+    enum Outcome { CONVERGED, EVICTED, AGED_OUT, REMOVED, DIVERGED, N_OUTCOMES };
+    static const int kNumBins = 8;
+    size_t counts[N_OUTCOMES][kNumBins];
+    SeedHistogram() { std::fill(&counts[0][0], &counts[0][0]+N_OUTCOMES*kNumBins, 0); }
+    void add(Outcome outcome, int lifetime);
+    size_t total(Outcome outcome) const;
+    static const char* name(Outcome outcome);
+    /// Write one line per outcome with the counts of the bins, comma separated.
+    void write(std::ostream& out) const;
+  };
+
+  /// State of the queue to the filter thread.
+  struct QueueStats
+  {
+    size_t depth;           //!< Commands in the queue.
+    size_t n_deferred;      //!< Commands which did not fit into the queue and are pushed later.
+    size_t n_dropped;       //!< Frames dropped so far because the filter did not keep up.
+    QueueStats() : depth(0), n_deferred(0), n_dropped(0) {}
+  };
+
   DepthFilter(
       std::shared_ptr<vilib::DetectorBaseGPU> feature_detector,
       callback_t seed_converged_cb);
 
   virtual ~DepthFilter();
 
+  /// The filter thread pins itself in the reclaimer of the map while it
+  /// processes a frame, such that it may access map points. Set before startThread().
+  void setReclaimer(EpochReclaimer* reclaimer) { reclaimer_ = reclaimer; }
+
   /// Start this thread when seed updating should be in a parallel thread.
   void startThread();
 
   /// Stop the parallel thread that is running.
   void stopThread();
 
-  /// Add frame to the queue to be processed.
+  /// In deterministic mode the filter processes every frame and keyframe in
+  /// order in the calling thread: frames are never dropped, the time budget is
+  /// ignored and the history replay runs to completion. The seeds then depend
+  /// only on the input sequence, not on thread timing or the number of workers.
+  /// Enabling it processes the queued commands and stops the filter thread,
+  /// disabling it starts the thread again.
+  void setDeterministic(bool deterministic);
+
+  /// Are the seeds updated in the calling thread?
+  bool isDeterministic() const { return deterministic_; }
+
+  /// Add frame to the queue to be processed. The frame is dropped if the
+  /// filter thread does not keep up.
   void addFrame(FramePtr frame);
 
   /// Add new keyframe to the queue
   void addKeyframe(FramePtr frame, double depth_mean, double depth_min);
 
-  void addKeyframe(FramePtr frame, double depth_mean, double depth_min, const std::vector<FramePtr> & history_frames);
+  /// Add new keyframe to the queue. The new seeds are updated with the recorded
+  /// history frames, newest first. If stereo_frame is set, it is the second view of the keyframe at
+  /// the same time and the seeds are initialized by stereo matching.
+  void addKeyframe(
+      FramePtr frame,
+      double depth_mean,
+      double depth_min,
+      const std::vector<ReplayFramePtr> & history_frames,
+      FramePtr stereo_frame = FramePtr());
 
   /// Remove all seeds which are initialized from the specified keyframe. This
   /// function is used to make sure that no seeds points to a non-existent frame
-  /// when a frame is removed from the map.
+  /// when a frame is removed from the map. The filter keeps a reference to the
+  /// keyframe until its seeds are removed.
   void removeKeyframe(FramePtr frame);
 
   /// If the map is reset, call this function such that we don't have pointers
   /// to old frames.
   void reset();
 
-  /// Returns a copy of the seeds belonging to frame. Thread-safe.
-  /// Can be used to compute the Next-Best-View in parallel.
-  /// IMPORTANT! Make sure you hold a valid reference counting pointer to frame
-  /// so it is not being deleted while you use it.
-  void getSeedsCopy(const FramePtr& frame, std::list<Seed>& seeds);
+  /// Statistics of the last seed update. Thread-safe.
+  UpdateStats getUpdateStats() const;
+
+  /// State of the command queue. Call from the thread which adds the frames.
+  QueueStats getQueueStats() const;
+
+  /// Lifetimes and outcomes of the seeds which left the filter so far. Thread-safe.
+  SeedHistogram getSeedHistogram() const;
+
+  /// Number of live seeds after the last change by the filter. Thread-safe,
+  /// does not wait for the filter.
+  inline size_t nSeeds() const { return n_seeds_.load(std::memory_order_relaxed); }
 
   /// Return a reference to the seeds. This is NOT THREAD SAFE!
-  std::list<Seed>& getSeeds() { return seeds_; }
+  std::deque<SeedBatch>& getSeeds() { return seed_batches_; }
 
-  /// Bayes update of the seed, x is the measurement, tau2 the measurement uncertainty
-  static void updateSeed(
-      const float x,
-      const float tau2,
-      Seed* seed);
+  /// Bayes update of the seeds idx[k], x[k] is the inverse depth measurement of
+  /// seed idx[k] and tau2[k] the measurement uncertainty. The update is
+  /// vectorized over the batch.
+  static void updateSeedBatch(
+      const std::vector<uint32_t>& idx,
+      const std::vector<float>& x,
+      const std::vector<float>& tau2,
+      SeedStore& seeds);
 
   /// Compute the uncertainty of the measurement.
   static double computeTau(
@@ -136,33 +332,200 @@ public:
       const double z,
       const double px_error_angle);
 
+  /// Compute the uncertainty of the measurement with the cosine and sine of the
+  /// pixel error angle precomputed, t is the translation of T_ref_cur.
+  static double computeTau(
+      const Vector3d& t,
+      const Vector3d& f,
+      const double z,
+      const double cos_px_error_angle,
+      const double sin_px_error_angle);
+
 protected:
   std::shared_ptr<vilib::DetectorBaseGPU> feature_detector_;
   callback_t seed_converged_cb_;
-  std::list<Seed> seeds_;
+  std::deque<SeedBatch> seed_batches_;  //!< Seeds grouped by keyframe, oldest first.
+  DepthPriorGrid depth_prior_grid_;     //!< Depths of the map points in the last keyframe, reused across keyframes.
   std::mutex seeds_mut_;
-  bool seeds_updating_halt_;            //!< Set this value to true when seeds updating should be interrupted.
+  std::atomic<bool> seeds_updating_halt_; //!< Set this value to true when seeds updating should be interrupted.
   std::unique_ptr<std::thread> thread_;
-  bool thread_halt_;
-  std::queue<FramePtr> frame_queue_;
-  std::mutex frame_queue_mut_;
-  std::condition_variable frame_queue_cond_;
-  FramePtr new_keyframe_;               //!< Next keyframe to extract new seeds.
-  std::vector<FramePtr> new_keyframe_update_frames_;
-  bool new_keyframe_set_;               //!< Do we have a new keyframe to process?.
-  double new_keyframe_min_depth_;       //!< Minimum depth in the new keyframe. Used for range in new seeds.
-  double new_keyframe_mean_depth_;      //!< Maximum depth in the new keyframe. Used for range in new seeds.
+  std::atomic<bool> thread_halt_;
+
+  /// Message from the tracking thread to the filter thread.
+  struct Command
+  {
+    enum Type { ADD_FRAME, ADD_KEYFRAME, REMOVE_KEYFRAME, RESET };
+    Type type;
+    FramePtr frame;
+    double depth_mean;                  //!< Mean depth in the new keyframe.
+    double depth_min;                   //!< Minimum depth in the new keyframe. Used for range in new seeds.
+    std::vector<ReplayFramePtr> history_frames; //!< Frames to update the seeds of a new keyframe with.
+    FramePtr stereo_frame;              //!< Second view of the new keyframe.
+    DepthPriorGrid::Samples depth_prior; //!< Map points of the new keyframe, collected by the tracking thread.
+    Command() : type(ADD_FRAME), depth_mean(0.0), depth_min(0.0) {}
+  };
+  std::unique_ptr<SpscQueue<Command>> commands_;
+  std::deque<Command> deferred_commands_; //!< Commands which did not fit into the queue, tracking thread only.
+  std::atomic<int> n_pending_interrupts_; //!< Queued commands other than frames, which interrupt the seed update.
+  std::atomic<size_t> n_dropped_frames_;
+  std::atomic<bool> thread_waiting_;    //!< Filter thread waits for new commands.
+  std::atomic<size_t> n_seeds_;         //!< Number of live seeds, published by the filter for nSeeds().
+  std::mutex wakeup_mut_;
+  std::condition_variable wakeup_cond_;
   vk::PerformanceMonitor permon_;       //!< Separate performance monitor since the DepthFilter runs in a parallel thread.
-  Matcher matcher_;
+  std::vector<std::unique_ptr<Matcher>> matchers_; //!< One matcher per worker.
+  std::unique_ptr<WorkerPool> pool_;    //!< Workers for the parallel seed update.
+  EpochReclaimer* reclaimer_;           //!< Reclaimer of the map points, NULL if the filter does not access the map.
+  UpdateStats stats_;
+  SeedHistogram seed_histogram_;
+  mutable std::mutex stats_mut_;
+  int n_frames_;                        //!< Frames the seeds were updated with, the clock of the seed lifetimes.
+  bool deterministic_;                  //!< Seeds are updated in the calling thread, see setDeterministic().
+
+  /// Initialize new seeds from a frame. Returns the number of new seeds.
+  size_t initializeSeeds(FramePtr frame, double depth_mean, double depth_min,
+                         const DepthPriorGrid::Samples& depth_prior);
+
+  /// Match the seeds of a new keyframe in the second view of a stereo rig and
+  /// start the matched ones with a tight prior. Returns the number of matches.
+  size_t initializeSeedsStereo(FramePtr frame, FramePtr stereo_frame);
+
+  /// Create the workers and their matchers if the number of threads changed.
+  void prepareWorkers();
+
+  /// Remove the seeds of a keyframe.
+  void removeSeeds(FramePtr frame);
+
+  /// Publish the number of live seeds. Call with seeds_mut_ held.
+  void publishSeedCount();
+
+  /// Evict the seeds with the lowest quality until at most max_n_seeds are
+  /// left. Seeds of the newest batch are only evicted if it alone exceeds the cap.
+  void evictSeeds();
+
+  /// Add the seeds i for which removed(i) is true to the histogram.
+  template<class F>
+  void countSeeds(SeedHistogram::Outcome outcome, const SeedStore& seeds, F removed)
+  {
+    std::lock_guard<std::mutex> lock(stats_mut_);
+    for(size_t i=0; i<seeds.size(); ++i)
+      if(removed(i))
+        seed_histogram_.add(outcome, n_frames_-seeds.birth[i]);
+  }
+
+  /// Remove all seeds.
+  void clearSeeds();
+
+  /// Seed updating is interrupted when the thread stops or a command other
+  /// than a frame is waiting in the queue.
+  inline bool isInterrupted() const { return seeds_updating_halt_ || n_pending_interrupts_ > 0; }
 
-  /// Initialize new seeds from a frame.
-  void initializeSeeds(FramePtr frame);
+  /// Pass a command to the filter thread without blocking.
+  void pushCommand(Command&& cmd);
 
-  /// Update all seeds with a new measurement frame.
-  virtual void updateSeeds(FramePtr frame, int start_seed_idx = 0);
+  /// Queue a command for the filter thread or, without the thread, process it
+  /// and the replay it starts right away.
+  void dispatchCommand(Command&& cmd);
 
-  /// When a new keyframe arrives, the frame queue should be cleared.
-  void clearFrameQueue();
+  /// Execute a command in the current thread.
+  void processCommand(Command& cmd);
+
+  /// Result of the measurement of a seed, applied in the serial commit phase.
+  struct SeedUpdate
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    enum Status { SKIPPED, INVISIBLE, SCHEDULED, NO_MATCH, MEASURED };
+    Status status;
+    double priority;      //!< Expected information gain of a measurement.
+    Vector2d px_cur;      //!< Matched position in the current frame.
+    float x;              //!< Inverse depth measurement.
+    float tau2;           //!< Variance of the inverse depth measurement.
+    bool z_inv_min_nan;
+    SeedUpdate() : status(SKIPPED), priority(0.0), x(0.0f), tau2(0.0f), z_inv_min_nan(false) {}
+  };
+  std::vector<SeedUpdate, Eigen::aligned_allocator<SeedUpdate>> seed_updates_;
+  /// Seed i of batch k in the flat list of seeds to update.
+  struct SeedRef
+  {
+    uint32_t k;
+    uint32_t i;
+  };
+  std::vector<SeedRef> seed_refs_;
+  std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d>> batch_poses_; //!< T_ref_cur of the batches to update.
+  std::vector<uint32_t> seed_schedule_; //!< Visible seeds, ordered by priority.
+  std::vector<uint32_t> batch_idx_;     //!< Seeds with a measurement in the current frame.
+  std::vector<float> batch_x_;
+  std::vector<float> batch_tau2_;
+  std::vector<char> seed_removed_;
+  /// Seed i of batch k with its quality, for the eviction.
+  struct RankedSeed
+  {
+    float quality;
+    uint32_t k;
+    uint32_t i;
+  };
+  std::vector<RankedSeed> eviction_ranking_;
+
+  /// Replay of the history frames to the seeds of a new keyframe. It runs in
+  /// steps between the commands, such that a new keyframe interrupts it.
+  struct ReplayTask
+  {
+    int batch_id;                         //!< Batch of the new seeds.
+    std::vector<ReplayFramePtr> frames;   //!< Frames to replay, in order.
+    size_t next_frame;                    //!< First frame which is not replayed yet.
+  };
+  std::deque<ReplayTask> replay_tasks_;  //!< Pending replays, the newest keyframe first.
+  /// Measurements of one worker in a replay step.
+  struct ReplayScratch
+  {
+    std::vector<uint32_t> idx;
+    std::vector<float> x;
+    std::vector<float> tau2;
+    std::vector<char> z_inv_min_nan;
+  };
+  std::vector<ReplayScratch> replay_scratch_;
+  std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d>> replay_poses_; //!< T_ref_cur of the frames in a replay step.
+
+  /// Queue the replay of the history frames to the newest batch of seeds.
+  void addReplayTask(const std::vector<ReplayFramePtr>& frames);
+
+  /// Replay the next frames of the newest task to its seeds. The seeds are
+  /// split among the workers and each worker passes its seeds through the
+  /// frames in order, so every seed sees the frames in sequence. Returns false
+  /// if no task is left.
+  bool replaySeedsStep();
+
+  /// Turn a converged seed into a candidate point, its feature is moved to the point.
+  void convergeSeed(SeedStore& seeds, size_t i);
+
+  /// Update all seeds with a new measurement frame. The seeds are measured in
+  /// parallel, the Bayesian update is applied to the measurements of each batch
+  /// at once and convergence and removal are committed serially in seed order.
+  /// If only_keyframe is set, only the seeds of this keyframe are updated.
+  virtual void updateSeeds(const ReplayFrame& frame, FramePtr only_keyframe = FramePtr());
+
+  /// Check if seed i is visible in the frame and rank it by the expected
+  /// information gain of a measurement. px_error holds the cosine and sine of
+  /// the pixel error angle.
+  void scheduleSeed(
+      const ReplayFrame& frame,
+      const Sophus::SE3d& T_ref_cur,
+      const Vector2d& px_error,
+      const SeedStore& seeds,
+      size_t i,
+      SeedUpdate& update) const;
+
+  /// Search seed i in the frame and compute the depth measurement. Does not
+  /// modify the seeds, hence it can run concurrently for different seeds.
+  /// Virtual such that tests can replace the epipolar search.
+  virtual void measureSeed(
+      const ReplayFrame& frame,
+      const Sophus::SE3d& T_ref_cur,
+      Matcher& matcher,
+      const Vector2d& px_error,
+      const SeedStore& seeds,
+      size_t i,
+      SeedUpdate& update) const;
 
   /// A thread that is continuously updating the seeds.
   void updateSeedsLoop();
@@ -0,0 +1,124 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SVO_EPOCH_RECLAIMER_H_
+#define SVO_EPOCH_RECLAIMER_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include <stdint.h>
+
+namespace svo {
+
+/// Epoch-based reclamation of map objects. Objects that are unlinked from the
+/// map are retired instead of deleted. A background thread advances a global
+/// epoch and frees an object once every reader that was pinned when the object
+/// was retired has left its critical section. Readers are the tracking thread,
+/// the depth-filter thread and any other thread (e.g. a visualizer) which
+/// dereferences points it obtained from the map.
+class EpochReclaimer
+{
+public:
+  static const size_t kMaxReaders = 64;
+
+  /// Reader critical section. While the guard lives, no object which was
+  /// reachable at construction of the guard is freed.
+  class Guard
+  {
+  public:
+    Guard(const EpochReclaimer& reclaimer) : reclaimer_(reclaimer), slot_(reclaimer.pin()) {}
+    ~Guard() { reclaimer_.unpin(slot_); }
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+  private:
+    const EpochReclaimer& reclaimer_;
+    size_t slot_;
+  };
+
+  /// Reclaimer config parameters
+  struct Options {
+    int reclaim_period_ms;  //!< The background thread frees retired objects at least every period.
+    size_t max_pending;     //!< The background thread is woken up early when more objects are pending.
+    Options()
+    : reclaim_period_ms(20),
+      max_pending(1000)
+    {}
+  } options_;
+
+  EpochReclaimer();
+  ~EpochReclaimer();
+
+  EpochReclaimer(const EpochReclaimer&) = delete;
+  EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+  /// Enter a critical section, returns the reader slot. Prefer the Guard.
+  size_t pin() const;
+
+  /// Leave the critical section of the reader slot.
+  void unpin(size_t slot) const;
+
+  /// Hand over an unlinked object. It is deleted once no reader can see it.
+  template<class T>
+  inline void retire(T* obj)
+  {
+    retire(static_cast<void*>(obj), [](void* p) { delete static_cast<T*>(p); });
+  }
+
+  /// Advance the epoch and free all objects that no reader can see anymore.
+  /// Called by the background thread, can also be called by any unpinned thread.
+  /// Returns the number of freed objects.
+  size_t reclaim();
+
+  /// Start the background thread, otherwise objects are only freed in reclaim().
+  void startThread();
+
+  /// Stop the background thread.
+  void stopThread();
+
+  /// Number of retired objects which were not yet freed.
+  size_t nPending() const;
+
+private:
+  typedef void (*Deleter)(void*);
+  struct Retired {
+    uint64_t epoch;   //!< Global epoch when the object was retired.
+    void* obj;
+    Deleter deleter;
+  };
+
+  static const uint64_t kUnpinned = 0;
+
+  std::atomic<uint64_t> epoch_;                 //!< Global epoch, starts at 1.
+  mutable std::atomic<uint64_t> readers_[kMaxReaders]; //!< Epoch of the reader when it was pinned or kUnpinned.
+  std::vector<Retired> retired_;                //!< Objects waiting to be freed.
+  mutable std::mutex retired_mut_;
+  std::mutex reclaim_mut_;                      //!< Serializes reclaim() calls.
+  std::condition_variable cond_;
+  std::thread* thread_;
+  bool thread_halt_;
+
+  void retire(void* obj, Deleter deleter);
+
+  /// Background loop, wakes up periodically or when many objects are pending.
+  void reclaimLoop();
+};
+
+} // namespace svo
+
+#endif // SVO_EPOCH_RECLAIMER_H_
@@ -18,6 +18,7 @@
 #define SVO_FEATURE_H_
 
 #include <svo/frame.h>
+#include <svo/point.h>
 
 namespace svo {
 
@@ -36,7 +37,7 @@ struct Feature
   Vector2d px;          //!< Coordinates in pixels on pyramid level 0.
   Vector3d f;           //!< Unit-bearing vector of the feature.
   int level;            //!< Image pyramid level where feature was extracted.
-  Point* point;         //!< Pointer to 3D point which corresponds to the feature.
+  PointRef point;       //!< Handle of the 3D point which corresponds to the feature, NULL once the point is deleted.
   Vector2d grad;        //!< Dominant gradient direction for edglets, normalized.
 
   Feature(Frame* _frame, const Vector2d& _px, int _level) :
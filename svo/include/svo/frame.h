@@ -17,6 +17,7 @@
 #ifndef SVO_FRAME_H_
 #define SVO_FRAME_H_
 
+#include <atomic>
 #include <sophus/se3.hpp>
 #include <vikit/math_utils.h>
 #include <vikit/abstract_camera.h>
@@ -43,7 +44,7 @@ class Frame : public vilib::Frame // boost::noncopyable
 public:
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     
-    static int                    frame_counter_;         //!< Counts the number of created frames. Used to set the unique id.
+    static std::atomic<int>       frame_counter_;         //!< Counts the number of created frames. Used to set the unique id, frames may be created concurrently.
     int                           id_;                    //!< Unique id of the frame.
     double                        timestamp_;             //!< Timestamp of when the image was recorded.
     vk::AbstractCamera*           cam_;                   //!< Camera model.
@@ -61,8 +62,15 @@ public:
 
     template<class Image>
     Frame(vk::AbstractCamera* cam, const Image& img, double timestamp, size_t n_levels = 4) :
+        Frame(frame_counter_++, cam, img, timestamp, n_levels)
+    {}
+
+    /// Create a frame with an id taken from frame_counter_ beforehand, such
+    /// that the frames of several cameras can be built concurrently.
+    template<class Image>
+    Frame(int id, vk::AbstractCamera* cam, const Image& img, double timestamp, size_t n_levels = 4) :
         vilib::Frame(img, timestamp, n_levels),
-        id_(frame_counter_++),
+        id_(id),
         timestamp_(timestamp),
         cam_(cam),
         key_pts_(5),
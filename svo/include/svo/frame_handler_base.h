@@ -18,11 +18,13 @@
 #define SVO_FRAME_HANDLER_BASE_H_
 
 #include <queue>
+#include <memory>
 #include <vikit/timer.h>
 #include <vikit/ringbuffer.h>
 #include <svo/global.h>
 #include <svo/map.h>
 #include <svo/frame.h>
+#include <svo/structure_optimizer.h>
 
 namespace vk
 {
@@ -34,6 +36,7 @@ namespace svo
 {
 class Point;
 class Matcher;
+class WorkerPool;
 //class DepthFilter;
 
 /// Base class for various VO pipelines. Manages the map and the state machine.
@@ -98,6 +101,10 @@ protected:
   size_t num_obs_last_;                         //!< Number of observations in the previous frame.
   TrackingQuality tracking_quality_;            //!< An estimate of the tracking quality based on the number of tracked features.
   bool  relocalize_after_track_failed_;         //!< relocalize after track failed, it set to 0, it'll reset when track failed.
+  size_t epoch_slot_;                           //!< Reader slot of the tracking thread in the map reclaimer while a frame is processed.
+  std::vector<Point*> structure_pts_;           //!< Candidate points of the structure optimization, reused.
+  structure_optimizer::Workspace structure_ws_; //!< Gathered observations of the structure optimization.
+  std::unique_ptr<WorkerPool> structure_pool_;  //!< Workers of the structure optimization.
 
   /// Before a frame is processed, this function is called.
   bool startFrameProcessingCommon(const double timestamp);
@@ -121,6 +128,11 @@ protected:
   virtual void optimizeStructure(FramePtr frame, size_t max_n_pts, int max_iter);
 
   virtual void optimizeStructure(FrameBundle::Ptr frame, size_t max_n_pts, int max_iter);
+
+  /// Optimize the points in structure_pts_ which were not optimized for the
+  /// longest time: max_n_pts of them, or as many as fit in the time budget
+  /// Config::structureOptimBudget(). Optimized points are marked with stamp.
+  void optimizeStructurePoints(const int stamp, size_t max_n_pts, const int max_iter);
 };
 
 } // namespace nslam
@@ -23,6 +23,10 @@
 #include <svo/depth_filter.h>
 #include <svo/reprojector.h>
 #include <svo/initialization.h>
+#include <svo/sparse_ba.h>
+#include <svo/mapping_thread.h>
+#include <svo/sliding_window_ba.h>
+#include <svo/frame_ingestion.h>
 
 namespace svo {
 
@@ -34,12 +38,31 @@ public:
 
     FrameHandlerMono(std::shared_ptr<vk::AbstractCamera> cam, std::shared_ptr<vilib::DetectorBaseGPU> detector);
 
+    /// Writes the lifetimes of the seeds to the trace directory.
+    virtual ~FrameHandlerMono();
+
     /// Provide an image.
     void addImage(const cv::Mat& img, double timestamp);
 
     /// Provide an image frame.
     void addImage(std::unique_ptr<Frame> frame, double timestamp);
 
+    /// Start the asynchronous ingestion with the queue options from Config.
+    /// Images passed to addImageAsync() are turned into frames in one thread
+    /// while the previous frame is tracked in another. The output callback is
+    /// called in the tracking thread after each frame.
+    void startIngestion(const FrameIngestion::output_t& output);
+
+    /// Stop the asynchronous ingestion, queued images are discarded.
+    void stopIngestion();
+
+    /// Queue an image for the asynchronous ingestion. Returns false if the
+    /// ingestion is not running.
+    bool addImageAsync(const cv::Mat& img, double timestamp);
+
+    /// Access the ingestion stage, e.g. to wait for the queued images.
+    FrameIngestion* ingestion() const { return ingestion_.get(); }
+
     /// Set the first frame (used for synthetic datasets in benchmark node)
     void setFirstFrame(const FramePtr& first_frame);
 
@@ -49,6 +72,9 @@ public:
     /// Get the set of spatially closest keyframes of the last frame.
     const std::set<FramePtr>& coreKeyframes() { return core_kfs_; }
 
+    /// Access the depth filter.
+    DepthFilter* depthFilter() const { return depth_filter_.get(); }
+
     /// Return the feature track to visualize the KLT tracking during initialization.
     const std::vector<cv::Point2f>& initFeatureTrackRefPx() const { return klt_homography_init_.px_ref_; }
     const std::vector<cv::Point2f>& initFeatureTrackCurPx() const { return klt_homography_init_.px_cur_; }
@@ -69,10 +95,17 @@ protected:
     std::vector<std::pair<FramePtr,size_t>> overlap_kfs_; //!< All keyframes with overlapping field of view. the paired number specifies how many common mappoints are observed TODO: why vector!?
     initialization::KltHomographyInit klt_homography_init_; //!< Used to estimate pose of the first two keyframes by estimating a homography.
     std::unique_ptr<DepthFilter> depth_filter_;   //!< Depth estimation algorithm runs in a parallel thread and is used to initialize new 3D points.
+    SparseBA local_ba_;                           //!< Local bundle adjustment if g2o is not available.
+    MappingThread mapping_thread_;                //!< Runs the local bundle adjustment in the background if enabled.
+    SlidingWindowBA window_ba_;                   //!< Local bundle adjustment over the last keyframes if enabled.
+    std::unique_ptr<FrameIngestion> ingestion_;   //!< Builds the next frame while the current one is tracked, if started.
 
     /// Initialize the visual odometry algorithm.
     virtual void initialize(std::shared_ptr<vilib::DetectorBaseGPU> detector);
 
+    /// Process a frame whose pyramid is built.
+    void addFrame(const FramePtr& frame, double timestamp);
+
     /// Processes the first frame and sets it as a keyframe.
     virtual UpdateResult processFirstFrame();
 
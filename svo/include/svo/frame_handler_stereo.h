@@ -22,10 +22,14 @@
 #include <svo/frame_handler_base.h>
 #include <svo/reprojector.h>
 #include <svo/depth_filter.h>
+#include <svo/replay_buffer.h>
 #include <svo/initialization.h>
+#include <svo/frame_ingestion.h>
 
 namespace svo {
 
+class WorkerPool;
+
 typedef std::shared_ptr<FrameBundle> FrameBundlePtr;
 
 /// Monocular Visual Odometry Pipeline as described in the SVO paper.
@@ -34,11 +38,28 @@ class FrameHandlerStereo : public FrameHandlerBase
 public:
   EIGEN_MAKE_ALIGNED_OPERATOR_NEW
   
-  FrameHandlerStereo(std::shared_ptr<vk::AbstractCamera> cam);
+  FrameHandlerStereo(std::shared_ptr<vk::AbstractCamera> cam, std::shared_ptr<vilib::DetectorBaseGPU> detector);
+
+  virtual ~FrameHandlerStereo();
 
   /// Provide an image.
   void addImage(const cv::Mat& img_left, const cv::Mat& img_right, double timestamp);
 
+  /// Start the asynchronous ingestion with the queue options from Config, the
+  /// pyramids of both cameras are built while the previous frame is tracked.
+  /// The output callback is called in the tracking thread after each frame.
+  void startIngestion(const FrameIngestion::output_t& output);
+
+  /// Stop the asynchronous ingestion, queued images are discarded.
+  void stopIngestion();
+
+  /// Queue an image pair for the asynchronous ingestion. Returns false if the
+  /// ingestion is not running.
+  bool addImagesAsync(const cv::Mat& img_left, const cv::Mat& img_right, double timestamp);
+
+  /// Access the ingestion stage, e.g. to wait for the queued images.
+  FrameIngestion* ingestion() const { return ingestion_.get(); }
+
   /// Get the last frame that has been processed.
   FrameBundlePtr lastFrames() { return last_frames_; }
 
@@ -57,6 +78,8 @@ public:
 protected:
   std::shared_ptr<vk::AbstractCamera> cam_;                     //!< Camera model, can be ATAN, Pinhole or Ocam (see vikit).
   Reprojector reprojector_;                     //!< Projects points from other keyframes into the current frame
+  Reprojector reprojector_right_;               //!< Reprojector of the right camera, if the cameras are processed in parallel.
+  std::unique_ptr<WorkerPool> camera_pool_;     //!< One worker per camera, used by the tracking thread.
   FrameBundlePtr new_frames_;                   //!< Current frame.
   FrameBundlePtr last_frames_;                  //!< Last frame, not necessarily a keyframe.
   std::set<FramePtr> core_kfs_;                      //!< Keyframes in the closer neighbourhood.
@@ -64,14 +87,24 @@ protected:
   std::unique_ptr<DepthFilter> depth_filter_;                   //!< Depth estimation algorithm runs in a parallel thread and is used to initialize new 3D points.
 
   FrameBundlePtr last_keyframes_;               //!< Last keyframes, used at keyframe selection.
-  std::deque<FrameBundlePtr> history_frames_;   //!< history frames, used at depth filter.
+  ReplayBuffer history_frames_;                 //!< Poses and pyramids of the last frames, replayed in the depth filter.
 
   Sophus::SE3d last_imu_pose_;                   //!< Last pose before lost, after reset use this pose to init first pose.
 
   initialization::KltHomographyInit initializer;
+  std::unique_ptr<FrameIngestion> ingestion_;   //!< Builds the next frames while the current ones are tracked, if started.
+
+  /// Create the frame of the left (0) or right (1) camera with its pyramid.
+  FramePtr createFrame(const size_t cam_index, const int frame_id, const cv::Mat& img, const double timestamp);
+
+  /// Workers to process the cameras in parallel, NULL if disabled in Config.
+  WorkerPool* cameraPool();
+
+  /// Process the frames of both cameras, whose pyramids are built.
+  void addFrames(const FramePtr& frame_left, const FramePtr& frame_right, const double timestamp);
 
   /// Initialize the visual odometry algorithm.
-  virtual void initialize();
+  virtual void initialize(std::shared_ptr<vilib::DetectorBaseGPU> detector);
 
   /// Processes the first frame and sets it as a keyframe.
   virtual UpdateResult processFirstFrame();
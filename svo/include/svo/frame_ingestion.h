@@ -0,0 +1,155 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_FRAME_INGESTION_H_
+#define SVO_FRAME_INGESTION_H_
+
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+#include <svo/global.h>
+
+namespace svo {
+
+class WorkerPool;
+
+/// Asynchronous ingestion of camera images in front of the frame handler.
+///
+/// Images are queued by the driver. The ingestion thread builds the frames
+/// and their pyramids, the tracking thread hands them to the frame handler.
+/// At most one built frame waits for the tracker, so the pyramids of frame
+/// N+1 are created while frame N is tracked. The input queue is bounded:
+/// when it is full, either the oldest image is dropped (latest wins) or the
+/// caller blocks. After a frame is tracked, its timings and the end-to-end
+/// latency are passed to the output callback.
+class FrameIngestion
+{
+public:
+  enum DropPolicy {
+    DROP_OLDEST,                //!< Latest wins, the oldest queued image is dropped.
+    BLOCK                       //!< The caller waits until there is space.
+  };
+
+  struct Options
+  {
+    size_t queue_size;          //!< maximum number of images waiting for the ingestion thread.
+    DropPolicy drop_policy;
+    size_t n_threads;           //!< threads building the frames of the cameras in parallel, read in startThreads().
+    Options() :
+      queue_size(2),
+      drop_policy(DROP_OLDEST),
+      n_threads(1)
+    {}
+  } options_;
+
+  /// Timings of one frame, from the sensor to the pose.
+  struct FrameStats
+  {
+    double timestamp;           //!< Sensor timestamp in seconds.
+    double queue_ms;            //!< Waiting in the input queue.
+    double pyramid_ms;          //!< Copying the images and creating the pyramids.
+    double wait_ms;             //!< Built frame waiting for the tracker.
+    double tracking_ms;
+    double total_ms;            //!< From addImages() to the pose.
+    double latency_ms;          //!< From the sensor timestamp to the pose, valid if timestamps are on the system clock.
+  };
+
+  struct Stats
+  {
+    size_t n_received;
+    size_t n_dropped;
+    size_t n_tracked;
+    Stats() : n_received(0), n_dropped(0), n_tracked(0) {}
+  };
+
+  /// Build the frame of camera cam_index, in the ingestion thread. With
+  /// several threads, the frames of the cameras are built concurrently. The
+  /// frame ids are reserved before, consecutive in camera order.
+  typedef std::function<FramePtr (size_t cam_index, int frame_id, const cv::Mat& img, double timestamp)> build_t;
+
+  /// Track the frames of all cameras, in the tracking thread.
+  typedef std::function<void (const std::vector<FramePtr>& frames, double timestamp)> track_t;
+
+  /// Called in the tracking thread after a frame is tracked, before the next
+  /// one is. The frame handler may be queried here, e.g. for the pose.
+  typedef std::function<void (const FrameStats& stats)> output_t;
+
+  FrameIngestion(const build_t& build, const track_t& track, const output_t& output);
+  ~FrameIngestion();
+
+  FrameIngestion(const FrameIngestion&) = delete;
+  FrameIngestion& operator=(const FrameIngestion&) = delete;
+
+  void startThreads();
+
+  /// Stop both threads. Queued images and a waiting frame are discarded.
+  void stopThreads();
+
+  inline bool isRunning() const { return ingestion_thread_ != nullptr; }
+
+  /// Queue the images of all cameras taken at timestamp. The images are
+  /// referenced, not copied, until the ingestion thread built the frames, so
+  /// the caller must not write into them afterwards. Returns false if the
+  /// images were not queued because the threads are not running.
+  bool addImages(const std::vector<cv::Mat>& imgs, double timestamp);
+
+  /// Wait until all queued images are tracked.
+  void flush();
+
+  Stats stats() const;
+
+private:
+  typedef std::unique_lock<std::mutex> lock_t;
+  typedef std::chrono::steady_clock clock_t;
+
+  struct Item
+  {
+    std::vector<cv::Mat> imgs;
+    std::vector<FramePtr> frames;
+    double timestamp;
+    clock_t::time_point t_added;
+    clock_t::time_point t_started;      //!< Ingestion started.
+    clock_t::time_point t_built;
+  };
+
+  build_t build_;
+  track_t track_;
+  output_t output_;
+  std::unique_ptr<std::thread> ingestion_thread_;
+  std::unique_ptr<std::thread> tracking_thread_;
+  std::unique_ptr<WorkerPool> build_pool_;      //!< Used by the ingestion thread only, if there are several threads.
+  mutable std::mutex mut_;
+  std::condition_variable cond_;        //!< Signals every change of the state below.
+  bool halt_;
+  std::deque<Item> queue_;              //!< Images waiting for the ingestion thread.
+  bool building_;                       //!< The ingestion thread is building frames.
+  std::unique_ptr<Item> ready_;         //!< Built frames waiting for the tracker.
+  bool tracking_;                       //!< The tracker is busy.
+  Stats stats_;
+
+  void ingestionLoop();
+  void trackingLoop();
+};
+
+} // namespace svo
+
+#endif // SVO_FRAME_INGESTION_H_
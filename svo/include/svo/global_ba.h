@@ -0,0 +1,126 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_GLOBAL_BA_H_
+#define SVO_GLOBAL_BA_H_
+
+#include <vector>
+#include <svo/global.h>
+#include <svo/map_snapshot.h>
+
+namespace svo {
+
+/// Offline refinement of all keyframes and points of a map snapshot.
+///
+/// If the reduced system of the sparse bundle adjustment fits the memory
+/// budget, all poses and points are optimized jointly; the first two
+/// keyframes are fixed. Otherwise, a pose graph is optimized instead: every
+/// keyframe is connected to the keyframes with which it shares most points,
+/// the relative pose of each pair is refined with a two-view bundle adjustment
+/// and its information is taken from the reduced system. Afterwards the points
+/// follow their first keyframe and are refined with the new poses. The memory
+/// of the pose graph is linear in the number of keyframes.
+class GlobalBA
+{
+public:
+  struct Options
+  {
+    size_t n_iter;              //!< number of iterations of the bundle adjustment and of the pose graph.
+    int n_threads;              //!< number of workers including the calling thread.
+    size_t max_bytes;           //!< memory budget of the bundle adjustment, the pose graph is used above.
+    double huber_width;         //!< width of the Huber kernel on the weighted error on the unit plane.
+    size_t n_neighbours;        //!< number of covisible keyframes connected to each keyframe in the pose graph.
+    size_t min_shared_points;   //!< minimum number of shared points of an edge in the pose graph.
+    size_t n_structure_iter;    //!< iterations to refine each point after the pose graph.
+    Options() :
+      n_iter(20),
+      n_threads(4),
+      max_bytes(size_t(1)<<30),
+      huber_width(0.005),
+      n_neighbours(10),
+      min_shared_points(20),
+      n_structure_iter(5)
+    {}
+  } options_;
+
+  struct Stats
+  {
+    bool pose_graph;            //!< The problem did not fit the budget and the pose graph was optimized.
+    size_t n_kfs;
+    size_t n_points;
+    size_t n_edges;             //!< Observations, or relative poses of the pose graph.
+    int n_threads;              //!< Workers that were used.
+    size_t estimated_bytes;     //!< Memory of the bundle adjustment with n_threads workers.
+    double init_error;          //!< Median reprojection error in pixels before the optimization.
+    double final_error;
+    double time_ms;
+    Stats() :
+      pose_graph(false), n_kfs(0), n_points(0), n_edges(0), n_threads(0),
+      estimated_bytes(0), init_error(0.0), final_error(0.0), time_ms(0.0)
+    {}
+  };
+
+  /// Optimize the keyframes and points of the snapshot in place.
+  void optimize(MapSnapshot& map, Stats& stats);
+
+  /// Memory of the sparse bundle adjustment. Dominated by the dense reduced
+  /// system of the poses, which each worker accumulates separately.
+  static size_t estimateBytes(
+      const size_t n_kfs,
+      const size_t n_points,
+      const size_t n_obs,
+      const int n_threads);
+
+  /// Median reprojection error of all observations in pixels.
+  static double medianError(const MapSnapshot& map);
+
+private:
+  /// Relative pose T_b_a with its information, in the tangent space of T_b.
+  struct Edge
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    size_t a;
+    size_t b;
+    SE3d T_b_a;
+    Eigen::Matrix<double,6,6> H;
+  };
+
+  void bundleAdjustment(MapSnapshot& map, const int n_threads, Stats& stats);
+
+  void poseGraph(MapSnapshot& map, Stats& stats);
+
+  /// Pairs of keyframes which share most points.
+  void selectEdges(const MapSnapshot& map, std::vector<Edge, Eigen::aligned_allocator<Edge>>& edges);
+
+  /// Refine the relative pose of every edge in parallel.
+  void estimateEdges(const MapSnapshot& map, std::vector<Edge, Eigen::aligned_allocator<Edge>>& edges);
+
+  /// Gauss-Newton with damping on the relative pose errors, the first
+  /// keyframe is fixed.
+  void optimizePoseGraph(
+      const std::vector<Edge, Eigen::aligned_allocator<Edge>>& edges,
+      std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T_f_w);
+
+  /// Move the points with their first keyframe and refine them.
+  void updateStructure(
+      MapSnapshot& map,
+      const std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T_f_w_old);
+};
+
+} // namespace svo
+
+#endif // SVO_GLOBAL_BA_H_
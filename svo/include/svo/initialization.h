@@ -19,6 +19,7 @@
 
 #include <vilib/feature_detection/detector_base_gpu.h>
 #include <svo/global.h>
+#include <svo/two_view_ransac.h>
 
 namespace svo {
 
@@ -29,7 +30,8 @@ namespace initialization {
 
 enum InitResult { FAILURE, NO_KEYFRAME, SUCCESS };
 
-/// Tracks features using Lucas-Kanade tracker and then estimates a homography.
+/// Tracks features using Lucas-Kanade tracker and then estimates a homography
+/// or an essential matrix, whichever explains the tracks better.
 class KltHomographyInit {
     friend class svo::FrameHandlerMono;
 public:
@@ -52,6 +54,7 @@ protected:
     std::vector<Vector3d> xyz_in_cur_;     //!< 3D points computed during the geometric check.
     SE3d T_cur_from_ref_;                  //!< computed transformation between the first two frames.
     std::shared_ptr<vilib::DetectorBaseGPU> detector_;
+    TwoViewRansac ransac_;                 //!< parallel RANSAC of the relative pose.
 
     /// Detect Fast corners in the image.
     void detectFeatures(
@@ -70,16 +73,6 @@ protected:
             std::vector<double>& disparities);
 };
 
-
-void computeHomography(
-        const std::vector<Vector3d>& f_ref,
-        const std::vector<Vector3d>& f_cur,
-        double focal_length,
-        double reprojection_threshold,
-        std::vector<int>& inliers,
-        std::vector<Vector3d>& xyz_in_cur,
-        SE3d& T_cur_from_ref);
-
 } // namespace initialization
 } // namespace svo
 
@@ -0,0 +1,125 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SVO_KEYFRAME_INDEX_H_
+#define SVO_KEYFRAME_INDEX_H_
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <svo/global.h>
+
+namespace svo {
+
+/// Keyframe container of the map. Keeps the keyframes in insertion order, such
+/// that iteration is deterministic, and indexes them by id and by position.
+/// The positions are stored in a KD-tree which grows with every insertion.
+/// Removed keyframes are only marked in the tree, it is rebuilt balanced when
+/// too many nodes are dead, when it got too deep or when the keyframe poses
+/// changed (see invalidatePositions()). The tree is maintained by the
+/// modifying calls, the const queries only read it. Hence queries may run
+/// concurrently with each other, but not with a modification.
+class KeyframeIndex
+{
+public:
+  typedef std::list<FramePtr> List;
+  typedef List::iterator iterator;
+  typedef List::const_iterator const_iterator;
+  typedef List::value_type value_type;
+
+  KeyframeIndex();
+  ~KeyframeIndex();
+
+  inline iterator begin() { return keyframes_.begin(); }
+  inline iterator end() { return keyframes_.end(); }
+  inline const_iterator begin() const { return keyframes_.begin(); }
+  inline const_iterator end() const { return keyframes_.end(); }
+  inline size_t size() const { return keyframes_.size(); }
+  inline bool empty() const { return keyframes_.empty(); }
+  inline const FramePtr& front() const { return keyframes_.front(); }
+  inline const FramePtr& back() const { return keyframes_.back(); }
+
+  /// Append a keyframe. O(log n) amortized.
+  void push_back(const FramePtr& frame);
+
+  /// Remove a keyframe, returns false if it is not in the container. O(1).
+  bool erase(const FramePtr& frame);
+
+  /// Remove all keyframes.
+  void clear();
+
+  /// Return the keyframe with the given id or NULL. O(1).
+  FramePtr find(int id) const;
+
+  /// The keyframe poses changed (e.g. bundle adjustment or map transformation),
+  /// rebuild the spatial index. O(n log n).
+  void invalidatePositions();
+
+  /// Keyframe which is furthest away from pos. On ties, the older keyframe wins.
+  FramePtr furthest(const Vector3d& pos) const;
+
+  /// The k keyframes closest to pos, sorted by increasing distance.
+  void nearest(const Vector3d& pos, size_t k, std::vector<FramePtr>& kfs) const;
+
+  /// All keyframes within radius of pos, sorted by increasing distance.
+  void withinRadius(const Vector3d& pos, double radius, std::vector<FramePtr>& kfs) const;
+
+private:
+  struct Node
+  {
+    Vector3d pos;
+    iterator kf;        //!< Position in the list, only valid if the node is alive.
+    size_t seq;         //!< Insertion sequence number, used to break ties deterministically.
+    int left;
+    int right;
+    int axis;
+    bool alive;
+    Vector3d bb_min;    //!< Bounding box of the subtree.
+    Vector3d bb_max;
+  };
+  struct Entry
+  {
+    iterator it;
+    size_t seq;
+    int node;
+  };
+  typedef std::pair<double, size_t> Hit; //!< Squared distance and node index.
+
+  List keyframes_;
+  std::unordered_map<int, Entry> entries_;  //!< Keyframe id to position in list and tree.
+  size_t seq_counter_;
+  std::vector<Node> nodes_;
+  int root_;
+  size_t n_dead_;
+  int depth_;
+
+  /// Rebuild a balanced tree from the alive keyframes if required.
+  void ensureTree();
+  void rebuild();
+  int build(std::vector<int>& idx, size_t begin, size_t end, int depth);
+  void insertNode(int n);
+
+  void furthestRecursive(int n, const Vector3d& pos, Hit& best) const;
+  void nearestRecursive(int n, const Vector3d& pos, size_t k, std::vector<Hit>& heap) const;
+  void radiusRecursive(int n, const Vector3d& pos, double radius2, std::vector<Hit>& hits) const;
+
+  /// Compare hits by distance, then by insertion order.
+  bool closer(const Hit& a, const Hit& b) const;
+};
+
+} // namespace svo
+
+#endif // SVO_KEYFRAME_INDEX_H_
@@ -0,0 +1,67 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_KLT_H_
+#define SVO_KLT_H_
+
+#include <vector>
+#include <stdint.h>
+#include <svo/global.h>
+#include <svo/frame.h>
+
+namespace svo {
+
+/// Pyramidal Lucas-Kanade tracking on the image pyramids of the frames, such
+/// that no pyramid has to be built or copied for the tracking.
+namespace klt {
+
+struct Options
+{
+  int half_win_size;            //!< the window has 2*half_win_size+1 pixels per side on every level.
+  int max_level;                //!< highest pyramid level, limited by the pyramids.
+  int n_iter;                   //!< maximum number of iterations per level.
+  float eps;                    //!< stop if the update is smaller, in pixels.
+  float min_eig;                //!< minimum eigenvalue of the gradient matrix per pixel of the window.
+  Options() :
+    half_win_size(15),
+    max_level(4),
+    n_iter(30),
+    eps(0.001f),
+    min_eig(0.1f)
+  {}
+};
+
+/// Views of the pyramid levels of a frame. Levels in host memory are not
+/// copied, levels in device memory are downloaded.
+void pyramidViews(const vilib::Frame& frame, ImgPyr& views);
+
+/// Track the points px_ref from the reference to the current pyramid. px_cur
+/// holds the initial estimates on level 0 and returns the tracked positions.
+/// status is zero for points which left the image or lie in a region without
+/// texture.
+void trackPoints(
+    const ImgPyr& pyr_ref,
+    const ImgPyr& pyr_cur,
+    const std::vector<cv::Point2f>& px_ref,
+    std::vector<cv::Point2f>& px_cur,
+    std::vector<uint8_t>& status,
+    const Options& options = Options());
+
+} // namespace klt
+} // namespace svo
+
+#endif // SVO_KLT_H_
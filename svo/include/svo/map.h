@@ -17,38 +17,54 @@
 #ifndef SVO_MAP_H_
 #define SVO_MAP_H_
 
-#include <queue>
-#include <mutex>
+#include <map>
+#include <atomic>
+#include <unordered_map>
 #include <svo/global.h>
+#include <svo/epoch_reclaimer.h>
+#include <svo/keyframe_index.h>
 
 namespace svo {
 
 class Point;
 class Feature;
-class Seed;
 
 /// Container for converged 3D points that are not already assigned to two keyframes.
+/// The depth-filter thread hands over converged points through a lock-free
+/// queue, everything else is only accessed by the tracking thread. Candidates
+/// are bucketed by the keyframe they were observed in and a point-to-slot hash
+/// makes removal of a single candidate O(1). The filter removes the seeds of a
+/// keyframe only after the map did, so candidates of keyframes which are not in
+/// the map anymore are deleted when they are taken from the queue.
 class MapPointCandidates
 {
 public:
   typedef std::pair<Point*, Feature*> PointCandidate;
-  typedef std::list<PointCandidate> PointCandidateList;
+  typedef std::vector<PointCandidate> Bucket;
+  typedef std::map<int, Bucket> BucketMap;
 
-  /// The depth-filter is running in a parallel thread and fills the canidate list.
-  /// This mutex controls concurrent access to point_candidates.
-  std::mutex mut_;
+  /// Candidate points are created from converged seeds, bucketed by the id of
+  /// the keyframe in which they were observed. Until the next keyframe, these
+  /// points can be used for reprojection and pose optimization.
+  BucketMap buckets_;
 
-  /// Candidate points are created from converged seeds.
-  /// Until the next keyframe, these points can be used for reprojection and pose optimization.
-  PointCandidateList candidates_;
-  std::list< Point* > trash_points_;
+  /// Deleted candidates are retired here, set by the map.
+  EpochReclaimer* reclaimer_;
+
+  /// Keyframes of the map, set by the map. Candidates are only accepted if
+  /// their keyframe is in the map, all are accepted if NULL.
+  const KeyframeIndex* keyframes_;
 
   MapPointCandidates();
   ~MapPointCandidates();
 
-  /// Add a candidate point.
+  /// Add a candidate point. Called by the depth-filter thread, never blocks.
   void newCandidatePoint(Point* point, double depth_sigma2);
 
+  /// Move the points that the depth-filter handed over into the buckets. Points
+  /// of removed keyframes are deleted, their keyframe may be freed already.
+  void processHandoffQueue();
+
   /// Adds the feature to the frame and deletes candidate from list.
   void addCandidatePointToFrame(FramePtr frame);
 
@@ -61,17 +77,42 @@ public:
   /// Reset the candidate list, remove and delete all points.
   void reset();
 
-  void deleteCandidate(PointCandidate& c);
+  /// Number of candidates, not counting the ones in the handoff queue.
+  inline size_t size() const { return slots_.size(); }
+
+private:
+  /// Position of a candidate in the buckets.
+  struct Slot {
+    int kf_id;
+    size_t idx;
+  };
+
+  /// Node of the intrusive lock-free stack filled by the depth-filter.
+  struct HandoffNode {
+    PointCandidate candidate;
+    int kf_id;            //!< Id of the keyframe, read while the depth-filter keeps it alive.
+    HandoffNode* next;
+  };
 
-  void emptyTrash();
+  std::unordered_map<Point*, Slot> slots_;     //!< Position of each candidate in the buckets.
+  std::atomic<HandoffNode*> handoff_head_;     //!< Converged points that were not yet moved into the buckets.
+
+  /// Remove the candidate from its bucket, the last candidate of the bucket takes its slot.
+  void eraseSlot(const Slot& slot);
+
+  /// Delete the candidate point and its feature. Other frames that still
+  /// reference the point hold a handle, which becomes stale immediately. The
+  /// memory is freed by the reclaimer once no reader can access it.
+  void deleteCandidate(PointCandidate& c);
 };
 
 /// Map object which saves all keyframes which are in a map.
 class Map
 {
 public:
-  std::list< FramePtr > keyframes_;          //!< List of keyframes in the map.
-  std::list< Point* > trash_points_;         //!< A deleted point is moved to the trash bin. Now and then this is cleaned. One reason is that the visualizer must remove the points also.
+  EpochReclaimer reclaimer_;                 //!< Frees deleted points once no reader can access them anymore. Declared first such that it is destroyed last.
+  KeyframeIndex keyframes_;                  //!< Keyframes in the map in insertion order, indexed by id and position.
+  std::vector< int > deleted_point_ids_;     //!< Ids of the points deleted since the last frame, the visualizer must remove the points also.
   MapPointCandidates point_candidates_;
 
   Map(const Map&) = delete;
@@ -85,7 +126,8 @@ public:
   /// Delete a point in the map and remove all references in keyframes to it.
   void safeDeletePoint(Point* pt);
 
-  /// Moves the point to the trash queue which is cleaned now and then.
+  /// Invalidates the handle of the point and retires it. The point is freed in
+  /// the background once no reader can access it anymore.
   void deletePoint(Point* pt);
 
   /// Moves the frame to the trash queue which is cleaned now and then.
@@ -106,15 +148,22 @@ public:
   /// Return the keyframe which is furthest apart from pos.
   FramePtr getFurthestKeyframe(const Vector3d& pos) const;
 
+  /// Return the k keyframes closest to pos, sorted by distance.
+  void getNearestKeyframes(const Vector3d& pos, size_t k, std::vector<FramePtr>& kfs) const;
+
+  /// Return all keyframes within radius of pos, sorted by distance.
+  void getKeyframesInRadius(const Vector3d& pos, double radius, std::vector<FramePtr>& kfs) const;
+
+  /// Lookup a keyframe by its id in O(1).
   bool getKeyframeById(const int id, FramePtr& frame) const;
 
   /// Transform the whole map with rotation R, translation t and scale s.
   void transform(const Matrix3d& R, const Vector3d& t, const double& s);
 
-  /// Empty trash bin of deleted keyframes and map points. We don't delete the
-  /// points immediately to ensure proper cleanup and to provide the visualizer
-  /// a list of objects which must be removed.
-  void emptyTrash();
+  /// Forget the ids of the points deleted during the last frame, which were
+  /// provided to the visualizer. Also compacts the point store, hence threads
+  /// that resolve point handles must be pinned in the reclaimer.
+  void clearDeletedPoints();
 
   /// Return the keyframe which was last inserted in the map.
   inline FramePtr lastKeyframe() { return keyframes_.back(); }
@@ -0,0 +1,91 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_MAP_SNAPSHOT_H_
+#define SVO_MAP_SNAPSHOT_H_
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <svo/global.h>
+
+namespace svo {
+
+class Map;
+
+/// Keyframe poses, points and observations of a map without the images. A
+/// snapshot is small enough to be saved at the end of a session and to be
+/// optimized offline with thousands of keyframes.
+class MapSnapshot
+{
+public:
+  struct Keyframe
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    int id;
+    double timestamp;
+    SE3d T_f_w;
+  };
+
+  struct Landmark
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    int id;
+    Vector3d pos;
+  };
+
+  struct Observation
+  {
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    uint32_t kf;                //!< Index of the keyframe.
+    uint32_t point;             //!< Index of the point.
+    Vector2d uv;                //!< Measurement on the unit plane.
+    int level;                  //!< Pyramid level of the feature.
+  };
+
+  std::vector<Keyframe, Eigen::aligned_allocator<Keyframe>> kfs_;       //!< Keyframes in the order of the map.
+  std::vector<Landmark, Eigen::aligned_allocator<Landmark>> points_;
+  std::vector<Observation, Eigen::aligned_allocator<Observation>> obs_;
+  double error_multiplier2_;    //!< Focal length of the camera, converts errors to pixels.
+
+  MapSnapshot();
+
+  void clear();
+
+  /// Copy the keyframes and the points they observe. Call from the tracking
+  /// thread.
+  void fromMap(const Map& map);
+
+  /// Binary file, see map_snapshot.cpp for the layout. Returns false on
+  /// failure. A truncated or corrupt file leaves the snapshot empty, the
+  /// counts in the header are checked against the size of the file before
+  /// anything is allocated.
+  bool save(const std::string& path) const;
+  bool load(const std::string& path);
+
+  /// Write the poses of the keyframes T_w_f, one per line as
+  /// "timestamp tx ty tz qx qy qz qw".
+  bool saveTrajectory(const std::string& path) const;
+
+private:
+  /// Read the file into the cleared snapshot, may stop half way.
+  bool loadFile(const std::string& path);
+};
+
+} // namespace svo
+
+#endif // SVO_MAP_SNAPSHOT_H_
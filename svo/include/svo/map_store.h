@@ -0,0 +1,280 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SVO_MAP_STORE_H_
+#define SVO_MAP_STORE_H_
+
+#include <atomic>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <svo/epoch_reclaimer.h>
+
+namespace svo {
+
+/// Generation-checked 32-bit reference to an object in a HandleStore.
+/// The lower bits index a slot of the store, the upper bits hold the generation
+/// of that slot when the handle was issued. Erasing the object bumps the
+/// generation, hence a stale handle is detected in O(1) without touching the
+/// object it used to reference. The generation wraps after 1024 reuses of a
+/// slot, the store delays the reuse of slots to make this unlikely.
+class Handle
+{
+public:
+  static const int      kIndexBits = 22;
+  static const uint32_t kIndexMask = (1u << kIndexBits) - 1;
+  static const uint32_t kGenerationMask = (1u << (32 - kIndexBits)) - 1;
+  static const uint32_t kInvalid = 0xffffffff;
+
+  Handle() : value_(kInvalid) {}
+
+  Handle(uint32_t index, uint32_t generation) :
+    value_(((generation & kGenerationMask) << kIndexBits) | (index & kIndexMask))
+  {}
+
+  /// Index of the slot in the store.
+  inline uint32_t index() const { return value_ & kIndexMask; }
+
+  /// Generation of the slot when the handle was issued.
+  inline uint32_t generation() const { return value_ >> kIndexBits; }
+
+  /// Raw 32-bit value, e.g. for serialization.
+  inline uint32_t value() const { return value_; }
+
+  /// Handle does not reference anything.
+  inline bool isValid() const { return value_ != kInvalid; }
+
+  static inline Handle fromValue(uint32_t value) { Handle h; h.value_ = value; return h; }
+
+  inline bool operator==(const Handle& other) const { return value_ == other.value_; }
+  inline bool operator!=(const Handle& other) const { return value_ != other.value_; }
+  inline bool operator<(const Handle& other) const { return value_ < other.value_; }
+
+private:
+  uint32_t value_;
+};
+
+/// Slot table which maps handles to objects. The store does not own the
+/// objects, it only tracks whether a handle is still alive. Insertion and
+/// removal are serialized with a mutex, lookups are lock-free and can run
+/// concurrently from other threads. Slots are allocated in fixed-size chunks
+/// that never move, so lookups stay valid while the table grows. Only
+/// compact() releases chunks, it hands them to a reclaimer, hence concurrent
+/// lookups must be made by readers pinned in that reclaimer.
+///
+/// Free slots are reused in FIFO order and only once kMinFreeSlots are free,
+/// so a slot is reused at most once every kMinFreeSlots erasures. compact()
+/// does not trim slots which are still waiting, nor reorder them. A stale
+/// handle can only alias a new object after its slot generation wrapped, i.e.
+/// after more than a million erasures.
+template<class T>
+class HandleStore
+{
+public:
+  static const int      kChunkBits = 12;
+  static const uint32_t kChunkSize = 1u << kChunkBits;
+  static const uint32_t kMaxChunks = (Handle::kIndexMask >> kChunkBits) + 1;
+  static const size_t   kMinFreeSlots = 1024;
+
+  HandleStore() :
+    n_slots_(0),
+    size_(0)
+  {
+    for(uint32_t i=0; i<kMaxChunks; ++i)
+    {
+      chunks_[i].store(NULL, std::memory_order_relaxed);
+      chunk_generation_[i] = 0;
+    }
+  }
+
+  ~HandleStore()
+  {
+    for(uint32_t i=0; i<kMaxChunks; ++i)
+      delete chunks_[i].load(std::memory_order_relaxed);
+  }
+
+  HandleStore(const HandleStore&) = delete;
+  HandleStore& operator=(const HandleStore&) = delete;
+
+  /// Register an object and return the handle which references it.
+  Handle insert(T* obj)
+  {
+    std::lock_guard<std::mutex> lock(mut_);
+    uint32_t idx;
+    // last index is reserved for the invalid handle
+    if(free_.size() > kMinFreeSlots || (!free_.empty() && n_slots_ >= Handle::kIndexMask))
+    {
+      idx = free_.front();
+      free_.pop_front();
+    }
+    else
+    {
+      if(n_slots_ >= Handle::kIndexMask)
+        return Handle();
+      idx = n_slots_++;
+      const uint32_t c = idx >> kChunkBits;
+      if(chunks_[c].load(std::memory_order_relaxed) == NULL)
+      {
+        Chunk* chunk = new Chunk;
+        for(uint32_t i=0; i<kChunkSize; ++i)
+        {
+          chunk->slots[i].generation.store(chunk_generation_[c], std::memory_order_relaxed);
+          chunk->slots[i].obj.store(NULL, std::memory_order_relaxed);
+        }
+        chunks_[c].store(chunk, std::memory_order_release);
+      }
+    }
+    Slot& s = slot(idx);
+    s.obj.store(obj, std::memory_order_release);
+    ++size_;
+    return Handle(idx, s.generation.load(std::memory_order_relaxed));
+  }
+
+  /// Return the object or NULL if the handle is stale. O(1) and lock-free.
+  inline T* get(Handle h) const
+  {
+    if(!h.isValid())
+      return NULL;
+    const Chunk* chunk = chunks_[h.index() >> kChunkBits].load(std::memory_order_acquire);
+    if(chunk == NULL)
+      return NULL;
+    const Slot& s = chunk->slots[h.index() & (kChunkSize-1)];
+    T* obj = s.obj.load(std::memory_order_acquire);
+    if(s.generation.load(std::memory_order_acquire) != h.generation())
+      return NULL;
+    return obj;
+  }
+
+  /// Check whether the handle still references a live object.
+  inline bool contains(Handle h) const { return get(h) != NULL; }
+
+  /// Invalidate the handle. Returns the object it referenced, or NULL if the
+  /// handle was already stale. If owner is given, the handle is only erased
+  /// while it references owner. The object itself is not destroyed.
+  T* erase(Handle h, const T* owner = NULL)
+  {
+    std::lock_guard<std::mutex> lock(mut_);
+    T* obj = get(h);
+    if(obj == NULL || (owner != NULL && obj != owner))
+      return NULL;
+    Slot& s = slot(h.index());
+    s.obj.store(NULL, std::memory_order_release);
+    s.generation.store((h.generation()+1) & Handle::kGenerationMask, std::memory_order_release);
+    free_.push_back(h.index());
+    --size_;
+    return obj;
+  }
+
+  /// Number of live objects.
+  inline size_t size() const { return size_; }
+
+  /// Number of allocated slots.
+  inline size_t capacity() const { return n_slots_; }
+
+  /// Call f(handle, object) for every live object in ascending slot order.
+  template<class F>
+  void forEach(F f) const
+  {
+    std::lock_guard<std::mutex> lock(mut_);
+    for(uint32_t idx=0; idx<n_slots_; ++idx)
+    {
+      const Slot& s = slot(idx);
+      T* obj = s.obj.load(std::memory_order_acquire);
+      if(obj != NULL)
+        f(Handle(idx, s.generation.load(std::memory_order_relaxed)), obj);
+    }
+  }
+
+  /// Shrink the slot table to the highest live slot and release empty chunks.
+  /// Slots which were freed less than kMinFreeSlots erasures ago are kept, so
+  /// they still wait in the queue. The other free slots are handed out lowest
+  /// index first afterwards, which keeps the live objects packed at the front
+  /// of the table. The released chunks are retired to the reclaimer, such
+  /// that pinned readers may still look up handles into them. Without a
+  /// reclaimer the chunks are freed immediately, then compact() must not run
+  /// concurrently with lookups.
+  void compact(EpochReclaimer* reclaimer)
+  {
+    std::lock_guard<std::mutex> lock(mut_);
+    uint32_t n_used = n_slots_;
+    while(n_used > 0 && slot(n_used-1).obj.load(std::memory_order_relaxed) == NULL)
+      --n_used;
+    const size_t n_aged = (free_.size() > kMinFreeSlots) ? free_.size()-kMinFreeSlots : 0;
+    for(size_t i=n_aged; i<free_.size(); ++i)
+      n_used = std::max(n_used, free_[i]+1);
+    const uint32_t n_chunks_used = (n_used + kChunkSize - 1) >> kChunkBits;
+    for(uint32_t c=n_chunks_used; c<kMaxChunks; ++c)
+    {
+      Chunk* chunk = chunks_[c].load(std::memory_order_relaxed);
+      if(chunk == NULL)
+        continue;
+      // remember the generations, such that handles into a released chunk
+      // remain stale when the chunk is allocated again.
+      uint32_t max_gen = chunk_generation_[c];
+      for(uint32_t i=0; i<kChunkSize; ++i)
+        max_gen = std::max(max_gen, chunk->slots[i].generation.load(std::memory_order_relaxed));
+      chunk_generation_[c] = (max_gen+1) & Handle::kGenerationMask;
+      chunks_[c].store(NULL, std::memory_order_release);
+      if(reclaimer != NULL)
+        reclaimer->retire(chunk);
+      else
+        delete chunk;
+    }
+    n_slots_ = n_used;
+    // only aged slots are trimmed, they are in front of the others
+    const auto it_aged = free_.begin()+n_aged;
+    const auto it_kept = std::remove_if(free_.begin(), it_aged, [&](uint32_t idx){ return idx >= n_used; });
+    std::sort(free_.begin(), it_kept);
+    free_.erase(it_kept, it_aged);
+  }
+
+  /// Invalidate all handles.
+  void clear()
+  {
+    std::vector<Handle> handles;
+    forEach([&](Handle h, T*){ handles.push_back(h); });
+    for(const Handle& h : handles)
+      erase(h);
+  }
+
+private:
+  struct Slot
+  {
+    std::atomic<uint32_t> generation;
+    std::atomic<T*> obj;
+  };
+
+  struct Chunk
+  {
+    Slot slots[kChunkSize];
+  };
+
+  std::atomic<Chunk*> chunks_[kMaxChunks];
+  uint32_t chunk_generation_[kMaxChunks]; //!< Generation of slots when a chunk is (re-)allocated.
+  std::deque<uint32_t> free_;             //!< Free slot indices, the front is reused first.
+  uint32_t n_slots_;                      //!< Number of slots handed out so far.
+  std::atomic<size_t> size_;              //!< Number of live objects.
+  mutable std::mutex mut_;
+
+  inline Slot& slot(uint32_t idx) { return chunks_[idx >> kChunkBits].load(std::memory_order_relaxed)->slots[idx & (kChunkSize-1)]; }
+  inline const Slot& slot(uint32_t idx) const { return chunks_[idx >> kChunkBits].load(std::memory_order_relaxed)->slots[idx & (kChunkSize-1)]; }
+};
+
+} // namespace svo
+
+#endif // SVO_MAP_STORE_H_
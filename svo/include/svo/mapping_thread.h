@@ -0,0 +1,118 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_MAPPING_THREAD_H_
+#define SVO_MAPPING_THREAD_H_
+
+#include <set>
+#include <mutex>
+#include <deque>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+#include <svo/global.h>
+#include <svo/sparse_ba.h>
+
+namespace svo {
+
+class Frame;
+class Map;
+
+/// Runs the local bundle adjustment of new keyframes in a background thread,
+/// such that the tracking thread is not blocked on keyframes.
+///
+/// The problem is set up from a snapshot of the map in the tracking thread,
+/// optimized in the mapping thread and written back by the tracking thread
+/// between two frames, see applyResults(). A keyframe which arrives while the
+/// previous one is optimized waits; a newer keyframe replaces a waiting one.
+class MappingThread
+{
+public:
+  struct Options
+  {
+    int n_threads;              //!< number of workers of one optimization, including the mapping thread.
+    Options() :
+      n_threads(1)
+    {}
+  } options_;
+
+  MappingThread();
+  ~MappingThread();
+
+  MappingThread(const MappingThread&) = delete;
+  MappingThread& operator=(const MappingThread&) = delete;
+
+  void startThread();
+
+  /// Stop the thread. Waiting and finished optimizations are discarded.
+  void stopThread();
+
+  inline bool isRunning() const { return thread_ != nullptr; }
+
+  /// Take a snapshot of the core keyframes and their points and queue the
+  /// local bundle adjustment. Call from the tracking thread.
+  void addKeyframe(Frame* center_kf, std::set<FramePtr>* core_kfs, Map* map);
+
+  /// Write all optimizations that finished since the last call back to the
+  /// map, in the order they were queued. Call from the tracking thread at a
+  /// safe point between frames. Returns the number of applied optimizations;
+  /// the outputs refer to the last one.
+  size_t applyResults(
+      Map* map,
+      size_t& n_incorrect_edges,
+      double& init_error,
+      double& final_error);
+
+  /// Discard waiting and finished optimizations, e.g. when the map is reset.
+  /// A running optimization finishes but is not applied.
+  void reset();
+
+  /// Number of optimizations which are waiting or running.
+  size_t nPending() const;
+
+private:
+  typedef std::unique_lock<std::mutex> lock_t;
+
+  struct Result
+  {
+    std::unique_ptr<SparseBA> ba;
+    SparseBA::Stats stats;
+  };
+
+  std::unique_ptr<std::thread> thread_;
+  mutable std::mutex mut_;
+  std::condition_variable cond_;
+  bool halt_;
+  bool busy_;                                   //!< An optimization is running.
+  size_t generation_;                           //!< Incremented on reset, results of older optimizations are dropped.
+  std::unique_ptr<SparseBA> waiting_;           //!< Set up, but not started yet.
+  std::deque<Result> results_;                  //!< Finished, but not applied yet.
+  std::vector<std::unique_ptr<SparseBA>> free_; //!< Problems whose memory is reused.
+
+  /// Return a problem from the free list or a new one. Requires the lock.
+  std::unique_ptr<SparseBA> acquire();
+
+  /// Clear a problem and put it on the free list. Requires the lock.
+  void release(std::unique_ptr<SparseBA> ba);
+
+  void mappingLoop();
+};
+
+} // namespace svo
+
+#endif // SVO_MAPPING_THREAD_H_
@@ -32,6 +32,7 @@ namespace svo {
 class Point;
 class Frame;
 class Feature;
+struct ReplayFrame;
 
 /// Warp a patch from the reference view to the current view.
 namespace warp {
@@ -70,6 +71,23 @@ void warpAffine(
 
 } // namespace warp
 
+/// Patch search on rectified stereo images.
+namespace stereo {
+
+/// Search the row y of img for the 8x8 patch with the lowest ZMSSD score with
+/// respect to ref_patch. Patch centers from x_begin to x_end (inclusive) are
+/// evaluated, SSE2 is used if available. Returns the best score and sets x_best.
+int searchRowZMSSD(
+    const uint8_t* ref_patch,
+    const uint8_t* img,
+    const int stride,
+    const int y,
+    const int x_begin,
+    const int x_end,
+    int& x_best);
+
+} // namespace stereo
+
 
 /// Patch-matcher for reprojection-matching and epipolar search in triangulation.
 class Matcher
@@ -133,6 +151,29 @@ public:
       const double d_max,
       double& depth);
 
+  /// Same search in a recorded frame, which may not exist anymore.
+  bool findEpipolarMatchDirect(
+      const Frame& ref_frame,
+      const ReplayFrame& cur_frame,
+      const Feature& ref_ftr,
+      const double d_estimate,
+      const double d_min,
+      const double d_max,
+      double& depth);
+
+  /// Find a match of a feature in a second view taken at the same time, e.g.
+  /// the other camera of a stereo rig. If the epipolar line is an image row,
+  /// as on rectified images, the row is searched directly. Otherwise this
+  /// falls back to the general epipolar search.
+  bool findStereoMatch(
+      const Frame& ref_frame,
+      const Frame& cur_frame,
+      const Feature& ref_ftr,
+      const double d_estimate,
+      const double d_min,
+      const double d_max,
+      double& depth);
+
   void createPatchFromPatchWithBorder();
 };
 
@@ -18,6 +18,7 @@
 #define SVO_POINT_H_
 
 #include <svo/global.h>
+#include <svo/map_store.h>
 
 namespace g2o {
   class VertexSBAPointXYZ;
@@ -27,8 +28,10 @@ typedef g2o::VertexSBAPointXYZ g2oPoint;
 namespace svo {
 
 class Feature;
+class Point;
 
 typedef Eigen::Matrix<double, 2, 3> Matrix23d;
+typedef HandleStore<Point> PointStore;
 
 /// A 3D point on the surface of the scene.
 class Point
@@ -45,6 +48,7 @@ public:
 
   static int                  point_counter_;           //!< Counts the number of created points. Used to set the unique id.
   int                         id_;                      //!< Unique ID of the point.
+  Handle                      handle_;                  //!< Handle in the point store. Becomes stale when the point is deleted from the map.
   Vector3d                    pos_;                     //!< 3d pos of the point in the world coordinate frame.
   Vector3d                    normal_;                  //!< Surface normal at point.
   Matrix3d                    normal_information_;      //!< Inverse covariance matrix of normal estimation.
@@ -53,7 +57,6 @@ public:
   size_t                      n_obs_;                   //!< Number of obervations: Keyframes AND successful reprojections in intermediate frames.
   g2oPoint*                   v_pt_;                    //!< Temporary pointer to the point-vertex in g2o during bundle adjustment.
   int                         last_published_ts_;       //!< Timestamp of last publishing.
-  int                         last_projected_kf_id_;    //!< Flag for the reprojection: don't reproject a pt twice.
   PointType                   type_;                    //!< Quality of the point.
   int                         n_failed_reproj_;         //!< Number of failed reprojections. Used to assess the quality of the point.
   int                         n_succeeded_reproj_;      //!< Number of succeeded reprojections. Used to assess the quality of the point.
@@ -65,6 +68,13 @@ public:
   Point(const Point&) = delete;
   Point& operator=(const Point&) = delete;
 
+  /// Store which resolves point handles. Every point registers on construction.
+  static inline PointStore& store()
+  {
+    static PointStore store;
+    return store;
+  }
+
   /// Add a reference to a frame.
   void addFrameRef(Feature* ftr);
 
@@ -84,6 +94,7 @@ public:
   inline size_t nRefs() const { return obs_.size(); }
 
   /// Optimize point position through minimizing the reprojection error.
+  /// To optimize many points, use structure_optimizer::optimizePoints.
   void optimize(const size_t n_iter);
 
   /// Jacobian of point projection on unit plane (focal length = 1) in frame (f).
@@ -104,6 +115,32 @@ public:
   }
 };
 
+/// Non-owning reference to a point through its handle. Behaves like a Point*
+/// but resolves to NULL as soon as the point was deleted from the map, hence
+/// features in frames that are not keyframes never dangle.
+class PointRef
+{
+public:
+  PointRef() {}
+  PointRef(Point* pt) : handle_(pt == NULL ? Handle() : pt->handle_) {}
+
+  inline PointRef& operator=(Point* pt)
+  {
+    handle_ = (pt == NULL) ? Handle() : pt->handle_;
+    return *this;
+  }
+
+  /// Resolve the handle, NULL if the point was deleted.
+  inline Point* get() const { return Point::store().get(handle_); }
+  inline operator Point*() const { return get(); }
+  inline Point* operator->() const { return get(); }
+
+  inline Handle handle() const { return handle_; }
+
+private:
+  Handle handle_;
+};
+
 } // namespace svo
 
 #endif // SVO_POINT_H_
@@ -33,6 +33,11 @@ typedef Eigen::Matrix<double,6,1> Vector6d;
 class Point;
 
 /// Motion-only bundle adjustment. Minimize the reprojection error of a single frame.
+///
+/// The observations are packed once per call into a float workspace that is
+/// kept per thread, so no memory is allocated once it has grown to the largest
+/// frame. error_init and error_final are the median reprojection errors; they
+/// are only computed if compute_median_errors is set, otherwise they are zero.
 namespace pose_optimizer {
 
 void optimizeGaussNewton(
@@ -43,8 +48,10 @@ void optimizeGaussNewton(
     double& estimated_scale,
     double& error_init,
     double& error_final,
-    size_t& num_obs);
+    size_t& num_obs,
+    const bool compute_median_errors = true);
 
+/// Same for a frame bundle, the body pose of the bundle is optimized.
 void optimizeGaussNewton(
     const double reproj_thresh,
     const size_t n_iter,
@@ -53,7 +60,8 @@ void optimizeGaussNewton(
     double& estimated_scale,
     double& error_init,
     double& error_final,
-    size_t& num_obs);
+    size_t& num_obs,
+    const bool compute_median_errors = true);
 
 } // namespace pose_optimizer
 } // namespace svo
@@ -0,0 +1,127 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_REPLAY_BUFFER_H_
+#define SVO_REPLAY_BUFFER_H_
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <stdint.h>
+#include <sophus/se3.hpp>
+#include <svo/global.h>
+#include <svo/frame.h>
+
+namespace vk {
+class AbstractCamera;
+}
+
+namespace svo {
+
+/// What the depth filter needs of a frame to search the epipolar line of a
+/// seed: the pose, the camera and the image pyramid. A replay frame either
+/// views the pyramid of a live frame or owns a block of a replay buffer.
+struct ReplayFrame
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  int                     id_;          //!< Id of the frame the record was taken from.
+  vk::AbstractCamera*     cam_;         //!< Camera model.
+  Sophus::SE3d            T_f_w_;       //!< Transform (f)rame from (w)orld.
+  bool                    is_keyframe_; //!< Was the frame selected as keyframe?
+  ImgPyr                  pyramid_;     //!< Image pyramid, views of the frame or of the pooled block.
+  FramePtr                frame_;       //!< Viewed frame, NULL if the pyramid is stored in a replay buffer.
+  std::shared_ptr<uint8_t> block_;      //!< Pooled memory of the pyramid, returned to the pool on destruction.
+
+  ReplayFrame() : id_(-1), cam_(NULL), is_keyframe_(false) {}
+
+  /// View of a frame, the frame must outlive the view.
+  explicit ReplayFrame(const Frame& frame);
+
+  /// View of a frame, keeps the frame alive.
+  explicit ReplayFrame(const FramePtr& frame);
+
+  /// Project a point from the frame coordinates to the image.
+  Vector2d f2c(const Vector3d& f) const;
+};
+
+typedef std::shared_ptr<const ReplayFrame> ReplayFramePtr;
+
+/// Last frames of the tracking thread, kept to replay them in the depth filter
+/// when a new keyframe initializes seeds. Only the pose and the pyramid levels
+/// used by the epipolar search are copied, into blocks of a pool bounded by a
+/// byte budget. Records which are dropped from the history stay valid as long
+/// as someone holds them, their block returns to the pool afterwards.
+class ReplayBuffer
+{
+public:
+  struct Options
+  {
+    size_t max_frames;          //!< number of frames kept in the history.
+    size_t max_bytes;           //!< memory budget of the pooled blocks.
+    size_t n_levels;            //!< number of pyramid levels to copy.
+    Options() :
+      max_frames(20),
+      max_bytes(16<<20),
+      n_levels(3)
+    {}
+  } options_;
+
+  ReplayBuffer();
+  ReplayBuffer(const ReplayBuffer&) = delete;
+  ReplayBuffer& operator=(const ReplayBuffer&) = delete;
+
+  /// Record a frame. Drops the oldest records to stay within the budget,
+  /// returns false if no block was available.
+  bool push(const Frame& frame);
+
+  /// Record a pose and the levels of an image pyramid.
+  bool push(int id, vk::AbstractCamera* cam, const Sophus::SE3d& T_f_w, const ImgPyr& pyramid);
+
+  /// Records from the oldest to the newest.
+  const std::deque<ReplayFramePtr>& records() const { return records_; }
+
+  /// Drop all records.
+  void clear() { records_.clear(); }
+
+  /// Memory allocated by the pool, including blocks which are in use.
+  size_t allocatedBytes() const;
+
+  /// Number of frames which could not be recorded.
+  size_t nDropped() const { return n_dropped_; }
+
+private:
+  struct Pool
+  {
+    std::mutex mut;
+    size_t block_bytes;
+    std::vector<std::unique_ptr<uint8_t[]>> blocks;
+    std::vector<uint8_t*> free_blocks;
+    explicit Pool(size_t bytes) : block_bytes(bytes) {}
+  };
+  std::shared_ptr<Pool> pool_;
+  std::deque<ReplayFramePtr> records_;
+  size_t n_dropped_;
+
+  /// Take a free block or allocate one within the budget, NULL if neither is possible.
+  std::shared_ptr<uint8_t> acquireBlock(size_t bytes);
+};
+
+} // namespace svo
+
+#endif // SVO_REPLAY_BUFFER_H_
@@ -17,8 +17,10 @@
 #ifndef SVO_REPROJECTION_H_
 #define SVO_REPROJECTION_H_
 
+#include <unordered_set>
 #include <svo/global.h>
 #include <svo/matcher.h>
+#include <svo/point.h>
 
 namespace vk {
 class AbstractCamera;
@@ -27,7 +29,6 @@ class AbstractCamera;
 namespace svo {
 
 class Map;
-class Point;
 
 /// Project points from the map into the image and find the corresponding
 /// feature (corner). We don't search a match for every point but only for one
@@ -62,13 +63,24 @@ public:
       FramePtr frame,
       std::vector< std::pair<FramePtr,std::size_t> >& overlap_kfs);
 
+  /// The three steps of reprojectMap(), such that the frames of several
+  /// cameras can be reprojected in parallel with one reprojector each:
+  /// prepare() once in the tracking thread, then project() per camera, which
+  /// only reads the map and writes to its own frame, then commit() per camera
+  /// in the tracking thread, which applies the match statistics to the points.
+  void prepare();
+  void project(
+      FramePtr frame,
+      std::vector< std::pair<FramePtr,std::size_t> >& overlap_kfs);
+  void commit();
+
 private:
 
   /// A candidate is a point that projects into the image plane and for which we
   /// will search a maching feature in the image.
   struct Candidate {
     EIGEN_MAKE_ALIGNED_OPERATOR_NEW
-    Point* pt;       //!< 3D point.
+    PointRef pt;     //!< 3D point, resolves to NULL if the point was deleted meanwhile.
     Vector2d px;     //!< projected 2D pixel location.
     Candidate(Point* pt, Vector2d& px) : pt(pt), px(px) {}
   };
@@ -85,13 +97,26 @@ private:
     int grid_n_rows;
   };
 
+  /// Outcome of a reprojection, applied to the point in commit().
+  struct Update {
+    enum Type { CANDIDATE_NOT_IN_FRAME, MATCH_FAILED, MATCH_SUCCEEDED };
+    PointRef pt;
+    Type type;
+    Update(Point* pt, Type type) : pt(pt), type(type) {}
+  };
+
   Grid grid_;
   Matcher matcher_;
   Map& map_;
+  std::unordered_set<const Point*> projected_; //!< Points projected into the current frame.
+  std::vector<Update> updates_;                //!< Outcomes of the current frame, not applied yet.
 
   static bool pointQualityComparator(const Candidate &lhs, const Candidate& rhs);
   void initializeGrid(vk::AbstractCamera* cam);
   void resetGrid();
+  void projectKeyframes(FramePtr frame, std::vector< std::pair<FramePtr,std::size_t> >& overlap_kfs);
+  void projectCandidates(FramePtr frame);
+  void alignCells(FramePtr frame);
   bool reprojectCell(Cell& cell, FramePtr frame);
   bool reprojectPoint(FramePtr frame, Point* point);
 };
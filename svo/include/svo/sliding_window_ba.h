@@ -0,0 +1,133 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_SLIDING_WINDOW_BA_H_
+#define SVO_SLIDING_WINDOW_BA_H_
+
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <svo/global.h>
+#include <svo/sparse_ba.h>
+
+namespace svo {
+
+class Frame;
+class Feature;
+class Map;
+
+/// Bundle adjustment over a sliding window of the last keyframes.
+///
+/// When the window is full, the oldest keyframe and the points it observes are
+/// marginalized into a dense prior on the remaining keyframes with the Schur
+/// complement. The cost per keyframe is therefore bounded by the window size,
+/// whereas the information of older keyframes is kept. Marginalized points
+/// remain fixed afterwards; only observations by newer keyframes are added,
+/// such that no information is counted twice. The oldest two keyframes of the
+/// window are fixed, which fixes the gauge of the prior.
+class SlidingWindowBA
+{
+public:
+  struct Options
+  {
+    size_t n_kfs;               //!< number of keyframes in the window, at least three.
+    int n_threads;              //!< number of workers of the optimization, including the calling thread.
+    Options() :
+      n_kfs(5),
+      n_threads(1)
+    {}
+  } options_;
+
+  struct Stats
+  {
+    size_t n_kfs;               //!< Keyframes in the window.
+    size_t n_points;
+    size_t n_edges;
+    size_t n_incorrect_edges;   //!< Observations removed after the optimization.
+    double init_error;
+    double final_error;
+    double solve_ms;            //!< Time of the optimization.
+    double marginalize_ms;      //!< Time to marginalize keyframes which left the window.
+    Stats() :
+      n_kfs(0), n_points(0), n_edges(0), n_incorrect_edges(0),
+      init_error(0.0), final_error(0.0), solve_ms(0.0), marginalize_ms(0.0)
+    {}
+  };
+
+  SlidingWindowBA();
+  ~SlidingWindowBA();
+
+  /// Clear the window and the prior, e.g. when the map is reset.
+  void reset();
+
+  /// Add a new keyframe to the window and optimize the window. The keyframe
+  /// may not be in the map yet. Keyframes that were deleted from the map
+  /// leave the window. Afterwards, observations with an error above
+  /// Config::lobaThresh() are removed.
+  void addKeyframe(const FramePtr& kf, Map* map, Stats& stats);
+
+  inline size_t size() const { return kfs_.size(); }
+
+private:
+  std::deque<FramePtr> kfs_;                    //!< Window, oldest first.
+
+  // prior from the marginalized keyframes
+  std::vector<FramePtr> prior_kfs_;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> prior_T0_;
+  Eigen::MatrixXd prior_H_;
+  Eigen::VectorXd prior_g_;
+
+  /// Marginalized points by id with the newest keyframe at that time. Only
+  /// observations by newer keyframes are used.
+  struct MarginalizedPoint
+  {
+    PointRef pt;
+    int last_kf_id;
+  };
+  std::unordered_map<int, MarginalizedPoint> marginalized_pts_;
+
+  SparseBA ba_;
+  std::unordered_map<const Frame*, size_t> pose_index_;
+  std::vector<Point*> pts_;                     //!< Map point of each point of the problem.
+  std::vector<Feature*> ftrs_;                  //!< Feature of each observation of the problem.
+
+  /// True if the keyframe is the newest of the window or still in the map.
+  bool isAlive(const FramePtr& kf, Map* map) const;
+
+  /// Remove a keyframe which was deleted from the window and the prior.
+  void removeKeyframe(const size_t i);
+
+  /// Add the window as poses of the problem and the prior on it.
+  void addWindow(const size_t n_fixed);
+
+  /// Add a point with its observations by the window keyframes, or only by
+  /// the given frame if not NULL. Observations of marginalized points by old
+  /// keyframes are skipped, such points are fixed. Returns false if the point
+  /// would not be constrained.
+  bool addPoint(Point* pt, const Frame* only_frame);
+
+  /// Marginalize the oldest keyframe of the window with its points.
+  void marginalizeOldest();
+
+  /// Last observation of a marginalized point that was already used, -1 if the
+  /// point is not marginalized.
+  int marginalizedUntil(const Point* pt) const;
+};
+
+} // namespace svo
+
+#endif // SVO_SLIDING_WINDOW_BA_H_
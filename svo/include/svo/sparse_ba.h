@@ -0,0 +1,265 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_SPARSE_BA_H_
+#define SVO_SPARSE_BA_H_
+
+#include <set>
+#include <cmath>
+#include <memory>
+#include <functional>
+#include <vector>
+#include <unordered_map>
+#include <svo/global.h>
+#include <svo/point.h>
+
+namespace svo {
+
+class Frame;
+class Map;
+class WorkerPool;
+
+/// Bundle adjustment of keyframe poses and points with Eigen only.
+///
+/// Levenberg-Marquardt with a Huber kernel on the reprojection error on the
+/// unit plane. The points are eliminated with the Schur complement, such that
+/// only the reduced system of the poses is factorized. Linearization and
+/// elimination run in parallel over the points. Poses are updated as
+/// T_f_w = exp(dx)*T_f_w, like in the pose optimizer.
+class SparseBA
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  struct Options
+  {
+    size_t n_iter;              //!< number of Levenberg-Marquardt iterations.
+    size_t max_trials;          //!< number of times the damping is increased before an iteration fails.
+    double huber_width;         //!< width of the Huber kernel on the weighted error on the unit plane.
+    double lambda_init;         //!< initial damping, relative to the diagonal of the system.
+    int n_threads;              //!< number of workers including the calling thread.
+    Options() :
+      n_iter(10),
+      max_trials(5),
+      huber_width(0.005),
+      lambda_init(1e-5),
+      n_threads(1)
+    {}
+  } options_;
+
+  struct Stats
+  {
+    size_t n_poses;             //!< Poses that were optimized.
+    size_t n_points;
+    size_t n_edges;
+    size_t n_iter;              //!< Successful iterations.
+    double init_chi2;           //!< Robust cost before the optimization.
+    double final_chi2;          //!< Robust cost after the optimization.
+    double time_ms;
+    Stats() :
+      n_poses(0), n_points(0), n_edges(0), n_iter(0),
+      init_chi2(0.0), final_chi2(0.0), time_ms(0.0)
+    {}
+  };
+
+  SparseBA();
+  ~SparseBA();
+
+  SparseBA(const SparseBA&) = delete;
+  SparseBA& operator=(const SparseBA&) = delete;
+
+  /// Remove all poses, points and observations. Keeps the memory.
+  void clear();
+
+  /// Add a pose T_f_w and return its index. Fixed poses are not optimized.
+  size_t addPose(const SE3d& T_f_w, const bool fixed);
+
+  /// Add a point in world coordinates and return its index. Fixed points only
+  /// constrain the poses.
+  size_t addPoint(const Vector3d& pos, const bool fixed = false);
+
+  /// Add a Gaussian prior on the given poses, e.g. from marginalize(). The
+  /// prior is linearized at the poses T0, H and g are in the tangent space at
+  /// T0 with the same sign as the normal equations H*dx = g. Removed by clear().
+  void setPrior(
+      const std::vector<size_t>& poses,
+      const std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T0,
+      const Eigen::MatrixXd& H,
+      const Eigen::VectorXd& g);
+
+  /// Add an observation of a point in a pose and return its index. uv is the
+  /// measurement on the unit plane with information weight*I.
+  size_t addObservation(
+      const size_t pose,
+      const size_t point,
+      const Vector2d& uv,
+      const double weight);
+
+  /// Optimize all poses that are not fixed and all points.
+  void optimize(Stats& stats);
+
+  /// Linearize at the current estimate and eliminate the points. Returns the
+  /// information H and the right-hand side g of the poses that are not fixed,
+  /// in the order they were added.
+  void reducedSystem(Eigen::MatrixXd& H, Eigen::VectorXd& g);
+
+  /// Linearize at the current estimate, eliminate the points and marginalize
+  /// the pose. Returns the prior on the remaining poses that are not fixed,
+  /// including the prior of this problem, in the format of setPrior() with T0
+  /// at the current estimate.
+  void marginalize(
+      const size_t pose,
+      std::vector<size_t>& poses,
+      Eigen::MatrixXd& H,
+      Eigen::VectorXd& g);
+
+  /// Eliminate the 6x6 block of a pose from the system H*dx = g with the
+  /// Schur complement. The remaining blocks keep their order.
+  static void schurComplement(
+      const size_t block,
+      Eigen::MatrixXd& H,
+      Eigen::VectorXd& g);
+
+  inline size_t nPoses() const { return poses_.size(); }
+  inline size_t nPoints() const { return points_.size(); }
+  inline size_t nObservations() const { return obs_.size(); }
+  inline const SE3d& pose(const size_t i) const { return poses_[i]; }
+  inline const Vector3d& point(const size_t j) const { return points_[j]; }
+  inline bool pointFixed(const size_t j) const { return point_fixed_[j]; }
+
+  /// Weighted squared error of an observation at the current estimate.
+  double chi2(const size_t k) const;
+
+  /// Local bundle adjustment without g2o, with the same contract as
+  /// ba::localBA: optimizes the core keyframes and all points they observe,
+  /// other keyframes which observe these points are fixed. Afterwards,
+  /// observations with an error above Config::lobaThresh() are removed.
+  /// Equivalent to setupLocalBA(), optimize() and applyLocalBA().
+  void localBA(
+      Frame* center_kf,
+      std::set<FramePtr>* core_kfs,
+      Map* map,
+      size_t& n_incorrect_edges_1,
+      size_t& n_incorrect_edges_2,
+      double& init_error,
+      double& final_error);
+
+  /// Set up the local bundle adjustment from a snapshot of the map. The
+  /// problem keeps references to the keyframes and points, hence it can be
+  /// optimized in another thread while the map changes.
+  void setupLocalBA(Frame* center_kf, std::set<FramePtr>* core_kfs, Map* map);
+
+  /// Write the result of the local bundle adjustment back to the map. The
+  /// corrections with respect to the snapshot are applied, such that changes
+  /// since the setup are kept. Keyframes and points which were deleted in the
+  /// meantime are skipped.
+  void applyLocalBA(
+      Map* map,
+      const Stats& stats,
+      size_t& n_incorrect_edges,
+      double& init_error,
+      double& final_error);
+
+private:
+  typedef Eigen::Matrix<double,6,6> Matrix6d;
+  typedef Eigen::Matrix<double,6,1> Vector6d;
+  typedef Eigen::Matrix<double,6,3> Matrix63d;
+  typedef Eigen::Matrix<double,2,6> Matrix26d;
+
+  struct Observation
+  {
+    size_t pose;
+    size_t point;
+    Vector2d uv;
+    double weight;
+  };
+
+  /// Reduced system of the poses accumulated by one worker.
+  struct Scratch
+  {
+    Eigen::MatrixXd S;          //!< Upper triangle of the Schur complement.
+    Eigen::VectorXd g;          //!< Reduced right-hand side.
+    Eigen::VectorXd d;          //!< Diagonal of the pose blocks, for the damping.
+    double cost;
+  };
+
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> poses_;
+  std::vector<int> pose_var_;                   //!< Index of a pose in the reduced system, -1 if fixed.
+  size_t n_var_poses_;
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> points_;
+  std::vector<bool> point_fixed_;
+  std::vector<Observation, Eigen::aligned_allocator<Observation>> obs_;
+
+  // linear system, valid during optimize()
+  std::vector<size_t> point_obs_begin_;         //!< Observations of point j are point_obs_[point_obs_begin_[j]...].
+  std::vector<size_t> point_obs_;
+  std::vector<Matrix63d, Eigen::aligned_allocator<Matrix63d>> H_pl_;    //!< Pose-point block of each observation.
+  std::vector<Matrix3d, Eigen::aligned_allocator<Matrix3d>> H_ll_inv_;  //!< Inverse of the damped point blocks.
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> b_l_;
+  std::vector<Scratch> scratch_;
+  Eigen::VectorXd dx_poses_;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> poses_backup_;
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> points_backup_;
+  std::unique_ptr<WorkerPool> pool_;
+
+  // prior on the poses
+  std::vector<size_t> prior_poses_;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> prior_T0_;      //!< Linearization point of the prior.
+  Eigen::MatrixXd prior_H_;
+  Eigen::VectorXd prior_g_;
+
+  // references of the local BA into the map
+  std::unordered_map<const Frame*, size_t> frame_index_;
+  std::vector<FramePtr> frames_;                //!< Keyframe of each pose.
+  std::vector<Point*> pts_setup_;
+  std::vector<PointRef> pts_;                   //!< Map point of each point, NULL once deleted.
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> poses_setup_;      //!< Poses in the snapshot.
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> points_setup_;
+  const Frame* center_kf_;                      //!< Keyframe of the snapshot, only compared.
+  double error_multiplier2_;                    //!< Focal length of the center keyframe.
+
+  /// Allocate the workers and sort the observations by point.
+  void prepare();
+
+  /// Linearize at the current estimate, eliminate the points and build the
+  /// damped reduced system in the first scratch. Points whose block is
+  /// singular are left out.
+  void buildReducedSystem(const double lambda);
+
+  /// Tangent of the prior poses with respect to the linearization point.
+  Eigen::VectorXd priorDelta() const;
+
+  /// Solve the reduced system and update the estimate. Returns false if the
+  /// system could not be solved.
+  bool solveAndUpdate();
+
+  /// Robust cost of all observations at the current estimate.
+  double computeCost();
+
+  inline double robustCost(const double chi2) const
+  {
+    const double delta = options_.huber_width;
+    return (chi2 <= delta*delta) ? chi2 : 2.0*delta*std::sqrt(chi2) - delta*delta;
+  }
+
+  /// Run f(worker, begin, end) over the points.
+  void forPoints(const std::function<void (size_t, size_t, size_t)>& f);
+};
+
+} // namespace svo
+
+#endif // SVO_SPARSE_BA_H_
@@ -0,0 +1,93 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_SPSC_QUEUE_H_
+#define SVO_SPSC_QUEUE_H_
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+
+namespace svo {
+
+/// Bounded lock-free queue for exactly one producer and one consumer thread.
+/// Pushing and popping never block, a full queue rejects the item instead.
+/// The capacity is rounded up to a power of two.
+template<class T>
+class SpscQueue
+{
+public:
+  explicit SpscQueue(size_t capacity) :
+    head_(0),
+    tail_(0)
+  {
+    size_t n = 1;
+    while(n < capacity)
+      n <<= 1;
+    buffer_.resize(n);
+    mask_ = n-1;
+  }
+
+  SpscQueue(const SpscQueue&) = delete;
+  SpscQueue& operator=(const SpscQueue&) = delete;
+
+  /// Append an item, producer thread only. Returns false if the queue is full,
+  /// in that case the item is not moved from.
+  bool tryPush(T&& item)
+  {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    if(tail - head_.load(std::memory_order_acquire) > mask_)
+      return false;
+    buffer_[tail & mask_] = std::move(item);
+    tail_.store(tail+1, std::memory_order_release);
+    return true;
+  }
+
+  /// Take the oldest item, consumer thread only. Returns false if the queue is empty.
+  bool tryPop(T& item)
+  {
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if(head == tail_.load(std::memory_order_acquire))
+      return false;
+    item = std::move(buffer_[head & mask_]);
+    buffer_[head & mask_] = T(); // release the resources of the item right away
+    head_.store(head+1, std::memory_order_release);
+    return true;
+  }
+
+  /// Number of queued items. Exact only when called from the producer or the
+  /// consumer thread while the other one is idle.
+  inline size_t size() const
+  {
+    const size_t head = head_.load(std::memory_order_acquire);
+    return tail_.load(std::memory_order_acquire) - head;
+  }
+
+  inline bool empty() const { return size() == 0; }
+
+  inline size_t capacity() const { return mask_+1; }
+
+private:
+  std::vector<T> buffer_;
+  size_t mask_;
+  alignas(64) std::atomic<size_t> head_;  //!< Next item to pop, written by the consumer.
+  alignas(64) std::atomic<size_t> tail_;  //!< Next slot to push, written by the producer.
+};
+
+} // namespace svo
+
+#endif // SVO_SPSC_QUEUE_H_
@@ -0,0 +1,72 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_STRUCTURE_OPTIMIZER_H_
+#define SVO_STRUCTURE_OPTIMIZER_H_
+
+#include <vector>
+#include <svo/global.h>
+
+namespace svo {
+
+class Point;
+class WorkerPool;
+
+/// Structure-only optimization of many points. The points are independent, so
+/// their observations are gathered into contiguous arrays and the points are
+/// refined in chunks across a worker pool.
+namespace structure_optimizer {
+
+/// Observation of a point: pose of the observing frame and measurement on the
+/// unit plane.
+struct Observation
+{
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+  Matrix3d R_f_w;
+  Vector3d t_f_w;
+  Vector2d uv;
+};
+
+/// Arrays of a batch of points. Reused from batch to batch.
+struct Workspace
+{
+  std::vector<size_t> obs_begin;      //!< First observation of each point, plus the total.
+  std::vector<Observation, Eigen::aligned_allocator<Observation>> obs;
+};
+
+/// Gauss-Newton refinement of a point from its observations.
+void optimizePoint(
+    const Observation* obs,
+    const size_t n_obs,
+    const size_t n_iter,
+    Vector3d& pos);
+
+/// Optimize the points pts[0, n_pts) with n_iter iterations each. Observations
+/// are gathered and points are refined in chunks of grain points on the pool,
+/// which may be NULL to run everything in the calling thread.
+void optimizePoints(
+    Point* const* pts,
+    const size_t n_pts,
+    const size_t n_iter,
+    Workspace& ws,
+    WorkerPool* pool,
+    const size_t grain = 8);
+
+} // namespace structure_optimizer
+} // namespace svo
+
+#endif // SVO_STRUCTURE_OPTIMIZER_H_
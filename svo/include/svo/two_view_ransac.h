@@ -0,0 +1,185 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#ifndef SVO_TWO_VIEW_RANSAC_H_
+#define SVO_TWO_VIEW_RANSAC_H_
+
+#include <memory>
+#include <vector>
+#include <svo/global.h>
+
+namespace svo {
+
+class WorkerPool;
+
+/// Relative pose of two views from correspondences of bearing vectors.
+///
+/// A homography (4 points) and an essential matrix (8 points) are estimated
+/// with RANSAC. Hypotheses are drawn in batches that are spread over a worker
+/// pool and each hypothesis is verified with Wald's sequential probability
+/// ratio test (SPRT), which rejects a bad hypothesis after a few points. The
+/// number of hypotheses adapts to the inlier ratio after every batch. Both
+/// models are scored with a truncated quadratic cost on the reprojection
+/// error, the better one is selected and decomposed into rotation and
+/// translation. Hypothesis i always uses the same sample, so the result does
+/// not depend on the number of threads.
+class TwoViewRansac
+{
+public:
+  EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+  enum Model { HOMOGRAPHY=0, ESSENTIAL=1 };
+
+  struct Options
+  {
+    double threshold;           //!< inlier threshold on the reprojection error in pixels.
+    double confidence;          //!< probability that an all-inlier sample is drawn before stopping.
+    size_t max_iter;            //!< maximum number of hypotheses per model.
+    size_t batch_size;          //!< hypotheses per batch, the stopping criterion is checked in between.
+    int n_threads;              //!< number of workers including the calling thread.
+    bool use_sprt;              //!< verify hypotheses with the SPRT, otherwise on all points.
+    double homography_ratio;    //!< the homography is selected if its share of the total score is larger.
+    unsigned int seed;          //!< seed of the samples.
+    Options() :
+      threshold(2.0),
+      confidence(0.99),
+      max_iter(1000),
+      batch_size(32),
+      n_threads(1),
+      use_sprt(true),
+      homography_ratio(0.45),
+      seed(0)
+    {}
+  } options_;
+
+  struct Stats
+  {
+    Model model;                //!< Selected model.
+    size_t n_hypotheses[2];     //!< Hypotheses per model.
+    size_t n_rejected[2];       //!< Hypotheses per model that the SPRT rejected early.
+    size_t n_inliers[2];        //!< Inliers of the best hypothesis per model.
+    double score[2];            //!< Score of the best hypothesis per model.
+    double time_ms;
+    Stats() :
+      model(HOMOGRAPHY), n_hypotheses{0, 0}, n_rejected{0, 0},
+      n_inliers{0, 0}, score{0.0, 0.0}, time_ms(0.0)
+    {}
+  };
+
+  Model model_;                 //!< Selected model.
+  Matrix3d H_cur_ref_;          //!< Homography on the unit plane, x_cur ~ H_cur_ref*x_ref.
+  Matrix3d E_cur_ref_;          //!< Essential matrix, x_cur^T*E_cur_ref*x_ref = 0.
+  SE3d T_cur_ref_;              //!< Pose of the selected model, the translation has unit norm.
+  std::vector<int> inliers_;    //!< Inliers of the selected model.
+
+  TwoViewRansac();
+  ~TwoViewRansac();
+
+  /// Estimate both models and the relative pose. The focal length converts
+  /// the threshold to the unit plane. Returns false if no model was found or
+  /// the selected model could not be decomposed.
+  bool compute(
+      const std::vector<Vector3d>& f_ref,
+      const std::vector<Vector3d>& f_cur,
+      const double focal_length,
+      Stats& stats);
+
+  /// Homography from four or more correspondences on the unit plane (DLT).
+  static bool fitHomography(
+      const std::vector<Vector2d>& uv_ref,
+      const std::vector<Vector2d>& uv_cur,
+      const std::vector<int>& sample,
+      Matrix3d& H);
+
+  /// Essential matrix from eight or more correspondences on the unit plane,
+  /// with rank two but not necessarily equal singular values.
+  static bool fitEssential(
+      const std::vector<Vector2d>& uv_ref,
+      const std::vector<Vector2d>& uv_cur,
+      const std::vector<int>& sample,
+      Matrix3d& E);
+
+  /// Candidate poses of a homography (up to eight) or an essential matrix (four).
+  static void decomposeHomography(const Matrix3d& H, std::vector<SE3d>& poses);
+  static void decomposeEssential(const Matrix3d& E, std::vector<SE3d>& poses);
+
+private:
+  struct Hypothesis
+  {
+    Matrix3d M;
+    double score;
+    size_t n_inliers;
+    size_t id;
+  };
+
+  std::vector<Vector2d> uv_ref_;
+  std::vector<Vector2d> uv_cur_;
+  std::unique_ptr<WorkerPool> pool_;
+
+  /// Run RANSAC for one model and return the best hypothesis.
+  bool ransac(
+      const Model model,
+      const double threshold2,
+      Hypothesis& best,
+      Stats& stats);
+
+  /// Squared reprojection errors of correspondence i in both views. M_inv
+  /// is the inverse of a homography and unused for the essential matrix.
+  void errors(
+      const Model model,
+      const Matrix3d& M,
+      const Matrix3d& M_inv,
+      const size_t i,
+      double& e_ref2,
+      double& e_cur2) const;
+
+  /// Score of a hypothesis on all points. If sprt_A is positive, the SPRT
+  /// may abort the verification, in which case false is returned.
+  bool score(
+      const Model model,
+      const double threshold2,
+      const double sprt_A,
+      const double sprt_epsilon,
+      const double sprt_delta,
+      Hypothesis& h,
+      size_t& n_tested,
+      size_t& n_consistent) const;
+
+  /// Indices of the correspondences that are consistent with a hypothesis.
+  void collectInliers(
+      const Model model,
+      const Matrix3d& M,
+      const double threshold2,
+      std::vector<int>& inliers) const;
+
+  /// Re-estimate the best hypothesis from its inliers while the score improves.
+  void refine(
+      const Model model,
+      const double threshold2,
+      Hypothesis& best) const;
+
+  /// Select the candidate pose with most points in front of both cameras.
+  bool selectPose(
+      const std::vector<SE3d>& poses,
+      const std::vector<int>& inliers,
+      const double threshold2,
+      SE3d& T_cur_ref) const;
+};
+
+} // namespace svo
+
+#endif // SVO_TWO_VIEW_RANSAC_H_
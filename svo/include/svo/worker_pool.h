@@ -0,0 +1,73 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SVO_WORKER_POOL_H_
+#define SVO_WORKER_POOL_H_
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <functional>
+#include <condition_variable>
+
+namespace svo {
+
+/// Fixed set of worker threads for data-parallel loops. The calling thread
+/// takes part as worker 0, so a pool of size one runs everything inline.
+/// Items are handed out in chunks through an atomic counter. The worker index
+/// passed to the task allows each worker to use its own scratch objects.
+class WorkerPool
+{
+public:
+  /// f(worker_id, begin, end) processes the items [begin, end).
+  typedef std::function<void (size_t, size_t, size_t)> task_t;
+
+  explicit WorkerPool(size_t n_workers);
+  ~WorkerPool();
+
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /// Number of workers including the calling thread.
+  inline size_t size() const { return threads_.size()+1; }
+
+  /// Process the items [0, n) and return when all are done. Items are
+  /// dispatched in chunks of grain items. Not reentrant.
+  void parallelFor(size_t n, size_t grain, const task_t& f);
+
+private:
+  std::vector<std::thread> threads_;
+  std::mutex mut_;
+  std::condition_variable start_cond_;
+  std::condition_variable done_cond_;
+  const task_t* task_;          //!< Task of the current loop.
+  size_t n_items_;
+  size_t grain_;
+  std::atomic<size_t> next_item_;
+  size_t generation_;           //!< Incremented for every loop, wakes up the workers.
+  size_t n_busy_;               //!< Number of workers that did not finish the current loop.
+  bool halt_;
+
+  /// Take chunks until all items are dispatched.
+  void runChunks(size_t worker_id);
+
+  void workerLoop(size_t worker_id);
+};
+
+} // namespace svo
+
+#endif // SVO_WORKER_POOL_H_
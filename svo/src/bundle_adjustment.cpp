@@ -92,6 +92,7 @@ void twoViewBA(
   frame1->T_f_w_.translation() = v_frame1->estimate().translation();
   frame2->T_f_w_.rotation_matrix() = v_frame2->estimate().rotation().toRotationMatrix();
   frame2->T_f_w_.translation() = v_frame2->estimate().translation();
+  map->keyframes_.invalidatePositions();
 
   // Update Mappoint Positions
   for(Features::iterator it=frame1->fts_.begin(); it!=frame1->fts_.end(); ++it)
@@ -223,6 +224,7 @@ void localBA(
                          (*it)->v_kf_->estimate().translation());
     (*it)->v_kf_ = NULL;
   }
+  map->keyframes_.invalidatePositions();
 
   for(list<Frame*>::iterator it = neib_kfs.begin(); it != neib_kfs.end(); ++it)
     (*it)->v_kf_ = NULL;
@@ -326,6 +328,7 @@ void globalBA(Map* map)
       mp->v_pt_ = NULL;
     }
   }
+  map->keyframes_.invalidatePositions();
 
   // Remove Measurements with too large reprojection error
   for(list< pair<FramePtr,Feature*> >::iterator it=incorrect_edges.begin();
@@ -33,6 +33,7 @@ Config::Config() :
     init_min_disparity(vk::getParam<double>("svo/init_min_disparity", 50.0)),
     init_min_tracked(vk::getParam<int>("svo/init_min_tracked", 50)),
     init_min_inliers(vk::getParam<int>("svo/init_min_inliers", 40)),
+    init_ransac_num_threads(vk::getParam<int>("svo/init_ransac_num_threads", 2)),
     klt_max_level(vk::getParam<int>("svo/klt_max_level", 4)),
     klt_min_level(vk::getParam<int>("svo/klt_min_level", 2)),
     reproj_thresh(vk::getParam<double>("svo/reproj_thresh", 2.0)),
@@ -40,9 +41,14 @@ Config::Config() :
     poseoptim_num_iter(vk::getParam<int>("svo/poseoptim_num_iter", 10)),
     structureoptim_max_pts(vk::getParam<int>("svo/structureoptim_max_pts", 20)),
     structureoptim_num_iter(vk::getParam<int>("svo/structureoptim_num_iter", 5)),
+    structureoptim_num_threads(vk::getParam<int>("svo/structureoptim_num_threads", 1)),
+    structureoptim_budget(vk::getParam<double>("svo/structureoptim_budget", 0.0)),
     loba_thresh(vk::getParam<double>("svo/loba_thresh", 2.0)),
     loba_robust_huber_width(vk::getParam<double>("svo/loba_robust_huber_width", 1.0)),
     loba_num_iter(vk::getParam<int>("svo/loba_num_iter", 0)),
+    loba_num_threads(vk::getParam<int>("svo/loba_num_threads", 2)),
+    loba_async(vk::getParam<bool>("svo/loba_async", true)),
+    loba_window_n_kfs(vk::getParam<int>("svo/loba_window_n_kfs", 0)),
     kfselect_mindist(vk::getParam<double>("svo/kfselect_mindist", 0.12)),
     triang_min_corner_score(vk::getParam<double>("svo/triang_min_corner_score", 20.0)),
     triang_half_patch_size(vk::getParam<int>("svo/triang_half_patch_size", 4)),
@@ -51,7 +57,13 @@ Config::Config() :
     img_imu_delay(vk::getParam<double>("svo/img_imu_delay", 0.0)),
     max_fts(vk::getParam<int>("svo/max_fts", 120)),
     quality_min_fts(vk::getParam<int>("svo/quality_min_fts", 50)),
-    quality_max_drop_fts(vk::getParam<int>("svo/quality_max_drop_fts", 40))
+    quality_max_drop_fts(vk::getParam<int>("svo/quality_max_drop_fts", 40)),
+    replay_max_frames(vk::getParam<int>("svo/replay_max_frames", 20)),
+    replay_max_mbytes(vk::getParam<double>("svo/replay_max_mbytes", 16.0)),
+    depth_filter_deterministic(vk::getParam<bool>("svo/depth_filter_deterministic", false)),
+    ingestion_queue_size(vk::getParam<int>("svo/ingestion_queue_size", 2)),
+    ingestion_latest_wins(vk::getParam<bool>("svo/ingestion_latest_wins", true)),
+    stereo_parallel_cameras(vk::getParam<bool>("svo/stereo_parallel_cameras", true))
 #else
     trace_name("svo"),
     trace_dir("/tmp"),
@@ -63,6 +75,7 @@ Config::Config() :
     init_min_disparity(50.0),
     init_min_tracked(50),
     init_min_inliers(40),
+    init_ransac_num_threads(2),
     klt_max_level(4),
     klt_min_level(2),
     reproj_thresh(2.0),
@@ -70,9 +83,14 @@ Config::Config() :
     poseoptim_num_iter(10),
     structureoptim_max_pts(20),
     structureoptim_num_iter(5),
+    structureoptim_num_threads(1),
+    structureoptim_budget(0.0),
     loba_thresh(2.0),
     loba_robust_huber_width(1.0),
     loba_num_iter(0),
+    loba_num_threads(2),
+    loba_async(true),
+    loba_window_n_kfs(0),
     kfselect_mindist(0.12),
     triang_min_corner_score(20.0),
     triang_half_patch_size(4),
@@ -81,7 +99,13 @@ Config::Config() :
     img_imu_delay(0.0),
     max_fts(120),
     quality_min_fts(50),
-    quality_max_drop_fts(40)
+    quality_max_drop_fts(40),
+    replay_max_frames(20),
+    replay_max_mbytes(16.0),
+    depth_filter_deterministic(false),
+    ingestion_queue_size(2),
+    ingestion_latest_wins(true),
+    stereo_parallel_cameras(true)
 #endif
 {}
 
@@ -15,6 +15,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <algorithm>
+#include <chrono>
 #include <vikit/math_utils.h>
 #include <vikit/abstract_camera.h>
 #include <vikit/vision.h>
@@ -32,28 +33,171 @@ using namespace std;
 
 namespace svo {
 
-int Seed::batch_counter = 0;
-int Seed::seed_counter = 0;
+int SeedStore::seed_counter = 0;
+int SeedBatch::counter = 0;
 
-Seed::Seed(std::unique_ptr<Feature> ftr, float depth_mean, float depth_min) :
-    batch_id(batch_counter),
-    id(seed_counter++),
-    ftr(std::move(ftr)),
-    a(10),
-    b(10),
-    mu(1.0/depth_mean),
-    z_range(1.0/depth_min),
-    sigma2(z_range*z_range/36)
-{}
+void SeedStore::add(std::unique_ptr<Feature> feature, float depth_mean, float depth_min, int birth_frame)
+{
+  id.push_back(seed_counter++);
+  ftr.push_back(std::move(feature));
+  a.push_back(10);
+  b.push_back(10);
+  mu.push_back(1.0/depth_mean);
+  z_range.push_back(1.0/depth_min);
+  sigma2.push_back(z_range.back()*z_range.back()/36);
+  birth.push_back(birth_frame);
+  n_failed.push_back(0);
+}
+
+float SeedStore::quality(size_t i, double convergence_sigma2_thresh) const
+{
+  // log of the factor by which the standard deviation still has to shrink
+  const float remaining = std::max(0.0, log(sqrt(sigma2[i])*convergence_sigma2_thresh/z_range[i]));
+  const float inlier_probability = a[i]/(a[i]+b[i]);
+  return log(std::max(inlier_probability, 1e-6f)) - remaining - 0.5f*n_failed[i];
+}
+
+void SeedStore::resize(size_t n)
+{
+  id.resize(n);
+  ftr.resize(n);
+  a.resize(n);
+  b.resize(n);
+  mu.resize(n);
+  z_range.resize(n);
+  sigma2.resize(n);
+  birth.resize(n);
+  n_failed.resize(n);
+}
+
+void DepthFilter::SeedHistogram::add(Outcome outcome, int lifetime)
+{
+  int bin = 0;
+  while(bin < kNumBins-1 && lifetime+1 >= (2 << bin))
+    ++bin;
+  ++counts[outcome][bin];
+}
+
+size_t DepthFilter::SeedHistogram::total(Outcome outcome) const
+{
+  size_t n = 0;
+  for(int k=0; k<kNumBins; ++k)
+    n += counts[outcome][k];
+  return n;
+}
+
+void DepthFilter::SeedHistogram::write(std::ostream& out) const
+{
+  out << "outcome";
+  for(int k=0; k<kNumBins; ++k)
+    out << ",lifetime_" << (1 << k)-1;
+  out << "\n";
+  for(int o=0; o<N_OUTCOMES; ++o)
+  {
+    out << name(static_cast<Outcome>(o));
+    for(int k=0; k<kNumBins; ++k)
+      out << "," << counts[o][k];
+    out << "\n";
+  }
+}
+
+const char* DepthFilter::SeedHistogram::name(Outcome outcome)
+{
+  switch(outcome)
+  {
+  case CONVERGED: return "converged";
+  case EVICTED: return "evicted";
+  case AGED_OUT: return "aged_out";
+  case REMOVED: return "removed";
+  case DIVERGED: return "diverged";
+  default: return "unknown";
+  }
+}
+
+void DepthPriorGrid::reset(int width, int height, int cell_size)
+{
+  cell_size_ = std::max(cell_size, 1);
+  n_cols_ = (width + cell_size_ - 1)/cell_size_;
+  n_rows_ = (height + cell_size_ - 1)/cell_size_;
+  cells_.resize(n_cols_*n_rows_);
+  for(auto& cell : cells_)
+    cell.clear();
+}
+
+void DepthPriorGrid::insert(const Vector2d& px, float inv_depth)
+{
+  const int col = static_cast<int>(px[0])/cell_size_;
+  const int row = static_cast<int>(px[1])/cell_size_;
+  if(px[0] < 0 || px[1] < 0 || col >= n_cols_ || row >= n_rows_)
+    return;
+  cells_[row*n_cols_+col].push_back(inv_depth);
+}
+
+void DepthPriorGrid::collect(const Frame& frame, Samples& samples)
+{
+  samples.clear();
+  for(auto& ftr : frame.fts_)
+  {
+    if(ftr->point == NULL)
+      continue;
+    // seeds measure the depth along the bearing vector
+    const double z = (frame.T_f_w_*ftr->point->pos_).norm();
+    if(z > 0.0)
+      samples.push_back(Sample{static_cast<float>(ftr->px[0]), static_cast<float>(ftr->px[1]),
+                               static_cast<float>(1.0/z)});
+  }
+}
+
+void DepthPriorGrid::build(const Samples& samples, int width, int height, int cell_size)
+{
+  reset(width, height, cell_size);
+  for(const Sample& sample : samples)
+    insert(Vector2d(sample.x, sample.y), sample.inv_depth);
+}
+
+bool DepthPriorGrid::lookup(const Vector2d& px, size_t min_points, float& mu, float& sigma2) const
+{
+  const int col = static_cast<int>(px[0])/cell_size_;
+  const int row = static_cast<int>(px[1])/cell_size_;
+  size_t n = 0;
+  double sum = 0.0, sum_sq = 0.0;
+  for(int r=std::max(row-1, 0); r<=std::min(row+1, n_rows_-1); ++r)
+  {
+    for(int c=std::max(col-1, 0); c<=std::min(col+1, n_cols_-1); ++c)
+    {
+      for(const float inv_depth : cells_[r*n_cols_+c])
+      {
+        sum += inv_depth;
+        sum_sq += inv_depth*inv_depth;
+        ++n;
+      }
+    }
+  }
+  if(n == 0 || n < min_points)
+    return false;
+  mu = sum/n;
+  // the seed may lie on a different surface than its neighbours, so take two
+  // standard deviations of the neighbourhood and at least 10% of the depth
+  const double var = std::max(sum_sq/n - mu*mu, 0.0);
+  sigma2 = std::max(4.0*var, 0.01*mu*mu);
+  return true;
+}
 
 DepthFilter::DepthFilter(std::shared_ptr<vilib::DetectorBaseGPU> feature_detector, callback_t seed_converged_cb) :
     feature_detector_(feature_detector),
     seed_converged_cb_(seed_converged_cb),
     seeds_updating_halt_(false),
-    new_keyframe_set_(false),
-    new_keyframe_min_depth_(0.0),
-    new_keyframe_mean_depth_(0.0)
-{}
+    thread_halt_(false),
+    n_pending_interrupts_(0),
+    n_dropped_frames_(0),
+    thread_waiting_(false),
+    n_seeds_(0),
+    reclaimer_(NULL),
+    n_frames_(0),
+    deterministic_(false)
+{
+  matchers_.emplace_back(new Matcher());
+}
 
 DepthFilter::~DepthFilter()
 {
@@ -63,7 +207,11 @@ DepthFilter::~DepthFilter()
 
 void DepthFilter::startThread()
 {
+    if(deterministic_ || thread_)
+        return;
     thread_halt_ = false;
+    seeds_updating_halt_ = false;
+    commands_.reset(new SpscQueue<Command>(options_.command_queue_size));
     thread_ = make_unique<thread>(&DepthFilter::updateSeedsLoop, this);
 }
 
@@ -75,60 +223,132 @@ void DepthFilter::stopThread()
         SVO_INFO_STREAM("DepthFilter interrupt and join thread... ");
         seeds_updating_halt_ = true;
         thread_halt_ = true;
+        {
+            lock_t lock(wakeup_mut_);
+            wakeup_cond_.notify_one();
+        }
         thread_->join();
         thread_.reset();
+        deferred_commands_.clear();
+        n_pending_interrupts_ = 0;
+        seeds_updating_halt_ = false;
     }
 }
 
-void DepthFilter::addFrame(FramePtr frame)
+void DepthFilter::setDeterministic(bool deterministic)
 {
-  if(thread_)
-  {
+    if(deterministic == deterministic_)
+        return;
+    if(deterministic)
     {
-      lock_t lock(frame_queue_mut_);
-      if(frame_queue_.size() > 2)
-        frame_queue_.pop();
-      frame_queue_.push(frame);
+        // finish the queued work in order before the calling thread takes over
+        std::deque<Command> deferred_commands;
+        deferred_commands.swap(deferred_commands_);
+        stopThread();
+        deterministic_ = true;
+        Command cmd;
+        while(commands_ && commands_->tryPop(cmd))
+            dispatchCommand(std::move(cmd));
+        for(Command& c : deferred_commands)
+            dispatchCommand(std::move(c));
+        while(replaySeedsStep());
+        SVO_INFO_STREAM("DepthFilter: deterministic mode, seeds are updated in the calling thread.");
+    }
+    else
+    {
+        deterministic_ = false;
+        startThread();
     }
-    seeds_updating_halt_ = false;
-    frame_queue_cond_.notify_one();
-  }
-  else
-    updateSeeds(frame);
 }
 
-void DepthFilter::addKeyframe(FramePtr frame, double depth_mean, double depth_min)
+void DepthFilter::dispatchCommand(Command&& cmd)
 {
-    new_keyframe_min_depth_ = depth_min;
-    new_keyframe_mean_depth_ = depth_mean;
     if(thread_)
     {
-        new_keyframe_ = frame;
-        new_keyframe_set_ = true;
-        seeds_updating_halt_ = true;
-        frame_queue_cond_.notify_one();
+        pushCommand(std::move(cmd));
+        return;
     }
-    else
-        initializeSeeds(frame);
+    std::unique_ptr<EpochReclaimer::Guard> epoch_guard;
+    if(reclaimer_ != NULL)
+        epoch_guard.reset(new EpochReclaimer::Guard(*reclaimer_));
+    processCommand(cmd);
+    while(replaySeedsStep());
 }
 
-void DepthFilter::addKeyframe(FramePtr frame, double depth_mean, double depth_min, const std::vector<FramePtr> & history_frames)
+void DepthFilter::pushCommand(Command&& cmd)
 {
-    new_keyframe_min_depth_ = depth_min;
-    new_keyframe_mean_depth_ = depth_mean;
-    if(thread_)
+  // first push the commands which did not fit into the queue before
+  while(!deferred_commands_.empty() && commands_->tryPush(std::move(deferred_commands_.front())))
+    deferred_commands_.pop_front();
+
+  if(cmd.type == Command::ADD_FRAME)
+  {
+    // the seeds are updated with the next frame if the filter does not keep up
+    if(!deferred_commands_.empty()
+       || commands_->size() >= options_.max_queued_frames
+       || !commands_->tryPush(std::move(cmd)))
     {
-        new_keyframe_ = frame;
-        new_keyframe_set_ = true;
-        seeds_updating_halt_ = true;
-        new_keyframe_update_frames_ = history_frames;
-        frame_queue_cond_.notify_one();
+      ++n_dropped_frames_;
+      return;
     }
-    else
-        initializeSeeds(frame);
+  }
+  else
+  {
+    // interrupt the seed update, such that the command is processed soon.
+    // Commands other than frames are never dropped.
+    ++n_pending_interrupts_;
+    if(!deferred_commands_.empty() || !commands_->tryPush(std::move(cmd)))
+      deferred_commands_.push_back(std::move(cmd));
+  }
+
+  // Wake up the filter thread if it waits. The mutex is only held by the
+  // filter thread while it checks the queue, so this does not wait for updates.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if(thread_waiting_)
+  {
+    lock_t lock(wakeup_mut_);
+    wakeup_cond_.notify_one();
+  }
+}
+
+void DepthFilter::addFrame(FramePtr frame)
+{
+  Command cmd;
+  cmd.type = Command::ADD_FRAME;
+  cmd.frame = frame;
+  dispatchCommand(std::move(cmd));
 }
 
-void DepthFilter::initializeSeeds(FramePtr frame)
+void DepthFilter::addKeyframe(FramePtr frame, double depth_mean, double depth_min)
+{
+    addKeyframe(frame, depth_mean, depth_min, std::vector<ReplayFramePtr>());
+}
+
+void DepthFilter::addKeyframe(
+    FramePtr frame,
+    double depth_mean,
+    double depth_min,
+    const std::vector<ReplayFramePtr> & history_frames,
+    FramePtr stereo_frame)
+{
+    Command cmd;
+    cmd.type = Command::ADD_KEYFRAME;
+    cmd.frame = frame;
+    cmd.depth_mean = depth_mean;
+    cmd.depth_min = depth_min;
+    cmd.history_frames = history_frames;
+    cmd.stereo_frame = stereo_frame;
+    // the filter thread must not read the map, which the tracking thread changes
+    if(options_.depth_prior_from_map)
+        DepthPriorGrid::collect(*frame, cmd.depth_prior);
+    dispatchCommand(std::move(cmd));
+}
+
+size_t DepthFilter::initializeSeeds(
+    FramePtr frame,
+    double depth_mean,
+    double depth_min,
+    const DepthPriorGrid::Samples& depth_prior)
 {
     using namespace std;
     auto &grid = feature_detector_->getGrid();
@@ -138,239 +358,713 @@ void DepthFilter::initializeSeeds(FramePtr frame)
     feature_detector_->detect(frame->pyramid_);
     const auto &pts = feature_detector_->getPoints();
 
+    // the map points of the keyframe give a depth prior to the seeds around them
+    if(options_.depth_prior_from_map && !pts.empty())
+        depth_prior_grid_.build(depth_prior, frame->cam_->width(), frame->cam_->height(),
+                                options_.depth_prior_cell_size);
+
     // initialize a seed for every new feature
-    seeds_updating_halt_ = true;
-    lock_t lock(seeds_mut_); // by locking the updateSeeds function stops
-    ++Seed::batch_counter;
+    lock_t lock(seeds_mut_);
+    ++SeedBatch::counter;
+    if(pts.empty())
+        return 0;
+    seed_batches_.emplace_back();
+    SeedBatch& batch = seed_batches_.back();
+    batch.id = SeedBatch::counter;
+    batch.frame = frame;
+    size_t n_prior = 0;
     for_each(pts.begin(), pts.end(), [&](const vilib::DetectorBase::FeaturePoint &pt){
-        seeds_.emplace_back(make_unique<Feature>(frame.get(), Vector2d(pt.x_, pt.y_), pt.level_), new_keyframe_mean_depth_, new_keyframe_min_depth_);
+        const Vector2d px(pt.x_, pt.y_);
+        SeedStore& seeds = batch.seeds;
+        seeds.add(make_unique<Feature>(frame.get(), px, pt.level_), depth_mean, depth_min, n_frames_);
+        float mu, sigma2;
+        if(options_.depth_prior_from_map
+           && depth_prior_grid_.lookup(px, options_.depth_prior_min_points, mu, sigma2)
+           && sigma2 < seeds.sigma2.back())
+        {
+            // z_range stays the same, the outlier model of the update is unchanged
+            seeds.mu.back() = mu;
+            seeds.sigma2.back() = sigma2;
+            ++n_prior;
+        }
     });
 
     if(options_.verbose)
-        SVO_INFO_STREAM("DepthFilter: Initialized " << pts.size() << " new seeds");
-    seeds_updating_halt_ = false;
+        SVO_INFO_STREAM("DepthFilter: Initialized " << pts.size() << " new seeds, "
+                        << n_prior << " with a depth prior from the map");
+
+    // make room for the new seeds
+    evictSeeds();
+    publishSeedCount();
+    return seed_batches_.back().seeds.size();
+}
+
+void DepthFilter::evictSeeds()
+{
+  if(options_.max_n_seeds == 0 || seed_batches_.empty())
+    return;
+  size_t n_seeds = 0;
+  for(const SeedBatch& batch : seed_batches_)
+    n_seeds += batch.seeds.size();
+  if(n_seeds <= options_.max_n_seeds)
+    return;
+  const size_t n_evict = n_seeds - options_.max_n_seeds;
+
+  // rank the seeds of the older batches, the newest batch only if that is not enough
+  eviction_ranking_.clear();
+  for(int pass=0; pass<2 && eviction_ranking_.size()<n_evict; ++pass)
+  {
+    const size_t k_begin = (pass == 0) ? 0 : seed_batches_.size()-1;
+    const size_t k_end = (pass == 0) ? seed_batches_.size()-1 : seed_batches_.size();
+    const size_t first = eviction_ranking_.size();
+    for(size_t k=k_begin; k<k_end; ++k)
+    {
+      const SeedStore& seeds = seed_batches_[k].seeds;
+      for(size_t i=0; i<seeds.size(); ++i)
+        eviction_ranking_.push_back(RankedSeed{seeds.quality(i, options_.seed_convergence_sigma2_thresh),
+                                               static_cast<uint32_t>(k), static_cast<uint32_t>(i)});
+    }
+    const size_t n_needed = n_evict-first;
+    if(eviction_ranking_.size()-first > n_needed)
+    {
+      std::nth_element(eviction_ranking_.begin()+first, eviction_ranking_.begin()+first+n_needed,
+                       eviction_ranking_.end(), [](const RankedSeed& lhs, const RankedSeed& rhs) {
+        return lhs.quality < rhs.quality;
+      });
+      eviction_ranking_.resize(first+n_needed);
+    }
+  }
+
+  // remove the evicted seeds batch by batch
+  std::sort(eviction_ranking_.begin(), eviction_ranking_.end(), [](const RankedSeed& lhs, const RankedSeed& rhs) {
+    return lhs.k < rhs.k;
+  });
+  for(size_t r=0; r<eviction_ranking_.size(); )
+  {
+    SeedStore& seeds = seed_batches_[eviction_ranking_[r].k].seeds;
+    seed_removed_.assign(seeds.size(), 0);
+    const uint32_t k = eviction_ranking_[r].k;
+    for(; r<eviction_ranking_.size() && eviction_ranking_[r].k == k; ++r)
+      seed_removed_[eviction_ranking_[r].i] = 1;
+    countSeeds(SeedHistogram::EVICTED, seeds, [&](size_t i){ return seed_removed_[i]; });
+    seeds.removeIf([&](size_t i){ return seed_removed_[i]; });
+  }
+  seed_batches_.erase(
+      std::remove_if(seed_batches_.begin(), seed_batches_.end(), [](const SeedBatch& b){ return b.seeds.empty(); }),
+      seed_batches_.end());
+
+  if(options_.verbose)
+    SVO_INFO_STREAM("DepthFilter: evicted " << eviction_ranking_.size() << " seeds");
+}
+
+void DepthFilter::prepareWorkers()
+{
+  const size_t n_workers = std::max(options_.n_threads, 1);
+  if(!pool_ || pool_->size() != n_workers)
+    pool_.reset(new WorkerPool(n_workers));
+  while(matchers_.size() < n_workers)
+    matchers_.emplace_back(new Matcher());
+}
+
+size_t DepthFilter::initializeSeedsStereo(FramePtr frame, FramePtr stereo_frame)
+{
+  lock_t lock(seeds_mut_);
+  if(seed_batches_.empty() || seed_batches_.back().frame != frame)
+    return 0;
+  SeedStore& seeds = seed_batches_.back().seeds;
+  prepareWorkers();
+  const double focal_length = stereo_frame->cam_->errorMultiplier2();
+  const double px_error_angle = atan(1.0/(2.0*focal_length))*2.0; // law of chord (sehnensatz)
+  const SE3d T_ref_cur = frame->T_f_w_ * stereo_frame->T_f_w_.inverse();
+
+  // each seed is written by one worker only
+  std::vector<char> matched(seeds.size(), 0);
+  pool_->parallelFor(seeds.size(), 16, [&](size_t worker_id, size_t begin, size_t end) {
+    Matcher& matcher = *matchers_[worker_id];
+    for(size_t i=begin; i<end; ++i)
+    {
+      const float z_inv_min = seeds.mu[i] + sqrt(seeds.sigma2[i]);
+      const float z_inv_max = std::max(seeds.mu[i] - sqrt(seeds.sigma2[i]), 0.00000001f);
+      double z;
+      if(!matcher.findStereoMatch(*frame, *stereo_frame, *seeds.ftr[i],
+                                  1.0/seeds.mu[i], 1.0/z_inv_min, 1.0/z_inv_max, z))
+        continue;
+      const double tau = computeTau(T_ref_cur.translation(), seeds.ftr[i]->f, z, cos(px_error_angle), sin(px_error_angle));
+      const double tau_inverse = 0.5 * (1.0/std::max(0.0000001, z-tau) - 1.0/(z+tau));
+      if(!std::isfinite(tau_inverse))
+        continue;
+      seeds.mu[i] = 1.0/z;
+      seeds.sigma2[i] = tau_inverse*tau_inverse;
+      matched[i] = 1;
+    }
+  });
+  const size_t n_matched = std::count(matched.begin(), matched.end(), 1);
+
+  if(options_.verbose)
+    SVO_INFO_STREAM("DepthFilter: Initialized " << n_matched << " of " << seeds.size() << " seeds by stereo");
+  return n_matched;
 }
 
 void DepthFilter::removeKeyframe(FramePtr frame)
 {
-  seeds_updating_halt_ = true;
+  Command cmd;
+  cmd.type = Command::REMOVE_KEYFRAME;
+  cmd.frame = frame;
+  dispatchCommand(std::move(cmd));
+}
+
+void DepthFilter::removeSeeds(FramePtr frame)
+{
   lock_t lock(seeds_mut_);
-  std::list<Seed>::iterator it=seeds_.begin();
-  size_t n_removed = 0;
-  while(it!=seeds_.end())
+  for(auto it=seed_batches_.begin(); it!=seed_batches_.end(); ++it)
   {
-    if(it->ftr->frame == frame.get())
+    if(it->frame == frame)
     {
-      it = seeds_.erase(it);
-      ++n_removed;
+      countSeeds(SeedHistogram::REMOVED, it->seeds, [](size_t){ return true; });
+      seed_batches_.erase(it);
+      break;
     }
-    else
-      ++it;
   }
-  seeds_updating_halt_ = false;
+  publishSeedCount();
 }
 
 void DepthFilter::reset()
 {
-    seeds_updating_halt_ = true;
-    {
-        lock_t lock(seeds_mut_);
-        seeds_.clear();
-    }
+    Command cmd;
+    cmd.type = Command::RESET;
+    dispatchCommand(std::move(cmd));
+}
+
+void DepthFilter::clearSeeds()
+{
     lock_t lock(seeds_mut_);
-    while(!frame_queue_.empty())
-        frame_queue_.pop();
-    seeds_updating_halt_ = false;
+    for(const SeedBatch& batch : seed_batches_)
+        countSeeds(SeedHistogram::REMOVED, batch.seeds, [](size_t){ return true; });
+    seed_batches_.clear();
+    replay_tasks_.clear();
+    publishSeedCount();
 
     if(options_.verbose)
         SVO_INFO_STREAM("DepthFilter: RESET.");
 }
 
+DepthFilter::QueueStats DepthFilter::getQueueStats() const
+{
+  QueueStats stats;
+  stats.depth = commands_ ? commands_->size() : 0;
+  stats.n_deferred = deferred_commands_.size();
+  stats.n_dropped = n_dropped_frames_;
+  return stats;
+}
+
 void DepthFilter::updateSeedsLoop()
 {
     while(!thread_halt_)
     {
-        FramePtr frame;
-        std::vector<FramePtr> history_frames;
+        Command cmd;
+        if(!commands_->tryPop(cmd))
         {
-            lock_t lock(frame_queue_mut_);
-            while(frame_queue_.empty() && new_keyframe_set_ == false)
-                frame_queue_cond_.wait(lock);
-            if(new_keyframe_set_)
-            {
-                new_keyframe_set_ = false;
-                seeds_updating_halt_ = false;
-                clearFrameQueue();
-                frame = new_keyframe_;
-                history_frames = new_keyframe_update_frames_;
-            }
-            else
+            // replay the history between the commands
+            if(!replay_tasks_.empty())
             {
-                frame = frame_queue_.front();
-                frame_queue_.pop();
-            }
-        }
-        updateSeeds(frame);
-        if(frame->isKeyframe())
-        {
-            int old_seed_size = seeds_.size();
-            initializeSeeds(frame);
-            int new_seed_size = seeds_.size();
-            if(new_seed_size>old_seed_size)
-            {
-                for(auto& f:new_keyframe_update_frames_)
-                    updateSeeds(f, old_seed_size);
+                std::unique_ptr<EpochReclaimer::Guard> epoch_guard;
+                if(reclaimer_ != NULL)
+                    epoch_guard.reset(new EpochReclaimer::Guard(*reclaimer_));
+                replaySeedsStep();
+                continue;
             }
+            lock_t lock(wakeup_mut_);
+            thread_waiting_ = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            wakeup_cond_.wait(lock, [&]{ return thread_halt_ || !commands_->empty(); });
+            thread_waiting_ = false;
+            continue;
         }
+        if(cmd.type != Command::ADD_FRAME)
+            --n_pending_interrupts_;
+
+        std::unique_ptr<EpochReclaimer::Guard> epoch_guard;
+        if(reclaimer_ != NULL)
+            epoch_guard.reset(new EpochReclaimer::Guard(*reclaimer_));
+        processCommand(cmd);
     }
 }
 
-void DepthFilter::updateSeeds(FramePtr frame, int start_seed_idx)
+void DepthFilter::processCommand(Command& cmd)
+{
+    switch(cmd.type)
+    {
+    case Command::ADD_FRAME:
+        // frames queued before a keyframe are outdated
+        if(n_pending_interrupts_ > 0)
+            ++n_dropped_frames_;
+        else
+            updateSeeds(ReplayFrame(*cmd.frame));
+        break;
+    case Command::ADD_KEYFRAME:
+    {
+        updateSeeds(ReplayFrame(*cmd.frame));
+        const size_t n_new_seeds = initializeSeeds(cmd.frame, cmd.depth_mean, cmd.depth_min, cmd.depth_prior);
+        size_t n_stereo_seeds = 0;
+        if(n_new_seeds > 0 && cmd.stereo_frame && options_.stereo_seed_init)
+            n_stereo_seeds = initializeSeedsStereo(cmd.frame, cmd.stereo_frame);
+
+        // seeds with a stereo prior converge without replaying the history
+        if(n_new_seeds > 0 && n_stereo_seeds < options_.stereo_skip_replay_ratio*n_new_seeds)
+            addReplayTask(cmd.history_frames);
+        break;
+    }
+    case Command::REMOVE_KEYFRAME:
+        removeSeeds(cmd.frame);
+        break;
+    case Command::RESET:
+        clearSeeds();
+        break;
+    }
+}
+
+void DepthFilter::updateSeeds(const ReplayFrame& frame, FramePtr only_keyframe)
 {
   // update only a limited number of seeds, because we don't have time to do it
-  // for all the seeds in every frame!
-  size_t n_updates=0, n_failed_matches=0, n_seeds = seeds_.size();
+  // for all the seeds in every frame! The seeds with the largest expected
+  // information gain are updated first, until the time budget is used up.
+  const auto t_start = std::chrono::steady_clock::now();
+  const bool has_budget = options_.seed_update_budget_ms > 0.0 && !deterministic_;
+  const auto deadline = t_start + std::chrono::microseconds(
+      static_cast<int64_t>(options_.seed_update_budget_ms*1000.0));
   lock_t lock(seeds_mut_);
-  std::list<Seed>::iterator it=seeds_.begin();
-  for(int i=0; i<start_seed_idx; i++) {it++;}
+  ++n_frames_;
 
-  const double focal_length = frame->cam_->errorMultiplier2();
-  double px_noise = 1.0;
-  double px_error_angle = atan(px_noise/(2.0*focal_length))*2.0; // law of chord (sehnensatz)
+  // drop the batches of keyframes which are too old at once
+  while(!seed_batches_.empty() && (SeedBatch::counter - seed_batches_.front().id) > options_.max_n_kfs)
+  {
+    countSeeds(SeedHistogram::AGED_OUT, seed_batches_.front().seeds, [](size_t){ return true; });
+    seed_batches_.pop_front();
+  }
 
-  while( it!=seeds_.end())
+  // all seeds of a batch share the relative pose to the frame
+  size_t first_batch = 0, end_batch = seed_batches_.size();
+  if(only_keyframe)
   {
-    // set this value true when seeds updating should be interrupted
-    if(seeds_updating_halt_)
-      return;
+    first_batch = end_batch;
+    for(size_t k=0; k<seed_batches_.size(); ++k)
+      if(seed_batches_[k].frame == only_keyframe)
+        first_batch = k;
+    end_batch = std::min(first_batch+1, end_batch);
+  }
+  seed_refs_.clear();
+  batch_poses_.clear();
+  for(size_t k=first_batch; k<end_batch; ++k)
+  {
+    const SeedBatch& batch = seed_batches_[k];
+    batch_poses_.push_back(batch.frame->T_f_w_ * frame.T_f_w_.inverse());
+    for(size_t i=0; i<batch.seeds.size(); ++i)
+      seed_refs_.push_back(SeedRef{static_cast<uint32_t>(k), static_cast<uint32_t>(i)});
+  }
+  const size_t n_seeds = seed_refs_.size();
 
-    // check if seed is not already too old
-    if((Seed::batch_counter - it->batch_id) > options_.max_n_kfs) {
-      it = seeds_.erase(it);
-      continue;
-    }
+  prepareWorkers();
+  const double focal_length = frame.cam_->errorMultiplier2();
+  const double px_noise = 1.0;
+  const double px_error_angle = atan(px_noise/(2.0*focal_length))*2.0; // law of chord (sehnensatz)
+  const Vector2d px_error(cos(px_error_angle), sin(px_error_angle));
 
-    // check if point is visible in the current image
-    SE3 T_ref_cur = it->ftr->frame->T_f_w_ * frame->T_f_w_.inverse();
-    const Vector3d xyz_f(T_ref_cur.inverse()*(1.0/it->mu * it->ftr->f) );
-    if(xyz_f.z() < 0.0)  {
-      ++it; // behind the camera
-      continue;
-    }
-    if(!frame->cam_->isInFrame(frame->f2c(xyz_f).cast<int>())) {
-      ++it; // point does not project in image
-      continue;
+  // check visibility and rank the seeds in parallel
+  seed_updates_.assign(n_seeds, SeedUpdate());
+  pool_->parallelFor(n_seeds, 64, [&](size_t worker_id, size_t begin, size_t end) {
+    for(size_t r=begin; r<end; ++r)
+    {
+      const SeedRef& ref = seed_refs_[r];
+      scheduleSeed(frame, batch_poses_[ref.k-first_batch], px_error,
+                   seed_batches_[ref.k].seeds, ref.i, seed_updates_[r]);
     }
+  });
+  seed_schedule_.clear();
+  for(size_t r=0; r<n_seeds; ++r)
+    if(seed_updates_[r].status == SeedUpdate::SCHEDULED)
+      seed_schedule_.push_back(r);
+  std::stable_sort(seed_schedule_.begin(), seed_schedule_.end(), [&](uint32_t lhs, uint32_t rhs) {
+    return seed_updates_[lhs].priority > seed_updates_[rhs].priority;
+  });
 
-    // we are using inverse depth coordinates
-    float z_inv_min = it->mu + sqrt(it->sigma2);
-    float z_inv_max = std::max(it->mu - sqrt(it->sigma2), 0.00000001f);
-    double z;
-    if(!matcher_.findEpipolarMatchDirect(
-        *it->ftr->frame, *frame, *it->ftr, 1.0/it->mu, 1.0/z_inv_min, 1.0/z_inv_max, z))
+  // measure the seeds in order of priority, each worker uses its own matcher.
+  // Seeds which are not measured before the deadline keep their estimate.
+  pool_->parallelFor(seed_schedule_.size(), 8, [&](size_t worker_id, size_t begin, size_t end) {
+    for(size_t s=begin; s<end; ++s)
     {
-      it->b++; // increase outlier probability when no match was found
-      ++it;
-      ++n_failed_matches;
-      continue;
+      // stop when a keyframe or the end of the thread is waiting
+      if(isInterrupted())
+        return;
+      if(has_budget && std::chrono::steady_clock::now() > deadline)
+        return;
+      const size_t r = seed_schedule_[s];
+      const SeedRef& ref = seed_refs_[r];
+      measureSeed(frame, batch_poses_[ref.k-first_batch], *matchers_[worker_id], px_error,
+                  seed_batches_[ref.k].seeds, ref.i, seed_updates_[r]);
     }
+  });
 
-    // compute tau
-    double tau = computeTau(T_ref_cur, it->ftr->f, z, px_error_angle);
-    double tau_inverse = 0.5 * (1.0/std::max(0.0000001, z-tau) - 1.0/(z+tau));
+  // commit the measurements batch by batch in seed order, such that the result
+  // does not depend on the number of workers
+  UpdateStats stats;
+  for(size_t k=first_batch, r=0; k<end_batch; ++k)
+  {
+    SeedStore& seeds = seed_batches_[k].seeds;
+    const size_t r_begin = r;
+    seed_removed_.assign(seeds.size(), 0);
+    batch_idx_.clear();
+    batch_x_.clear();
+    batch_tau2_.clear();
+    for(size_t i=0; i<seeds.size(); ++i, ++r)
+    {
+      const SeedUpdate& u = seed_updates_[r];
+      if(u.status == SeedUpdate::INVISIBLE)
+      {
+        ++stats.n_invisible;
+      }
+      else if(u.status == SeedUpdate::SCHEDULED)
+      {
+        ++stats.n_skipped;
+      }
+      else if(u.status == SeedUpdate::NO_MATCH)
+      {
+        ++stats.n_failed;
+        seeds.b[i]++; // increase outlier probability when no match was found
+        seeds.n_failed[i]++;
+      }
+      else if(u.status == SeedUpdate::MEASURED)
+      {
+        ++stats.n_updated;
+        seeds.n_failed[i] = 0;
+        batch_idx_.push_back(i);
+        batch_x_.push_back(u.x);
+        batch_tau2_.push_back(u.tau2);
+        if(frame.is_keyframe_)
+        {
+          // The feature detector should not initialize new seeds close to this location
+          feature_detector_->getGrid().setOccupied(u.px_cur[0], u.px_cur[1]);
+        }
+      }
+    }
 
-    // update the estimate
-    updateSeed(1./z, tau_inverse*tau_inverse, &*it);
-    ++n_updates;
+    // update the estimates
+    updateSeedBatch(batch_idx_, batch_x_, batch_tau2_, seeds);
 
-    if(frame->isKeyframe())
+    for(const uint32_t i : batch_idx_)
     {
-        // The feature detector should not initialize new seeds close to this location
-        auto &px = matcher_.px_cur_;
-        feature_detector_->getGrid().setOccupied(px[0], px[1]);
+      // if the seed has converged, we initialize a new candidate point and remove the seed
+      if(sqrt(seeds.sigma2[i]) < seeds.z_range[i]/options_.seed_convergence_sigma2_thresh)
+      {
+        convergeSeed(seeds, i);
+        seed_removed_[i] = 2;
+        ++stats.n_converged;
+      }
+      else if(seed_updates_[r_begin+i].z_inv_min_nan)
+      {
+        SVO_WARN_STREAM("z_min is NaN");
+        seed_removed_[i] = 1;
+      }
     }
+    countSeeds(SeedHistogram::CONVERGED, seeds, [&](size_t i){ return seed_removed_[i] == 2; });
+    countSeeds(SeedHistogram::DIVERGED, seeds, [&](size_t i){ return seed_removed_[i] == 1; });
+    seeds.removeIf([&](size_t i){ return seed_removed_[i]; });
+  }
+
+  // release the keyframes which have no seeds anymore
+  seed_batches_.erase(
+      std::remove_if(seed_batches_.begin(), seed_batches_.end(), [](const SeedBatch& b){ return b.seeds.empty(); }),
+      seed_batches_.end());
+  publishSeedCount();
 
-    // if the seed has converged, we initialize a new candidate point and remove the seed
-    if(sqrt(it->sigma2) < it->z_range/options_.seed_convergence_sigma2_thresh)
+  stats.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t_start).count();
+  {
+    std::lock_guard<std::mutex> stats_lock(stats_mut_);
+    stats_ = stats;
+  }
+  if(options_.verbose && stats.n_skipped > 0)
+    SVO_INFO_STREAM("DepthFilter: skipped " << stats.n_skipped << " seeds, updated " << stats.n_updated);
+}
+
+void DepthFilter::convergeSeed(SeedStore& seeds, size_t i)
+{
+  std::unique_ptr<Feature>& ftr = seeds.ftr[i];
+  assert(ftr->point == NULL); // TODO this should not happen anymore
+  Vector3d xyz_world(ftr->frame->T_f_w_.inverse() * (ftr->f * (1.0/seeds.mu[i])));
+  Point* point = new Point(xyz_world, ftr.get());
+  ftr->point = point;
+  seed_converged_cb_(point, seeds.sigma2[i]); // put in candidate list
+  ftr.release(); // the feature is owned by the candidate point now
+}
+
+void DepthFilter::addReplayTask(const std::vector<ReplayFramePtr>& frames)
+{
+  if(frames.empty())
+    return;
+  ReplayTask task;
+  task.batch_id = SeedBatch::counter;
+  task.frames = frames;
+  task.next_frame = 0;
+  replay_tasks_.push_front(std::move(task));
+}
+
+bool DepthFilter::replaySeedsStep()
+{
+  if(replay_tasks_.empty())
+    return false;
+  ReplayTask& task = replay_tasks_.front();
+  lock_t lock(seeds_mut_);
+  auto batch = std::find_if(seed_batches_.begin(), seed_batches_.end(),
+                            [&](const SeedBatch& b){ return b.id == task.batch_id; });
+  if(batch == seed_batches_.end() || task.next_frame >= task.frames.size())
+  {
+    // done, or the keyframe was removed in the meantime
+    replay_tasks_.pop_front();
+    return !replay_tasks_.empty();
+  }
+  SeedStore& seeds = batch->seeds;
+  const size_t frame_begin = task.next_frame;
+  const size_t frame_end = std::min(frame_begin + std::max<size_t>(options_.replay_frames_per_step, 1),
+                                    task.frames.size());
+  replay_poses_.clear();
+  for(size_t f=frame_begin; f<frame_end; ++f)
+    replay_poses_.push_back(batch->frame->T_f_w_ * task.frames[f]->T_f_w_.inverse());
+
+  prepareWorkers();
+  replay_scratch_.resize(pool_->size());
+  seed_removed_.assign(seeds.size(), 0); // 1: removed, 2: converged
+  pool_->parallelFor(seeds.size(), 32, [&](size_t worker_id, size_t begin, size_t end) {
+    Matcher& matcher = *matchers_[worker_id];
+    ReplayScratch& scratch = replay_scratch_[worker_id];
+    for(size_t f=frame_begin; f<frame_end; ++f)
     {
-      assert(it->ftr->point == NULL); // TODO this should not happen anymore
-      Vector3d xyz_world(it->ftr->frame->T_f_w_.inverse() * (it->ftr->f * (1.0/it->mu)));
-      Point* point = new Point(xyz_world, it->ftr.get());
-      it->ftr->point = point;
-      /* FIXME it is not threadsafe to add a feature to the frame here.
-      if(frame->isKeyframe())
+      const ReplayFrame& frame = *task.frames[f];
+      const SE3d& T_ref_cur = replay_poses_[f-frame_begin];
+      const double focal_length = frame.cam_->errorMultiplier2();
+      const double px_error_angle = atan(1.0/(2.0*focal_length))*2.0; // law of chord (sehnensatz)
+      const Vector2d px_error(cos(px_error_angle), sin(px_error_angle));
+      scratch.idx.clear();
+      scratch.x.clear();
+      scratch.tau2.clear();
+      scratch.z_inv_min_nan.clear();
+      for(size_t i=begin; i<end; ++i)
       {
-        Feature* ftr = new Feature(frame.get(), matcher_.px_cur_, matcher_.search_level_);
-        ftr->point = point;
-        point->addFrameRef(ftr);
-        frame->addFeature(ftr);
-        it->ftr->frame->addFeature(it->ftr);
+        if(seed_removed_[i])
+          continue;
+        SeedUpdate u;
+        scheduleSeed(frame, T_ref_cur, px_error, seeds, i, u);
+        if(u.status == SeedUpdate::INVISIBLE)
+          continue;
+        measureSeed(frame, T_ref_cur, matcher, px_error, seeds, i, u);
+        if(u.status == SeedUpdate::NO_MATCH)
+        {
+          seeds.b[i]++; // increase outlier probability when no match was found
+          seeds.n_failed[i]++;
+          continue;
+        }
+        seeds.n_failed[i] = 0;
+        scratch.idx.push_back(i);
+        scratch.x.push_back(u.x);
+        scratch.tau2.push_back(u.tau2);
+        scratch.z_inv_min_nan.push_back(u.z_inv_min_nan);
       }
-      else
-      */
+
+      // the seeds of this worker are disjoint from the others. As in the live
+      // update, a seed is only dropped for a NaN bound if it did not converge.
+      updateSeedBatch(scratch.idx, scratch.x, scratch.tau2, seeds);
+      for(size_t k=0; k<scratch.idx.size(); ++k)
       {
-        seed_converged_cb_(point, it->sigma2); // put in candidate list
+        const uint32_t i = scratch.idx[k];
+        if(sqrt(seeds.sigma2[i]) < seeds.z_range[i]/options_.seed_convergence_sigma2_thresh)
+          seed_removed_[i] = 2;
+        else if(scratch.z_inv_min_nan[k])
+          seed_removed_[i] = 1;
       }
-      it = seeds_.erase(it);
     }
-    else if(isnan(z_inv_min))
+  });
+
+  // hand over the converged seeds in seed order
+  size_t n_converged = 0;
+  for(size_t i=0; i<seeds.size(); ++i)
+  {
+    if(seed_removed_[i] == 2)
     {
-      SVO_WARN_STREAM("z_min is NaN");
-      it = seeds_.erase(it);
+      convergeSeed(seeds, i);
+      ++n_converged;
     }
-    else
-      ++it;
   }
+  countSeeds(SeedHistogram::CONVERGED, seeds, [&](size_t i){ return seed_removed_[i] == 2; });
+  countSeeds(SeedHistogram::DIVERGED, seeds, [&](size_t i){ return seed_removed_[i] == 1; });
+  seeds.removeIf([&](size_t i){ return seed_removed_[i]; });
+  if(seeds.empty())
+    seed_batches_.erase(batch);
+  publishSeedCount();
+  task.next_frame = frame_end;
+
+  if(options_.verbose)
+    SVO_INFO_STREAM("DepthFilter: replayed frames " << frame_begin << "-" << frame_end
+                    << " of " << task.frames.size() << ", " << n_converged << " seeds converged");
+  return true;
 }
 
-void DepthFilter::clearFrameQueue()
+DepthFilter::UpdateStats DepthFilter::getUpdateStats() const
 {
-  while(!frame_queue_.empty())
-    frame_queue_.pop();
+  std::lock_guard<std::mutex> lock(stats_mut_);
+  return stats_;
 }
 
-/*void DepthFilter::getSeedsCopy(const FramePtr& frame, std::list<Seed>& seeds)
+DepthFilter::SeedHistogram DepthFilter::getSeedHistogram() const
 {
-    lock_t lock(seeds_mut_);
-    for(std::list<Seed>::iterator it=seeds_.begin(); it!=seeds_.end(); ++it)
-    {
-        if (it->ftr->frame == frame.get())
-            seeds.push_back(*it);
-    }
-}*/
+  std::lock_guard<std::mutex> lock(stats_mut_);
+  return seed_histogram_;
+}
+
+void DepthFilter::publishSeedCount()
+{
+  size_t n = 0;
+  for(const SeedBatch& batch : seed_batches_)
+    n += batch.seeds.size();
+  n_seeds_.store(n, std::memory_order_relaxed);
+}
 
-template<class real>
-real pdf(std::normal_distribution<real> nd, real x)
+void DepthFilter::scheduleSeed(
+    const ReplayFrame& frame,
+    const SE3d& T_ref_cur,
+    const Vector2d& px_error,
+    const SeedStore& seeds,
+    size_t i,
+    SeedUpdate& update) const
 {
-    real e = x - nd.mean(), sd = nd.stddev();
-    e *= -e;
-    e /= 2 * sd * sd;
-    return exp(e) / (sd * sqrt(2 * M_PI));
+  // check if point is visible in the current image
+  update.status = SeedUpdate::INVISIBLE;
+  const Feature& ftr = *seeds.ftr[i];
+  const float mu = seeds.mu[i];
+  const float sigma2 = seeds.sigma2[i];
+  const Vector3d xyz_f(T_ref_cur.inverse()*(1.0/mu * ftr.f) );
+  if(xyz_f.z() < 0.0)
+    return; // behind the camera
+  if(!frame.cam_->isInFrame(frame.f2c(xyz_f).cast<int>()))
+    return; // point does not project in image
+  update.status = SeedUpdate::SCHEDULED;
+
+  // predict the measurement uncertainty from the baseline at the current
+  // estimate. The information gain of a Gaussian measurement is large for
+  // uncertain seeds with a good baseline. It is weighted with the inlier
+  // probability and seeds which would converge with this measurement first.
+  const double z = 1.0/mu;
+  const double tau = computeTau(T_ref_cur.translation(), ftr.f, z, px_error[0], px_error[1]);
+  const double tau_inverse = 0.5 * (1.0/std::max(0.0000001, z-tau) - 1.0/(z+tau));
+  const double tau2 = std::max(tau_inverse*tau_inverse, 1e-12);
+  const double inlier_probability = seeds.a[i]/(seeds.a[i]+seeds.b[i]);
+  double priority = inlier_probability * 0.5*log(1.0 + sigma2/tau2);
+  const double sigma2_post = sigma2*tau2/(sigma2+tau2);
+  if(sqrt(sigma2_post) < seeds.z_range[i]/options_.seed_convergence_sigma2_thresh)
+    priority *= 2.0;
+  update.priority = std::isfinite(priority) ? priority : 0.0;
 }
 
-void DepthFilter::updateSeed(const float x, const float tau2, Seed* seed)
+void DepthFilter::measureSeed(
+    const ReplayFrame& frame,
+    const SE3d& T_ref_cur,
+    Matcher& matcher,
+    const Vector2d& px_error,
+    const SeedStore& seeds,
+    size_t i,
+    SeedUpdate& update) const
 {
-  float norm_scale = sqrt(seed->sigma2 + tau2);
-  if(std::isnan(norm_scale))
+  const Feature& ftr = *seeds.ftr[i];
+  const float mu = seeds.mu[i];
+  const float sigma2 = seeds.sigma2[i];
+
+  // we are using inverse depth coordinates
+  float z_inv_min = mu + sqrt(sigma2);
+  float z_inv_max = std::max(mu - sqrt(sigma2), 0.00000001f);
+  double z;
+  if(!matcher.findEpipolarMatchDirect(
+      *ftr.frame, frame, ftr, 1.0/mu, 1.0/z_inv_min, 1.0/z_inv_max, z))
+  {
+    update.status = SeedUpdate::NO_MATCH;
     return;
-  std::normal_distribution<float> nd(seed->mu, norm_scale);
-  float s2 = 1./(1./seed->sigma2 + 1./tau2);
-  float m = s2*(seed->mu/seed->sigma2 + x/tau2);
-  float C1 = seed->a/(seed->a+seed->b) * pdf(nd, x);
-  float C2 = seed->b/(seed->a+seed->b) * 1./seed->z_range;
-  float normalization_constant = C1 + C2;
-  C1 /= normalization_constant;
-  C2 /= normalization_constant;
-  float f = C1*(seed->a+1.)/(seed->a+seed->b+1.) + C2*seed->a/(seed->a+seed->b+1.);
-  float e = C1*(seed->a+1.)*(seed->a+2.)/((seed->a+seed->b+1.)*(seed->a+seed->b+2.))
-          + C2*seed->a*(seed->a+1.0f)/((seed->a+seed->b+1.0f)*(seed->a+seed->b+2.0f));
-
-  // update parameters
-  float mu_new = C1*m+C2*seed->mu;
-  seed->sigma2 = C1*(s2 + m*m) + C2*(seed->sigma2 + seed->mu*seed->mu) - mu_new*mu_new;
-  seed->mu = mu_new;
-  seed->a = (e-f)/(f-e/f);
-  seed->b = seed->a*(1.0f-f)/f;
+  }
+
+  // compute tau
+  double tau = computeTau(T_ref_cur.translation(), ftr.f, z, px_error[0], px_error[1]);
+  double tau_inverse = 0.5 * (1.0/std::max(0.0000001, z-tau) - 1.0/(z+tau));
+
+  update.status = SeedUpdate::MEASURED;
+  update.px_cur = matcher.px_cur_;
+  update.x = 1./z;
+  update.tau2 = tau_inverse*tau_inverse;
+  update.z_inv_min_nan = std::isnan(z_inv_min);
+}
+
+void DepthFilter::updateSeedBatch(
+    const std::vector<uint32_t>& idx,
+    const std::vector<float>& x_vec,
+    const std::vector<float>& tau2_vec,
+    SeedStore& seeds)
+{
+  // process the seeds in fixed-size blocks, such that all intermediate results
+  // live on the stack and Eigen vectorizes the expressions
+  static const int kBlock = 64;
+  typedef Eigen::Array<float, kBlock, 1> Block;
+  const size_t n = idx.size();
+  for(size_t start=0; start<n; start+=kBlock)
+  {
+    const int n_block = std::min<size_t>(kBlock, n-start);
+
+    // gather the states of the measured seeds, pad with a valid dummy state
+    Block mu, sigma2, a, b, z_range, x, tau2;
+    for(int k=0; k<kBlock; ++k)
+    {
+      if(k < n_block)
+      {
+        const uint32_t i = idx[start+k];
+        mu[k] = seeds.mu[i];
+        sigma2[k] = seeds.sigma2[i];
+        a[k] = seeds.a[i];
+        b[k] = seeds.b[i];
+        z_range[k] = seeds.z_range[i];
+        x[k] = x_vec[start+k];
+        tau2[k] = tau2_vec[start+k];
+      }
+      else
+      {
+        mu[k] = sigma2[k] = a[k] = b[k] = z_range[k] = x[k] = tau2[k] = 1.0f;
+      }
+    }
+
+    // Beta-Gaussian update, the normal pdf is evaluated in closed form
+    const Block norm_var = sigma2 + tau2;
+    const Block s2 = sigma2*tau2/norm_var;
+    const Block m = s2*(mu/sigma2 + x/tau2);
+    const Block ab_inv = (a+b).inverse();
+    const Block pdf = (-(x-mu).square()/(2.0f*norm_var)).exp() * (norm_var*static_cast<float>(2.0*M_PI)).rsqrt();
+    Block C1 = a*ab_inv*pdf;
+    Block C2 = b*ab_inv/z_range;
+    const Block normalization_inv = (C1 + C2).inverse();
+    C1 *= normalization_inv;
+    C2 *= normalization_inv;
+    const Block ab1_inv = (a+b+1.0f).inverse();
+    const Block ab12_inv = ab1_inv*(a+b+2.0f).inverse();
+    const Block f = (C1*(a+1.0f) + C2*a)*ab1_inv;
+    const Block e = (C1*(a+1.0f)*(a+2.0f) + C2*a*(a+1.0f))*ab12_inv;
+    const Block mu_new = C1*m + C2*mu;
+    const Block sigma2_new = C1*(s2 + m.square()) + C2*(sigma2 + mu.square()) - mu_new.square();
+    const Block a_new = (e-f)/(f-e/f);
+    const Block b_new = a_new*(1.0f-f)/f;
+
+    // scatter the new states, seeds with an invalid variance are not updated
+    for(int k=0; k<n_block; ++k)
+    {
+      if(!(norm_var[k] >= 0.0f))
+        continue;
+      const uint32_t i = idx[start+k];
+      seeds.mu[i] = mu_new[k];
+      seeds.sigma2[i] = sigma2_new[k];
+      seeds.a[i] = a_new[k];
+      seeds.b[i] = b_new[k];
+    }
+  }
 }
 
 double DepthFilter::computeTau(
@@ -379,15 +1073,30 @@ double DepthFilter::computeTau(
       const double z,
       const double px_error_angle)
 {
-  Vector3d t(T_ref_cur.translation());
+  return computeTau(T_ref_cur.translation(), f, z, cos(px_error_angle), sin(px_error_angle));
+}
+
+double DepthFilter::computeTau(
+      const Vector3d& t,
+      const Vector3d& f,
+      const double z,
+      const double cos_px_error_angle,
+      const double sin_px_error_angle)
+{
+  // alpha is the angle between f and t, beta the angle between a and -t. The
+  // sines follow from the dot products, beta_plus = beta + px_error_angle and
+  // gamma_plus = PI-alpha-beta_plus from the angle sum identities.
   Vector3d a = f*z-t;
   double t_norm = t.norm();
   double a_norm = a.norm();
-  double alpha = acos(f.dot(t)/t_norm); // dot product
-  double beta = acos(a.dot(-t)/(t_norm*a_norm)); // dot product
-  double beta_plus = beta + px_error_angle;
-  double gamma_plus = PI-alpha-beta_plus; // triangle angles sum to PI
-  double z_plus = t_norm*sin(beta_plus)/sin(gamma_plus); // law of sines
+  double cos_alpha = f.dot(t)/t_norm; // dot product
+  double cos_beta = a.dot(-t)/(t_norm*a_norm); // dot product
+  double sin_alpha = sqrt(std::max(0.0, 1.0-cos_alpha*cos_alpha));
+  double sin_beta = sqrt(std::max(0.0, 1.0-cos_beta*cos_beta));
+  double sin_beta_plus = sin_beta*cos_px_error_angle + cos_beta*sin_px_error_angle;
+  double cos_beta_plus = cos_beta*cos_px_error_angle - sin_beta*sin_px_error_angle;
+  double sin_gamma_plus = sin_alpha*cos_beta_plus + cos_alpha*sin_beta_plus; // sin(PI-x) = sin(x)
+  double z_plus = t_norm*sin_beta_plus/sin_gamma_plus; // law of sines
   return (z_plus - z); // tau
 }
 
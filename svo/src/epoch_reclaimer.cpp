@@ -0,0 +1,152 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <chrono>
+#include <svo/epoch_reclaimer.h>
+
+namespace svo {
+
+EpochReclaimer::EpochReclaimer() :
+    epoch_(1),
+    thread_(NULL),
+    thread_halt_(false)
+{
+  for(size_t i=0; i<kMaxReaders; ++i)
+    readers_[i].store(kUnpinned, std::memory_order_relaxed);
+}
+
+EpochReclaimer::~EpochReclaimer()
+{
+  stopThread();
+  // nobody may be pinned anymore when the owner of the objects is destroyed.
+  for(const Retired& r : retired_)
+    r.deleter(r.obj);
+  retired_.clear();
+}
+
+size_t EpochReclaimer::pin() const
+{
+  while(true)
+  {
+    for(size_t i=0; i<kMaxReaders; ++i)
+    {
+      uint64_t expected = kUnpinned;
+      if(readers_[i].load(std::memory_order_relaxed) != kUnpinned)
+        continue;
+      // The seq_cst exchange orders the pin before all reads of the critical
+      // section and against the epoch increment in reclaim().
+      if(readers_[i].compare_exchange_strong(expected, epoch_.load()))
+        return i;
+    }
+    std::this_thread::yield(); // all slots in use
+  }
+}
+
+void EpochReclaimer::unpin(size_t slot) const
+{
+  readers_[slot].store(kUnpinned, std::memory_order_release);
+}
+
+void EpochReclaimer::retire(void* obj, Deleter deleter)
+{
+  size_t n_pending;
+  {
+    std::lock_guard<std::mutex> lock(retired_mut_);
+    retired_.push_back(Retired{epoch_.load(), obj, deleter});
+    n_pending = retired_.size();
+  }
+  if(n_pending > options_.max_pending)
+    cond_.notify_one();
+}
+
+size_t EpochReclaimer::reclaim()
+{
+  std::lock_guard<std::mutex> reclaim_lock(reclaim_mut_);
+
+  // A reader that pins after the increment can't reach objects retired before
+  // it, hence everything retired before the oldest pinned epoch can go.
+  const uint64_t epoch = epoch_.fetch_add(1) + 1;
+  uint64_t min_epoch = epoch;
+  for(size_t i=0; i<kMaxReaders; ++i)
+  {
+    const uint64_t e = readers_[i].load();
+    if(e != kUnpinned && e < min_epoch)
+      min_epoch = e;
+  }
+
+  std::vector<Retired> to_free;
+  {
+    std::lock_guard<std::mutex> lock(retired_mut_);
+    auto it = std::partition(retired_.begin(), retired_.end(),
+                             [&](const Retired& r) { return r.epoch >= min_epoch; });
+    to_free.assign(it, retired_.end());
+    retired_.erase(it, retired_.end());
+  }
+
+  // free outside of the lock such that retire() never waits for the deleters
+  for(const Retired& r : to_free)
+    r.deleter(r.obj);
+  return to_free.size();
+}
+
+void EpochReclaimer::startThread()
+{
+  if(thread_ != NULL)
+    return;
+  thread_halt_ = false;
+  thread_ = new std::thread(&EpochReclaimer::reclaimLoop, this);
+}
+
+void EpochReclaimer::stopThread()
+{
+  if(thread_ == NULL)
+    return;
+  {
+    std::lock_guard<std::mutex> lock(retired_mut_);
+    thread_halt_ = true;
+  }
+  cond_.notify_one();
+  thread_->join();
+  delete thread_;
+  thread_ = NULL;
+}
+
+size_t EpochReclaimer::nPending() const
+{
+  std::lock_guard<std::mutex> lock(retired_mut_);
+  return retired_.size();
+}
+
+void EpochReclaimer::reclaimLoop()
+{
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(retired_mut_);
+      cond_.wait_for(lock, std::chrono::milliseconds(options_.reclaim_period_ms), [&] {
+        return thread_halt_ || retired_.size() > options_.max_pending;
+      });
+      if(thread_halt_)
+        break;
+      if(retired_.empty())
+        continue;
+    }
+    reclaim();
+  }
+}
+
+} // namespace svo
@@ -26,7 +26,7 @@
 
 namespace svo {
 
-int Frame::frame_counter_ = 0;
+std::atomic<int> Frame::frame_counter_(0);
 
 
 
@@ -16,6 +16,8 @@
 
 #include <vikit/abstract_camera.h>
 #include <stdlib.h>
+#include <chrono>
+#include <algorithm>
 #include <Eigen/StdVector>
 #include <fstream>
 #include <svo/frame_handler_base.h>
@@ -24,6 +26,7 @@
 #include <svo/matcher.h>
 #include <svo/map.h>
 #include <svo/point.h>
+#include <svo/worker_pool.h>
 
 namespace svo
 {
@@ -41,7 +44,8 @@ FrameHandlerBase::FrameHandlerBase() :
     acc_num_obs_(10),
     num_obs_last_(0),
     tracking_quality_(TRACKING_INSUFFICIENT),
-    relocalize_after_track_failed_(true)
+    relocalize_after_track_failed_(true),
+    epoch_slot_(0)
 {
 #ifdef SVO_TRACE
   // Initialize Performance Monitor
@@ -68,7 +72,18 @@ FrameHandlerBase::FrameHandlerBase() :
   g_permon->addLog("loba_n_erredges_fin");
   g_permon->addLog("loba_err_init");
   g_permon->addLog("loba_err_fin");
+  g_permon->addLog("loba_window_n_kfs");
+  g_permon->addLog("loba_window_solve_ms");
+  g_permon->addLog("loba_window_marg_ms");
   g_permon->addLog("n_candidates");
+  g_permon->addLog("df_n_updated");
+  g_permon->addLog("df_n_skipped");
+  g_permon->addLog("df_queue_depth");
+  g_permon->addLog("df_n_dropped");
+  g_permon->addLog("df_n_seeds");
+  g_permon->addLog("df_n_converged");
+  g_permon->addLog("df_n_evicted");
+  g_permon->addLog("df_n_aged_out");
   g_permon->addLog("dropout");
   g_permon->init(Config::traceName(), Config::traceDir());
 #endif
@@ -101,7 +116,10 @@ bool FrameHandlerBase::startFrameProcessingCommon(const double timestamp)
   timer_.start();
 
   // some cleanup from last iteration, can't do before because of visualization
-  map_.emptyTrash();
+  map_.clearDeletedPoints();
+
+  // points deleted while processing this frame are not freed before we are done
+  epoch_slot_ = map_.reclaimer_.pin();
   return true;
 }
 
@@ -119,14 +137,12 @@ int FrameHandlerBase::finishFrameProcessingCommon(
     acc_num_obs_.push_back(num_observations);
   num_obs_last_ = num_observations;
   SVO_STOP_TIMER("tot_time");
+  map_.reclaimer_.unpin(epoch_slot_);
 
 #ifdef SVO_TRACE
   g_permon->writeToFile();
-  {
-    std::lock_guard<std::mutex> lock(map_.point_candidates_.mut_);
-    size_t n_candidates = map_.point_candidates_.candidates_.size();
-    SVO_LOG(n_candidates);
-  }
+  size_t n_candidates = map_.point_candidates_.size();
+  SVO_LOG(n_candidates);
 #endif
 
   if( relocalize_after_track_failed_ && dropout == RESULT_FAILURE &&
@@ -182,19 +198,13 @@ void FrameHandlerBase::optimizeStructure(
     size_t max_n_pts,
     int max_iter)
 {
-  std::deque<Point*> pts;
+  structure_pts_.clear();
   for(Features::iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
   {
     if((*it)->point != NULL)
-      pts.push_back((*it)->point);
-  }
-  max_n_pts = std::min(max_n_pts, pts.size());
-  nth_element(pts.begin(), pts.begin() + max_n_pts, pts.end(), ptLastOptimComparator);
-  for(std::deque<Point*>::iterator it=pts.begin(); it!=pts.begin()+max_n_pts; ++it)
-  {
-    (*it)->optimize(max_iter);
-    (*it)->last_structure_optim_ = frame->id_;
+      structure_pts_.push_back((*it)->point);
   }
+  optimizeStructurePoints(frame->id_, max_n_pts, max_iter);
 }
 
 void FrameHandlerBase::optimizeStructure(
@@ -202,28 +212,65 @@ void FrameHandlerBase::optimizeStructure(
     size_t max_n_pts,
     int max_iter)
 {
-  std::set<Point*> pts_set;
+  structure_pts_.clear();
   for(size_t i=0; i<frames->size(); i++)
   {
     FramePtr frame = frames->at(i);
     for(Features::iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
     {
       if((*it)->point != NULL)
-        pts_set.insert((*it)->point);
+        structure_pts_.push_back((*it)->point);
     }
   }
-  std::deque<Point*> pts(pts_set.begin(), pts_set.end());
-#if 1
-  max_n_pts = std::min(max_n_pts, pts.size());
-  nth_element(pts.begin(), pts.begin() + max_n_pts, pts.end(), ptLastOptimComparator);
-  for(std::deque<Point*>::iterator it=pts.begin(); it!=pts.begin()+max_n_pts; ++it)
-#else
-  for(auto it=pts.begin(); it!=pts.end(); ++it)
-#endif  
+
+  // a point may be observed by several cameras of the bundle
+  std::sort(structure_pts_.begin(), structure_pts_.end());
+  structure_pts_.erase(std::unique(structure_pts_.begin(), structure_pts_.end()), structure_pts_.end());
+  optimizeStructurePoints(frames->getBundleId(), max_n_pts, max_iter);
+}
+
+void FrameHandlerBase::optimizeStructurePoints(
+    const int stamp,
+    size_t max_n_pts,
+    const int max_iter)
+{
+  const size_t n_workers = std::max<size_t>(Config::structureOptimNumThreads(), 1);
+  if(n_workers > 1 && (!structure_pool_ || structure_pool_->size() != n_workers))
+    structure_pool_.reset(new WorkerPool(n_workers));
+  WorkerPool* pool = (n_workers > 1) ? structure_pool_.get() : NULL;
+  std::vector<Point*>& pts = structure_pts_;
+
+  const double budget_us = Config::structureOptimBudget();
+  if(budget_us <= 0.0)
   {
-    (*it)->optimize(max_iter);
-    (*it)->last_structure_optim_ = frames->getBundleId();
+    max_n_pts = std::min(max_n_pts, pts.size());
+    nth_element(pts.begin(), pts.begin() + max_n_pts, pts.end(), ptLastOptimComparator);
+    structure_optimizer::optimizePoints(pts.data(), max_n_pts, max_iter, structure_ws_, pool);
+    for(size_t i=0; i<max_n_pts; ++i)
+      pts[i]->last_structure_optim_ = stamp;
+    return;
+  }
+
+  // Optimize the most stale points first, one batch at a time. The next batch
+  // is only started if it is expected to finish within the budget.
+  std::sort(pts.begin(), pts.end(), ptLastOptimComparator);
+  const auto t_start = std::chrono::steady_clock::now();
+  const size_t batch_size = 32*n_workers;
+  size_t n_done = 0;
+  while(n_done < pts.size())
+  {
+    const size_t n = std::min(batch_size, pts.size()-n_done);
+    structure_optimizer::optimizePoints(&pts[n_done], n, max_iter, structure_ws_, pool);
+    for(size_t i=n_done; i<n_done+n; ++i)
+      pts[i]->last_structure_optim_ = stamp;
+    n_done += n;
+
+    const double elapsed_us = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now()-t_start).count();
+    if(elapsed_us + elapsed_us/n_done*std::min(batch_size, pts.size()-n_done) > budget_us)
+      break;
   }
+  SVO_DEBUG_STREAM("Structure optimization:\t "<<n_done<<" of "<<pts.size()<<" points in budget");
 }
 
 } // namespace svo
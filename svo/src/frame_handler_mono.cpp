@@ -14,6 +14,7 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <fstream>
 #include <svo/config.h>
 #include <svo/frame_handler_mono.h>
 #include <svo/map.h>
@@ -39,6 +40,16 @@ FrameHandlerMono::FrameHandlerMono(std::shared_ptr<vk::AbstractCamera> cam, std:
     initialize(detector);
 }
 
+FrameHandlerMono::~FrameHandlerMono()
+{
+    stopIngestion();
+#ifdef SVO_TRACE
+    std::ofstream ofs(Config::traceDir() + "/" + Config::traceName() + "_seed_lifetimes.csv");
+    if(ofs.is_open())
+        depth_filter_->getSeedHistogram().write(ofs);
+#endif
+}
+
 void FrameHandlerMono::initialize(std::shared_ptr<vilib::DetectorBaseGPU> detector)
 {
     //auto feature_detector = std::make_unique<vilib::DetectorBaseGPU>
@@ -48,7 +59,15 @@ void FrameHandlerMono::initialize(std::shared_ptr<vilib::DetectorBaseGPU> detect
                 &MapPointCandidates::newCandidatePoint, &map_.point_candidates_,
                 std::placeholders::_1, std::placeholders::_2);
     depth_filter_ = std::make_unique<DepthFilter>(detector, depth_filter_cb);
-    depth_filter_->startThread();
+    depth_filter_->setReclaimer(&map_.reclaimer_);
+    depth_filter_->setDeterministic(Config::depthFilterDeterministic());
+    depth_filter_->startThread(); // not started in deterministic mode
+    local_ba_.options_.n_threads = Config::lobaNumThreads();
+    mapping_thread_.options_.n_threads = Config::lobaNumThreads();
+    window_ba_.options_.n_kfs = Config::lobaWindowNKfs();
+    window_ba_.options_.n_threads = Config::lobaNumThreads();
+    if(Config::lobaAsync() && Config::lobaWindowNKfs() == 0)
+        mapping_thread_.startThread();
 }
 
 
@@ -64,6 +83,42 @@ void FrameHandlerMono::addImage(const cv::Mat& img, const double timestamp)
 
 
 void FrameHandlerMono::addImage(std::unique_ptr<Frame> frame, double timestamp)
+{
+    addFrame(FramePtr(frame.release()), timestamp);
+}
+
+void FrameHandlerMono::startIngestion(const FrameIngestion::output_t& output)
+{
+    stopIngestion();
+    ingestion_.reset(new FrameIngestion(
+        [this](size_t cam_index, int frame_id, const cv::Mat& img, double timestamp) {
+            return FramePtr(new Frame(frame_id, cam_.get(), img.clone(), timestamp));
+        },
+        [this](const std::vector<FramePtr>& frames, double timestamp) {
+            addFrame(frames[0], timestamp);
+        },
+        output));
+    ingestion_->options_.queue_size = Config::ingestionQueueSize();
+    ingestion_->options_.drop_policy =
+        Config::ingestionLatestWins() ? FrameIngestion::DROP_OLDEST : FrameIngestion::BLOCK;
+    ingestion_->startThreads();
+}
+
+void FrameHandlerMono::stopIngestion()
+{
+    if(ingestion_)
+        ingestion_->stopThreads();
+    ingestion_.reset();
+}
+
+bool FrameHandlerMono::addImageAsync(const cv::Mat& img, const double timestamp)
+{
+    if(!ingestion_)
+        return false;
+    return ingestion_->addImages(std::vector<cv::Mat>(1, img), timestamp);
+}
+
+void FrameHandlerMono::addFrame(const FramePtr& frame, double timestamp)
 {
     if(!startFrameProcessingCommon(timestamp))
         return;
@@ -72,7 +127,7 @@ void FrameHandlerMono::addImage(std::unique_ptr<Frame> frame, double timestamp)
     core_kfs_.clear();
     overlap_kfs_.clear();
 
-    new_frame_.reset(frame.release());
+    new_frame_ = frame;
 
     // process frame
     UpdateResult res = RESULT_FAILURE;
@@ -121,10 +176,10 @@ FrameHandlerBase::UpdateResult FrameHandlerMono::processSecondFrame()
     new_frame_->setKeyframe();
     double depth_mean, depth_min;
     frame_utils::getSceneDepth(*new_frame_, depth_mean, depth_min);
-    depth_filter_->addKeyframe(new_frame_, depth_mean, 0.5 * depth_min);
 
-    // add frame to map
+    // add frame to map before the depth-filter hands over its candidates
     map_.addKeyframe(new_frame_);
+    depth_filter_->addKeyframe(new_frame_, depth_mean, 0.5 * depth_min);
     stage_ = STAGE_DEFAULT_FRAME;
     klt_homography_init_.reset();
     SVO_INFO_STREAM("Init: Selected second frame, triangulated initial map.");
@@ -133,6 +188,17 @@ FrameHandlerBase::UpdateResult FrameHandlerMono::processSecondFrame()
 
 FrameHandlerBase::UpdateResult FrameHandlerMono::processFrame()
 {
+#ifndef USE_BUNDLE_ADJUSTMENT
+    // write back the local bundle adjustments that finished in the mapping thread
+    size_t loba_n_erredges_fin;
+    double loba_err_init, loba_err_fin;
+    if(mapping_thread_.applyResults(&map_, loba_n_erredges_fin, loba_err_init, loba_err_fin) > 0)
+    {
+        SVO_LOG3(loba_n_erredges_fin, loba_err_init, loba_err_fin);
+        SVO_DEBUG_STREAM("Local BA:\t RemovedEdges "<<loba_n_erredges_fin<<" \t Error {"<<loba_err_init<<", "<<loba_err_fin<<"}");
+    }
+#endif
+
     // Set initial pose TODO use prior
     new_frame_->T_f_w_ = last_frame_->T_f_w_;
 
@@ -195,6 +261,19 @@ FrameHandlerBase::UpdateResult FrameHandlerMono::processFrame()
         new_frame_->T_f_w_ = last_frame_->T_f_w_; // reset to avoid crazy pose jumps
         return RESULT_FAILURE;
     }
+    const DepthFilter::UpdateStats df_stats = depth_filter_->getUpdateStats(); // last update in the filter thread
+    const size_t df_n_updated = df_stats.n_updated;
+    const size_t df_n_skipped = df_stats.n_skipped;
+    const DepthFilter::QueueStats df_queue = depth_filter_->getQueueStats();
+    const size_t df_queue_depth = df_queue.depth;
+    const size_t df_n_dropped = df_queue.n_dropped;
+    SVO_LOG4(df_n_updated, df_n_skipped, df_queue_depth, df_n_dropped);
+    const DepthFilter::SeedHistogram df_hist = depth_filter_->getSeedHistogram();
+    const size_t df_n_seeds = depth_filter_->nSeeds();
+    const size_t df_n_converged = df_hist.total(DepthFilter::SeedHistogram::CONVERGED);
+    const size_t df_n_evicted = df_hist.total(DepthFilter::SeedHistogram::EVICTED);
+    const size_t df_n_aged_out = df_hist.total(DepthFilter::SeedHistogram::AGED_OUT);
+    SVO_LOG4(df_n_seeds, df_n_converged, df_n_evicted, df_n_aged_out);
     double depth_mean, depth_min;
     frame_utils::getSceneDepth(*new_frame_, depth_mean, depth_min);
     if(!needNewKf(depth_mean) || tracking_quality_ == TRACKING_BAD)
@@ -227,22 +306,62 @@ FrameHandlerBase::UpdateResult FrameHandlerMono::processFrame()
         SVO_DEBUG_STREAM("Local BA:\t RemovedEdges {"<<loba_n_erredges_init<<", "<<loba_n_erredges_fin<<"} \t "
                                                                                                         "Error {"<<loba_err_init<<", "<<loba_err_fin<<"}");
     }
+#else
+    if(Config::lobaNumIter() > 0 && Config::lobaWindowNKfs() > 0)
+    {
+        SVO_START_TIMER("local_ba");
+        SlidingWindowBA::Stats window_stats;
+        window_ba_.addKeyframe(new_frame_, &map_, window_stats);
+        SVO_STOP_TIMER("local_ba");
+        const size_t loba_n_erredges_fin = window_stats.n_incorrect_edges;
+        const double loba_err_init = window_stats.init_error, loba_err_fin = window_stats.final_error;
+        const size_t loba_window_n_kfs = window_stats.n_kfs;
+        const double loba_window_solve_ms = window_stats.solve_ms, loba_window_marg_ms = window_stats.marginalize_ms;
+        SVO_LOG3(loba_n_erredges_fin, loba_err_init, loba_err_fin);
+        SVO_LOG3(loba_window_n_kfs, loba_window_solve_ms, loba_window_marg_ms);
+        SVO_DEBUG_STREAM("Local BA:\t Window "<<loba_window_n_kfs<<" \t RemovedEdges "<<loba_n_erredges_fin<<" \t "
+                         "Error {"<<loba_err_init<<", "<<loba_err_fin<<"}");
+    }
+    else if(Config::lobaNumIter() > 0 && mapping_thread_.isRunning())
+    {
+        // only the snapshot is taken here, the result is applied at a later frame
+        SVO_START_TIMER("local_ba");
+        setCoreKfs(Config::coreNKfs());
+        mapping_thread_.addKeyframe(new_frame_.get(), &core_kfs_, &map_);
+        SVO_STOP_TIMER("local_ba");
+    }
+    else if(Config::lobaNumIter() > 0)
+    {
+        SVO_START_TIMER("local_ba");
+        setCoreKfs(Config::coreNKfs());
+        size_t loba_n_erredges_init, loba_n_erredges_fin;
+        double loba_err_init, loba_err_fin;
+        local_ba_.localBA(new_frame_.get(), &core_kfs_, &map_,
+                          loba_n_erredges_init, loba_n_erredges_fin,
+                          loba_err_init, loba_err_fin);
+        SVO_STOP_TIMER("local_ba");
+        SVO_LOG4(loba_n_erredges_init, loba_n_erredges_fin, loba_err_init, loba_err_fin);
+        SVO_DEBUG_STREAM("Local BA:\t RemovedEdges {"<<loba_n_erredges_init<<", "<<loba_n_erredges_fin<<"} \t "
+                                                                                                        "Error {"<<loba_err_init<<", "<<loba_err_fin<<"}");
+    }
 #endif
 
-    // init new depth-filters
-    depth_filter_->addKeyframe(new_frame_, depth_mean, 0.5*depth_min);
-
     // if limited number of keyframes, remove the one furthest apart
     if(Config::maxNKfs() > 2 && map_.size() >= Config::maxNKfs())
     {
         FramePtr furthest_frame = map_.getFurthestKeyframe(new_frame_->pos());
-        depth_filter_->removeKeyframe(furthest_frame); // TODO this interrupts the mapper thread, maybe we can solve this better
+        // queued, does not wait for the filter thread. Candidates which still
+        // converge in this keyframe are rejected by the map.
+        depth_filter_->removeKeyframe(furthest_frame);
         map_.safeDeleteFrame(furthest_frame);
     }
 
-    // add keyframe to map
+    // add keyframe to map, the candidates of its seeds are accepted from now on
     map_.addKeyframe(new_frame_);
 
+    // init new depth-filters
+    depth_filter_->addKeyframe(new_frame_, depth_mean, 0.5*depth_min);
+
     return RESULT_IS_KEYFRAME;
 }
 
@@ -283,6 +402,8 @@ bool FrameHandlerMono::relocalizeFrameAtPose(
         const cv::Mat& img,
         const double timestamp)
 {
+    // called outside of the frame processing, keep the map points alive
+    EpochReclaimer::Guard epoch_guard(map_.reclaimer_);
     FramePtr ref_keyframe;
     if(!map_.getKeyframeById(keyframe_id, ref_keyframe))
         return false;
@@ -297,16 +418,21 @@ bool FrameHandlerMono::relocalizeFrameAtPose(
 
 void FrameHandlerMono::resetAll()
 {
+    // may be called between two frames, when the tracking thread is not pinned
+    EpochReclaimer::Guard epoch_guard(map_.reclaimer_);
     resetCommon();
     last_frame_.reset();
     new_frame_.reset();
     core_kfs_.clear();
     overlap_kfs_.clear();
     depth_filter_->reset();
+    mapping_thread_.reset();
+    window_ba_.reset();
 }
 
 void FrameHandlerMono::setFirstFrame(const FramePtr& first_frame)
 {
+    EpochReclaimer::Guard epoch_guard(map_.reclaimer_);
     resetAll();
     last_frame_ = first_frame;
     last_frame_->setKeyframe();
@@ -24,6 +24,7 @@
 #include <svo/sparse_img_align.h>
 #include <vikit/performance_monitor.h>
 #include <svo/depth_filter.h>
+#include <svo/worker_pool.h>
 #ifdef USE_BUNDLE_ADJUSTMENT
 #include <svo/bundle_adjustment.h>
 #endif
@@ -34,52 +35,129 @@ namespace svo {
         for(int i=0;i<new_frames_->size();i++) printf("%f ", calcReprojectError(new_frames_->at(i))); \
         printf("\n");}*/
 
-FrameHandlerStereo::FrameHandlerStereo(std::shared_ptr<vk::AbstractCamera> cam) :
+FrameHandlerStereo::FrameHandlerStereo(std::shared_ptr<vk::AbstractCamera> cam, std::shared_ptr<vilib::DetectorBaseGPU> detector) :
   FrameHandlerBase(),
   cam_(cam),
-  reprojector_(cam_.get(), map_)
+  reprojector_(cam_.get(), map_),
+  reprojector_right_(cam_.get(), map_),
+  initializer(detector)
 {
-  initialize();
+  initialize(detector);
   setRelocalize(false);
 }
 
-void FrameHandlerStereo::initialize()
+void FrameHandlerStereo::initialize(std::shared_ptr<vilib::DetectorBaseGPU> detector)
 {
-    feature_detection::DetectorPtr feature_detector(
-                new feature_detection::FastDetector(
-                    cam_->width(), cam_->height(), Config::gridSize(), Config::nPyrLevels()));
-    DepthFilter::callback_t depth_filter_cb = boost::bind(
-                &MapPointCandidates::newCandidatePoint, &map_.point_candidates_, _1, _2);
-    depth_filter_ = std::make_unique<DepthFilter>(feature_detector, depth_filter_cb);
-    depth_filter_->startThread();
+    history_frames_.options_.max_frames = Config::replayMaxFrames();
+    history_frames_.options_.max_bytes = Config::replayMaxMBytes()*(1<<20);
+    history_frames_.options_.n_levels = Config::nPyrLevels();
+    DepthFilter::callback_t depth_filter_cb = std::bind(
+                &MapPointCandidates::newCandidatePoint, &map_.point_candidates_,
+                std::placeholders::_1, std::placeholders::_2);
+    depth_filter_ = std::make_unique<DepthFilter>(detector, depth_filter_cb);
+    depth_filter_->setReclaimer(&map_.reclaimer_);
+    depth_filter_->setDeterministic(Config::depthFilterDeterministic());
+    depth_filter_->startThread(); // not started in deterministic mode
 }
 
 
-void FrameHandlerStereo::addImage(const cv::Mat& img_left, const cv::Mat& img_right, const double timestamp)
+FrameHandlerStereo::~FrameHandlerStereo()
 {
-  if(!startFrameProcessingCommon(timestamp))
-    return;
-
-  // some cleanup from last iteration, can't do before because of visualization
-  core_kfs_.clear();
-  overlap_kfs_.clear();
+  stopIngestion();
+}
 
+FramePtr FrameHandlerStereo::createFrame(const size_t cam_index, const int frame_id, const cv::Mat& img, const double timestamp)
+{
   Matrix3d R_cam_body;
   R_cam_body<<0,1,0,0,0,1,1,0,0;
   Vector3d t_cam_body;
   t_cam_body<<0,0,0;
   Vector3d t_cam_body_right;
   t_cam_body_right<<-0.11944,0,0;
-#if 1 // stereo svo
+  FramePtr frame(new Frame(frame_id, cam_.get(), img.clone(), timestamp));
+  frame->set_T_cam_body(SE3(R_cam_body, (cam_index == 0) ? t_cam_body : t_cam_body_right));
+  return frame;
+}
+
+WorkerPool* FrameHandlerStereo::cameraPool()
+{
+  if(!Config::stereoParallelCameras())
+  {
+    camera_pool_.reset();
+    return NULL;
+  }
+  if(!camera_pool_)
+    camera_pool_.reset(new WorkerPool(2));
+  return camera_pool_.get();
+}
+
+void FrameHandlerStereo::addImage(const cv::Mat& img_left, const cv::Mat& img_right, const double timestamp)
+{
   // create new frame
   SVO_START_TIMER("pyramid_creation");
-  new_frames_.reset(new FrameBundle(std::vector<FramePtr>({
-                      FramePtr(new Frame(cam_, img_left.clone(), timestamp)),
-                      FramePtr(new Frame(cam_, img_right.clone(), timestamp))
-                    })));
-  new_frames_->at(0)->set_T_cam_body(SE3(R_cam_body, t_cam_body));
-  new_frames_->at(1)->set_T_cam_body(SE3(R_cam_body, t_cam_body_right));
+  const cv::Mat* imgs[2] = { &img_left, &img_right };
+  FramePtr frames[2];
+  const int first_id = Frame::frame_counter_.fetch_add(2);
+  WorkerPool* pool = cameraPool();
+  if(pool)
+  {
+    pool->parallelFor(2, 1, [&](size_t, size_t begin, size_t end) {
+      for(size_t i=begin; i<end; ++i)
+        frames[i] = createFrame(i, first_id+i, *imgs[i], timestamp);
+    });
+  }
+  else
+  {
+    for(size_t i=0; i<2; ++i)
+      frames[i] = createFrame(i, first_id+i, *imgs[i], timestamp);
+  }
   SVO_STOP_TIMER("pyramid_creation");
+  addFrames(frames[0], frames[1], timestamp);
+}
+
+void FrameHandlerStereo::startIngestion(const FrameIngestion::output_t& output)
+{
+  stopIngestion();
+  ingestion_.reset(new FrameIngestion(
+      [this](size_t cam_index, int frame_id, const cv::Mat& img, double timestamp) {
+        return createFrame(cam_index, frame_id, img, timestamp);
+      },
+      [this](const std::vector<FramePtr>& frames, double timestamp) {
+        addFrames(frames[0], frames[1], timestamp);
+      },
+      output));
+  ingestion_->options_.queue_size = Config::ingestionQueueSize();
+  ingestion_->options_.drop_policy =
+      Config::ingestionLatestWins() ? FrameIngestion::DROP_OLDEST : FrameIngestion::BLOCK;
+  ingestion_->options_.n_threads = Config::stereoParallelCameras() ? 2 : 1;
+  ingestion_->startThreads();
+}
+
+void FrameHandlerStereo::stopIngestion()
+{
+  if(ingestion_)
+    ingestion_->stopThreads();
+  ingestion_.reset();
+}
+
+bool FrameHandlerStereo::addImagesAsync(const cv::Mat& img_left, const cv::Mat& img_right, const double timestamp)
+{
+  if(!ingestion_)
+    return false;
+  return ingestion_->addImages(std::vector<cv::Mat>({img_left, img_right}), timestamp);
+}
+
+void FrameHandlerStereo::addFrames(const FramePtr& frame_left, const FramePtr& frame_right, const double timestamp)
+{
+  if(!startFrameProcessingCommon(timestamp))
+    return;
+
+  // some cleanup from last iteration, can't do before because of visualization
+  core_kfs_.clear();
+  overlap_kfs_.clear();
+
+#if 1 // stereo svo
+  new_frames_.reset(new FrameBundle(std::vector<FramePtr>({frame_left, frame_right})));
 
   // process frame
   UpdateResult res = RESULT_FAILURE;
@@ -95,28 +173,22 @@ void FrameHandlerStereo::addImage(const cv::Mat& img_left, const cv::Mat& img_ri
   UpdateResult res = RESULT_FAILURE;
   if(stage_ == STAGE_FIRST_FRAME)
   {
-    new_frames_.reset(new FrameBundle(std::vector<FramePtr>({
-                      FramePtr(new Frame(cam_, img_left.clone(), timestamp)),
-                      FramePtr(new Frame(cam_, img_right.clone(), timestamp))
-                    })));
-    new_frames_->at(0)->set_T_cam_body(SE3(R_cam_body, t_cam_body));
-    new_frames_->at(1)->set_T_cam_body(SE3(R_cam_body, t_cam_body_right));
+    new_frames_.reset(new FrameBundle(std::vector<FramePtr>({frame_left, frame_right})));
     res = processFirstFrame();
     last_frames_.reset(new FrameBundle(std::vector<FramePtr>(1,new_frames_->at(0))));
     new_frames_.reset();
   }
   else if(stage_ == STAGE_DEFAULT_FRAME)
   {
-    new_frames_.reset(new FrameBundle(std::vector<FramePtr>(1,FramePtr(new Frame(cam_, img_left.clone(), timestamp)))));
-    new_frames_->at(0)->set_T_cam_body(SE3(R_cam_body, t_cam_body));
+    new_frames_.reset(new FrameBundle(std::vector<FramePtr>(1,frame_left)));
     res = processFrame();
     last_frames_ = new_frames_;
     new_frames_.reset();
   }
 #endif
-  history_frames_.push_back(last_frames_);
-  if(history_frames_.size()>10)
-    history_frames_.pop_front();
+  // keep only the pose and pyramid of the frame to replay it in the depth filter
+  for(size_t i=0; i<last_frames_->size(); i++)
+    history_frames_.push(*last_frames_->at(i));
   // finish processing
   finishFrameProcessingCommon(last_frames_->getBundleId(), res, last_frames_->numFeatures());
 }
@@ -126,7 +198,7 @@ FrameHandlerStereo::UpdateResult FrameHandlerStereo::processFirstFrame()
   // new_frames_->set_T_W_B(new_frames_->at(0)->T_cam_imu());
   new_frames_->set_T_W_B(last_imu_pose_);
 
-  initialization::InitResult res = initializer.initFrameStereo(new_frames_->at(0),new_frames_->at(1));
+  initialization::InitResult res = initializer.initFrameStereo(new_frames_->at(0).get(), new_frames_->at(1).get());
   if(res == initialization::FAILURE)
     return RESULT_FAILURE;
   else if(res == initialization::NO_KEYFRAME)
@@ -134,16 +206,13 @@ FrameHandlerStereo::UpdateResult FrameHandlerStereo::processFirstFrame()
 
   new_frames_->setKeyframe();
   for(size_t i=0; i<new_frames_->size(); i++)
-  {
-    FramePtr f = new_frames_->at(i);
-    if(i==0)
-    {
-      double depth_mean, depth_min;
-      frame_utils::getSceneDepth(*f, depth_mean, depth_min);
-      depth_filter_->addKeyframe(f, depth_mean, 0.5*depth_min);
-    }
-    map_.addKeyframe(f);
-  }
+    map_.addKeyframe(new_frames_->at(i));
+
+  // the keyframes are in the map before the depth-filter hands over candidates
+  double depth_mean, depth_min;
+  frame_utils::getSceneDepth(*new_frames_->at(0), depth_mean, depth_min);
+  depth_filter_->addKeyframe(new_frames_->at(0), depth_mean, 0.5*depth_min,
+                             std::vector<ReplayFramePtr>(), new_frames_->at(1));
   last_keyframes_ = new_frames_;
   stage_ = STAGE_DEFAULT_FRAME;
   return RESULT_IS_KEYFRAME;
@@ -185,37 +254,44 @@ FrameHandlerBase::UpdateResult FrameHandlerStereo::processFrame()
   SVO_START_TIMER("reproject");
   size_t repr_n_new_references = 0;
   size_t repr_n_mps = 0;
-  for(size_t i=0; i<new_frames_->size(); i++)
+  WorkerPool* pool = cameraPool();
+  if(pool && new_frames_->size() == 2)
   {
-    vector< pair<FramePtr,size_t> > overlap_kfs;
-    reprojector_.reprojectMap(new_frames_->at(i), overlap_kfs);
-    if(i==0)
-      overlap_kfs_ = overlap_kfs;
-    else
-      overlap_kfs_.insert(overlap_kfs_.end(),overlap_kfs.begin(),overlap_kfs.end());
-    repr_n_new_references += reprojector_.n_matches_;
-    repr_n_mps += reprojector_.n_trials_;
+    // The cameras only read the map and add features to their own frame. The
+    // match statistics of the points are applied afterwards in camera order.
+    Reprojector* reprojectors[2] = { &reprojector_, &reprojector_right_ };
+    vector< pair<FramePtr,size_t> > overlap_kfs[2];
+    reprojector_.prepare();
+    pool->parallelFor(2, 1, [&](size_t, size_t begin, size_t end) {
+      for(size_t i=begin; i<end; ++i)
+        reprojectors[i]->project(new_frames_->at(i), overlap_kfs[i]);
+    });
+    for(size_t i=0; i<2; i++)
+    {
+      reprojectors[i]->commit();
+      overlap_kfs_.insert(overlap_kfs_.end(),overlap_kfs[i].begin(),overlap_kfs[i].end());
+      repr_n_new_references += reprojectors[i]->n_matches_;
+      repr_n_mps += reprojectors[i]->n_trials_;
+    }
   }
-  SVO_STOP_TIMER("reproject");
-  SVO_LOG2(repr_n_mps, repr_n_new_references);
-  if(1) //the later frame may delete some candidates which the prev frame used
+  else
   {
-    std::set<Point*> trash_pts;
-    std::for_each(map_.point_candidates_.trash_points_.begin(), map_.point_candidates_.trash_points_.end(), [&](Point* pt){
-      trash_pts.insert(pt);
-    });
-    std::for_each(map_.trash_points_.begin(), map_.trash_points_.end(), [&](Point* pt){
-      trash_pts.insert(pt);
-    });
-    std::for_each(new_frames_->begin(), new_frames_->end(), [trash_pts](FramePtr f){
-      std::for_each(f->fts_.begin(), f->fts_.end(), [trash_pts](Feature* ftr){
-        if(trash_pts.count(ftr->point))
-        {
-          ftr->point = NULL;
-        }
-      });
-    });
+    for(size_t i=0; i<new_frames_->size(); i++)
+    {
+      vector< pair<FramePtr,size_t> > overlap_kfs;
+      reprojector_.reprojectMap(new_frames_->at(i), overlap_kfs);
+      if(i==0)
+        overlap_kfs_ = overlap_kfs;
+      else
+        overlap_kfs_.insert(overlap_kfs_.end(),overlap_kfs.begin(),overlap_kfs.end());
+      repr_n_new_references += reprojector_.n_matches_;
+      repr_n_mps += reprojector_.n_trials_;
+    }
   }
+  SVO_STOP_TIMER("reproject");
+  SVO_LOG2(repr_n_mps, repr_n_new_references);
+  // candidates that a later frame deleted are not referenced anymore: the
+  // features hold handles which resolve to NULL once the point is gone.
   SVO_DEBUG_STREAM("Reprojection:\t nPoints = "<<repr_n_mps<<"\t \t nMatches = "<<repr_n_new_references);
   if(repr_n_new_references < Config::qualityMinFts())
   {
@@ -262,6 +338,8 @@ FrameHandlerBase::UpdateResult FrameHandlerStereo::processFrame()
   SVO_DEBUG_STREAM("Frame Depth:\t depth_mean = "<<depth_mean<<"\t depth_min = "<<depth_min);
   if(!needNewKf(depth_mean) || tracking_quality_ == TRACKING_BAD)
   {
+    // not per camera in parallel: both cameras update the same seeds, the
+    // updates of one frame are parallel over the seeds already
     for(size_t i=0; i<new_frames_->size(); i++)
       depth_filter_->addFrame(new_frames_->at(i));
     return RESULT_NO_KEYFRAME;
@@ -277,35 +355,37 @@ FrameHandlerBase::UpdateResult FrameHandlerStereo::processFrame()
     FramePtr frame = new_frames_->at(i);
     for(Features::iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
       if((*it)->point != NULL)
-        (*it)->point->addFrameRef(*it);
+        (*it)->point->addFrameRef(it->get());
     map_.point_candidates_.addCandidatePointToFrame(frame);
   }
-  // init new depth-filters
-  {
-    std::vector<FramePtr> update_frames;
-    for(auto & fb: history_frames_)
-    {
-      update_frames.insert(update_frames.begin(),fb->frames_.begin(),fb->frames_.end());
-    }
-    for(size_t i=1; i<new_frames_->size(); i++)
-    {
-      update_frames.push_back(new_frames_->at(i));
-    }
-    depth_filter_->addKeyframe(new_frames_->at(0), depth_mean, 0.5*depth_min, update_frames);
-  }
-
   // if limited number of keyframes, remove the one furthest apart
   while(Config::maxNKfs() > 2 && map_.size() >= Config::maxNKfs())
   {
     FramePtr furthest_frame = map_.getFurthestKeyframe(new_frames_->imuPos());
-    depth_filter_->removeKeyframe(furthest_frame); // TODO this interrupts the mapper thread, maybe we can solve this better
+    // queued, does not wait for the filter thread. Candidates which still
+    // converge in this keyframe are rejected by the map.
+    depth_filter_->removeKeyframe(furthest_frame);
     map_.safeDeleteFrame(furthest_frame);
   }
 
-  // add keyframe to map
+  // add keyframe to map, the candidates of its seeds are accepted from now on
   for(size_t i=0; i<new_frames_->size(); i++)
     map_.addKeyframe(new_frames_->at(i));
 
+  // init new depth-filters
+  {
+    // newest frames first, the right image of the keyframe last
+    const std::deque<ReplayFramePtr>& records = history_frames_.records();
+    std::vector<ReplayFramePtr> update_frames(records.rbegin(), records.rend());
+    for(size_t i=1; i<new_frames_->size(); i++)
+    {
+      update_frames.push_back(std::make_shared<ReplayFrame>(new_frames_->at(i)));
+    }
+    // the right image sees the new seeds at the same time, match them there first
+    depth_filter_->addKeyframe(new_frames_->at(0), depth_mean, 0.5*depth_min, update_frames,
+                               new_frames_->size() > 1 ? new_frames_->at(1) : FramePtr());
+  }
+
   last_keyframes_ = new_frames_;
   return RESULT_IS_KEYFRAME;
 }
@@ -328,6 +408,8 @@ bool FrameHandlerStereo::relocalizeFrameAtPose(
 
 void FrameHandlerStereo::resetAll()
 {
+  // may be called between two frames, when the tracking thread is not pinned
+  EpochReclaimer::Guard epoch_guard(map_.reclaimer_);
   if(last_frames_.get())
     last_imu_pose_ = last_frames_->get_T_W_B();
 
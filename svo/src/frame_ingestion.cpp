@@ -0,0 +1,208 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <svo/frame_ingestion.h>
+#include <svo/frame.h>
+#include <svo/worker_pool.h>
+
+namespace svo {
+
+namespace {
+
+inline double milliseconds(const std::chrono::steady_clock::duration& d)
+{
+  return std::chrono::duration<double, std::milli>(d).count();
+}
+
+} // namespace
+
+FrameIngestion::FrameIngestion(const build_t& build, const track_t& track, const output_t& output) :
+  build_(build),
+  track_(track),
+  output_(output),
+  halt_(false),
+  building_(false),
+  tracking_(false)
+{}
+
+FrameIngestion::~FrameIngestion()
+{
+  stopThreads();
+}
+
+void FrameIngestion::startThreads()
+{
+  if(ingestion_thread_)
+    return;
+  halt_ = false;
+  if(options_.n_threads > 1 && (!build_pool_ || build_pool_->size() != options_.n_threads))
+    build_pool_.reset(new WorkerPool(options_.n_threads));
+  else if(options_.n_threads <= 1)
+    build_pool_.reset();
+  ingestion_thread_.reset(new std::thread(&FrameIngestion::ingestionLoop, this));
+  tracking_thread_.reset(new std::thread(&FrameIngestion::trackingLoop, this));
+}
+
+void FrameIngestion::stopThreads()
+{
+  if(!ingestion_thread_)
+    return;
+  {
+    lock_t lock(mut_);
+    halt_ = true;
+  }
+  cond_.notify_all();
+  ingestion_thread_->join();
+  tracking_thread_->join();
+  ingestion_thread_.reset();
+  tracking_thread_.reset();
+  queue_.clear();
+  ready_.reset();
+}
+
+bool FrameIngestion::addImages(const std::vector<cv::Mat>& imgs, double timestamp)
+{
+  Item item;
+  item.imgs = imgs;
+  item.timestamp = timestamp;
+  item.t_added = clock_t::now();
+  {
+    lock_t lock(mut_);
+    if(!ingestion_thread_ || halt_)
+      return false;
+    ++stats_.n_received;
+    const size_t queue_size = std::max<size_t>(options_.queue_size, 1);
+    if(options_.drop_policy == BLOCK)
+    {
+      cond_.wait(lock, [&]{ return queue_.size() < queue_size || halt_; });
+      if(halt_)
+        return false;
+    }
+    while(queue_.size() >= queue_size)
+    {
+      queue_.pop_front();
+      ++stats_.n_dropped;
+    }
+    queue_.push_back(std::move(item));
+  }
+  cond_.notify_all();
+  return true;
+}
+
+void FrameIngestion::flush()
+{
+  lock_t lock(mut_);
+  cond_.wait(lock, [&]{
+    return (queue_.empty() && !building_ && !ready_ && !tracking_) || !ingestion_thread_ || halt_; });
+}
+
+FrameIngestion::Stats FrameIngestion::stats() const
+{
+  lock_t lock(mut_);
+  return stats_;
+}
+
+void FrameIngestion::ingestionLoop()
+{
+  while(true)
+  {
+    std::unique_ptr<Item> item(new Item);
+    {
+      lock_t lock(mut_);
+      cond_.wait(lock, [&]{ return !queue_.empty() || halt_; });
+      if(halt_)
+        return;
+      *item = std::move(queue_.front());
+      queue_.pop_front();
+      building_ = true;
+    }
+    cond_.notify_all(); // space in the queue
+
+    item->t_started = clock_t::now();
+    item->frames.resize(item->imgs.size());
+    const int first_id = Frame::frame_counter_.fetch_add(item->imgs.size());
+    if(build_pool_ && item->imgs.size() > 1)
+    {
+      build_pool_->parallelFor(item->imgs.size(), 1, [&](size_t, size_t begin, size_t end) {
+        for(size_t i=begin; i<end; ++i)
+          item->frames[i] = build_(i, first_id+i, item->imgs[i], item->timestamp);
+      });
+    }
+    else
+    {
+      for(size_t i=0; i<item->imgs.size(); ++i)
+        item->frames[i] = build_(i, first_id+i, item->imgs[i], item->timestamp);
+    }
+    item->imgs.clear();
+    item->t_built = clock_t::now();
+
+    // hand over to the tracker once it took the previous frame
+    {
+      lock_t lock(mut_);
+      cond_.wait(lock, [&]{ return !ready_ || halt_; });
+      building_ = false;
+      if(halt_)
+        return;
+      ready_ = std::move(item);
+    }
+    cond_.notify_all();
+  }
+}
+
+void FrameIngestion::trackingLoop()
+{
+  while(true)
+  {
+    std::unique_ptr<Item> item;
+    {
+      lock_t lock(mut_);
+      cond_.wait(lock, [&]{ return ready_ || halt_; });
+      if(halt_)
+        return;
+      item = std::move(ready_);
+      tracking_ = true;
+    }
+    cond_.notify_all(); // the next frame may be handed over
+
+    const clock_t::time_point t_tracking = clock_t::now();
+    track_(item->frames, item->timestamp);
+    const clock_t::time_point t_done = clock_t::now();
+
+    FrameStats stats;
+    stats.timestamp = item->timestamp;
+    stats.queue_ms = milliseconds(item->t_started-item->t_added);
+    stats.pyramid_ms = milliseconds(item->t_built-item->t_started);
+    stats.wait_ms = milliseconds(t_tracking-item->t_built);
+    stats.tracking_ms = milliseconds(t_done-t_tracking);
+    stats.total_ms = milliseconds(t_done-item->t_added);
+    stats.latency_ms = 1e3*(std::chrono::duration<double>(
+          std::chrono::system_clock::now().time_since_epoch()).count() - item->timestamp);
+    if(output_)
+      output_(stats);
+
+    // release the frames outside of the lock
+    item.reset();
+    {
+      lock_t lock(mut_);
+      tracking_ = false;
+      ++stats_.n_tracked;
+    }
+    cond_.notify_all();
+  }
+}
+
+} // namespace svo
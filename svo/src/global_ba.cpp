@@ -0,0 +1,414 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <vikit/math_utils.h>
+#include <svo/global_ba.h>
+#include <svo/sparse_ba.h>
+#include <svo/structure_optimizer.h>
+#include <svo/worker_pool.h>
+
+namespace svo {
+
+namespace {
+
+typedef Eigen::Matrix<double,6,6> Matrix6d;
+typedef Eigen::Matrix<double,6,1> Vector6d;
+
+/// Observations sorted by a key, e.g. by keyframe or by point.
+struct ObservationIndex
+{
+  std::vector<size_t> begin;    //!< Observations of element i are obs[begin[i]...begin[i+1]).
+  std::vector<size_t> obs;
+
+  template<class Key>
+  void build(const MapSnapshot& map, const size_t n, const Key& key)
+  {
+    begin.assign(n+1, 0);
+    for(const MapSnapshot::Observation& o : map.obs_)
+      ++begin[key(o)+1];
+    for(size_t i=0; i<n; ++i)
+      begin[i+1] += begin[i];
+    obs.resize(map.obs_.size());
+    std::vector<size_t> next(begin.begin(), begin.end()-1);
+    for(size_t k=0; k<map.obs_.size(); ++k)
+      obs[next[key(map.obs_[k])]++] = k;
+  }
+};
+
+inline double weight(const MapSnapshot::Observation& o)
+{
+  return 1.0 / (1<<o.level);
+}
+
+/// Add the 6x6 block at the block row r and column c.
+inline void addBlock(
+    std::vector<Eigen::Triplet<double>>& triplets,
+    const size_t r,
+    const size_t c,
+    const Matrix6d& block)
+{
+  for(int i=0; i<6; ++i)
+    for(int j=0; j<6; ++j)
+      triplets.emplace_back(6*r+i, 6*c+j, block(i,j));
+}
+
+} // namespace
+
+size_t GlobalBA::estimateBytes(
+    const size_t n_kfs,
+    const size_t n_points,
+    const size_t n_obs,
+    const int n_threads)
+{
+  // reduced system per worker and its factorization
+  const size_t dim = 6*n_kfs;
+  const size_t dense = sizeof(double)*dim*dim*(std::max(n_threads, 1)+1);
+  // observation, pose-point block and index
+  const size_t per_obs = 48 + sizeof(double)*18 + sizeof(size_t);
+  // estimate, backup, inverse point block, right-hand side and index
+  const size_t per_point = sizeof(double)*(3+3+9+3) + sizeof(size_t) + 1;
+  return dense + n_obs*per_obs + n_points*per_point;
+}
+
+double GlobalBA::medianError(const MapSnapshot& map)
+{
+  std::vector<double> errors;
+  errors.reserve(map.obs_.size());
+  for(const MapSnapshot::Observation& o : map.obs_)
+  {
+    const Vector3d p_in_f(map.kfs_[o.kf].T_f_w*map.points_[o.point].pos);
+    if(p_in_f[2] > 0.0)
+      errors.push_back((o.uv - vk::project2d(p_in_f)).norm());
+  }
+  if(errors.empty())
+    return 0.0;
+  std::vector<double>::iterator it = errors.begin()+errors.size()/2;
+  std::nth_element(errors.begin(), it, errors.end());
+  return *it * map.error_multiplier2_;
+}
+
+void GlobalBA::optimize(MapSnapshot& map, Stats& stats)
+{
+  const auto t_start = std::chrono::steady_clock::now();
+  stats = Stats();
+  stats.n_kfs = map.kfs_.size();
+  stats.n_points = map.points_.size();
+  stats.init_error = medianError(map);
+  if(map.kfs_.size() < 3)
+  {
+    stats.final_error = stats.init_error;
+    return; // the first two keyframes are fixed
+  }
+
+  // use fewer workers if their reduced systems do not fit the budget
+  int n_threads = std::max(options_.n_threads, 1);
+  while(n_threads > 1 && estimateBytes(map.kfs_.size(), map.points_.size(), map.obs_.size(), n_threads) > options_.max_bytes)
+    --n_threads;
+  stats.n_threads = n_threads;
+  stats.estimated_bytes = estimateBytes(map.kfs_.size(), map.points_.size(), map.obs_.size(), n_threads);
+  if(stats.estimated_bytes <= options_.max_bytes)
+  {
+    bundleAdjustment(map, n_threads, stats);
+  }
+  else
+  {
+    stats.pose_graph = true;
+    stats.n_threads = std::max(options_.n_threads, 1);
+    poseGraph(map, stats);
+  }
+  stats.final_error = medianError(map);
+  stats.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t_start).count();
+}
+
+void GlobalBA::bundleAdjustment(MapSnapshot& map, const int n_threads, Stats& stats)
+{
+  SparseBA ba;
+  ba.options_.n_iter = options_.n_iter;
+  ba.options_.huber_width = options_.huber_width;
+  ba.options_.n_threads = n_threads;
+  for(size_t i=0; i<map.kfs_.size(); ++i)
+    ba.addPose(map.kfs_[i].T_f_w, i < 2);
+  for(const MapSnapshot::Landmark& pt : map.points_)
+    ba.addPoint(pt.pos);
+  for(const MapSnapshot::Observation& o : map.obs_)
+    ba.addObservation(o.kf, o.point, o.uv, weight(o));
+  SparseBA::Stats ba_stats;
+  ba.optimize(ba_stats);
+  stats.n_edges = ba_stats.n_edges;
+
+  for(size_t i=2; i<map.kfs_.size(); ++i)
+    map.kfs_[i].T_f_w = ba.pose(i);
+  for(size_t j=0; j<map.points_.size(); ++j)
+    map.points_[j].pos = ba.point(j);
+}
+
+void GlobalBA::poseGraph(MapSnapshot& map, Stats& stats)
+{
+  std::vector<Edge, Eigen::aligned_allocator<Edge>> edges;
+  selectEdges(map, edges);
+  estimateEdges(map, edges);
+  stats.n_edges = edges.size();
+
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w, T_f_w_old;
+  for(const MapSnapshot::Keyframe& kf : map.kfs_)
+    T_f_w.push_back(kf.T_f_w);
+  T_f_w_old = T_f_w;
+  optimizePoseGraph(edges, T_f_w);
+  for(size_t i=0; i<map.kfs_.size(); ++i)
+    map.kfs_[i].T_f_w = T_f_w[i];
+  updateStructure(map, T_f_w_old);
+}
+
+void GlobalBA::selectEdges(
+    const MapSnapshot& map,
+    std::vector<Edge, Eigen::aligned_allocator<Edge>>& edges)
+{
+  // number of points shared by each pair of keyframes
+  const size_t n_kfs = map.kfs_.size();
+  ObservationIndex point_obs;
+  point_obs.build(map, map.points_.size(), [](const MapSnapshot::Observation& o) { return o.point; });
+  std::unordered_map<uint64_t, uint32_t> n_shared;
+  for(size_t j=0; j<map.points_.size(); ++j)
+    for(size_t k1=point_obs.begin[j]; k1<point_obs.begin[j+1]; ++k1)
+      for(size_t k2=k1+1; k2<point_obs.begin[j+1]; ++k2)
+      {
+        const uint64_t a = map.obs_[point_obs.obs[k1]].kf;
+        const uint64_t b = map.obs_[point_obs.obs[k2]].kf;
+        if(a != b)
+          ++n_shared[std::min(a, b)*n_kfs + std::max(a, b)];
+      }
+
+  // strongest neighbours of each keyframe, and the next keyframe to keep the
+  // graph connected
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> neighbours(n_kfs);
+  std::vector<std::pair<size_t, size_t>> pairs;
+  for(const auto& s : n_shared)
+  {
+    const size_t a = s.first / n_kfs, b = s.first % n_kfs;
+    if(b == a+1 && s.second >= 5)
+      pairs.push_back(std::make_pair(a, b));
+    if(s.second < options_.min_shared_points)
+      continue;
+    neighbours[a].push_back(std::make_pair(s.second, b));
+    neighbours[b].push_back(std::make_pair(s.second, a));
+  }
+  for(size_t i=0; i<n_kfs; ++i)
+  {
+    std::vector<std::pair<uint32_t, uint32_t>>& n = neighbours[i];
+    const size_t n_best = std::min(options_.n_neighbours, n.size());
+    std::partial_sort(n.begin(), n.begin()+n_best, n.end(), std::greater<std::pair<uint32_t, uint32_t>>());
+    for(size_t k=0; k<n_best; ++k)
+      pairs.push_back(std::make_pair(std::min<size_t>(i, n[k].second), std::max<size_t>(i, n[k].second)));
+  }
+  std::sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+  edges.resize(pairs.size());
+  for(size_t e=0; e<pairs.size(); ++e)
+  {
+    edges[e].a = pairs[e].first;
+    edges[e].b = pairs[e].second;
+  }
+}
+
+void GlobalBA::estimateEdges(
+    const MapSnapshot& map,
+    std::vector<Edge, Eigen::aligned_allocator<Edge>>& edges)
+{
+  // observations of each keyframe sorted by point, to intersect two keyframes
+  ObservationIndex kf_obs;
+  kf_obs.build(map, map.kfs_.size(), [](const MapSnapshot::Observation& o) { return o.kf; });
+  for(size_t i=0; i<map.kfs_.size(); ++i)
+    std::sort(kf_obs.obs.begin()+kf_obs.begin[i], kf_obs.obs.begin()+kf_obs.begin[i+1],
+              [&](size_t k1, size_t k2) { return map.obs_[k1].point < map.obs_[k2].point; });
+
+  WorkerPool pool(std::max(options_.n_threads, 1));
+  std::vector<std::unique_ptr<SparseBA>> bas(pool.size());
+  for(std::unique_ptr<SparseBA>& ba : bas)
+  {
+    ba.reset(new SparseBA());
+    ba->options_.n_iter = options_.n_iter;
+    ba->options_.huber_width = options_.huber_width;
+  }
+  pool.parallelFor(edges.size(), 4, [&](size_t worker_id, size_t begin, size_t end) {
+    SparseBA& ba = *bas[worker_id];
+    Eigen::MatrixXd H;
+    Eigen::VectorXd g;
+    for(size_t e=begin; e<end; ++e)
+    {
+      Edge& edge = edges[e];
+      ba.clear();
+      ba.addPose(map.kfs_[edge.a].T_f_w, true);
+      ba.addPose(map.kfs_[edge.b].T_f_w, false);
+      const size_t* it_a = kf_obs.obs.data()+kf_obs.begin[edge.a];
+      const size_t* end_a = kf_obs.obs.data()+kf_obs.begin[edge.a+1];
+      const size_t* it_b = kf_obs.obs.data()+kf_obs.begin[edge.b];
+      const size_t* end_b = kf_obs.obs.data()+kf_obs.begin[edge.b+1];
+      while(it_a != end_a && it_b != end_b)
+      {
+        const MapSnapshot::Observation& o_a = map.obs_[*it_a];
+        const MapSnapshot::Observation& o_b = map.obs_[*it_b];
+        if(o_a.point < o_b.point)
+          ++it_a;
+        else if(o_b.point < o_a.point)
+          ++it_b;
+        else
+        {
+          const size_t j = ba.addPoint(map.points_[o_a.point].pos);
+          ba.addObservation(0, j, o_a.uv, weight(o_a));
+          ba.addObservation(1, j, o_b.uv, weight(o_b));
+          ++it_a;
+          ++it_b;
+        }
+      }
+      SparseBA::Stats ba_stats;
+      ba.optimize(ba_stats);
+      ba.reducedSystem(H, g);
+      edge.T_b_a = ba.pose(1)*ba.pose(0).inverse();
+      edge.H = H;
+    }
+  });
+}
+
+void GlobalBA::optimizePoseGraph(
+    const std::vector<Edge, Eigen::aligned_allocator<Edge>>& edges,
+    std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T_f_w)
+{
+  // e = log(T_b*T_a^-1*T_b_a^-1), the first keyframe is fixed
+  const size_t n_vars = T_f_w.size()-1;
+  auto cost = [&]() {
+    double chi2 = 0.0;
+    for(const Edge& edge : edges)
+    {
+      const Vector6d e = (T_f_w[edge.b]*T_f_w[edge.a].inverse()*edge.T_b_a.inverse()).log();
+      chi2 += e.dot(edge.H*e);
+    }
+    return chi2;
+  };
+
+  std::vector<Eigen::Triplet<double>> triplets;
+  Eigen::VectorXd g(6*n_vars), d(6*n_vars);
+  Eigen::SparseMatrix<double> H(6*n_vars, 6*n_vars);
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w_backup;
+  double chi2 = cost();
+  double lambda = 1e-5;
+  for(size_t iter=0; iter<options_.n_iter; ++iter)
+  {
+    // linearize
+    triplets.clear();
+    g.setZero();
+    d.setZero();
+    for(const Edge& edge : edges)
+    {
+      const SE3d T_b_a = T_f_w[edge.b]*T_f_w[edge.a].inverse();
+      const Vector6d e = (T_b_a*edge.T_b_a.inverse()).log();
+      const Matrix6d J_a = -T_b_a.Adj(); // J_b is the identity
+      const Matrix6d JH_a = J_a.transpose()*edge.H;
+      if(edge.b > 0)
+      {
+        addBlock(triplets, edge.b-1, edge.b-1, edge.H);
+        d.segment<6>(6*(edge.b-1)) += edge.H.diagonal();
+        g.segment<6>(6*(edge.b-1)) -= edge.H*e;
+      }
+      if(edge.a > 0)
+      {
+        const Matrix6d H_aa = JH_a*J_a;
+        addBlock(triplets, edge.a-1, edge.a-1, H_aa);
+        d.segment<6>(6*(edge.a-1)) += H_aa.diagonal();
+        g.segment<6>(6*(edge.a-1)) -= JH_a*e;
+      }
+      if(edge.a > 0 && edge.b > 0)
+      {
+        addBlock(triplets, edge.a-1, edge.b-1, JH_a);
+        addBlock(triplets, edge.b-1, edge.a-1, JH_a.transpose());
+      }
+    }
+
+    // damped steps until the cost decreases
+    bool success = false;
+    for(size_t trial=0; trial<5 && !success; ++trial)
+    {
+      std::vector<Eigen::Triplet<double>> damped(triplets);
+      for(size_t r=0; r<6*n_vars; ++r)
+        damped.emplace_back(r, r, lambda*d[r] + 1e-12); // keyframes without edges stay
+      H.setFromTriplets(damped.begin(), damped.end());
+      solver.compute(H);
+      if(solver.info() == Eigen::Success)
+      {
+        const Eigen::VectorXd dx = solver.solve(g);
+        T_f_w_backup = T_f_w;
+        for(size_t i=0; i<n_vars; ++i)
+          T_f_w[i+1] = SE3d::exp(dx.segment<6>(6*i))*T_f_w[i+1];
+        const double new_chi2 = cost();
+        if(dx.allFinite() && new_chi2 < chi2)
+        {
+          success = true;
+          chi2 = new_chi2;
+          lambda = std::max(lambda/10.0, 1e-12);
+          if(dx.lpNorm<Eigen::Infinity>() <= EPS)
+            return;
+          break;
+        }
+        T_f_w.swap(T_f_w_backup);
+      }
+      lambda *= 10.0;
+    }
+    if(!success)
+      break;
+  }
+}
+
+void GlobalBA::updateStructure(
+    MapSnapshot& map,
+    const std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T_f_w_old)
+{
+  ObservationIndex point_obs;
+  point_obs.build(map, map.points_.size(), [](const MapSnapshot::Observation& o) { return o.point; });
+  WorkerPool pool(std::max(options_.n_threads, 1));
+  std::vector<std::vector<structure_optimizer::Observation,
+      Eigen::aligned_allocator<structure_optimizer::Observation>>> obs(pool.size());
+  pool.parallelFor(map.points_.size(), 64, [&](size_t worker_id, size_t begin, size_t end) {
+    for(size_t j=begin; j<end; ++j)
+    {
+      if(point_obs.begin[j] == point_obs.begin[j+1])
+        continue;
+
+      // keep the point fixed in its first keyframe
+      const size_t anchor = map.obs_[point_obs.obs[point_obs.begin[j]]].kf;
+      Vector3d& pos = map.points_[j].pos;
+      pos = map.kfs_[anchor].T_f_w.inverse()*(T_f_w_old[anchor]*pos);
+
+      obs[worker_id].clear();
+      for(size_t k=point_obs.begin[j]; k<point_obs.begin[j+1]; ++k)
+      {
+        const MapSnapshot::Observation& o = map.obs_[point_obs.obs[k]];
+        const SE3d& T = map.kfs_[o.kf].T_f_w;
+        obs[worker_id].push_back(structure_optimizer::Observation{T.rotationMatrix(), T.translation(), o.uv});
+      }
+      structure_optimizer::optimizePoint(obs[worker_id].data(), obs[worker_id].size(), options_.n_structure_iter, pos);
+    }
+  });
+}
+
+} // namespace svo
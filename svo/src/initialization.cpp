@@ -19,8 +19,8 @@
 #include <svo/point.h>
 #include <svo/feature.h>
 #include <svo/initialization.h>
+#include <svo/klt.h>
 #include <vikit/math_utils.h>
-#include <vikit/homography.h>
 
 namespace svo {
 namespace initialization {
@@ -61,11 +61,24 @@ InitResult KltHomographyInit::addSecondFrame(Frame *frame_cur)
     if(disparity < Config::initMinDisparity())
         return NO_KEYFRAME;
 
-    computeHomography(
-                f_ref_, f_cur_,
-                frame_ref_->cam_->errorMultiplier2(), Config::poseOptimThresh(),
-                inliers_, xyz_in_cur_, T_cur_from_ref_);
-    SVO_INFO_STREAM("Init: Homography RANSAC "<<inliers_.size()<<" inliers.");
+    ransac_.options_.threshold = Config::poseOptimThresh();
+    ransac_.options_.n_threads = Config::initRansacNumThreads();
+    TwoViewRansac::Stats ransac_stats;
+    if(!ransac_.compute(f_ref_, f_cur_, frame_ref_->cam_->errorMultiplier2(), ransac_stats))
+    {
+        SVO_WARN_STREAM("Init WARNING: no relative pose found.");
+        return FAILURE;
+    }
+    T_cur_from_ref_ = ransac_.T_cur_ref_;
+    std::vector<int> outliers;
+    vk::computeInliers(f_cur_, f_ref_,
+                       T_cur_from_ref_.rotationMatrix(), T_cur_from_ref_.translation(),
+                       Config::poseOptimThresh(), frame_ref_->cam_->errorMultiplier2(),
+                       xyz_in_cur_, inliers_, outliers);
+    SVO_INFO_STREAM("Init: "<<(ransac_stats.model == TwoViewRansac::HOMOGRAPHY ? "Homography" : "Essential")
+                    <<" RANSAC "<<inliers_.size()<<" inliers, "
+                    <<ransac_stats.n_hypotheses[0]+ransac_stats.n_hypotheses[1]<<" hypotheses in "
+                    <<ransac_stats.time_ms<<"ms.");
 
     if(inliers_.size() < Config::initMinInliers())
     {
@@ -142,67 +155,36 @@ void KltHomographyInit::trackKlt(
         std::vector<Vector3d>& f_cur,
         std::vector<double>& disparities)
 {
-    const double klt_win_size = 30.0;
-    const int klt_max_iter = 30;
-    const double klt_eps = 0.001;
-    std::vector<uchar> status;
-    std::vector<float> error;
-    std::vector<float> min_eig_vec;
-    cv::TermCriteria termcrit(cv::TermCriteria::COUNT + cv::TermCriteria::EPS, klt_max_iter, klt_eps);
-    cv::Mat img_ref, img_cur;
-    frame_ref->pyramid_[0].copy_to(img_ref);
-    frame_cur->pyramid_[0].copy_to(img_cur);
-    cv::calcOpticalFlowPyrLK(img_ref, img_cur,
-                             px_ref, px_cur,
-                             status, error,
-                             cv::Size2i(klt_win_size, klt_win_size),
-                             4, termcrit, cv::OPTFLOW_USE_INITIAL_FLOW);
-    std::vector<cv::Point2f>::iterator px_ref_it = px_ref.begin();
-    std::vector<cv::Point2f>::iterator px_cur_it = px_cur.begin();
-    std::vector<Vector3d>::iterator f_ref_it = f_ref.begin();
+    // track on the pyramids of the frames, levels in host memory are not copied
+    ImgPyr pyr_ref, pyr_cur;
+    klt::pyramidViews(*frame_ref, pyr_ref);
+    klt::pyramidViews(*frame_cur, pyr_cur);
+    klt::Options options;
+    options.half_win_size = 15;
+    options.max_level = 4;
+    options.n_iter = 30;
+    options.eps = 0.001f;
+    std::vector<uint8_t> status;
+    klt::trackPoints(pyr_ref, pyr_cur, px_ref, px_cur, status, options);
+
+    // keep the tracked features, in one pass
     f_cur.clear(); f_cur.reserve(px_cur.size());
     disparities.clear(); disparities.reserve(px_cur.size());
-    for(size_t i=0; px_ref_it != px_ref.end(); ++i)
+    size_t n_tracked = 0;
+    for(size_t i=0; i<px_ref.size(); ++i)
     {
         if(!status[i])
-        {
-            px_ref_it = px_ref.erase(px_ref_it);
-            px_cur_it = px_cur.erase(px_cur_it);
-            f_ref_it = f_ref.erase(f_ref_it);
             continue;
-        }
-        f_cur.push_back(frame_cur->c2f(px_cur_it->x, px_cur_it->y));
-        disparities.push_back(Vector2d(px_ref_it->x - px_cur_it->x, px_ref_it->y - px_cur_it->y).norm());
-        ++px_ref_it;
-        ++px_cur_it;
-        ++f_ref_it;
+        px_ref[n_tracked] = px_ref[i];
+        px_cur[n_tracked] = px_cur[i];
+        f_ref[n_tracked] = f_ref[i];
+        f_cur.push_back(frame_cur->c2f(px_cur[i].x, px_cur[i].y));
+        disparities.push_back(Vector2d(px_ref[i].x - px_cur[i].x, px_ref[i].y - px_cur[i].y).norm());
+        ++n_tracked;
     }
-}
-
-void computeHomography(
-        const std::vector<Vector3d>& f_ref,
-        const std::vector<Vector3d>& f_cur,
-        double focal_length,
-        double reprojection_threshold,
-        std::vector<int>& inliers,
-        std::vector<Vector3d>& xyz_in_cur,
-        SE3d& T_cur_from_ref)
-{
-    std::vector<Vector2d > uv_ref(f_ref.size());
-    std::vector<Vector2d > uv_cur(f_cur.size());
-    for(size_t i=0, i_max=f_ref.size(); i<i_max; ++i)
-    {
-        uv_ref[i] = vk::project2d(f_ref[i]);
-        uv_cur[i] = vk::project2d(f_cur[i]);
-    }
-    vk::Homography Homography(uv_ref, uv_cur, focal_length, reprojection_threshold);
-    Homography.computeSE3fromMatches();
-    std::vector<int> outliers;
-    vk::computeInliers(f_cur, f_ref,
-                       Homography.T_c2_from_c1.rotationMatrix(), Homography.T_c2_from_c1.translation(),
-                       reprojection_threshold, focal_length,
-                       xyz_in_cur, inliers, outliers);
-    T_cur_from_ref = Homography.T_c2_from_c1;
+    px_ref.resize(n_tracked);
+    px_cur.resize(n_tracked);
+    f_ref.resize(n_tracked);
 }
 
 InitResult KltHomographyInit::initFrameStereo(Frame *frame_left, Frame *frame_right)
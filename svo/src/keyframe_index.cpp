@@ -0,0 +1,316 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <cmath>
+#include <svo/keyframe_index.h>
+#include <svo/frame.h>
+
+namespace svo {
+
+namespace {
+
+inline double maxDist2(const Vector3d& p, const Vector3d& bb_min, const Vector3d& bb_max)
+{
+  return (p-bb_min).cwiseAbs().cwiseMax((p-bb_max).cwiseAbs()).squaredNorm();
+}
+
+inline double minDist2(const Vector3d& p, const Vector3d& bb_min, const Vector3d& bb_max)
+{
+  return (bb_min-p).cwiseMax(p-bb_max).cwiseMax(0.0).squaredNorm();
+}
+
+} // namespace
+
+KeyframeIndex::KeyframeIndex() :
+    seq_counter_(0),
+    root_(-1),
+    n_dead_(0),
+    depth_(0)
+{}
+
+KeyframeIndex::~KeyframeIndex()
+{}
+
+void KeyframeIndex::push_back(const FramePtr& frame)
+{
+  keyframes_.push_back(frame);
+  Entry& e = entries_[frame->id_];
+  e.it = std::prev(keyframes_.end());
+  e.seq = seq_counter_++;
+  e.node = -1;
+
+  Node n;
+  n.pos = frame->pos();
+  n.kf = e.it;
+  n.seq = e.seq;
+  n.left = n.right = -1;
+  n.axis = 0;
+  n.alive = true;
+  n.bb_min = n.bb_max = n.pos;
+  nodes_.push_back(n);
+  e.node = nodes_.size()-1;
+  insertNode(e.node);
+  ensureTree();
+}
+
+bool KeyframeIndex::erase(const FramePtr& frame)
+{
+  auto it = entries_.find(frame->id_);
+  if(it == entries_.end() || *it->second.it != frame)
+    return false;
+  if(it->second.node >= 0)
+  {
+    nodes_[it->second.node].alive = false;
+    ++n_dead_;
+  }
+  keyframes_.erase(it->second.it);
+  entries_.erase(it);
+  ensureTree();
+  return true;
+}
+
+void KeyframeIndex::clear()
+{
+  keyframes_.clear();
+  entries_.clear();
+  nodes_.clear();
+  root_ = -1;
+  n_dead_ = 0;
+  depth_ = 0;
+}
+
+void KeyframeIndex::invalidatePositions()
+{
+  rebuild();
+}
+
+FramePtr KeyframeIndex::find(int id) const
+{
+  auto it = entries_.find(id);
+  if(it == entries_.end())
+    return FramePtr();
+  return *it->second.it;
+}
+
+FramePtr KeyframeIndex::furthest(const Vector3d& pos) const
+{
+  Hit best(-1.0, 0);
+  furthestRecursive(root_, pos, best);
+  if(best.first < 0.0)
+    return FramePtr();
+  return *nodes_[best.second].kf;
+}
+
+void KeyframeIndex::nearest(const Vector3d& pos, size_t k, std::vector<FramePtr>& kfs) const
+{
+  kfs.clear();
+  if(k == 0)
+    return;
+  std::vector<Hit> heap;
+  heap.reserve(k+1);
+  nearestRecursive(root_, pos, k, heap);
+  std::sort(heap.begin(), heap.end(), [this](const Hit& a, const Hit& b) { return closer(a, b); });
+  for(const Hit& h : heap)
+    kfs.push_back(*nodes_[h.second].kf);
+}
+
+void KeyframeIndex::withinRadius(const Vector3d& pos, double radius, std::vector<FramePtr>& kfs) const
+{
+  kfs.clear();
+  std::vector<Hit> hits;
+  radiusRecursive(root_, pos, radius*radius, hits);
+  std::sort(hits.begin(), hits.end(), [this](const Hit& a, const Hit& b) { return closer(a, b); });
+  for(const Hit& h : hits)
+    kfs.push_back(*nodes_[h.second].kf);
+}
+
+void KeyframeIndex::ensureTree()
+{
+  const size_t n_alive = keyframes_.size();
+  const int max_depth = 2*static_cast<int>(std::ceil(std::log2(n_alive+1))) + 4;
+  if(n_dead_ > n_alive || depth_ > max_depth)
+    rebuild();
+}
+
+void KeyframeIndex::rebuild()
+{
+  nodes_.clear();
+  nodes_.reserve(keyframes_.size());
+  for(const FramePtr& kf : keyframes_)
+  {
+    Entry& e = entries_[kf->id_];
+    Node n;
+    n.pos = kf->pos();
+    n.kf = e.it;
+    n.seq = e.seq;
+    n.left = n.right = -1;
+    n.axis = 0;
+    n.alive = true;
+    n.bb_min = n.bb_max = n.pos;
+    e.node = nodes_.size();
+    nodes_.push_back(n);
+  }
+  std::vector<int> idx(nodes_.size());
+  for(size_t i=0; i<idx.size(); ++i)
+    idx[i] = i;
+  depth_ = 0;
+  root_ = build(idx, 0, idx.size(), 0);
+  n_dead_ = 0;
+}
+
+int KeyframeIndex::build(std::vector<int>& idx, size_t begin, size_t end, int depth)
+{
+  if(begin >= end)
+    return -1;
+  depth_ = std::max(depth_, depth+1);
+  const int axis = depth % 3;
+  const size_t mid = begin + (end-begin)/2;
+  std::nth_element(idx.begin()+begin, idx.begin()+mid, idx.begin()+end, [&](int a, int b) {
+    return nodes_[a].pos[axis] < nodes_[b].pos[axis]
+        || (nodes_[a].pos[axis] == nodes_[b].pos[axis] && nodes_[a].seq < nodes_[b].seq);
+  });
+  Node& n = nodes_[idx[mid]]; // nodes_ is not resized while building
+  n.axis = axis;
+  n.left = build(idx, begin, mid, depth+1);
+  n.right = build(idx, mid+1, end, depth+1);
+  if(n.left >= 0)
+  {
+    n.bb_min = n.bb_min.cwiseMin(nodes_[n.left].bb_min);
+    n.bb_max = n.bb_max.cwiseMax(nodes_[n.left].bb_max);
+  }
+  if(n.right >= 0)
+  {
+    n.bb_min = n.bb_min.cwiseMin(nodes_[n.right].bb_min);
+    n.bb_max = n.bb_max.cwiseMax(nodes_[n.right].bb_max);
+  }
+  return idx[mid];
+}
+
+void KeyframeIndex::insertNode(int n)
+{
+  if(root_ < 0)
+  {
+    root_ = n;
+    depth_ = 1;
+    return;
+  }
+  const Vector3d& p = nodes_[n].pos;
+  int cur = root_;
+  int depth = 1;
+  while(true)
+  {
+    Node& c = nodes_[cur];
+    c.bb_min = c.bb_min.cwiseMin(p);
+    c.bb_max = c.bb_max.cwiseMax(p);
+    ++depth;
+    int& child = (p[c.axis] < c.pos[c.axis]) ? c.left : c.right;
+    if(child < 0)
+    {
+      child = n;
+      nodes_[n].axis = (c.axis+1) % 3;
+      break;
+    }
+    cur = child;
+  }
+  depth_ = std::max(depth_, depth);
+}
+
+bool KeyframeIndex::closer(const Hit& a, const Hit& b) const
+{
+  return a.first < b.first || (a.first == b.first && nodes_[a.second].seq < nodes_[b.second].seq);
+}
+
+void KeyframeIndex::furthestRecursive(int n, const Vector3d& pos, Hit& best) const
+{
+  if(n < 0)
+    return;
+  const Node& node = nodes_[n];
+  if(maxDist2(pos, node.bb_min, node.bb_max) < best.first)
+    return;
+  if(node.alive)
+  {
+    const Hit h((node.pos-pos).squaredNorm(), n);
+    if(best.first < 0.0 || h.first > best.first
+       || (h.first == best.first && node.seq < nodes_[best.second].seq))
+      best = h;
+  }
+  // visit the side away from pos first, it more likely holds the furthest keyframe
+  if(pos[node.axis] < node.pos[node.axis])
+  {
+    furthestRecursive(node.right, pos, best);
+    furthestRecursive(node.left, pos, best);
+  }
+  else
+  {
+    furthestRecursive(node.left, pos, best);
+    furthestRecursive(node.right, pos, best);
+  }
+}
+
+void KeyframeIndex::nearestRecursive(int n, const Vector3d& pos, size_t k, std::vector<Hit>& heap) const
+{
+  if(n < 0)
+    return;
+  const Node& node = nodes_[n];
+  auto cmp = [this](const Hit& a, const Hit& b) { return closer(a, b); };
+  if(heap.size() == k && minDist2(pos, node.bb_min, node.bb_max) > heap.front().first)
+    return;
+  if(node.alive)
+  {
+    const Hit h((node.pos-pos).squaredNorm(), n);
+    if(heap.size() < k)
+    {
+      heap.push_back(h);
+      std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+    else if(closer(h, heap.front()))
+    {
+      std::pop_heap(heap.begin(), heap.end(), cmp);
+      heap.back() = h;
+      std::push_heap(heap.begin(), heap.end(), cmp);
+    }
+  }
+  if(pos[node.axis] < node.pos[node.axis])
+  {
+    nearestRecursive(node.left, pos, k, heap);
+    nearestRecursive(node.right, pos, k, heap);
+  }
+  else
+  {
+    nearestRecursive(node.right, pos, k, heap);
+    nearestRecursive(node.left, pos, k, heap);
+  }
+}
+
+void KeyframeIndex::radiusRecursive(int n, const Vector3d& pos, double radius2, std::vector<Hit>& hits) const
+{
+  if(n < 0)
+    return;
+  const Node& node = nodes_[n];
+  if(minDist2(pos, node.bb_min, node.bb_max) > radius2)
+    return;
+  if(node.alive)
+  {
+    const double d2 = (node.pos-pos).squaredNorm();
+    if(d2 <= radius2)
+      hits.push_back(Hit(d2, n));
+  }
+  radiusRecursive(node.left, pos, radius2, hits);
+  radiusRecursive(node.right, pos, radius2, hits);
+}
+
+} // namespace svo
@@ -0,0 +1,174 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <svo/klt.h>
+
+namespace svo {
+namespace klt {
+
+namespace {
+
+/// Bilinear interpolation of the rows [y, y+n_rows) and the columns
+/// [x, x+n_cols) of an image, shifted by the subpixel offset (a_x, a_y).
+void sampleWindow(
+    const cv::Mat& img,
+    const int x,
+    const int y,
+    const float a_x,
+    const float a_y,
+    const int n_cols,
+    const int n_rows,
+    float* out)
+{
+  const float w00 = (1.0f-a_x)*(1.0f-a_y);
+  const float w01 = a_x*(1.0f-a_y);
+  const float w10 = (1.0f-a_x)*a_y;
+  const float w11 = a_x*a_y;
+  const int step = img.step.p[0];
+  for(int r=0; r<n_rows; ++r)
+  {
+    const uint8_t* it = img.data + (y+r)*step + x;
+    for(int c=0; c<n_cols; ++c, ++it, ++out)
+      *out = w00*it[0] + w01*it[1] + w10*it[step] + w11*it[step+1];
+  }
+}
+
+/// The window of size n with its top left corner at x, y can be interpolated.
+inline bool isInside(const cv::Mat& img, const float x, const float y, const int n)
+{
+  return x >= 0.0f && y >= 0.0f && x+n < img.cols-1 && y+n < img.rows-1;
+}
+
+} // namespace
+
+void pyramidViews(const vilib::Frame& frame, ImgPyr& views)
+{
+  views.resize(frame.pyramid_.size());
+  for(size_t l=0; l<frame.pyramid_.size(); ++l)
+  {
+    const vilib::Subframe& level = frame.pyramid_[l];
+    if(level.type_ == vilib::Subframe::MemoryType::PAGED_HOST_MEMORY
+       || level.type_ == vilib::Subframe::MemoryType::PINNED_HOST_MEMORY)
+      views[l] = cv::Mat(level.height_, level.width_, CV_8UC1, level.data_, level.pitch_);
+    else
+      level.copy_to(views[l]);
+  }
+}
+
+void trackPoints(
+    const ImgPyr& pyr_ref,
+    const ImgPyr& pyr_cur,
+    const std::vector<cv::Point2f>& px_ref,
+    std::vector<cv::Point2f>& px_cur,
+    std::vector<uint8_t>& status,
+    const Options& options)
+{
+  const int n_levels = std::min<int>(options.max_level+1, std::min(pyr_ref.size(), pyr_cur.size()));
+  const int h = options.half_win_size;
+  const int win = 2*h+1;
+  const int area = win*win;
+  std::vector<float> tmpl_with_border((win+2)*(win+2));
+  std::vector<float> tmpl(area), dx(area), dy(area), cur(area);
+
+  status.assign(px_ref.size(), 1);
+  for(size_t i=0; i<px_ref.size(); ++i)
+  {
+    const float top_scale = 1.0f / (1<<(n_levels-1));
+    Vector2f c(px_cur[i].x*top_scale, px_cur[i].y*top_scale);
+    for(int level=n_levels-1; level>=0; --level)
+    {
+      const cv::Mat& img_ref = pyr_ref[level];
+      const cv::Mat& img_cur = pyr_cur[level];
+      const float scale = 1.0f / (1<<level);
+      const Vector2f p(px_ref[i].x*scale, px_ref[i].y*scale);
+
+      // template with a border of one pixel for the gradients
+      const float x0 = p[0]-h-1, y0 = p[1]-h-1;
+      if(!isInside(img_ref, x0, y0, win+2))
+      {
+        if(level == 0)
+          status[i] = 0;
+        else
+          c *= 2.0f;
+        continue;
+      }
+      const int ix0 = std::floor(x0), iy0 = std::floor(y0);
+      sampleWindow(img_ref, ix0, iy0, x0-ix0, y0-iy0, win+2, win+2, tmpl_with_border.data());
+      float G_xx = 0.0f, G_xy = 0.0f, G_yy = 0.0f;
+      for(int r=0, k=0; r<win; ++r)
+      {
+        const float* it = tmpl_with_border.data() + (r+1)*(win+2) + 1;
+        for(int col=0; col<win; ++col, ++it, ++k)
+        {
+          tmpl[k] = it[0];
+          dx[k] = 0.5f*(it[1]-it[-1]);
+          dy[k] = 0.5f*(it[win+2]-it[-(win+2)]);
+          G_xx += dx[k]*dx[k];
+          G_xy += dx[k]*dy[k];
+          G_yy += dy[k]*dy[k];
+        }
+      }
+      const float min_eig = (G_xx+G_yy-std::sqrt((G_xx-G_yy)*(G_xx-G_yy)+4.0f*G_xy*G_xy)) / (2.0f*area);
+      if(min_eig < options.min_eig)
+      {
+        if(level == 0)
+          status[i] = 0;
+        else
+          c *= 2.0f;
+        continue;
+      }
+      const float det_inv = 1.0f / (G_xx*G_yy-G_xy*G_xy);
+
+      // Gauss-Newton on the translation with the gradients of the template
+      bool lost = false;
+      for(int iter=0; iter<options.n_iter; ++iter)
+      {
+        const float cx0 = c[0]-h, cy0 = c[1]-h;
+        if(!isInside(img_cur, cx0, cy0, win))
+        {
+          lost = true;
+          break;
+        }
+        const int icx0 = std::floor(cx0), icy0 = std::floor(cy0);
+        sampleWindow(img_cur, icx0, icy0, cx0-icx0, cy0-icy0, win, win, cur.data());
+        float b_x = 0.0f, b_y = 0.0f;
+        for(int k=0; k<area; ++k)
+        {
+          const float e = tmpl[k]-cur[k];
+          b_x += e*dx[k];
+          b_y += e*dy[k];
+        }
+        const Vector2f delta(det_inv*(G_yy*b_x-G_xy*b_y), det_inv*(G_xx*b_y-G_xy*b_x));
+        c += delta;
+        if(delta.squaredNorm() <= options.eps*options.eps)
+          break;
+      }
+      if(lost && level == 0)
+      {
+        status[i] = 0;
+        break;
+      }
+      if(level > 0)
+        c *= 2.0f;
+    }
+    px_cur[i] = cv::Point2f(c[0], c[1]);
+  }
+}
+
+} // namespace klt
+} // namespace svo
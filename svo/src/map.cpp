@@ -24,7 +24,12 @@ using namespace std;
 
 namespace svo {
 
-Map::Map() {}
+Map::Map()
+{
+  point_candidates_.reclaimer_ = &reclaimer_;
+  point_candidates_.keyframes_ = &keyframes_;
+  reclaimer_.startThread();
+}
 
 Map::~Map()
 {
@@ -36,23 +41,20 @@ void Map::reset()
 {
   keyframes_.clear();
   point_candidates_.reset();
-  emptyTrash();
+  clearDeletedPoints();
 }
 
 bool Map::safeDeleteFrame(FramePtr frame)
 {
   bool found = false;
-  for(auto it=keyframes_.begin(), ite=keyframes_.end(); it!=ite; ++it)
+  FramePtr kf = keyframes_.find(frame->id_);
+  if(kf == frame)
   {
-    if(*it == frame)
-    {
-      std::for_each((*it)->fts_.begin(), (*it)->fts_.end(), [&](std::unique_ptr<Feature> &ftr){
-        removePtFrameRef(it->get(), ftr.get());
-      });
-      keyframes_.erase(it);
-      found = true;
-      break;
-    }
+    std::for_each(frame->fts_.begin(), frame->fts_.end(), [&](std::unique_ptr<Feature> &ftr){
+      removePtFrameRef(frame.get(), ftr.get());
+    });
+    keyframes_.erase(frame);
+    found = true;
   }
 
   point_candidates_.removeFrameCandidates(frame);
@@ -96,7 +98,9 @@ void Map::safeDeletePoint(Point* pt)
 void Map::deletePoint(Point* pt)
 {
   pt->type_ = Point::TYPE_DELETED;
-  trash_points_.push_back(pt);
+  Point::store().erase(pt->handle_);
+  deleted_point_ids_.push_back(pt->id_);
+  reclaimer_.retire(pt);
 }
 
 void Map::addKeyframe(FramePtr new_keyframe)
@@ -146,29 +150,26 @@ FramePtr Map::getClosestKeyframe(const FramePtr& frame) const
 
 FramePtr Map::getFurthestKeyframe(const Vector3d& pos) const
 {
-  FramePtr furthest_kf;
-  double maxdist = 0.0;
-  for(auto it=keyframes_.begin(), ite=keyframes_.end(); it!=ite; ++it)
-  {
-    double dist = ((*it)->pos()-pos).norm();
-    if(dist > maxdist) {
-      maxdist = dist;
-      furthest_kf = *it;
-    }
-  }
-  return furthest_kf;
+  return keyframes_.furthest(pos);
+}
+
+void Map::getNearestKeyframes(const Vector3d& pos, size_t k, std::vector<FramePtr>& kfs) const
+{
+  keyframes_.nearest(pos, k, kfs);
+}
+
+void Map::getKeyframesInRadius(const Vector3d& pos, double radius, std::vector<FramePtr>& kfs) const
+{
+  keyframes_.withinRadius(pos, radius, kfs);
 }
 
 bool Map::getKeyframeById(const int id, FramePtr& frame) const
 {
-  bool found = false;
-  for(auto it=keyframes_.begin(), ite=keyframes_.end(); it!=ite; ++it)
-    if((*it)->id_ == id) {
-      found = true;
-      frame = *it;
-      break;
-    }
-  return found;
+  FramePtr kf = keyframes_.find(id);
+  if(kf == nullptr)
+    return false;
+  frame = kf;
+  return true;
 }
 
 void Map::transform(const Matrix3d& R, const Vector3d& t, const double& s)
@@ -188,19 +189,21 @@ void Map::transform(const Matrix3d& R, const Vector3d& t, const double& s)
       (*ftr)->point->pos_ = s*R*(*ftr)->point->pos_ + t;
     }
   }
+  keyframes_.invalidatePositions();
 }
 
-void Map::emptyTrash()
+void Map::clearDeletedPoints()
 {
-  std::for_each(trash_points_.begin(), trash_points_.end(), [&](Point*& pt){
-    delete pt;
-    pt=NULL;
-  });
-  trash_points_.clear();
-  point_candidates_.emptyTrash();
+  deleted_point_ids_.clear();
+  // readers of the point store are pinned in the reclaimer, which frees the
+  // released chunks after them
+  Point::store().compact(&reclaimer_);
 }
 
-MapPointCandidates::MapPointCandidates()
+MapPointCandidates::MapPointCandidates() :
+    reclaimer_(NULL),
+    keyframes_(NULL),
+    handoff_head_(NULL)
 {}
 
 MapPointCandidates::~MapPointCandidates()
@@ -210,86 +213,137 @@ MapPointCandidates::~MapPointCandidates()
 
 void MapPointCandidates::newCandidatePoint(Point* point, double depth_sigma2)
 {
-    point->type_ = Point::TYPE_CANDIDATE;
-    std::lock_guard<std::mutex> lock(mut_);
-    candidates_.push_back(PointCandidate(point, point->obs_.front()));
+  point->type_ = Point::TYPE_CANDIDATE;
+  Feature* ftr = point->obs_.front();
+  HandoffNode* node = new HandoffNode{PointCandidate(point, ftr), ftr->frame->id_, NULL};
+  node->next = handoff_head_.load(std::memory_order_relaxed);
+  while(!handoff_head_.compare_exchange_weak(node->next, node,
+                                             std::memory_order_release,
+                                             std::memory_order_relaxed));
 }
 
-void MapPointCandidates::addCandidatePointToFrame(FramePtr frame)
+void MapPointCandidates::processHandoffQueue()
 {
-  std::lock_guard<std::mutex> lock(mut_);
-  PointCandidateList::iterator it=candidates_.begin();
-  while(it != candidates_.end())
+  // take the whole stack at once, hence there is no ABA problem
+  HandoffNode* node = handoff_head_.exchange(NULL, std::memory_order_acquire);
+
+  // the stack is in reverse order of convergence
+  HandoffNode* prev = NULL;
+  while(node != NULL)
   {
-    if(it->first->obs_.front()->frame == frame.get())
+    HandoffNode* next = node->next;
+    node->next = prev;
+    prev = node;
+    node = next;
+  }
+
+  for(node = prev; node != NULL; )
+  {
+    const int kf_id = node->kf_id;
+    if(keyframes_ != NULL && keyframes_->find(kf_id) == nullptr)
     {
-      // insert feature in the frame
-      it->first->type_ = Point::TYPE_UNKNOWN;
-      it->first->n_failed_reproj_ = 0;
-      it->second->frame->addFeature(it->second);
-      it = candidates_.erase(it);
+      // the seed converged before the filter processed the removal of its
+      // keyframe, which is not referenced anymore
+      deleteCandidate(node->candidate);
     }
     else
-      ++it;
+    {
+      Bucket& bucket = buckets_[kf_id];
+      slots_[node->candidate.first] = Slot{kf_id, bucket.size()};
+      bucket.push_back(node->candidate);
+    }
+    HandoffNode* next = node->next;
+    delete node;
+    node = next;
   }
 }
 
-bool MapPointCandidates::deleteCandidatePoint(Point* point)
+void MapPointCandidates::addCandidatePointToFrame(FramePtr frame)
 {
-  std::lock_guard<std::mutex> lock(mut_);
-  for(auto it=candidates_.begin(), ite=candidates_.end(); it!=ite; ++it)
+  processHandoffQueue();
+  auto it_bucket = buckets_.find(frame->id_);
+  if(it_bucket == buckets_.end())
+    return;
+  for(PointCandidate& c : it_bucket->second)
   {
-    if(it->first == point)
-    {
-      deleteCandidate(*it);
-      candidates_.erase(it);
-      return true;
-    }
+    // insert feature in the frame
+    c.first->type_ = Point::TYPE_UNKNOWN;
+    c.first->n_failed_reproj_ = 0;
+    c.second->frame->addFeature(c.second);
+    slots_.erase(c.first);
   }
-  return false;
+  buckets_.erase(it_bucket);
+}
+
+bool MapPointCandidates::deleteCandidatePoint(Point* point)
+{
+  processHandoffQueue();
+  auto it_slot = slots_.find(point);
+  if(it_slot == slots_.end())
+    return false;
+  const Slot slot = it_slot->second;
+  slots_.erase(it_slot);
+  deleteCandidate(buckets_[slot.kf_id][slot.idx]);
+  eraseSlot(slot);
+  return true;
 }
 
 void MapPointCandidates::removeFrameCandidates(FramePtr frame)
 {
-  std::lock_guard<std::mutex> lock(mut_);
-  auto it=candidates_.begin();
-  while(it!=candidates_.end())
+  processHandoffQueue();
+  auto it_bucket = buckets_.find(frame->id_);
+  if(it_bucket == buckets_.end())
+    return;
+  for(PointCandidate& c : it_bucket->second)
   {
-    if(it->second->frame == frame.get())
-    {
-      deleteCandidate(*it);
-      it = candidates_.erase(it);
-    }
-    else
-      ++it;
+    slots_.erase(c.first);
+    deleteCandidate(c);
   }
+  buckets_.erase(it_bucket);
 }
 
 void MapPointCandidates::reset()
 {
-  std::lock_guard<std::mutex> lock(mut_);
-  std::for_each(candidates_.begin(), candidates_.end(), [&](PointCandidate& c){
-    delete c.first;
-    delete c.second;
-  });
-  candidates_.clear();
+  processHandoffQueue();
+  for(auto& b : buckets_)
+    std::for_each(b.second.begin(), b.second.end(), [&](PointCandidate& c){
+      deleteCandidate(c);
+    });
+  buckets_.clear();
+  slots_.clear();
 }
 
-void MapPointCandidates::deleteCandidate(PointCandidate& c)
+void MapPointCandidates::eraseSlot(const Slot& slot)
 {
-  // camera-rig: another frame might still be pointing to the candidate point
-  // therefore, we can't delete it right now.
-  delete c.second; c.second=NULL;
-  c.first->type_ = Point::TYPE_DELETED;
-  trash_points_.push_back(c.first);
+  Bucket& bucket = buckets_[slot.kf_id];
+  if(slot.idx+1 != bucket.size())
+  {
+    bucket[slot.idx] = bucket.back();
+    slots_[bucket[slot.idx].first].idx = slot.idx;
+  }
+  bucket.pop_back();
+  if(bucket.empty())
+    buckets_.erase(slot.kf_id);
 }
 
-void MapPointCandidates::emptyTrash()
+void MapPointCandidates::deleteCandidate(PointCandidate& c)
 {
-  std::for_each(trash_points_.begin(), trash_points_.end(), [&](Point*& p){
-    delete p; p=NULL;
-  });
-  trash_points_.clear();
+  // camera-rig: another frame might still reference the candidate point. It
+  // does so through a handle, which is invalidated here.
+  c.first->type_ = Point::TYPE_DELETED;
+  Point::store().erase(c.first->handle_);
+  if(reclaimer_ != NULL)
+  {
+    reclaimer_->retire(c.second);
+    reclaimer_->retire(c.first);
+  }
+  else
+  {
+    delete c.second;
+    delete c.first;
+  }
+  c.second=NULL;
+  c.first=NULL;
 }
 
 namespace map_debug {
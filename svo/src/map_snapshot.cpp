@@ -0,0 +1,218 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vikit/math_utils.h>
+#include <svo/map_snapshot.h>
+#include <svo/map.h>
+#include <svo/frame.h>
+#include <svo/feature.h>
+#include <svo/point.h>
+
+namespace svo {
+
+namespace {
+
+// File layout, little endian:
+//   char[8]  magic "SVOMAP01"
+//   double   error_multiplier2
+//   uint64   n_kfs, n_points, n_obs
+//   n_kfs    x { int32 id, double timestamp, double q[4] (x,y,z,w), double t[3] }
+//   n_points x { int32 id, double pos[3] }
+//   n_obs    x { uint32 kf, uint32 point, double uv[2], int32 level }
+const char kMagic[8] = {'S','V','O','M','A','P','0','1'};
+const uint64_t kKeyframeBytes = 4 + 8 + 4*8 + 3*8;
+const uint64_t kPointBytes = 4 + 3*8;
+const uint64_t kObservationBytes = 4 + 4 + 2*8 + 4;
+
+template<class T>
+inline void write(std::ofstream& ofs, const T& value)
+{
+  ofs.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template<class T>
+inline bool read(std::ifstream& ifs, T& value)
+{
+  return static_cast<bool>(ifs.read(reinterpret_cast<char*>(&value), sizeof(T)));
+}
+
+} // namespace
+
+MapSnapshot::MapSnapshot() :
+  error_multiplier2_(1.0)
+{}
+
+void MapSnapshot::clear()
+{
+  kfs_.clear();
+  points_.clear();
+  obs_.clear();
+  error_multiplier2_ = 1.0;
+}
+
+void MapSnapshot::fromMap(const Map& map)
+{
+  clear();
+  if(map.keyframes_.empty())
+    return;
+  error_multiplier2_ = map.keyframes_.front()->cam_->errorMultiplier2();
+  std::unordered_map<const Point*, uint32_t> point_index;
+  for(const FramePtr& frame : map.keyframes_)
+  {
+    const uint32_t i = kfs_.size();
+    kfs_.push_back(Keyframe{frame->id_, frame->timestamp_, frame->T_f_w_});
+    for(Features::const_iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
+    {
+      const Point* pt = (*it)->point;
+      if(pt == NULL)
+        continue;
+      auto res = point_index.emplace(pt, points_.size());
+      if(res.second)
+        points_.push_back(Landmark{pt->id_, pt->pos_});
+      obs_.push_back(Observation{i, res.first->second, vk::project2d((*it)->f), (*it)->level});
+    }
+  }
+}
+
+bool MapSnapshot::save(const std::string& path) const
+{
+  std::ofstream ofs(path, std::ios::binary);
+  if(!ofs.is_open())
+    return false;
+  ofs.write(kMagic, sizeof(kMagic));
+  write(ofs, error_multiplier2_);
+  write(ofs, static_cast<uint64_t>(kfs_.size()));
+  write(ofs, static_cast<uint64_t>(points_.size()));
+  write(ofs, static_cast<uint64_t>(obs_.size()));
+  for(const Keyframe& kf : kfs_)
+  {
+    const Eigen::Quaterniond q = kf.T_f_w.unit_quaternion();
+    write(ofs, static_cast<int32_t>(kf.id));
+    write(ofs, kf.timestamp);
+    write(ofs, q.x()); write(ofs, q.y()); write(ofs, q.z()); write(ofs, q.w());
+    for(int k=0; k<3; ++k)
+      write(ofs, kf.T_f_w.translation()[k]);
+  }
+  for(const Landmark& pt : points_)
+  {
+    write(ofs, static_cast<int32_t>(pt.id));
+    for(int k=0; k<3; ++k)
+      write(ofs, pt.pos[k]);
+  }
+  for(const Observation& o : obs_)
+  {
+    write(ofs, o.kf);
+    write(ofs, o.point);
+    write(ofs, o.uv[0]); write(ofs, o.uv[1]);
+    write(ofs, static_cast<int32_t>(o.level));
+  }
+  return ofs.good();
+}
+
+bool MapSnapshot::load(const std::string& path)
+{
+  clear();
+  if(!loadFile(path))
+  {
+    clear();
+    return false;
+  }
+  return true;
+}
+
+bool MapSnapshot::loadFile(const std::string& path)
+{
+  std::ifstream ifs(path, std::ios::binary);
+  char magic[sizeof(kMagic)];
+  if(!ifs.read(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+    return false;
+  uint64_t n_kfs, n_points, n_obs;
+  if(!read(ifs, error_multiplier2_) || !read(ifs, n_kfs) || !read(ifs, n_points) || !read(ifs, n_obs))
+    return false;
+
+  // the counts are not trusted, the records must fit into the rest of the file
+  const std::streamoff header_end = ifs.tellg();
+  if(!ifs.seekg(0, std::ios::end))
+    return false;
+  uint64_t n_bytes = ifs.tellg() - header_end;
+  if(!ifs.seekg(header_end))
+    return false;
+  if(n_kfs > n_bytes/kKeyframeBytes)
+    return false;
+  n_bytes -= n_kfs*kKeyframeBytes;
+  if(n_points > n_bytes/kPointBytes)
+    return false;
+  n_bytes -= n_points*kPointBytes;
+  if(n_obs != n_bytes/kObservationBytes || n_bytes%kObservationBytes != 0)
+    return false;
+
+  kfs_.resize(n_kfs);
+  for(Keyframe& kf : kfs_)
+  {
+    int32_t id;
+    double q[4], t[3];
+    if(!read(ifs, id) || !read(ifs, kf.timestamp) || !read(ifs, q) || !read(ifs, t))
+      return false;
+    kf.id = id;
+    kf.T_f_w = SE3d(Eigen::Quaterniond(q[3], q[0], q[1], q[2]).normalized(), Vector3d(t[0], t[1], t[2]));
+  }
+  points_.resize(n_points);
+  for(Landmark& pt : points_)
+  {
+    int32_t id;
+    double pos[3];
+    if(!read(ifs, id) || !read(ifs, pos))
+      return false;
+    pt.id = id;
+    pt.pos = Vector3d(pos[0], pos[1], pos[2]);
+  }
+  obs_.resize(n_obs);
+  for(Observation& o : obs_)
+  {
+    double uv[2];
+    int32_t level;
+    if(!read(ifs, o.kf) || !read(ifs, o.point) || !read(ifs, uv) || !read(ifs, level))
+      return false;
+    if(o.kf >= n_kfs || o.point >= n_points)
+      return false;
+    o.uv = Vector2d(uv[0], uv[1]);
+    o.level = level;
+  }
+  return true;
+}
+
+bool MapSnapshot::saveTrajectory(const std::string& path) const
+{
+  std::ofstream ofs(path);
+  if(!ofs.is_open())
+    return false;
+  ofs.precision(10);
+  for(const Keyframe& kf : kfs_)
+  {
+    const SE3d T_w_f = kf.T_f_w.inverse();
+    const Eigen::Quaterniond q = T_w_f.unit_quaternion();
+    const Vector3d& t = T_w_f.translation();
+    ofs << kf.timestamp << " " << t[0] << " " << t[1] << " " << t[2] << " "
+        << q.x() << " " << q.y() << " " << q.z() << " " << q.w() << "\n";
+  }
+  return ofs.good();
+}
+
+} // namespace svo
@@ -0,0 +1,161 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <svo/mapping_thread.h>
+#include <svo/frame.h>
+#include <svo/map.h>
+
+namespace svo {
+
+MappingThread::MappingThread() :
+  halt_(false),
+  busy_(false),
+  generation_(0)
+{}
+
+MappingThread::~MappingThread()
+{
+  stopThread();
+}
+
+void MappingThread::startThread()
+{
+  if(thread_)
+    return;
+  halt_ = false;
+  thread_.reset(new std::thread(&MappingThread::mappingLoop, this));
+}
+
+void MappingThread::stopThread()
+{
+  if(!thread_)
+    return;
+  {
+    lock_t lock(mut_);
+    halt_ = true;
+  }
+  cond_.notify_one();
+  thread_->join();
+  thread_.reset();
+  reset();
+}
+
+std::unique_ptr<SparseBA> MappingThread::acquire()
+{
+  if(free_.empty())
+    return std::unique_ptr<SparseBA>(new SparseBA());
+  std::unique_ptr<SparseBA> ba = std::move(free_.back());
+  free_.pop_back();
+  return ba;
+}
+
+void MappingThread::release(std::unique_ptr<SparseBA> ba)
+{
+  ba->clear(); // drop the references to keyframes
+  free_.push_back(std::move(ba));
+}
+
+void MappingThread::addKeyframe(Frame* center_kf, std::set<FramePtr>* core_kfs, Map* map)
+{
+  std::unique_ptr<SparseBA> ba;
+  {
+    lock_t lock(mut_);
+    ba = acquire();
+  }
+
+  // the snapshot is taken in the calling thread, which owns the map
+  ba->setupLocalBA(center_kf, core_kfs, map);
+  ba->options_.n_threads = options_.n_threads;
+
+  {
+    lock_t lock(mut_);
+    if(waiting_)
+      release(std::move(waiting_));
+    waiting_ = std::move(ba);
+  }
+  cond_.notify_one();
+}
+
+size_t MappingThread::applyResults(
+    Map* map,
+    size_t& n_incorrect_edges,
+    double& init_error,
+    double& final_error)
+{
+  std::deque<Result> results;
+  {
+    lock_t lock(mut_);
+    if(results_.empty())
+      return 0;
+    results.swap(results_);
+  }
+
+  // the corrections are relative to each snapshot, hence they can be applied
+  // one after the other
+  for(Result& r : results)
+    r.ba->applyLocalBA(map, r.stats, n_incorrect_edges, init_error, final_error);
+
+  lock_t lock(mut_);
+  for(Result& r : results)
+    release(std::move(r.ba));
+  return results.size();
+}
+
+void MappingThread::reset()
+{
+  lock_t lock(mut_);
+  ++generation_;
+  if(waiting_)
+    release(std::move(waiting_));
+  for(Result& r : results_)
+    release(std::move(r.ba));
+  results_.clear();
+}
+
+size_t MappingThread::nPending() const
+{
+  lock_t lock(mut_);
+  return (waiting_ ? 1 : 0) + (busy_ ? 1 : 0);
+}
+
+void MappingThread::mappingLoop()
+{
+  lock_t lock(mut_);
+  while(true)
+  {
+    cond_.wait(lock, [&]{ return halt_ || waiting_; });
+    if(halt_)
+      break;
+    std::unique_ptr<SparseBA> ba = std::move(waiting_);
+    const size_t generation = generation_;
+    busy_ = true;
+    lock.unlock();
+
+    Result r;
+    ba->optimize(r.stats);
+    r.ba = std::move(ba);
+
+    lock.lock();
+    busy_ = false;
+    if(generation == generation_)
+      results_.push_back(std::move(r));
+    else
+      release(std::move(r.ba));
+  }
+}
+
+} // namespace svo
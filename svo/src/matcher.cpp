@@ -15,6 +15,11 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <cstdlib>
+#include <limits>
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #include <vikit/abstract_camera.h>
 #include <vikit/vision.h>
 #include <vikit/math_utils.h>
@@ -23,6 +28,7 @@
 #include <svo/frame.h>
 #include <svo/feature.h>
 #include <svo/point.h>
+#include <svo/replay_buffer.h>
 #include <svo/config.h>
 #include <svo/feature_alignment.h>
 
@@ -120,6 +126,83 @@ void warpAffine(const Matrix2d &A_cur_ref,
 
 } // namespace warp
 
+namespace stereo {
+
+int searchRowZMSSD(
+    const uint8_t* ref_patch,
+    const uint8_t* img,
+    const int stride,
+    const int y,
+    const int x_begin,
+    const int x_end,
+    int& x_best)
+{
+  const int patch_size = Matcher::patch_size_;
+  const int halfpatch_size = Matcher::halfpatch_size_;
+  const int patch_area = patch_size*patch_size;
+  int sumA = 0, sumAA = 0;
+  for(int i=0; i<patch_area; ++i)
+  {
+    sumA += ref_patch[i];
+    sumAA += ref_patch[i]*ref_patch[i];
+  }
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  __m128i ref_rows[8];
+  for(int r=0; r<patch_size; ++r)
+    ref_rows[r] = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(ref_patch + r*patch_size)), zero);
+#endif
+
+  int score_best = std::numeric_limits<int>::max();
+  x_best = x_begin;
+  for(int x=x_begin; x<=x_end; ++x)
+  {
+    const uint8_t* cur_patch = img + (y-halfpatch_size)*stride + (x-halfpatch_size);
+    int sumB = 0, sumBB = 0, sumAB = 0;
+#ifdef __SSE2__
+    __m128i ab = zero, bb = zero, b = zero;
+    for(int r=0; r<patch_size; ++r)
+    {
+      const __m128i row8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(cur_patch + r*stride));
+      const __m128i row16 = _mm_unpacklo_epi8(row8, zero);
+      ab = _mm_add_epi32(ab, _mm_madd_epi16(ref_rows[r], row16));
+      bb = _mm_add_epi32(bb, _mm_madd_epi16(row16, row16));
+      b = _mm_add_epi64(b, _mm_sad_epu8(row8, zero));
+    }
+    ab = _mm_add_epi32(ab, _mm_shuffle_epi32(ab, _MM_SHUFFLE(1,0,3,2)));
+    ab = _mm_add_epi32(ab, _mm_shuffle_epi32(ab, _MM_SHUFFLE(2,3,0,1)));
+    bb = _mm_add_epi32(bb, _mm_shuffle_epi32(bb, _MM_SHUFFLE(1,0,3,2)));
+    bb = _mm_add_epi32(bb, _mm_shuffle_epi32(bb, _MM_SHUFFLE(2,3,0,1)));
+    sumAB = _mm_cvtsi128_si32(ab);
+    sumBB = _mm_cvtsi128_si32(bb);
+    sumB = _mm_cvtsi128_si32(b) + _mm_cvtsi128_si32(_mm_srli_si128(b, 8));
+#else
+    for(int r=0; r<patch_size; ++r)
+    {
+      const uint8_t* ref_row = ref_patch + r*patch_size;
+      const uint8_t* cur_row = cur_patch + r*stride;
+      for(int c=0; c<patch_size; ++c)
+      {
+        sumB += cur_row[c];
+        sumBB += cur_row[c]*cur_row[c];
+        sumAB += ref_row[c]*cur_row[c];
+      }
+    }
+#endif
+    // zero mean sum of squared differences, same as vk::patch_score::ZMSSD
+    const int score = sumAA - 2*sumAB + sumBB - (sumA*sumA - 2*sumA*sumB + sumB*sumB)/patch_area;
+    if(score < score_best)
+    {
+      score_best = score;
+      x_best = x;
+    }
+  }
+  return score_best;
+}
+
+} // namespace stereo
+
 bool depthFromTriangulation(
     const SE3d& T_search_ref,
     const Vector3d& f_ref,
@@ -198,6 +281,19 @@ bool Matcher::findEpipolarMatchDirect(
     const double d_min,
     const double d_max,
     double& depth)
+{
+  return findEpipolarMatchDirect(
+      ref_frame, ReplayFrame(cur_frame), ref_ftr, d_estimate, d_min, d_max, depth);
+}
+
+bool Matcher::findEpipolarMatchDirect(
+    const Frame& ref_frame,
+    const ReplayFrame& cur_frame,
+    const Feature& ref_ftr,
+    const double d_estimate,
+    const double d_min,
+    const double d_max,
+    double& depth)
 {
   SE3 T_cur_ref = cur_frame.T_f_w_ * ref_frame.T_f_w_.inverse();
   int zmssd_best = PatchScore::threshold();
@@ -335,4 +431,71 @@ bool Matcher::findEpipolarMatchDirect(
   return false;
 }
 
+bool Matcher::findStereoMatch(
+    const Frame& ref_frame,
+    const Frame& cur_frame,
+    const Feature& ref_ftr,
+    const double d_estimate,
+    const double d_min,
+    const double d_max,
+    double& depth)
+{
+  SE3 T_cur_ref = cur_frame.T_f_w_ * ref_frame.T_f_w_.inverse();
+  const Vector2d A = vk::project2d(T_cur_ref * (ref_ftr.f*d_min));
+  const Vector2d B = vk::project2d(T_cur_ref * (ref_ftr.f*d_max));
+  const Vector2d px_A(cur_frame.cam_->world2cam(A));
+  const Vector2d px_B(cur_frame.cam_->world2cam(B));
+
+  // on rectified images the epipolar line is an image row
+  if(fabs(px_A[1]-px_B[1]) > 0.5)
+    return findEpipolarMatchDirect(ref_frame, cur_frame, ref_ftr, d_estimate, d_min, d_max, depth);
+  epi_dir_ = A - B;
+
+  warp::getWarpMatrixAffine(
+      *ref_frame.cam_, *cur_frame.cam_, ref_ftr.px, ref_ftr.f,
+      d_estimate, T_cur_ref, ref_ftr.level, A_cur_ref_);
+
+  // gradient features are only matched if the row is not parallel to the edge
+  reject_ = false;
+  if(ref_ftr.type == Feature::EDGELET && options_.epi_search_edgelet_filtering)
+  {
+    const Vector2d grad_cur = (A_cur_ref_ * ref_ftr.grad).normalized();
+    if(fabs(grad_cur[0]) < options_.epi_search_edgelet_max_angle)
+    {
+      reject_ = true;
+      return false;
+    }
+  }
+
+  search_level_ = warp::getBestSearchLevel(A_cur_ref_, Config::nPyrLevels()-1);
+  epi_length_ = (px_A-px_B).norm() / (1<<search_level_);
+  warp::warpAffine(A_cur_ref_, ref_frame.pyramid_[ref_ftr.level], ref_ftr.px,
+                   ref_ftr.level, search_level_, halfpatch_size_+1, patch_with_border_);
+  createPatchFromPatchWithBorder();
+
+  // search the row within the image, the patch with border must fit for the refinement
+  cv::Mat img = cur_frame.pyramid_[search_level_];
+  const double scale = 1.0/(1<<search_level_);
+  const int border = halfpatch_size_+1;
+  const int y = static_cast<int>(0.5*(px_A[1]+px_B[1])*scale + 0.5);
+  const int x_begin = std::max(static_cast<int>(floor(std::min(px_A[0], px_B[0])*scale)), border);
+  const int x_end = std::min(static_cast<int>(ceil(std::max(px_A[0], px_B[0])*scale)), img.cols-border-1);
+  if(y < border || y >= img.rows-border || x_begin > x_end)
+    return false;
+  int x_best;
+  if(stereo::searchRowZMSSD(patch_, img.data, img.cols, y, x_begin, x_end, x_best) >= PatchScore::threshold())
+    return false;
+
+  Vector2d px_scaled(x_best, y);
+  if(options_.subpix_refinement)
+  {
+    if(!feature_alignment::align1D(
+        img, Vector2f(1.0f, 0.0f), patch_with_border_, patch_,
+        options_.align_max_iter, px_scaled, h_inv_))
+      return false;
+  }
+  px_cur_ = px_scaled*(1<<search_level_);
+  return depthFromTriangulation(T_cur_ref, ref_ftr.f, cur_frame.cam_->cam2world(px_cur_), depth);
+}
+
 } // namespace svo
@@ -19,6 +19,7 @@
 #include <svo/point.h>
 #include <svo/frame.h>
 #include <svo/feature.h>
+#include <svo/structure_optimizer.h>
  
 namespace svo {
 
@@ -31,12 +32,13 @@ Point::Point(const Vector3d& pos) :
   n_obs_(0),
   v_pt_(NULL),
   last_published_ts_(0),
-  last_projected_kf_id_(-1),
   type_(TYPE_UNKNOWN),
   n_failed_reproj_(0),
   n_succeeded_reproj_(0),
   last_structure_optim_(0)
-{}
+{
+  handle_ = store().insert(this);
+}
 
 Point::Point(const Vector3d& pos, Feature* ftr) :
   id_(point_counter_++),
@@ -45,17 +47,21 @@ Point::Point(const Vector3d& pos, Feature* ftr) :
   n_obs_(1),
   v_pt_(NULL),
   last_published_ts_(0),
-  last_projected_kf_id_(-1),
   type_(TYPE_UNKNOWN),
   n_failed_reproj_(0),
   n_succeeded_reproj_(0),
   last_structure_optim_(0)
 {
+  handle_ = store().insert(this);
   obs_.push_front(ftr);
 }
 
 Point::~Point()
-{}
+{
+  // no-op if the map already invalidated the handle, the slot may be reused
+  // by another point since then
+  store().erase(handle_, this);
+}
 
 void Point::addFrameRef(Feature* ftr)
 {
@@ -118,62 +124,9 @@ bool Point::getCloseViewObs(const Vector3d& framepos, Feature*& ftr) const
 
 void Point::optimize(const size_t n_iter)
 {
-  Vector3d old_point = pos_;
-  double chi2 = 0.0;
-  Matrix3d A;
-  Vector3d b;
-
-  for(size_t i=0; i<n_iter; i++)
-  {
-    A.setZero();
-    b.setZero();
-    double new_chi2 = 0.0;
-
-    // compute residuals
-    for(auto it=obs_.begin(); it!=obs_.end(); ++it)
-    {
-      Matrix23d J;
-      const Vector3d p_in_f((*it)->frame->T_f_w_ * pos_);
-      Point::jacobian_xyz2uv(p_in_f, (*it)->frame->T_f_w_.rotationMatrix(), J);
-      const Vector2d e(vk::project2d((*it)->f) - vk::project2d(p_in_f));
-      new_chi2 += e.squaredNorm();
-      A.noalias() += J.transpose() * J;
-      b.noalias() -= J.transpose() * e;
-    }
-
-    // solve linear system
-    const Vector3d dp(A.ldlt().solve(b));
-
-    // check if error increased
-    if((i > 0 && new_chi2 > chi2) || (bool) std::isnan((double)dp[0]) || dp.norm()>1e4 )
-    {
-#ifdef POINT_OPTIMIZER_DEBUG
-      cout << "it " << i
-           << "\t FAILURE \t new_chi2 = " << new_chi2 << endl;
-#endif
-      pos_ = old_point; // roll-back
-      break;
-    }
-
-    // update the model
-    Vector3d new_point = pos_ + dp;
-    old_point = pos_;
-    pos_ = new_point;
-    chi2 = new_chi2;
-#ifdef POINT_OPTIMIZER_DEBUG
-    cout << "it " << i
-         << "\t Success \t new_chi2 = " << new_chi2
-         << "\t norm(b) = " << vk::norm_max(b)
-         << endl;
-#endif
-
-    // stop when converged
-    if(vk::norm_max(dp) <= EPS)
-      break;
-  }
-#ifdef POINT_OPTIMIZER_DEBUG
-  cout << endl;
-#endif
+  Point* pt = this;
+  structure_optimizer::Workspace ws;
+  structure_optimizer::optimizePoints(&pt, 1, n_iter, ws, NULL);
 }
 
 } // namespace svo
@@ -14,7 +14,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
+
 #include <stdexcept>
+#include <algorithm>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
 #include <svo/pose_optimizer.h>
 #include <svo/frame.h>
 #include <svo/feature.h>
@@ -25,217 +30,275 @@
 namespace svo {
 namespace pose_optimizer {
 
-void optimizeGaussNewton(
-    const double reproj_thresh,
-    const size_t n_iter,
-    const bool verbose,
-    FramePtr& frame,
-    double& estimated_scale,
-    double& error_init,
-    double& error_final,
-    size_t& num_obs)
+namespace {
+
+/// Tukey constant, the same as in vk::robust_cost::TukeyWeightFunction.
+const float kTukeyB = 4.6851f;
+
+/// Rows of the packed observation buffer. Every row holds one value per
+/// observation and is padded with zeros to a multiple of four.
+enum Row
 {
-  // init
-  double chi2(0.0);
-  vector<double> chi2_vec_init, chi2_vec_final;
-  vk::robust_cost::TukeyWeightFunction weight_function;
-  SE3 T_old(frame->T_f_w_);
-  Matrix6d A;
-  Vector6d b;
+  ROW_PX, ROW_PY, ROW_PZ,       //!< point in the body frame of the initial pose
+  ROW_U, ROW_V,                 //!< measurement on the unit plane
+  ROW_S,                        //!< 1/2^level, square root of the information
+  ROW_EU, ROW_EV,               //!< weighted residual
+  ROW_W,                        //!< robust weight
+  ROW_JU0, ROW_JV0 = ROW_JU0+6, //!< weighted Jacobian of u and v w.r.t. the body pose
+  N_ROWS = ROW_JV0+6
+};
 
-  // compute the scale of the error for robust estimation
-  std::vector<float> errors; errors.reserve(frame->fts_.size());
-  for(auto it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
+/// Per-thread workspace of optimizeGaussNewton. Grows to the largest frame
+/// and is then reused without allocating.
+struct Workspace
+{
+  size_t n = 0;                        //!< number of observations
+  size_t stride = 0;                   //!< padded row length
+  std::vector<float, Eigen::aligned_allocator<float>> data;
+  std::vector<Feature*> ftrs;          //!< feature of each observation
+  std::vector<size_t> cam_begin;       //!< first observation of each camera, plus n
+  std::vector<Sophus::SE3d, Eigen::aligned_allocator<Sophus::SE3d>> T_c_b;
+  std::vector<float> errors;           //!< for the scale and the median statistics
+
+  inline float* row(const int r) { return &data[r*stride]; }
+
+  void reserve(const size_t n_max, const size_t n_cams)
   {
-    if((*it)->point == NULL)
-      continue;
-    Vector2d e = vk::project2d((*it)->f)
-               - vk::project2d(frame->T_f_w_ * (*it)->point->pos_);
-    e *= 1.0 / (1<<(*it)->level);
-    errors.push_back(e.norm());
+    const size_t s = (n_max+3) & ~size_t(3);
+    if(data.size() < N_ROWS*s)
+      data.resize(N_ROWS*s);
+    ftrs.reserve(n_max);
+    errors.reserve(n_max);
+    cam_begin.clear();
+    cam_begin.reserve(n_cams+1);
+    T_c_b.clear();
+    T_c_b.reserve(n_cams);
+    stride = s;
+    n = 0;
+    ftrs.clear();
   }
-  if(errors.empty())
-    return;
-  vk::robust_cost::MADScaleEstimator scale_estimator;
-  estimated_scale = scale_estimator.compute(errors);
 
-  num_obs = errors.size();
-  chi2_vec_init.reserve(num_obs);
-  chi2_vec_final.reserve(num_obs);
-  double scale = estimated_scale;
-  for(size_t iter=0; iter<n_iter; iter++)
+  /// Add all features of the camera with a point. T_b_w is the initial pose.
+  void addCamera(const Frame& frame, const SE3d& T_c_b_cam, const SE3d& T_b_w)
   {
-    // overwrite scale
-    if(iter == 5)
-      scale = 0.85/frame->cam_->errorMultiplier2();
-
-    b.setZero();
-    A.setZero();
-    double new_chi2(0.0);
-
-    // compute residual
-    for(auto it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
+    cam_begin.push_back(n);
+    T_c_b.push_back(T_c_b_cam);
+    for(const auto& ftr : frame.fts_)
     {
-      if((*it)->point == NULL)
+      if(ftr->point == NULL)
         continue;
-      Matrix26d J;
-      Vector3d xyz_f(frame->T_f_w_ * (*it)->point->pos_);
-      Frame::jacobian_xyz2uv(xyz_f, J);
-      Vector2d e = vk::project2d((*it)->f) - vk::project2d(xyz_f);
-      double sqrt_inv_cov = 1.0 / (1<<(*it)->level);
-      e *= sqrt_inv_cov;
-      if(iter == 0)
-        chi2_vec_init.push_back(e.squaredNorm()); // just for debug
-      J *= sqrt_inv_cov;
-      double weight = weight_function.value(e.norm()/scale);
-      A.noalias() += J.transpose()*J*weight;
-      b.noalias() -= J.transpose()*e*weight;
-      new_chi2 += e.squaredNorm()*weight;
+      const Vector3d p_b(T_b_w * ftr->point->pos_);
+      row(ROW_PX)[n] = p_b[0];
+      row(ROW_PY)[n] = p_b[1];
+      row(ROW_PZ)[n] = p_b[2];
+      row(ROW_U)[n] = ftr->f[0]/ftr->f[2];
+      row(ROW_V)[n] = ftr->f[1]/ftr->f[2];
+      row(ROW_S)[n] = 1.0f / (1<<ftr->level);
+      ftrs.push_back(ftr.get());
+      ++n;
     }
+  }
 
-    // solve linear system
-    const Vector6d dT(A.ldlt().solve(b));
-
-    // check if error increased
-    if((iter > 0 && new_chi2 > chi2) || (bool) std::isnan((double)dT[0]))
-    {
-      if(verbose)
-        std::cout << "it " << iter
-                  << "\t FAILURE \t new_chi2 = " << new_chi2 << std::endl;
-      frame->T_f_w_ = T_old; // roll-back
-      break;
-    }
+  /// Close the last camera and zero the padding.
+  void finish()
+  {
+    cam_begin.push_back(n);
+    for(int r=0; r<N_ROWS; ++r)
+      std::fill(row(r)+n, row(r)+stride, 0.0f);
+  }
+};
 
-    // update the model
-    SE3d T_new = SE3d::exp(dT)*frame->T_f_w_;
-    T_old = frame->T_f_w_;
-    frame->T_f_w_ = T_new;
-    chi2 = new_chi2;
-    if(verbose)
-      std::cout << "it " << iter
-                << "\t Success \t new_chi2 = " << new_chi2
-                << "\t norm(dT) = " << vk::norm_max(dT) << std::endl;
+thread_local Workspace workspace;
 
-    // stop when converged
-    if(vk::norm_max(dT) <= EPS)
-      break;
+/// Compute the residuals and Jacobians at the body pose T_b_b0, relative to
+/// the initial pose. The loops only touch the packed rows and vectorize.
+void linearize(Workspace& ws, const SE3d& T_b_b0, const bool with_jacobian)
+{
+  const Eigen::Matrix3f R_b_b0 = T_b_b0.rotationMatrix().cast<float>();
+  const Eigen::Vector3f t_b_b0 = T_b_b0.translation().cast<float>();
+  const float* px = ws.row(ROW_PX);
+  const float* py = ws.row(ROW_PY);
+  const float* pz = ws.row(ROW_PZ);
+  const float* u = ws.row(ROW_U);
+  const float* v = ws.row(ROW_V);
+  const float* s = ws.row(ROW_S);
+  float* eu = ws.row(ROW_EU);
+  float* ev = ws.row(ROW_EV);
+  float* ju[6];
+  float* jv[6];
+  for(int k=0; k<6; ++k)
+  {
+    ju[k] = ws.row(ROW_JU0+k);
+    jv[k] = ws.row(ROW_JV0+k);
   }
 
-  // Set covariance as inverse information matrix. Optimistic estimator!
-  const double pixel_variance=1.0;
-  frame->Cov_ = pixel_variance*(A*std::pow(frame->cam_->errorMultiplier2(),2)).inverse();
-
-  // Remove Measurements with too large reprojection error
-  double reproj_thresh_scaled = reproj_thresh / frame->cam_->errorMultiplier2();
-  size_t n_deleted_refs = 0;
-  for(Features::iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
+  for(size_t c=0; c+1<ws.cam_begin.size(); ++c)
   {
-    if((*it)->point == NULL)
-      continue;
-    Vector2d e = vk::project2d((*it)->f) - vk::project2d(frame->T_f_w_ * (*it)->point->pos_);
-    double sqrt_inv_cov = 1.0 / (1<<(*it)->level);
-    e *= sqrt_inv_cov;
-    chi2_vec_final.push_back(e.squaredNorm());
-    if(e.norm() > reproj_thresh_scaled)
+    const SE3d T_c_b0 = ws.T_c_b[c] * T_b_b0;
+    const Eigen::Matrix3f R = T_c_b0.rotationMatrix().cast<float>();
+    const Eigen::Vector3f t = T_c_b0.translation().cast<float>();
+    const Eigen::Matrix3f R_c_b = ws.T_c_b[c].rotationMatrix().cast<float>();
+    for(size_t i=ws.cam_begin[c]; i<ws.cam_begin[c+1]; ++i)
     {
-      // we don't need to delete a reference in the point since it was not created yet
-      (*it)->point = NULL;
-      ++n_deleted_refs;
+      const float xc = R(0,0)*px[i] + R(0,1)*py[i] + R(0,2)*pz[i] + t[0];
+      const float yc = R(1,0)*px[i] + R(1,1)*py[i] + R(1,2)*pz[i] + t[1];
+      const float zc = R(2,0)*px[i] + R(2,1)*py[i] + R(2,2)*pz[i] + t[2];
+      const float z_inv = 1.0f/zc;
+      const float x = xc*z_inv;
+      const float y = yc*z_inv;
+      eu[i] = s[i]*(u[i] - x);
+      ev[i] = s[i]*(v[i] - y);
+      if(!with_jacobian)
+        continue;
+
+      // J = [m, p_b x m] with m = d_proj/d_p_cam * R_c_b, which is
+      // Frame::jacobian_xyz2uv_imu written out for one row.
+      const float xb = R_b_b0(0,0)*px[i] + R_b_b0(0,1)*py[i] + R_b_b0(0,2)*pz[i] + t_b_b0[0];
+      const float yb = R_b_b0(1,0)*px[i] + R_b_b0(1,1)*py[i] + R_b_b0(1,2)*pz[i] + t_b_b0[1];
+      const float zb = R_b_b0(2,0)*px[i] + R_b_b0(2,1)*py[i] + R_b_b0(2,2)*pz[i] + t_b_b0[2];
+      const float sz = -s[i]*z_inv;
+      const float mu0 = sz*(R_c_b(0,0) - x*R_c_b(2,0));
+      const float mu1 = sz*(R_c_b(0,1) - x*R_c_b(2,1));
+      const float mu2 = sz*(R_c_b(0,2) - x*R_c_b(2,2));
+      const float mv0 = sz*(R_c_b(1,0) - y*R_c_b(2,0));
+      const float mv1 = sz*(R_c_b(1,1) - y*R_c_b(2,1));
+      const float mv2 = sz*(R_c_b(1,2) - y*R_c_b(2,2));
+      ju[0][i] = mu0;
+      ju[1][i] = mu1;
+      ju[2][i] = mu2;
+      ju[3][i] = yb*mu2 - zb*mu1;
+      ju[4][i] = zb*mu0 - xb*mu2;
+      ju[5][i] = xb*mu1 - yb*mu0;
+      jv[0][i] = mv0;
+      jv[1][i] = mv1;
+      jv[2][i] = mv2;
+      jv[3][i] = yb*mv2 - zb*mv1;
+      jv[4][i] = zb*mv0 - xb*mv2;
+      jv[5][i] = xb*mv1 - yb*mv0;
     }
   }
+}
 
-  error_init=0.0;
-  error_final=0.0;
-  if(!chi2_vec_init.empty())
-    error_init = sqrt(vk::getMedian(chi2_vec_init))*frame->cam_->errorMultiplier2();
-  if(!chi2_vec_final.empty())
-    error_final = sqrt(vk::getMedian(chi2_vec_final))*frame->cam_->errorMultiplier2();
+/// Tukey weights of the current residuals. The padding keeps a zero weight.
+void computeWeights(Workspace& ws, const float scale)
+{
+  const float* eu = ws.row(ROW_EU);
+  const float* ev = ws.row(ROW_EV);
+  float* w = ws.row(ROW_W);
+  const float inv_b2 = 1.0f / (kTukeyB*kTukeyB*scale*scale);
+  for(size_t i=0; i<ws.n; ++i)
+  {
+    const float r2 = (eu[i]*eu[i] + ev[i]*ev[i])*inv_b2;
+    const float tmp = 1.0f - r2;
+    w[i] = (r2 <= 1.0f) ? tmp*tmp : 0.0f;
+  }
+}
 
-  estimated_scale *= frame->cam_->errorMultiplier2();
-  if(verbose)
-    std::cout << "n deleted obs = " << n_deleted_refs
-              << "\t scale = " << estimated_scale
-              << "\t error init = " << error_init
-              << "\t error end = " << error_final << std::endl;
-  num_obs -= n_deleted_refs;
+/// Sum over i of w[i]*(a0[i]*b0[i] + a1[i]*b1[i]) on the padded rows.
+double weightedDot(
+    const Workspace& ws,
+    const float* w,
+    const float* a0, const float* b0,
+    const float* a1, const float* b1)
+{
+#ifdef __SSE2__
+  __m128 acc = _mm_setzero_ps();
+  for(size_t i=0; i<ws.stride; i+=4)
+  {
+    const __m128 p = _mm_add_ps(_mm_mul_ps(_mm_load_ps(a0+i), _mm_load_ps(b0+i)),
+                                _mm_mul_ps(_mm_load_ps(a1+i), _mm_load_ps(b1+i)));
+    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(w+i), p));
+  }
+  float sum[4] __attribute__ ((aligned (16)));
+  _mm_store_ps(sum, acc);
+  return (double) sum[0] + sum[1] + sum[2] + sum[3];
+#else
+  float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for(size_t i=0; i<ws.stride; i+=4)
+    for(int k=0; k<4; ++k)
+      sum[k] += w[i+k]*(a0[i+k]*b0[i+k] + a1[i+k]*b1[i+k]);
+  return (double) sum[0] + sum[1] + sum[2] + sum[3];
+#endif
 }
 
-void optimizeGaussNewton(
+/// Accumulate the normal equations from the linearized observations and
+/// return the weighted chi2.
+double buildNormalEquations(Workspace& ws, Matrix6d& A, Vector6d& b)
+{
+  const float* w = ws.row(ROW_W);
+  const float* eu = ws.row(ROW_EU);
+  const float* ev = ws.row(ROW_EV);
+  for(int r=0; r<6; ++r)
+  {
+    const float* ju_r = ws.row(ROW_JU0+r);
+    const float* jv_r = ws.row(ROW_JV0+r);
+    for(int c=r; c<6; ++c)
+      A(r,c) = A(c,r) = weightedDot(ws, w, ju_r, ws.row(ROW_JU0+c), jv_r, ws.row(ROW_JV0+c));
+    b[r] = -weightedDot(ws, w, ju_r, eu, jv_r, ev);
+  }
+  return weightedDot(ws, w, eu, eu, ev, ev);
+}
+
+/// Median of the squared residuals, reorders ws.errors.
+double medianChi2(Workspace& ws)
+{
+  ws.errors.clear();
+  const float* eu = ws.row(ROW_EU);
+  const float* ev = ws.row(ROW_EV);
+  for(size_t i=0; i<ws.n; ++i)
+    ws.errors.push_back(eu[i]*eu[i] + ev[i]*ev[i]);
+  auto it = ws.errors.begin() + ws.errors.size()/2;
+  std::nth_element(ws.errors.begin(), it, ws.errors.end());
+  return *it;
+}
+
+/// Gauss-Newton on the packed observations. T_b_w is the initial body pose
+/// and is set to the result. Returns false if there is no observation.
+bool optimize(
+    Workspace& ws,
     const double reproj_thresh,
     const size_t n_iter,
     const bool verbose,
-    FrameBundle::Ptr frames,
+    const double focal_len,
+    const bool compute_median_errors,
+    SE3d& T_b_w,
+    Matrix6d& A,
     double& estimated_scale,
     double& error_init,
     double& error_final,
-    size_t& num_obs)
+    size_t& num_obs,
+    size_t& n_deleted_refs)
 {
-  // init
-  double chi2(0.0);
-  vector<double> chi2_vec_init, chi2_vec_final;
-  vk::robust_cost::TukeyWeightFunction weight_function;
-  SE3 T_old_W_B(frames->get_T_W_B());
-  Matrix6d A;
-  Vector6d b;
-  float focal_len = frames->at(0)->cam_->errorMultiplier2();
+  if(ws.n == 0)
+    return false;
 
   // compute the scale of the error for robust estimation
-  std::vector<float> errors; errors.reserve(frames->numFeatures());
-  for(size_t i = 0; i < frames->size(); i++)
-  {
-    FramePtr frame = frames->at(i);
-    for(auto it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
-    {
-      if((*it)->point == NULL)
-        continue;
-      Vector2d e = vk::project2d((*it)->f)
-                 - vk::project2d(frame->T_f_w_ * (*it)->point->pos_);
-      e *= 1.0 / (1<<(*it)->level);
-      errors.push_back(e.norm());
-    }
-  }
-  if(errors.empty())
-    return;
+  SE3d T_b_b0;
+  linearize(ws, T_b_b0, true);
+  ws.errors.clear();
+  const float* eu = ws.row(ROW_EU);
+  const float* ev = ws.row(ROW_EV);
+  for(size_t i=0; i<ws.n; ++i)
+    ws.errors.push_back(std::sqrt(eu[i]*eu[i] + ev[i]*ev[i]));
   vk::robust_cost::MADScaleEstimator scale_estimator;
-  estimated_scale = scale_estimator.compute(errors);
+  estimated_scale = scale_estimator.compute(ws.errors);
+  error_init = compute_median_errors ? std::sqrt(medianChi2(ws))*focal_len : 0.0;
 
-  num_obs = errors.size();
-  chi2_vec_init.reserve(num_obs);
-  chi2_vec_final.reserve(num_obs);
+  num_obs = ws.n;
+  double chi2(0.0);
   double scale = estimated_scale;
+  Vector6d b;
+  SE3d T_old(T_b_b0);
   for(size_t iter=0; iter<n_iter; iter++)
   {
     // overwrite scale
     if(iter == 5)
       scale = 0.85/focal_len;
 
-    b.setZero();
-    A.setZero();
-    double new_chi2(0.0);
-
-    // compute residual
-    for(size_t i=0; i < frames->size(); i++)
-    {
-      FramePtr frame = frames->at(i);
-      for(auto it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
-      {
-        if((*it)->point == NULL)
-          continue;
-        Matrix26d J;
-        Vector3d xyz_body(frames->get_T_B_W() * (*it)->point->pos_);
-        Frame::jacobian_xyz2uv_imu(frame->T_cam_body_, xyz_body, J);
-        Vector2d e = vk::project2d((*it)->f) - vk::project2d(frame->T_cam_body_ * xyz_body);
-        double sqrt_inv_cov = 1.0 / (1<<(*it)->level);
-        e *= sqrt_inv_cov;
-        if(iter == 0)
-          chi2_vec_init.push_back(e.squaredNorm()); // just for debug
-        J *= sqrt_inv_cov;
-        double weight = weight_function.value(e.norm()/scale);
-        A.noalias() += J.transpose()*J*weight;
-        b.noalias() -= J.transpose()*e*weight;
-        new_chi2 += e.squaredNorm()*weight;
-      }
-    }
+    if(iter > 0)
+      linearize(ws, T_b_b0, true);
+    computeWeights(ws, scale);
+    const double new_chi2 = buildNormalEquations(ws, A, b);
 
     // solve linear system
     const Vector6d dT(A.ldlt().solve(b));
@@ -246,13 +309,13 @@ void optimizeGaussNewton(
       if(verbose)
         std::cout << "it " << iter
                   << "\t FAILURE \t new_chi2 = " << new_chi2 << std::endl;
-      frames->set_T_W_B(T_old_W_B);
+      T_b_b0 = T_old; // roll-back
       break;
     }
 
     // update the model
-    T_old_W_B = frames->get_T_W_B();
-    frames->set_T_W_B((SE3d::exp(dT)*frames->get_T_B_W()).inverse());
+    T_old = T_b_b0;
+    T_b_b0 = SE3d::exp(dT)*T_b_b0;
     chi2 = new_chi2;
     if(verbose)
       std::cout << "it " << iter
@@ -263,42 +326,23 @@ void optimizeGaussNewton(
     if(vk::norm_max(dT) <= EPS)
       break;
   }
-
-  // Set covariance as inverse information matrix. Optimistic estimator!
-  const double pixel_variance=1.0;
-  for(size_t i = 0; i < frames->size(); i++)
-  {
-    frames->at(i)->Cov_ = pixel_variance*(A*std::pow(frames->at(i)->cam_->errorMultiplier2(),2)).inverse();
-  }  
+  T_b_w = T_b_b0*T_b_w;
 
   // Remove Measurements with too large reprojection error
-  double reproj_thresh_scaled = reproj_thresh / focal_len;
-  size_t n_deleted_refs = 0;
-  for(size_t i = 0; i < frames->size(); i++)
+  linearize(ws, T_b_b0, false);
+  const float reproj_thresh_scaled = reproj_thresh / focal_len;
+  const float reproj_thresh_scaled2 = reproj_thresh_scaled*reproj_thresh_scaled;
+  n_deleted_refs = 0;
+  for(size_t i=0; i<ws.n; ++i)
   {
-    FramePtr frame = frames->at(i);
-    for(Features::iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
+    if(eu[i]*eu[i] + ev[i]*ev[i] > reproj_thresh_scaled2)
     {
-      if((*it)->point == NULL)
-        continue;
-      Vector2d e = vk::project2d((*it)->f) - vk::project2d(frame->T_f_w_ * (*it)->point->pos_);
-      double sqrt_inv_cov = 1.0 / (1<<(*it)->level);
-      e *= sqrt_inv_cov;
-      chi2_vec_final.push_back(e.squaredNorm());
-      if(e.norm() > reproj_thresh_scaled)
-      {
-        // we don't need to delete a reference in the point since it was not created yet
-        (*it)->point = NULL;
-        ++n_deleted_refs;
-      }
+      // we don't need to delete a reference in the point since it was not created yet
+      ws.ftrs[i]->point = NULL;
+      ++n_deleted_refs;
     }
   }
-  error_init=0.0;
-  error_final=0.0;
-  if(!chi2_vec_init.empty())
-    error_init = sqrt(vk::getMedian(chi2_vec_init))*focal_len;
-  if(!chi2_vec_final.empty())
-    error_final = sqrt(vk::getMedian(chi2_vec_final))*focal_len;
+  error_final = compute_median_errors ? std::sqrt(medianChi2(ws))*focal_len : 0.0;
 
   estimated_scale *= focal_len;
   if(verbose)
@@ -307,6 +351,77 @@ void optimizeGaussNewton(
               << "\t error init = " << error_init
               << "\t error end = " << error_final << std::endl;
   num_obs -= n_deleted_refs;
+  return true;
+}
+
+} // namespace
+
+void optimizeGaussNewton(
+    const double reproj_thresh,
+    const size_t n_iter,
+    const bool verbose,
+    FramePtr& frame,
+    double& estimated_scale,
+    double& error_init,
+    double& error_final,
+    size_t& num_obs,
+    const bool compute_median_errors)
+{
+  // the frame is its own body
+  Workspace& ws = workspace;
+  ws.reserve(frame->fts_.size(), 1);
+  ws.addCamera(*frame, SE3d(), frame->T_f_w_);
+  ws.finish();
+
+  Matrix6d A;
+  size_t n_deleted_refs;
+  const double focal_len = frame->cam_->errorMultiplier2();
+  if(!optimize(ws, reproj_thresh, n_iter, verbose, focal_len, compute_median_errors,
+               frame->T_f_w_, A, estimated_scale, error_init, error_final,
+               num_obs, n_deleted_refs))
+    return;
+
+  // Set covariance as inverse information matrix. Optimistic estimator!
+  const double pixel_variance=1.0;
+  frame->Cov_ = pixel_variance*(A*std::pow(focal_len,2)).inverse();
+}
+
+void optimizeGaussNewton(
+    const double reproj_thresh,
+    const size_t n_iter,
+    const bool verbose,
+    FrameBundle::Ptr frames,
+    double& estimated_scale,
+    double& error_init,
+    double& error_final,
+    size_t& num_obs,
+    const bool compute_median_errors)
+{
+  Workspace& ws = workspace;
+  size_t n_max = 0;
+  for(size_t i = 0; i < frames->size(); i++)
+    n_max += frames->at(i)->fts_.size();
+  ws.reserve(n_max, frames->size());
+  SE3d T_b_w(frames->get_T_B_W());
+  for(size_t i = 0; i < frames->size(); i++)
+    ws.addCamera(*frames->at(i), frames->at(i)->T_cam_body_, T_b_w);
+  ws.finish();
+
+  Matrix6d A;
+  size_t n_deleted_refs;
+  const double focal_len = frames->at(0)->cam_->errorMultiplier2();
+  if(!optimize(ws, reproj_thresh, n_iter, verbose, focal_len, compute_median_errors,
+               T_b_w, A, estimated_scale, error_init, error_final,
+               num_obs, n_deleted_refs))
+    return;
+  frames->set_T_W_B(T_b_w.inverse());
+
+  // Set covariance as inverse information matrix. Optimistic estimator!
+  const double pixel_variance=1.0;
+  for(size_t i = 0; i < frames->size(); i++)
+  {
+    frames->at(i)->Cov_ = pixel_variance*(A*std::pow(frames->at(i)->cam_->errorMultiplier2(),2)).inverse();
+  }
 }
 
 } // namespace pose_optimizer
@@ -0,0 +1,143 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <algorithm>
+#include <vikit/abstract_camera.h>
+#include <svo/replay_buffer.h>
+
+namespace svo {
+
+ReplayFrame::ReplayFrame(const Frame& frame) :
+  id_(frame.id_),
+  cam_(frame.cam_),
+  T_f_w_(frame.T_f_w_),
+  is_keyframe_(frame.isKeyframe())
+{
+  pyramid_.reserve(frame.pyramid_.size());
+  for(size_t l=0; l<frame.pyramid_.size(); ++l)
+    pyramid_.push_back(frame.pyramid_[l]);
+}
+
+ReplayFrame::ReplayFrame(const FramePtr& frame) :
+  ReplayFrame(*frame)
+{
+  frame_ = frame;
+}
+
+Vector2d ReplayFrame::f2c(const Vector3d& f) const
+{
+  return cam_->world2cam(f);
+}
+
+ReplayBuffer::ReplayBuffer() :
+  n_dropped_(0)
+{}
+
+bool ReplayBuffer::push(const Frame& frame)
+{
+  const size_t n_levels = std::min(options_.n_levels, frame.pyramid_.size());
+  ImgPyr pyramid;
+  pyramid.reserve(n_levels);
+  for(size_t l=0; l<n_levels; ++l)
+    pyramid.push_back(frame.pyramid_[l]);
+  return push(frame.id_, frame.cam_, frame.T_f_w_, pyramid);
+}
+
+bool ReplayBuffer::push(int id, vk::AbstractCamera* cam, const Sophus::SE3d& T_f_w, const ImgPyr& pyramid)
+{
+  if(options_.max_frames == 0)
+  {
+    ++n_dropped_;
+    return false;
+  }
+  const size_t n_levels = std::min(options_.n_levels, pyramid.size());
+  size_t bytes = 0;
+  for(size_t l=0; l<n_levels; ++l)
+    bytes += pyramid[l].rows*pyramid[l].cols;
+
+  while(!records_.empty() && records_.size() >= options_.max_frames)
+    records_.pop_front();
+  std::shared_ptr<uint8_t> block = acquireBlock(bytes);
+  while(!block && !records_.empty())
+  {
+    // the block of the oldest record is free unless the depth filter still uses it
+    records_.pop_front();
+    block = acquireBlock(bytes);
+  }
+  if(!block)
+  {
+    ++n_dropped_;
+    return false;
+  }
+
+  std::shared_ptr<ReplayFrame> record = std::make_shared<ReplayFrame>();
+  record->id_ = id;
+  record->cam_ = cam;
+  record->T_f_w_ = T_f_w;
+  record->block_ = block;
+  record->pyramid_.reserve(n_levels);
+  uint8_t* data = block.get();
+  for(size_t l=0; l<n_levels; ++l)
+  {
+    record->pyramid_.push_back(cv::Mat(pyramid[l].rows, pyramid[l].cols, CV_8UC1, data));
+    pyramid[l].copyTo(record->pyramid_.back());
+    data += pyramid[l].rows*pyramid[l].cols;
+  }
+  records_.push_back(record);
+  return true;
+}
+
+size_t ReplayBuffer::allocatedBytes() const
+{
+  if(!pool_)
+    return 0;
+  std::lock_guard<std::mutex> lock(pool_->mut);
+  return pool_->blocks.size()*pool_->block_bytes;
+}
+
+std::shared_ptr<uint8_t> ReplayBuffer::acquireBlock(size_t bytes)
+{
+  // a new image size starts a new pool, the old one lives until its last block is released
+  if(!pool_ || pool_->block_bytes != bytes)
+    pool_ = std::make_shared<Pool>(bytes);
+
+  uint8_t* data = NULL;
+  {
+    std::lock_guard<std::mutex> lock(pool_->mut);
+    if(!pool_->free_blocks.empty())
+    {
+      data = pool_->free_blocks.back();
+      pool_->free_blocks.pop_back();
+    }
+    else if((pool_->blocks.size()+1)*bytes <= options_.max_bytes)
+    {
+      pool_->blocks.emplace_back(new uint8_t[bytes]);
+      data = pool_->blocks.back().get();
+    }
+  }
+  if(data == NULL)
+    return std::shared_ptr<uint8_t>();
+
+  // records may be released by the filter thread
+  std::shared_ptr<Pool> pool = pool_;
+  return std::shared_ptr<uint8_t>(data, [pool](uint8_t* p) {
+    std::lock_guard<std::mutex> lock(pool->mut);
+    pool->free_blocks.push_back(p);
+  });
+}
+
+} // namespace svo
@@ -65,10 +65,75 @@ void Reprojector::reprojectMap(
     FramePtr frame,
     std::vector< std::pair<FramePtr,std::size_t> >& overlap_kfs)
 {
+  prepare();
   resetGrid();
 
-  // Identify those Keyframes which share a common field of view.
   SVO_START_TIMER("reproject_kfs");
+  projectKeyframes(frame, overlap_kfs);
+  SVO_STOP_TIMER("reproject_kfs");
+
+  SVO_START_TIMER("reproject_candidates");
+  projectCandidates(frame);
+  SVO_STOP_TIMER("reproject_candidates");
+
+  SVO_START_TIMER("feature_align");
+  alignCells(frame);
+  SVO_STOP_TIMER("feature_align");
+  commit();
+}
+
+void Reprojector::prepare()
+{
+  // the depth-filter hands over converged points without waiting for us
+  map_.point_candidates_.processHandoffQueue();
+}
+
+void Reprojector::project(
+    FramePtr frame,
+    std::vector< std::pair<FramePtr,std::size_t> >& overlap_kfs)
+{
+  resetGrid();
+  projectKeyframes(frame, overlap_kfs);
+  projectCandidates(frame);
+  alignCells(frame);
+}
+
+void Reprojector::commit()
+{
+  for(const Update& u : updates_)
+  {
+    Point* pt = u.pt.get();
+    if(pt == NULL)
+      continue; // deleted by the commit of another camera
+    switch(u.type)
+    {
+      case Update::CANDIDATE_NOT_IN_FRAME:
+        pt->n_failed_reproj_ += 3;
+        if(pt->n_failed_reproj_ > 30)
+          map_.point_candidates_.deleteCandidatePoint(pt);
+        break;
+      case Update::MATCH_FAILED:
+        pt->n_failed_reproj_++;
+        if(pt->type_ == Point::TYPE_UNKNOWN && pt->n_failed_reproj_ > 15)
+          map_.safeDeletePoint(pt);
+        else if(pt->type_ == Point::TYPE_CANDIDATE  && pt->n_failed_reproj_ > 30)
+          map_.point_candidates_.deleteCandidatePoint(pt);
+        break;
+      case Update::MATCH_SUCCEEDED:
+        pt->n_succeeded_reproj_++;
+        if(pt->type_ == Point::TYPE_UNKNOWN && pt->n_succeeded_reproj_ > 10)
+          pt->type_ = Point::TYPE_GOOD;
+        break;
+    }
+  }
+  updates_.clear();
+}
+
+void Reprojector::projectKeyframes(
+    FramePtr frame,
+    std::vector< std::pair<FramePtr,std::size_t> >& overlap_kfs)
+{
+  // Identify those Keyframes which share a common field of view.
   vector< pair<FramePtr,double> > close_kfs;
   map_.getCloseKeyframes(frame, close_kfs);
 
@@ -82,6 +147,7 @@ void Reprojector::reprojectMap(
   // Reproject all mappoints of the closest N kfs with overlap. We only store
   // in which grid cell the points fall.
   size_t n = 0;
+  projected_.clear();
   overlap_kfs.reserve(options_.max_n_kfs);
   for(auto it_frame=close_kfs.begin(), ite_frame=close_kfs.end();
       it_frame!=ite_frame && n<options_.max_n_kfs; ++it_frame, ++n)
@@ -94,44 +160,32 @@ void Reprojector::reprojectMap(
         it_ftr!=ite_ftr; ++it_ftr)
     {
       // check if the feature has a mappoint assigned
-      if((*it_ftr)->point == NULL)
+      Point* pt = (*it_ftr)->point;
+      if(pt == NULL)
         continue;
 
       // make sure we project a point only once
-      if((*it_ftr)->point->last_projected_kf_id_ == frame->id_)
+      if(!projected_.insert(pt).second)
         continue;
-      (*it_ftr)->point->last_projected_kf_id_ = frame->id_;
-      if(reprojectPoint(frame, (*it_ftr)->point))
+      if(reprojectPoint(frame, pt))
         overlap_kfs.back().second++;
     }
   }
-  SVO_STOP_TIMER("reproject_kfs");
+}
 
-  // Now project all point candidates
-  SVO_START_TIMER("reproject_candidates");
-  {
-    std::lock_guard<std::mutex> lock(map_.point_candidates_.mut_);
-    auto it=map_.point_candidates_.candidates_.begin();
-    while(it!=map_.point_candidates_.candidates_.end())
-    {
-      if(!reprojectPoint(frame, it->first))
-      {
-        it->first->n_failed_reproj_ += 3;
-        if(it->first->n_failed_reproj_ > 30)
-        {
-          map_.point_candidates_.deleteCandidate(*it);
-          it = map_.point_candidates_.candidates_.erase(it);
-          continue;
-        }
-      }
-      ++it;
-    }
-  } // unlock the mutex when out of scope
-  SVO_STOP_TIMER("reproject_candidates");
+void Reprojector::projectCandidates(FramePtr frame)
+{
+  const MapPointCandidates& candidates = map_.point_candidates_;
+  for(auto& bucket : candidates.buckets_)
+    for(auto& c : bucket.second)
+      if(!reprojectPoint(frame, c.first))
+        updates_.push_back(Update(c.first, Update::CANDIDATE_NOT_IN_FRAME));
+}
 
+void Reprojector::alignCells(FramePtr frame)
+{
   // Now we go through each grid cell and select one point to match.
   // At the end, we should have at maximum one reprojected point per cell.
-  SVO_START_TIMER("feature_align");
   for(size_t i=0; i<grid_.cells.size(); ++i)
   {
     // we prefer good quality points over unkown quality (more likely to match)
@@ -141,7 +195,6 @@ void Reprojector::reprojectMap(
     if(n_matches_ > (size_t) Config::maxFts())
       break;
   }
-  SVO_STOP_TIMER("feature_align");
 }
 
 bool Reprojector::pointQualityComparator(const Candidate& lhs, const Candidate &rhs)
@@ -151,13 +204,16 @@ bool Reprojector::pointQualityComparator(const Candidate& lhs, const Candidate &
 
 bool Reprojector::reprojectCell(Cell& cell, FramePtr frame)
 {
+    // points that were deleted since they were projected have a stale handle
+    cell.remove_if([](const Candidate& c) { return c.pt.get() == NULL; });
     cell.sort(&Reprojector::pointQualityComparator);
     Cell::iterator it=cell.begin();
     while(it!=cell.end())
     {
         ++n_trials_;
 
-        if(it->pt->type_ == Point::TYPE_DELETED)
+        Point* pt = it->pt.get();
+        if(pt == NULL)
         {
             it = cell.erase(it);
             continue;
@@ -166,29 +222,25 @@ bool Reprojector::reprojectCell(Cell& cell, FramePtr frame)
         //feature alignment
         bool found_match = true;
         if(options_.find_match_direct)
-            found_match = matcher_.findMatchDirect(*it->pt, *frame, it->px);
+            found_match = matcher_.findMatchDirect(*pt, *frame, it->px);
         if(!found_match)
         {
-            it->pt->n_failed_reproj_++;
-            if(it->pt->type_ == Point::TYPE_UNKNOWN && it->pt->n_failed_reproj_ > 15)
-                map_.safeDeletePoint(it->pt);
-            if(it->pt->type_ == Point::TYPE_CANDIDATE  && it->pt->n_failed_reproj_ > 30)
-                map_.point_candidates_.deleteCandidatePoint(it->pt);
+            updates_.push_back(Update(pt, Update::MATCH_FAILED));
             it = cell.erase(it);
             continue;
         }
-        it->pt->n_succeeded_reproj_++;
-        if(it->pt->type_ == Point::TYPE_UNKNOWN && it->pt->n_succeeded_reproj_ > 10)
-            it->pt->type_ = Point::TYPE_GOOD;
+        updates_.push_back(Update(pt, Update::MATCH_SUCCEEDED));
 
-        Feature* new_feature = new Feature(frame.get(), it->px, matcher_.search_level_);
+        // without alignment, the matcher did not look at the point
+        const bool aligned = options_.find_match_direct;
+        Feature* new_feature = new Feature(frame.get(), it->px, aligned ? matcher_.search_level_ : 0);
         frame->addFeature(new_feature);
 
         // Here we add a reference in the feature to the 3D point, the other way
         // round is only done if this frame is selected as keyframe.
-        new_feature->point = it->pt;
+        new_feature->point = pt;
 
-        if(matcher_.ref_ftr_->type == Feature::EDGELET)
+        if(aligned && matcher_.ref_ftr_->type == Feature::EDGELET)
         {
             new_feature->type = Feature::EDGELET;
             new_feature->grad = matcher_.A_cur_ref_*matcher_.ref_ftr_->grad;
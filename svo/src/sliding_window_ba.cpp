@@ -0,0 +1,218 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <chrono>
+#include <algorithm>
+#include <vikit/math_utils.h>
+#include <svo/sliding_window_ba.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include <svo/map.h>
+#include <svo/config.h>
+
+namespace svo {
+
+SlidingWindowBA::SlidingWindowBA()
+{}
+
+SlidingWindowBA::~SlidingWindowBA()
+{}
+
+void SlidingWindowBA::reset()
+{
+  kfs_.clear();
+  prior_kfs_.clear();
+  prior_T0_.clear();
+  prior_H_.resize(0, 0);
+  prior_g_.resize(0);
+  marginalized_pts_.clear();
+  ba_.clear();
+  pose_index_.clear();
+  pts_.clear();
+  ftrs_.clear();
+}
+
+bool SlidingWindowBA::isAlive(const FramePtr& kf, Map* map) const
+{
+  return kf == kfs_.back() || map->keyframes_.find(kf->id_) == kf;
+}
+
+void SlidingWindowBA::removeKeyframe(const size_t i)
+{
+  auto it = std::find(prior_kfs_.begin(), prior_kfs_.end(), kfs_[i]);
+  if(it != prior_kfs_.end())
+  {
+    const size_t p = it - prior_kfs_.begin();
+    SparseBA::schurComplement(p, prior_H_, prior_g_);
+    prior_kfs_.erase(it);
+    prior_T0_.erase(prior_T0_.begin()+p);
+  }
+  kfs_.erase(kfs_.begin()+i);
+}
+
+int SlidingWindowBA::marginalizedUntil(const Point* pt) const
+{
+  auto it = marginalized_pts_.find(pt->id_);
+  return (it == marginalized_pts_.end()) ? -1 : it->second.last_kf_id;
+}
+
+void SlidingWindowBA::addWindow(const size_t n_fixed)
+{
+  ba_.clear();
+  pose_index_.clear();
+  pts_.clear();
+  ftrs_.clear();
+  for(size_t i=0; i<kfs_.size(); ++i)
+    pose_index_[kfs_[i].get()] = ba_.addPose(kfs_[i]->T_f_w_, i < n_fixed);
+  if(prior_kfs_.empty())
+    return;
+  std::vector<size_t> poses;
+  for(const FramePtr& kf : prior_kfs_)
+    poses.push_back(pose_index_[kf.get()]);
+  ba_.setPrior(poses, prior_T0_, prior_H_, prior_g_);
+}
+
+bool SlidingWindowBA::addPoint(Point* pt, const Frame* only_frame)
+{
+  const int last_kf_id = marginalizedUntil(pt);
+  const bool fixed = last_kf_id >= 0;
+  const size_t n_ftrs = ftrs_.size();
+  for(Feature* ftr : pt->obs_)
+  {
+    if((only_frame != NULL && ftr->frame != only_frame)
+       || (fixed && ftr->frame->id_ <= last_kf_id)
+       || pose_index_.find(ftr->frame) == pose_index_.end())
+      continue;
+    ftrs_.push_back(ftr);
+  }
+
+  // a point that is optimized needs two observations to constrain the poses
+  if(ftrs_.size() - n_ftrs < (fixed ? 1u : 2u))
+  {
+    ftrs_.resize(n_ftrs);
+    return false;
+  }
+  const size_t j = ba_.addPoint(pt->pos_, fixed);
+  pts_.push_back(pt);
+  for(size_t k=n_ftrs; k<ftrs_.size(); ++k)
+  {
+    Feature* ftr = ftrs_[k];
+    ba_.addObservation(pose_index_[ftr->frame], j, vk::project2d(ftr->f), 1.0 / (1<<ftr->level));
+  }
+  return true;
+}
+
+void SlidingWindowBA::marginalizeOldest()
+{
+  // The oldest keyframe, all its points that are not marginalized yet with
+  // their observations in the window and the prior.
+  addWindow(0);
+  const FramePtr kf = kfs_.front();
+  for(Features::iterator it=kf->fts_.begin(); it!=kf->fts_.end(); ++it)
+  {
+    Point* pt = (*it)->point;
+    if(pt != NULL)
+      addPoint(pt, (marginalizedUntil(pt) >= 0) ? kf.get() : NULL);
+  }
+
+  std::vector<size_t> poses;
+  ba_.marginalize(0, poses, prior_H_, prior_g_);
+  prior_kfs_.clear();
+  prior_T0_.clear();
+  for(size_t i : poses)
+  {
+    prior_kfs_.push_back(kfs_[i]);
+    prior_T0_.push_back(ba_.pose(i));
+  }
+
+  // the observations in the window are now part of the prior
+  for(size_t j=0; j<pts_.size(); ++j)
+    if(!ba_.pointFixed(j))
+      marginalized_pts_[pts_[j]->id_] = MarginalizedPoint{PointRef(pts_[j]), kfs_.back()->id_};
+  for(auto it=marginalized_pts_.begin(); it!=marginalized_pts_.end();)
+  {
+    if(it->second.pt == NULL)
+      it = marginalized_pts_.erase(it);
+    else
+      ++it;
+  }
+  kfs_.pop_front();
+}
+
+void SlidingWindowBA::addKeyframe(const FramePtr& kf, Map* map, Stats& stats)
+{
+  stats = Stats();
+  const auto t_start = std::chrono::steady_clock::now();
+  kfs_.push_back(kf);
+  for(size_t i=kfs_.size()-1; i-- > 0;)
+    if(!isAlive(kfs_[i], map))
+      removeKeyframe(i);
+  while(kfs_.size() > std::max<size_t>(options_.n_kfs, 3))
+    marginalizeOldest();
+  const auto t_marg = std::chrono::steady_clock::now();
+  stats.marginalize_ms = std::chrono::duration<double, std::milli>(t_marg-t_start).count();
+  stats.n_kfs = kfs_.size();
+  if(kfs_.size() < 3)
+    return;
+
+  // all points of the window
+  addWindow(2);
+  std::vector<Point*> pts;
+  for(const FramePtr& frame : kfs_)
+    for(Features::iterator it=frame->fts_.begin(); it!=frame->fts_.end(); ++it)
+      if((*it)->point != NULL)
+        pts.push_back((*it)->point);
+  std::sort(pts.begin(), pts.end());
+  pts.erase(std::unique(pts.begin(), pts.end()), pts.end());
+  for(Point* pt : pts)
+    addPoint(pt, NULL);
+
+  // same parameters as the g2o local BA
+  const double error_multiplier2 = kf->cam_->errorMultiplier2();
+  ba_.options_.n_iter = Config::lobaNumIter();
+  ba_.options_.huber_width = Config::lobaThresh() / error_multiplier2 * Config::lobaRobustHuberWidth();
+  ba_.options_.n_threads = options_.n_threads;
+  SparseBA::Stats ba_stats;
+  ba_.optimize(ba_stats);
+  stats.n_points = ba_stats.n_points;
+  stats.n_edges = ba_stats.n_edges;
+  stats.init_error = sqrt(ba_stats.init_chi2)*error_multiplier2;
+  stats.final_error = sqrt(ba_stats.final_chi2)*error_multiplier2;
+
+  // update the keyframes and points
+  for(size_t i=2; i<kfs_.size(); ++i)
+    kfs_[i]->T_f_w_ = ba_.pose(i);
+  map->keyframes_.invalidatePositions();
+  for(size_t j=0; j<pts_.size(); ++j)
+    if(!ba_.pointFixed(j))
+      pts_[j]->pos_ = ba_.point(j);
+
+  // remove measurements with too large reprojection error
+  const double reproj_thresh_2 = Config::lobaThresh() / error_multiplier2;
+  const double reproj_thresh_2_squared = reproj_thresh_2*reproj_thresh_2;
+  for(size_t k=0; k<ftrs_.size(); ++k)
+  {
+    if(ba_.chi2(k) <= reproj_thresh_2_squared || ftrs_[k]->point == NULL)
+      continue;
+    map->removePtFrameRef(ftrs_[k]->frame, ftrs_[k]);
+    ++stats.n_incorrect_edges;
+  }
+  stats.solve_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t_marg).count();
+}
+
+} // namespace svo
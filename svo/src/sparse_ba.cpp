@@ -0,0 +1,556 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <chrono>
+#include <algorithm>
+#include <Eigen/Eigenvalues>
+#include <vikit/math_utils.h>
+#include <svo/sparse_ba.h>
+#include <svo/worker_pool.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include <svo/map.h>
+#include <svo/config.h>
+
+namespace svo {
+
+SparseBA::SparseBA() :
+  n_var_poses_(0),
+  center_kf_(NULL),
+  error_multiplier2_(1.0)
+{}
+
+SparseBA::~SparseBA()
+{}
+
+void SparseBA::clear()
+{
+  poses_.clear();
+  pose_var_.clear();
+  n_var_poses_ = 0;
+  points_.clear();
+  point_fixed_.clear();
+  obs_.clear();
+  prior_poses_.clear();
+  prior_T0_.clear();
+  frame_index_.clear();
+  frames_.clear();
+  pts_setup_.clear();
+  pts_.clear();
+  poses_setup_.clear();
+  points_setup_.clear();
+  center_kf_ = NULL;
+}
+
+size_t SparseBA::addPose(const SE3d& T_f_w, const bool fixed)
+{
+  poses_.push_back(T_f_w);
+  pose_var_.push_back(fixed ? -1 : static_cast<int>(n_var_poses_++));
+  return poses_.size()-1;
+}
+
+size_t SparseBA::addPoint(const Vector3d& pos, const bool fixed)
+{
+  points_.push_back(pos);
+  point_fixed_.push_back(fixed);
+  return points_.size()-1;
+}
+
+void SparseBA::setPrior(
+    const std::vector<size_t>& poses,
+    const std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T0,
+    const Eigen::MatrixXd& H,
+    const Eigen::VectorXd& g)
+{
+  assert(T0.size() == poses.size());
+  assert(H.rows() == 6*static_cast<int>(poses.size()) && g.rows() == H.rows());
+  prior_poses_ = poses;
+  prior_T0_ = T0;
+  prior_H_ = H;
+  prior_g_ = g;
+}
+
+void SparseBA::schurComplement(
+    const size_t block,
+    Eigen::MatrixXd& H,
+    Eigen::VectorXd& g)
+{
+  const int n = H.rows();
+  const int m = 6*block;
+
+  // pseudo-inverse, the block may be rank deficient
+  const Eigen::SelfAdjointEigenSolver<Matrix6d> eig(H.block<6,6>(m, m));
+  const Vector6d& ev = eig.eigenvalues();
+  Vector6d ev_inv;
+  for(int i=0; i<6; ++i)
+    ev_inv[i] = (ev[i] > 1e-12*std::max(ev[5], 1e-12)) ? 1.0/ev[i] : 0.0;
+  const Matrix6d H_mm_inv = eig.eigenvectors()*ev_inv.asDiagonal()*eig.eigenvectors().transpose();
+
+  // move the block to the end and eliminate it
+  Eigen::PermutationMatrix<Eigen::Dynamic> perm(n);
+  for(int i=0; i<n; ++i)
+    perm.indices()[i] = (i < m) ? i : ((i < m+6) ? n-6+(i-m) : i-6);
+  const Eigen::MatrixXd Hp = perm*H*perm.transpose();
+  const Eigen::VectorXd gp = perm*g;
+  const int r = n-6;
+  const Eigen::MatrixXd H_rm_inv = Hp.topRightCorner(r, 6)*H_mm_inv;
+  H = Hp.topLeftCorner(r, r) - H_rm_inv*Hp.bottomLeftCorner(6, r);
+  g = gp.head(r) - H_rm_inv*gp.tail(6);
+}
+
+size_t SparseBA::addObservation(
+    const size_t pose,
+    const size_t point,
+    const Vector2d& uv,
+    const double weight)
+{
+  obs_.push_back(Observation{pose, point, uv, weight});
+  return obs_.size()-1;
+}
+
+double SparseBA::chi2(const size_t k) const
+{
+  const Observation& o = obs_[k];
+  const Vector2d e = o.uv - vk::project2d(poses_[o.pose]*points_[o.point]);
+  return o.weight*e.squaredNorm();
+}
+
+void SparseBA::forPoints(const std::function<void (size_t, size_t, size_t)>& f)
+{
+  if(pool_)
+    pool_->parallelFor(points_.size(), 32, f);
+  else
+    f(0, 0, points_.size());
+}
+
+void SparseBA::buildReducedSystem(const double lambda)
+{
+  const size_t dim = 6*n_var_poses_;
+  for(Scratch& s : scratch_)
+  {
+    s.S.setZero(dim, dim);
+    s.g.setZero(dim);
+    s.d.setZero(dim);
+  }
+
+  forPoints([&](size_t worker_id, size_t begin, size_t end) {
+    Scratch& s = scratch_[worker_id];
+    const double delta = options_.huber_width;
+    for(size_t j=begin; j<end; ++j)
+    {
+      Vector3d& b_l = b_l_[j];
+      b_l.setZero();
+      H_ll_inv_[j].setZero();
+      const size_t* first = point_obs_.data() + point_obs_begin_[j];
+      const size_t* last = point_obs_.data() + point_obs_begin_[j+1];
+      for(const size_t* k=first; k!=last; ++k)
+        H_pl_[*k].setZero();
+
+      // linearize w.r.t. the point. A point which is not constrained, e.g. with
+      // a single observation, carries no information on the poses.
+      if(!point_fixed_[j])
+      {
+        Matrix3d H_ll = Matrix3d::Zero();
+        for(const size_t* k=first; k!=last; ++k)
+        {
+          const Observation& o = obs_[*k];
+          const SE3d& T_f_w = poses_[o.pose];
+          const Vector3d p_in_f(T_f_w*points_[o.point]);
+          if(p_in_f[2] <= 0.0)
+            continue; // the point is behind the camera, skip the observation
+          const Vector2d e(o.uv - vk::project2d(p_in_f));
+          const double chi2 = o.weight*e.squaredNorm();
+          const double w = o.weight * ((chi2 <= delta*delta) ? 1.0 : delta/std::sqrt(chi2));
+          Matrix23d J_l;
+          Point::jacobian_xyz2uv(p_in_f, T_f_w.rotationMatrix(), J_l);
+          H_ll.noalias() += w*J_l.transpose()*J_l;
+          b_l.noalias() -= w*J_l.transpose()*e;
+        }
+        H_ll.diagonal() *= 1.0+lambda;
+        Eigen::SelfAdjointEigenSolver<Matrix3d> eig;
+        eig.computeDirect(H_ll, Eigen::EigenvaluesOnly);
+        if(eig.eigenvalues()[2] <= 0.0 || eig.eigenvalues()[0] <= 1e-10*eig.eigenvalues()[2])
+        {
+          b_l.setZero();
+          continue;
+        }
+        H_ll_inv_[j] = H_ll.inverse();
+      }
+
+      // linearize w.r.t. the poses
+      for(const size_t* k=first; k!=last; ++k)
+      {
+        const Observation& o = obs_[*k];
+        const int v = pose_var_[o.pose];
+        if(v < 0)
+          continue;
+        const SE3d& T_f_w = poses_[o.pose];
+        const Vector3d p_in_f(T_f_w*points_[o.point]);
+        if(p_in_f[2] <= 0.0)
+          continue;
+        const Vector2d e(o.uv - vk::project2d(p_in_f));
+        const double chi2 = o.weight*e.squaredNorm();
+        const double w = o.weight * ((chi2 <= delta*delta) ? 1.0 : delta/std::sqrt(chi2));
+        Matrix26d J_p;
+        Frame::jacobian_xyz2uv(p_in_f, J_p);
+        const Matrix6d H_pp = w*J_p.transpose()*J_p;
+        s.S.block<6,6>(6*v, 6*v) += H_pp;
+        s.d.segment<6>(6*v) += H_pp.diagonal();
+        s.g.segment<6>(6*v).noalias() -= w*J_p.transpose()*e;
+        if(!point_fixed_[j])
+        {
+          Matrix23d J_l;
+          Point::jacobian_xyz2uv(p_in_f, T_f_w.rotationMatrix(), J_l);
+          H_pl_[*k].noalias() = w*J_p.transpose()*J_l;
+        }
+      }
+      if(point_fixed_[j])
+        continue;
+
+      // eliminate the point
+      for(const size_t* k1=first; k1!=last; ++k1)
+      {
+        const int v1 = pose_var_[obs_[*k1].pose];
+        if(v1 < 0)
+          continue;
+        const Matrix63d HW = H_pl_[*k1]*H_ll_inv_[j];
+        s.g.segment<6>(6*v1).noalias() -= HW*b_l;
+        for(const size_t* k2=first; k2!=last; ++k2)
+        {
+          const int v2 = pose_var_[obs_[*k2].pose];
+          if(v2 < v1)
+            continue; // upper triangle only
+          s.S.block<6,6>(6*v1, 6*v2).noalias() -= HW*H_pl_[*k2].transpose();
+        }
+      }
+    }
+  });
+
+  // reduce the workers
+  Scratch& s0 = scratch_[0];
+  for(size_t i=1; i<scratch_.size(); ++i)
+  {
+    s0.S += scratch_[i].S;
+    s0.g += scratch_[i].g;
+    s0.d += scratch_[i].d;
+  }
+
+  // prior, linearized at its own estimate
+  if(!prior_poses_.empty())
+  {
+    const Eigen::VectorXd g_p = prior_g_ - prior_H_*priorDelta();
+    for(size_t p1=0; p1<prior_poses_.size(); ++p1)
+    {
+      const int v1 = pose_var_[prior_poses_[p1]];
+      if(v1 < 0)
+        continue;
+      s0.g.segment<6>(6*v1) += g_p.segment<6>(6*p1);
+      s0.d.segment<6>(6*v1) += prior_H_.block<6,6>(6*p1, 6*p1).diagonal();
+      for(size_t p2=0; p2<prior_poses_.size(); ++p2)
+      {
+        const int v2 = pose_var_[prior_poses_[p2]];
+        if(v2 >= v1)
+          s0.S.block<6,6>(6*v1, 6*v2) += prior_H_.block<6,6>(6*p1, 6*p2);
+      }
+    }
+  }
+  s0.S.diagonal() += lambda*s0.d;
+}
+
+Eigen::VectorXd SparseBA::priorDelta() const
+{
+  Eigen::VectorXd delta(6*prior_poses_.size());
+  for(size_t p=0; p<prior_poses_.size(); ++p)
+    delta.segment<6>(6*p) = (poses_[prior_poses_[p]]*prior_T0_[p].inverse()).log();
+  return delta;
+}
+
+bool SparseBA::solveAndUpdate()
+{
+  Scratch& s0 = scratch_[0];
+  if(n_var_poses_ > 0)
+  {
+    const Eigen::LDLT<Eigen::MatrixXd, Eigen::Upper> ldlt(s0.S);
+    if(ldlt.info() != Eigen::Success)
+      return false;
+    dx_poses_ = ldlt.solve(s0.g);
+    if(!dx_poses_.allFinite())
+      return false;
+  }
+
+  // back-substitute the points
+  forPoints([&](size_t worker_id, size_t begin, size_t end) {
+    for(size_t j=begin; j<end; ++j)
+    {
+      Vector3d b = b_l_[j];
+      for(size_t i=point_obs_begin_[j]; i<point_obs_begin_[j+1]; ++i)
+      {
+        const size_t k = point_obs_[i];
+        const int v = pose_var_[obs_[k].pose];
+        if(v >= 0)
+          b.noalias() -= H_pl_[k].transpose()*dx_poses_.segment<6>(6*v);
+      }
+      points_[j] += H_ll_inv_[j]*b;
+    }
+  });
+  for(size_t i=0; i<poses_.size(); ++i)
+  {
+    if(pose_var_[i] >= 0)
+      poses_[i] = SE3d::exp(dx_poses_.segment<6>(6*pose_var_[i]))*poses_[i];
+  }
+  return true;
+}
+
+double SparseBA::computeCost()
+{
+  for(Scratch& s : scratch_)
+    s.cost = 0.0;
+  forPoints([&](size_t worker_id, size_t begin, size_t end) {
+    Scratch& s = scratch_[worker_id];
+    for(size_t j=begin; j<end; ++j)
+      for(size_t i=point_obs_begin_[j]; i<point_obs_begin_[j+1]; ++i)
+      {
+        const Observation& o = obs_[point_obs_[i]];
+        const Vector3d p_in_f(poses_[o.pose]*points_[o.point]);
+        if(p_in_f[2] > 0.0)
+          s.cost += robustCost(o.weight*(o.uv - vk::project2d(p_in_f)).squaredNorm());
+      }
+  });
+  double cost = 0.0;
+  for(const Scratch& s : scratch_)
+    cost += s.cost;
+  if(!prior_poses_.empty())
+  {
+    const Eigen::VectorXd delta = priorDelta();
+    cost += delta.dot(prior_H_*delta) - 2.0*prior_g_.dot(delta);
+  }
+  return cost;
+}
+
+void SparseBA::prepare()
+{
+  const size_t n_workers = std::max(options_.n_threads, 1);
+  if(n_workers > 1 && (!pool_ || pool_->size() != n_workers))
+    pool_.reset(new WorkerPool(n_workers));
+  else if(n_workers == 1)
+    pool_.reset();
+  scratch_.resize(n_workers);
+
+  // observations sorted by point, such that a point is linearized by one worker
+  point_obs_begin_.assign(points_.size()+1, 0);
+  for(const Observation& o : obs_)
+    ++point_obs_begin_[o.point+1];
+  for(size_t j=0; j<points_.size(); ++j)
+    point_obs_begin_[j+1] += point_obs_begin_[j];
+  point_obs_.resize(obs_.size());
+  {
+    std::vector<size_t> next(point_obs_begin_.begin(), point_obs_begin_.end()-1);
+    for(size_t k=0; k<obs_.size(); ++k)
+      point_obs_[next[obs_[k].point]++] = k;
+  }
+  H_pl_.resize(obs_.size());
+  H_ll_inv_.resize(points_.size());
+  b_l_.resize(points_.size());
+}
+
+void SparseBA::reducedSystem(Eigen::MatrixXd& H, Eigen::VectorXd& g)
+{
+  prepare();
+  buildReducedSystem(0.0);
+  H = scratch_[0].S.selfadjointView<Eigen::Upper>();
+  g = scratch_[0].g;
+}
+
+void SparseBA::marginalize(
+    const size_t pose,
+    std::vector<size_t>& poses,
+    Eigen::MatrixXd& H,
+    Eigen::VectorXd& g)
+{
+  assert(pose_var_[pose] >= 0);
+  reducedSystem(H, g);
+  schurComplement(pose_var_[pose], H, g);
+
+  // the blocks of the remaining poses keep their order
+  poses.clear();
+  for(size_t i=0; i<poses_.size(); ++i)
+    if(pose_var_[i] >= 0 && i != pose)
+      poses.push_back(i);
+}
+
+void SparseBA::optimize(Stats& stats)
+{
+  const auto t_start = std::chrono::steady_clock::now();
+  stats = Stats();
+  stats.n_poses = n_var_poses_;
+  stats.n_points = points_.size();
+  stats.n_edges = obs_.size();
+
+  prepare();
+
+  double cost = computeCost();
+  stats.init_chi2 = cost;
+  double lambda = options_.lambda_init;
+  for(size_t iter=0; iter<options_.n_iter; ++iter)
+  {
+    bool success = false;
+    for(size_t trial=0; trial<options_.max_trials && !success; ++trial)
+    {
+      buildReducedSystem(lambda);
+      poses_backup_ = poses_;
+      points_backup_ = points_;
+      if(solveAndUpdate())
+      {
+        const double new_cost = computeCost();
+        if(new_cost < cost)
+        {
+          success = true;
+          cost = new_cost;
+          lambda = std::max(lambda/10.0, 1e-12);
+          break;
+        }
+      }
+
+      // roll-back and increase the damping
+      poses_.swap(poses_backup_);
+      points_.swap(points_backup_);
+      lambda *= 10.0;
+    }
+    if(!success)
+      break;
+    ++stats.n_iter;
+    if(dx_poses_.size() > 0 && dx_poses_.lpNorm<Eigen::Infinity>() <= EPS)
+      break;
+  }
+  stats.final_chi2 = cost;
+  stats.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t_start).count();
+}
+
+void SparseBA::localBA(
+    Frame* center_kf,
+    std::set<FramePtr>* core_kfs,
+    Map* map,
+    size_t& n_incorrect_edges_1,
+    size_t& n_incorrect_edges_2,
+    double& init_error,
+    double& final_error)
+{
+  n_incorrect_edges_1 = 0;
+  setupLocalBA(center_kf, core_kfs, map);
+  Stats stats;
+  optimize(stats);
+  applyLocalBA(map, stats, n_incorrect_edges_2, init_error, final_error);
+}
+
+void SparseBA::setupLocalBA(Frame* center_kf, std::set<FramePtr>* core_kfs, Map* map)
+{
+  clear();
+
+  // Add all core keyframes. All points that they observe are also optimized.
+  for(const FramePtr& kf : *core_kfs)
+  {
+    frame_index_[kf.get()] = addPose(kf->T_f_w_, false);
+    frames_.push_back(kf);
+    for(Features::iterator it=kf->fts_.begin(); it!=kf->fts_.end(); ++it)
+      if((*it)->point != NULL)
+        pts_setup_.push_back((*it)->point);
+  }
+  std::sort(pts_setup_.begin(), pts_setup_.end());
+  pts_setup_.erase(std::unique(pts_setup_.begin(), pts_setup_.end()), pts_setup_.end());
+
+  // Add a measurement for every observation of the points. A neighbour
+  // keyframe which is not in the set of core kfs is fixed.
+  for(Point* pt : pts_setup_)
+  {
+    const size_t j = addPoint(pt->pos_);
+    pts_.push_back(pt);
+    for(Feature* ftr : pt->obs_)
+    {
+      auto it = frame_index_.find(ftr->frame);
+      if(it == frame_index_.end())
+      {
+        FramePtr kf = map->keyframes_.find(ftr->frame->id_);
+        if(!kf)
+          continue;
+        it = frame_index_.emplace(ftr->frame, addPose(kf->T_f_w_, true)).first;
+        frames_.push_back(kf);
+      }
+      addObservation(it->second, j, vk::project2d(ftr->f), 1.0 / (1<<ftr->level));
+    }
+  }
+  poses_setup_ = poses_;
+  points_setup_ = points_;
+
+  // same parameters as the g2o local BA
+  center_kf_ = center_kf;
+  error_multiplier2_ = center_kf->cam_->errorMultiplier2();
+  options_.n_iter = Config::lobaNumIter();
+  options_.huber_width = Config::lobaThresh() / error_multiplier2_ * Config::lobaRobustHuberWidth();
+}
+
+void SparseBA::applyLocalBA(
+    Map* map,
+    const Stats& stats,
+    size_t& n_incorrect_edges,
+    double& init_error,
+    double& final_error)
+{
+  // Update Keyframes that are still in the map. The center keyframe may not
+  // be inserted yet.
+  std::vector<bool> alive(frames_.size());
+  for(size_t i=0; i<frames_.size(); ++i)
+  {
+    alive[i] = (frames_[i].get() == center_kf_)
+            || (map->keyframes_.find(frames_[i]->id_) == frames_[i]);
+    if(alive[i] && pose_var_[i] >= 0)
+      frames_[i]->T_f_w_ = poses_[i] * poses_setup_[i].inverse() * frames_[i]->T_f_w_;
+  }
+  map->keyframes_.invalidatePositions();
+
+  // Update Mappoints that were not deleted
+  for(size_t j=0; j<pts_.size(); ++j)
+  {
+    Point* pt = pts_[j];
+    if(pt != NULL)
+      pt->pos_ += points_[j] - points_setup_[j];
+  }
+
+  // Remove Measurements with too large reprojection error
+  const double reproj_thresh_2 = Config::lobaThresh() / error_multiplier2_;
+  const double reproj_thresh_2_squared = reproj_thresh_2*reproj_thresh_2;
+  n_incorrect_edges = 0;
+  for(size_t k=0; k<obs_.size(); ++k)
+  {
+    if(chi2(k) <= reproj_thresh_2_squared)
+      continue;
+    Frame* frame = frames_[obs_[k].pose].get();
+    Point* pt = pts_[obs_[k].point];
+    if(!alive[obs_[k].pose] || pt == NULL)
+      continue;
+    Feature* ftr = pt->findFrameRef(frame);
+    if(ftr == NULL)
+      continue;
+    map->removePtFrameRef(frame, ftr);
+    ++n_incorrect_edges;
+  }
+
+  init_error = sqrt(stats.init_chi2)*error_multiplier2_;
+  final_error = sqrt(stats.final_chi2)*error_multiplier2_;
+}
+
+} // namespace svo
@@ -0,0 +1,134 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <vikit/math_utils.h>
+#include <svo/structure_optimizer.h>
+#include <svo/worker_pool.h>
+#include <svo/point.h>
+#include <svo/frame.h>
+#include <svo/feature.h>
+
+namespace svo {
+namespace structure_optimizer {
+
+void optimizePoint(
+    const Observation* obs,
+    const size_t n_obs,
+    const size_t n_iter,
+    Vector3d& pos)
+{
+  Vector3d old_point = pos;
+  double chi2 = 0.0;
+  Matrix3d A;
+  Vector3d b;
+
+  for(size_t i=0; i<n_iter; i++)
+  {
+    A.setZero();
+    b.setZero();
+    double new_chi2 = 0.0;
+
+    // compute residuals
+    for(const Observation* o=obs; o!=obs+n_obs; ++o)
+    {
+      Matrix23d J;
+      const Vector3d p_in_f(o->R_f_w * pos + o->t_f_w);
+      Point::jacobian_xyz2uv(p_in_f, o->R_f_w, J);
+      const Vector2d e(o->uv - vk::project2d(p_in_f));
+      new_chi2 += e.squaredNorm();
+      A.noalias() += J.transpose() * J;
+      b.noalias() -= J.transpose() * e;
+    }
+
+    // solve linear system
+    const Vector3d dp(A.ldlt().solve(b));
+
+    // check if error increased
+    if((i > 0 && new_chi2 > chi2) || (bool) std::isnan((double)dp[0]) || dp.norm()>1e4 )
+    {
+#ifdef POINT_OPTIMIZER_DEBUG
+      std::cout << "it " << i
+           << "\t FAILURE \t new_chi2 = " << new_chi2 << std::endl;
+#endif
+      pos = old_point; // roll-back
+      break;
+    }
+
+    // update the model
+    Vector3d new_point = pos + dp;
+    old_point = pos;
+    pos = new_point;
+    chi2 = new_chi2;
+#ifdef POINT_OPTIMIZER_DEBUG
+    std::cout << "it " << i
+         << "\t Success \t new_chi2 = " << new_chi2
+         << "\t norm(b) = " << vk::norm_max(b)
+         << std::endl;
+#endif
+
+    // stop when converged
+    if(vk::norm_max(dp) <= EPS)
+      break;
+  }
+#ifdef POINT_OPTIMIZER_DEBUG
+  std::cout << std::endl;
+#endif
+}
+
+void optimizePoints(
+    Point* const* pts,
+    const size_t n_pts,
+    const size_t n_iter,
+    Workspace& ws,
+    WorkerPool* pool,
+    const size_t grain)
+{
+  // the observation lists are walked once to reserve a contiguous range per point
+  ws.obs_begin.resize(n_pts+1);
+  size_t n_obs = 0;
+  for(size_t i=0; i<n_pts; ++i)
+  {
+    ws.obs_begin[i] = n_obs;
+    n_obs += pts[i]->obs_.size();
+  }
+  ws.obs_begin[n_pts] = n_obs;
+  if(ws.obs.size() < n_obs)
+    ws.obs.resize(n_obs);
+
+  auto task = [&](size_t worker_id, size_t begin, size_t end) {
+    for(size_t i=begin; i<end; ++i)
+    {
+      Observation* const first = ws.obs.data() + ws.obs_begin[i];
+      Observation* o = first;
+      for(const Feature* ftr : pts[i]->obs_)
+      {
+        o->R_f_w = ftr->frame->T_f_w_.rotationMatrix();
+        o->t_f_w = ftr->frame->T_f_w_.translation();
+        o->uv = vk::project2d(ftr->f);
+        ++o;
+      }
+      optimizePoint(first, o-first, n_iter, pts[i]->pos_);
+    }
+  };
+  if(pool)
+    pool->parallelFor(n_pts, grain, task);
+  else
+    task(0, 0, n_pts);
+}
+
+} // namespace structure_optimizer
+} // namespace svo
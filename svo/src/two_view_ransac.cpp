@@ -0,0 +1,586 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <Eigen/SVD>
+#include <Eigen/Eigenvalues>
+#include <svo/two_view_ransac.h>
+#include <svo/worker_pool.h>
+
+namespace svo {
+
+namespace {
+
+/// Ratio of the chi-square quantiles (95%) with one and two degrees of
+/// freedom. The distance to the epipolar line has one degree of freedom, the
+/// transfer error of the homography two, both are scored on the same scale.
+const double kEssentialThresholdRatio = 3.84/5.99;
+
+/// Cost of estimating a model in units of verifying one point.
+const double kSprtModelCost = 200.0;
+
+/// Similarity transform that moves the centroid of the points to the origin
+/// and scales their mean distance to sqrt(2), for the DLT.
+Matrix3d normalization(const std::vector<Vector2d>& uv, const std::vector<int>& sample)
+{
+  Vector2d mean = Vector2d::Zero();
+  for(int i : sample)
+    mean += uv[i];
+  mean /= sample.size();
+  double dist = 0.0;
+  for(int i : sample)
+    dist += (uv[i]-mean).norm();
+  dist /= sample.size();
+  const double s = (dist > 1e-12) ? std::sqrt(2.0)/dist : 1.0;
+  Matrix3d T;
+  T << s, 0.0, -s*mean[0],
+       0.0, s, -s*mean[1],
+       0.0, 0.0, 1.0;
+  return T;
+}
+
+/// Eigenvector of the smallest eigenvalue of A^T*A.
+Eigen::Matrix<double,9,1> nullVector(const Eigen::Matrix<double,9,9>& AtA)
+{
+  Eigen::SelfAdjointEigenSolver<Eigen::Matrix<double,9,9>> eig(AtA);
+  return eig.eigenvectors().col(0);
+}
+
+/// Decision threshold A of the SPRT for the inlier ratio epsilon and the
+/// probability delta that a point is consistent with a bad model, see Chum
+/// and Matas, "Optimal Randomized RANSAC", PAMI 2008.
+double sprtThreshold(const double epsilon, const double delta)
+{
+  const double C = (1.0-delta)*std::log((1.0-delta)/(1.0-epsilon)) + delta*std::log(delta/epsilon);
+  double A = kSprtModelCost*C + 1.0;
+  for(int i=0; i<10; ++i)
+    A = kSprtModelCost*C + 1.0 + std::log(A);
+  return A;
+}
+
+/// Number of hypotheses after which an all-inlier sample was drawn and
+/// accepted with the requested confidence. A good hypothesis passes the SPRT
+/// with probability 1-1/A.
+size_t requiredIterations(
+    const double inlier_ratio,
+    const size_t sample_size,
+    const double sprt_A,
+    const double confidence,
+    const size_t max_iter)
+{
+  double p = std::pow(inlier_ratio, double(sample_size));
+  if(sprt_A > 0.0)
+    p *= 1.0-1.0/sprt_A;
+  if(p <= std::numeric_limits<double>::epsilon())
+    return max_iter;
+  if(p >= 1.0)
+    return 1;
+  const double n = std::ceil(std::log(1.0-confidence)/std::log(1.0-p));
+  return (n < double(max_iter)) ? size_t(n) : max_iter;
+}
+
+} // namespace
+
+TwoViewRansac::TwoViewRansac() :
+  model_(HOMOGRAPHY),
+  H_cur_ref_(Matrix3d::Identity()),
+  E_cur_ref_(Matrix3d::Zero())
+{}
+
+TwoViewRansac::~TwoViewRansac()
+{}
+
+bool TwoViewRansac::compute(
+    const std::vector<Vector3d>& f_ref,
+    const std::vector<Vector3d>& f_cur,
+    const double focal_length,
+    Stats& stats)
+{
+  const auto t_start = std::chrono::steady_clock::now();
+  stats = Stats();
+  inliers_.clear();
+
+  uv_ref_.resize(f_ref.size());
+  uv_cur_.resize(f_cur.size());
+  for(size_t i=0; i<f_ref.size(); ++i)
+  {
+    uv_ref_[i] = f_ref[i].head<2>()/f_ref[i][2];
+    uv_cur_[i] = f_cur[i].head<2>()/f_cur[i][2];
+  }
+  const double threshold = options_.threshold/focal_length;
+  const double threshold2 = threshold*threshold;
+
+  const size_t n_workers = std::max(options_.n_threads, 1);
+  if(n_workers > 1 && (!pool_ || pool_->size() != n_workers))
+    pool_.reset(new WorkerPool(n_workers));
+  else if(n_workers == 1)
+    pool_.reset();
+
+  Hypothesis best[2];
+  bool found[2];
+  for(int model=HOMOGRAPHY; model<=ESSENTIAL; ++model)
+  {
+    found[model] = ransac(Model(model), threshold2, best[model], stats);
+    if(!found[model])
+      continue;
+    refine(Model(model), threshold2, best[model]);
+    stats.score[model] = best[model].score;
+    stats.n_inliers[model] = best[model].n_inliers;
+  }
+  stats.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t_start).count();
+  if(!found[HOMOGRAPHY] && !found[ESSENTIAL])
+    return false;
+
+  // the homography explains a planar scene or a small baseline better
+  const double score_h = found[HOMOGRAPHY] ? best[HOMOGRAPHY].score : 0.0;
+  const double score_e = found[ESSENTIAL] ? best[ESSENTIAL].score : 0.0;
+  model_ = (score_h > options_.homography_ratio*(score_h+score_e)) ? HOMOGRAPHY : ESSENTIAL;
+  stats.model = model_;
+  if(found[HOMOGRAPHY])
+    H_cur_ref_ = best[HOMOGRAPHY].M;
+  if(found[ESSENTIAL])
+  {
+    Eigen::JacobiSVD<Matrix3d> svd(best[ESSENTIAL].M, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    E_cur_ref_ = svd.matrixU()*Vector3d(1.0, 1.0, 0.0).asDiagonal()*svd.matrixV().transpose();
+  }
+
+  collectInliers(model_, best[model_].M, threshold2, inliers_);
+  std::vector<SE3d> poses;
+  if(model_ == HOMOGRAPHY)
+    decomposeHomography(H_cur_ref_, poses);
+  else
+    decomposeEssential(E_cur_ref_, poses);
+  const bool success = selectPose(poses, inliers_, threshold2, T_cur_ref_);
+  stats.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-t_start).count();
+  return success;
+}
+
+bool TwoViewRansac::ransac(
+    const Model model,
+    const double threshold2,
+    Hypothesis& best,
+    Stats& stats)
+{
+  const size_t n = uv_ref_.size();
+  const size_t sample_size = (model == HOMOGRAPHY) ? 4 : 8;
+  if(n < sample_size)
+    return false;
+
+  // best hypothesis and rejection statistics of one worker within a batch
+  struct WorkerResult
+  {
+    Hypothesis best;
+    size_t n_rejected;
+    size_t n_tested;            //!< Points verified in rejected hypotheses.
+    size_t n_consistent;        //!< Consistent points in rejected hypotheses.
+  };
+  const size_t n_workers = pool_ ? pool_->size() : 1;
+  std::vector<WorkerResult, Eigen::aligned_allocator<WorkerResult>> results(n_workers);
+
+  best.score = -1.0;
+  best.n_inliers = 0;
+  best.id = 0;
+  double epsilon = 0.1;         // initial, conservative inlier ratio
+  double delta = 0.05;          // initial consistency of bad hypotheses
+  double sprt_A = options_.use_sprt ? sprtThreshold(epsilon, delta) : 0.0;
+  size_t n_tested_rejected = 0, n_consistent_rejected = 0;
+  size_t n_required = options_.max_iter;
+  size_t n_done = 0;
+  while(n_done < n_required)
+  {
+    const size_t n_batch = std::min(std::max<size_t>(options_.batch_size, 1), n_required-n_done);
+    for(WorkerResult& r : results)
+    {
+      r.best.score = -1.0;
+      r.best.id = 0;
+      r.n_rejected = r.n_tested = r.n_consistent = 0;
+    }
+
+    // hypotheses of one batch are verified with the same SPRT parameters
+    auto task = [&](size_t worker, size_t begin, size_t end)
+    {
+      WorkerResult& r = results[worker];
+      std::vector<int> sample(sample_size);
+      Hypothesis h;
+      for(size_t k=begin; k<end; ++k)
+      {
+        h.id = n_done+k;
+        std::minstd_rand rng(1u + options_.seed + 2u*h.id + model);
+        for(size_t s=0; s<sample_size; )
+        {
+          const int i = rng() % n;
+          if(std::find(sample.begin(), sample.begin()+s, i) == sample.begin()+s)
+            sample[s++] = i;
+        }
+        const bool valid = (model == HOMOGRAPHY) ? fitHomography(uv_ref_, uv_cur_, sample, h.M)
+                                                 : fitEssential(uv_ref_, uv_cur_, sample, h.M);
+        if(!valid)
+          continue;
+        size_t n_tested, n_consistent;
+        if(!score(model, threshold2, sprt_A, epsilon, delta, h, n_tested, n_consistent))
+        {
+          ++r.n_rejected;
+          r.n_tested += n_tested;
+          r.n_consistent += n_consistent;
+          continue;
+        }
+        if(h.score > r.best.score || (h.score == r.best.score && h.id < r.best.id))
+          r.best = h;
+      }
+    };
+    if(pool_)
+      pool_->parallelFor(n_batch, 1, task);
+    else
+      task(0, 0, n_batch);
+    n_done += n_batch;
+
+    for(const WorkerResult& r : results)
+    {
+      stats.n_rejected[model] += r.n_rejected;
+      n_tested_rejected += r.n_tested;
+      n_consistent_rejected += r.n_consistent;
+      if(r.best.score > best.score || (r.best.score == best.score && r.best.score >= 0.0 && r.best.id < best.id))
+        best = r.best;
+    }
+    if(best.score < 0.0)
+      continue;
+
+    // adapt the SPRT and the number of hypotheses to the best hypothesis
+    const double inlier_ratio = double(best.n_inliers)/n;
+    if(options_.use_sprt)
+    {
+      epsilon = std::min(std::max(inlier_ratio, 0.01), 0.99);
+      if(n_tested_rejected > 0)
+        delta = double(n_consistent_rejected)/n_tested_rejected;
+      delta = std::min(std::max(delta, 0.001), 0.5*epsilon);
+      sprt_A = sprtThreshold(epsilon, delta);
+    }
+    n_required = requiredIterations(
+          inlier_ratio, sample_size, sprt_A, options_.confidence, options_.max_iter);
+  }
+  stats.n_hypotheses[model] = n_done;
+  return best.score >= 0.0 && best.n_inliers >= sample_size;
+}
+
+void TwoViewRansac::errors(
+    const Model model,
+    const Matrix3d& M,
+    const Matrix3d& M_inv,
+    const size_t i,
+    double& e_ref2,
+    double& e_cur2) const
+{
+  const Vector3d x_ref(uv_ref_[i][0], uv_ref_[i][1], 1.0);
+  const Vector3d x_cur(uv_cur_[i][0], uv_cur_[i][1], 1.0);
+  if(model == HOMOGRAPHY)
+  {
+    // transfer error in both views
+    const Vector3d p_cur = M*x_ref;
+    const Vector3d p_ref = M_inv*x_cur;
+    e_cur2 = (p_cur.head<2>()/p_cur[2] - uv_cur_[i]).squaredNorm();
+    e_ref2 = (p_ref.head<2>()/p_ref[2] - uv_ref_[i]).squaredNorm();
+  }
+  else
+  {
+    // distance to the epipolar line in both views
+    const Vector3d l_cur = M*x_ref;
+    const Vector3d l_ref = M.transpose()*x_cur;
+    const double r = x_cur.dot(l_cur);
+    e_cur2 = r*r/(l_cur.head<2>().squaredNorm() + 1e-20);
+    e_ref2 = r*r/(l_ref.head<2>().squaredNorm() + 1e-20);
+  }
+  if(!std::isfinite(e_ref2) || !std::isfinite(e_cur2))
+    e_ref2 = e_cur2 = std::numeric_limits<double>::max();
+}
+
+bool TwoViewRansac::score(
+    const Model model,
+    const double threshold2,
+    const double sprt_A,
+    const double sprt_epsilon,
+    const double sprt_delta,
+    Hypothesis& h,
+    size_t& n_tested,
+    size_t& n_consistent) const
+{
+  const double inlier_threshold2 = (model == ESSENTIAL) ? threshold2*kEssentialThresholdRatio : threshold2;
+  const Matrix3d M_inv = (model == HOMOGRAPHY) ? Matrix3d(h.M.inverse()) : Matrix3d::Identity();
+  const double ratio_consistent = sprt_delta/sprt_epsilon;
+  const double ratio_inconsistent = (1.0-sprt_delta)/(1.0-sprt_epsilon);
+  const size_t n = uv_ref_.size();
+
+  // the points are verified from an offset that differs between hypotheses
+  size_t i = (h.id*2654435761u) % n;
+  double lambda = 1.0;
+  h.score = 0.0;
+  h.n_inliers = 0;
+  n_tested = n_consistent = 0;
+  for(size_t k=0; k<n; ++k, ++i)
+  {
+    if(i == n)
+      i = 0;
+    double e_ref2, e_cur2;
+    errors(model, h.M, M_inv, i, e_ref2, e_cur2);
+    bool consistent = true;
+    if(e_ref2 < inlier_threshold2)
+      h.score += threshold2-e_ref2;
+    else
+      consistent = false;
+    if(e_cur2 < inlier_threshold2)
+      h.score += threshold2-e_cur2;
+    else
+      consistent = false;
+    ++n_tested;
+    if(consistent)
+    {
+      ++h.n_inliers;
+      ++n_consistent;
+    }
+    if(sprt_A > 0.0)
+    {
+      lambda *= consistent ? ratio_consistent : ratio_inconsistent;
+      if(lambda > sprt_A)
+        return false;
+    }
+  }
+  return true;
+}
+
+void TwoViewRansac::collectInliers(
+    const Model model,
+    const Matrix3d& M,
+    const double threshold2,
+    std::vector<int>& inliers) const
+{
+  const double inlier_threshold2 = (model == ESSENTIAL) ? threshold2*kEssentialThresholdRatio : threshold2;
+  const Matrix3d M_inv = (model == HOMOGRAPHY) ? Matrix3d(M.inverse()) : Matrix3d::Identity();
+  inliers.clear();
+  for(size_t i=0; i<uv_ref_.size(); ++i)
+  {
+    double e_ref2, e_cur2;
+    errors(model, M, M_inv, i, e_ref2, e_cur2);
+    if(e_ref2 < inlier_threshold2 && e_cur2 < inlier_threshold2)
+      inliers.push_back(i);
+  }
+}
+
+void TwoViewRansac::refine(
+    const Model model,
+    const double threshold2,
+    Hypothesis& best) const
+{
+  std::vector<int> inliers;
+  for(int iter=0; iter<5; ++iter)
+  {
+    collectInliers(model, best.M, threshold2, inliers);
+    Hypothesis h = best;
+    const bool valid = (model == HOMOGRAPHY) ? fitHomography(uv_ref_, uv_cur_, inliers, h.M)
+                                             : fitEssential(uv_ref_, uv_cur_, inliers, h.M);
+    size_t n_tested, n_consistent;
+    if(!valid)
+      return;
+    score(model, threshold2, 0.0, 0.5, 0.25, h, n_tested, n_consistent);
+    if(h.score <= best.score)
+      return;
+    best = h;
+  }
+}
+
+bool TwoViewRansac::fitHomography(
+    const std::vector<Vector2d>& uv_ref,
+    const std::vector<Vector2d>& uv_cur,
+    const std::vector<int>& sample,
+    Matrix3d& H)
+{
+  if(sample.size() < 4)
+    return false;
+  const Matrix3d T_ref = normalization(uv_ref, sample);
+  const Matrix3d T_cur = normalization(uv_cur, sample);
+  Eigen::Matrix<double,9,9> AtA = Eigen::Matrix<double,9,9>::Zero();
+  Eigen::Matrix<double,2,9> A;
+  for(int i : sample)
+  {
+    const Vector3d p = T_ref*Vector3d(uv_ref[i][0], uv_ref[i][1], 1.0);
+    const Vector3d q = T_cur*Vector3d(uv_cur[i][0], uv_cur[i][1], 1.0);
+    A << 0.0, 0.0, 0.0, -p[0], -p[1], -1.0, q[1]*p[0], q[1]*p[1], q[1],
+         p[0], p[1], 1.0, 0.0, 0.0, 0.0, -q[0]*p[0], -q[0]*p[1], -q[0];
+    AtA.noalias() += A.transpose()*A;
+  }
+  const Eigen::Matrix<double,9,1> h = nullVector(AtA);
+  Matrix3d H_normalized;
+  H_normalized << h[0], h[1], h[2], h[3], h[4], h[5], h[6], h[7], h[8];
+  H = T_cur.inverse()*H_normalized*T_ref;
+  if(!H.allFinite() || std::fabs(H.determinant()) < 1e-12*std::pow(H.norm(), 3))
+    return false;
+  H /= std::cbrt(H.determinant());
+  return true;
+}
+
+bool TwoViewRansac::fitEssential(
+    const std::vector<Vector2d>& uv_ref,
+    const std::vector<Vector2d>& uv_cur,
+    const std::vector<int>& sample,
+    Matrix3d& E)
+{
+  if(sample.size() < 8)
+    return false;
+  const Matrix3d T_ref = normalization(uv_ref, sample);
+  const Matrix3d T_cur = normalization(uv_cur, sample);
+  Eigen::Matrix<double,9,9> AtA = Eigen::Matrix<double,9,9>::Zero();
+  Eigen::Matrix<double,1,9> a;
+  for(int i : sample)
+  {
+    const Vector3d p = T_ref*Vector3d(uv_ref[i][0], uv_ref[i][1], 1.0);
+    const Vector3d q = T_cur*Vector3d(uv_cur[i][0], uv_cur[i][1], 1.0);
+    a << q[0]*p[0], q[0]*p[1], q[0], q[1]*p[0], q[1]*p[1], q[1], p[0], p[1], 1.0;
+    AtA.noalias() += a.transpose()*a;
+  }
+  const Eigen::Matrix<double,9,1> e = nullVector(AtA);
+  Matrix3d E_normalized;
+  E_normalized << e[0], e[1], e[2], e[3], e[4], e[5], e[6], e[7], e[8];
+  E = T_cur.transpose()*E_normalized*T_ref;
+
+  // enforce rank two, the singular values are made equal in decomposeEssential,
+  // because doing so on minimal samples makes the hypotheses much worse
+  Eigen::JacobiSVD<Matrix3d> svd(E, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  E = svd.matrixU()*Vector3d(svd.singularValues()[0], svd.singularValues()[1], 0.0).asDiagonal()*svd.matrixV().transpose();
+  return E.allFinite();
+}
+
+void TwoViewRansac::decomposeEssential(const Matrix3d& E, std::vector<SE3d>& poses)
+{
+  Eigen::JacobiSVD<Matrix3d> svd(E, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  Matrix3d U = svd.matrixU();
+  Matrix3d V = svd.matrixV();
+  if(U.determinant() < 0.0)
+    U.col(2) *= -1.0;
+  if(V.determinant() < 0.0)
+    V.col(2) *= -1.0;
+  Matrix3d W;
+  W << 0.0, -1.0, 0.0,
+       1.0, 0.0, 0.0,
+       0.0, 0.0, 1.0;
+  const Matrix3d R1 = U*W*V.transpose();
+  const Matrix3d R2 = U*W.transpose()*V.transpose();
+  const Vector3d t = U.col(2);
+  poses.clear();
+  poses.push_back(SE3d(R1, t));
+  poses.push_back(SE3d(R1, -t));
+  poses.push_back(SE3d(R2, t));
+  poses.push_back(SE3d(R2, -t));
+}
+
+void TwoViewRansac::decomposeHomography(const Matrix3d& H, std::vector<SE3d>& poses)
+{
+  // Faugeras and Lustman, "Motion and structure from motion in a piecewise
+  // planar environment", 1988.
+  poses.clear();
+  Eigen::JacobiSVD<Matrix3d> svd(H, Eigen::ComputeFullU | Eigen::ComputeFullV);
+  const Matrix3d& U = svd.matrixU();
+  const Matrix3d& V = svd.matrixV();
+  const double s = U.determinant()*V.determinant();
+  const double d1 = svd.singularValues()[0];
+  const double d2 = svd.singularValues()[1];
+  const double d3 = svd.singularValues()[2];
+  if(d1/d2 < 1.00001 || d2/d3 < 1.00001)
+    return; // no translation or no unique plane
+
+  const double aux1 = std::sqrt((d1*d1-d2*d2)/(d1*d1-d3*d3));
+  const double aux3 = std::sqrt((d2*d2-d3*d3)/(d1*d1-d3*d3));
+  const double x1[] = {aux1, aux1, -aux1, -aux1};
+  const double x3[] = {aux3, -aux3, aux3, -aux3};
+
+  // d' = d2
+  const double aux_stheta = std::sqrt((d1*d1-d2*d2)*(d2*d2-d3*d3))/((d1+d3)*d2);
+  const double ctheta = (d2*d2+d1*d3)/((d1+d3)*d2);
+  const double stheta[] = {aux_stheta, -aux_stheta, -aux_stheta, aux_stheta};
+  for(int i=0; i<4; ++i)
+  {
+    Matrix3d Rp;
+    Rp << ctheta, 0.0, -stheta[i],
+          0.0, 1.0, 0.0,
+          stheta[i], 0.0, ctheta;
+    const Matrix3d R = s*U*Rp*V.transpose();
+    const Vector3d t = U*Vector3d(x1[i], 0.0, -x3[i])*(d1-d3);
+    poses.push_back(SE3d(R, t.normalized()));
+  }
+
+  // d' = -d2
+  const double aux_sphi = std::sqrt((d1*d1-d2*d2)*(d2*d2-d3*d3))/((d1-d3)*d2);
+  const double cphi = (d1*d3-d2*d2)/((d1-d3)*d2);
+  const double sphi[] = {aux_sphi, -aux_sphi, -aux_sphi, aux_sphi};
+  for(int i=0; i<4; ++i)
+  {
+    Matrix3d Rp;
+    Rp << cphi, 0.0, sphi[i],
+          0.0, -1.0, 0.0,
+          sphi[i], 0.0, -cphi;
+    const Matrix3d R = s*U*Rp*V.transpose();
+    const Vector3d t = U*Vector3d(x1[i], 0.0, x3[i])*(d1+d3);
+    poses.push_back(SE3d(R, t.normalized()));
+  }
+}
+
+bool TwoViewRansac::selectPose(
+    const std::vector<SE3d>& poses,
+    const std::vector<int>& inliers,
+    const double threshold2,
+    SE3d& T_cur_ref) const
+{
+  size_t n_best = 0;
+  for(const SE3d& T : poses)
+  {
+    const Matrix3d R = T.rotationMatrix();
+    const Vector3d t = T.translation();
+    size_t n_good = 0;
+    for(int i : inliers)
+    {
+      // midpoint triangulation in the current frame, x_cur = d_ref*R*f_ref + t = d_cur*f_cur
+      const Vector3d f_ref = R*Vector3d(uv_ref_[i][0], uv_ref_[i][1], 1.0);
+      const Vector3d f_cur(uv_cur_[i][0], uv_cur_[i][1], 1.0);
+      Matrix2d AtA;
+      AtA << f_ref.dot(f_ref), -f_ref.dot(f_cur),
+             -f_ref.dot(f_cur), f_cur.dot(f_cur);
+      const Vector2d Atb(-f_ref.dot(t), f_cur.dot(t));
+      if(std::fabs(AtA.determinant()) < 1e-12)
+        continue; // no parallax
+      const Vector2d d = AtA.inverse()*Atb;
+      if(d[0] <= 0.0 || d[1] <= 0.0)
+        continue;
+      const Vector3d xyz_cur = 0.5*(d[0]*f_ref + t + d[1]*f_cur);
+      const Vector3d xyz_ref = R.transpose()*(xyz_cur-t);
+      if(xyz_cur[2] <= 0.0 || xyz_ref[2] <= 0.0)
+        continue;
+      if((xyz_cur.head<2>()/xyz_cur[2] - uv_cur_[i]).squaredNorm() > 4.0*threshold2
+         || (xyz_ref.head<2>()/xyz_ref[2] - uv_ref_[i]).squaredNorm() > 4.0*threshold2)
+        continue;
+      ++n_good;
+    }
+    if(n_good > n_best)
+    {
+      n_best = n_good;
+      T_cur_ref = T;
+    }
+  }
+  return n_best > 0;
+}
+
+} // namespace svo
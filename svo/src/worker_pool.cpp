@@ -0,0 +1,107 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+#include <svo/worker_pool.h>
+
+namespace svo {
+
+WorkerPool::WorkerPool(size_t n_workers) :
+    task_(NULL),
+    n_items_(0),
+    grain_(1),
+    next_item_(0),
+    generation_(0),
+    n_busy_(0),
+    halt_(false)
+{
+  for(size_t i=1; i<std::max<size_t>(n_workers, 1); ++i)
+    threads_.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mut_);
+    halt_ = true;
+  }
+  start_cond_.notify_all();
+  for(std::thread& t : threads_)
+    t.join();
+}
+
+void WorkerPool::parallelFor(size_t n, size_t grain, const task_t& f)
+{
+  if(n == 0)
+    return;
+  grain = std::max<size_t>(grain, 1);
+  if(threads_.empty() || n <= grain)
+  {
+    f(0, 0, n);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mut_);
+    task_ = &f;
+    n_items_ = n;
+    grain_ = grain;
+    next_item_ = 0;
+    n_busy_ = threads_.size();
+    ++generation_;
+  }
+  start_cond_.notify_all();
+
+  runChunks(0);
+
+  std::unique_lock<std::mutex> lock(mut_);
+  done_cond_.wait(lock, [&] { return n_busy_ == 0; });
+  task_ = NULL;
+}
+
+void WorkerPool::runChunks(size_t worker_id)
+{
+  while(true)
+  {
+    const size_t begin = next_item_.fetch_add(grain_);
+    if(begin >= n_items_)
+      break;
+    (*task_)(worker_id, begin, std::min(begin+grain_, n_items_));
+  }
+}
+
+void WorkerPool::workerLoop(size_t worker_id)
+{
+  size_t last_generation = 0;
+  while(true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mut_);
+      start_cond_.wait(lock, [&] { return halt_ || generation_ != last_generation; });
+      if(halt_)
+        return;
+      last_generation = generation_;
+    }
+
+    runChunks(worker_id);
+
+    std::lock_guard<std::mutex> lock(mut_);
+    if(--n_busy_ == 0)
+      done_cond_.notify_one();
+  }
+}
+
+} // namespace svo
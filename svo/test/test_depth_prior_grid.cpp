@@ -0,0 +1,95 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vikit/pinhole_camera.h>
+#include <svo/depth_filter.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+void testLookup()
+{
+  svo::DepthPriorGrid grid;
+  grid.reset(640, 480, 32);
+  float mu, sigma2;
+  CHECK(!grid.lookup(Eigen::Vector2d(100, 100), 1, mu, sigma2));
+
+  // three points on a plane at 2m around the query, one far away
+  grid.insert(Eigen::Vector2d(70, 90), 0.5);
+  grid.insert(Eigen::Vector2d(110, 100), 0.5);
+  grid.insert(Eigen::Vector2d(125, 127), 0.5);
+  grid.insert(Eigen::Vector2d(300, 300), 0.1);
+  CHECK(!grid.lookup(Eigen::Vector2d(100, 100), 4, mu, sigma2));
+  CHECK(grid.lookup(Eigen::Vector2d(100, 100), 3, mu, sigma2));
+  CHECK(std::fabs(mu - 0.5) < 1e-6);
+  CHECK(std::fabs(sigma2 - 0.01*0.25) < 1e-6); // variance floor of 10% of the depth
+
+  // a point on another surface widens the prior
+  grid.insert(Eigen::Vector2d(90, 70), 0.1);
+  CHECK(grid.lookup(Eigen::Vector2d(100, 100), 3, mu, sigma2));
+  CHECK(std::fabs(mu - 0.4) < 1e-6);
+  CHECK(std::fabs(sigma2 - 4.0*0.03) < 1e-5);
+
+  // points outside the image are ignored, reset clears the cells
+  grid.insert(Eigen::Vector2d(-5, 10), 1.0);
+  grid.insert(Eigen::Vector2d(700, 10), 1.0);
+  CHECK(grid.lookup(Eigen::Vector2d(639, 479), 0, mu, sigma2) == false);
+  grid.reset(640, 480, 32);
+  CHECK(!grid.lookup(Eigen::Vector2d(100, 100), 1, mu, sigma2));
+}
+
+void testCollect()
+{
+  // the tracking thread collects the map points of the keyframe, the filter
+  // thread builds the grid from them without reading the map
+  vk::PinholeCamera cam(640, 480, 300.0, 300.0, 320.0, 240.0);
+  svo::Point point(Eigen::Vector3d(0.0, 0.0, 3.0));
+  svo::Frame frame(&cam, cv::Mat(480, 640, CV_8UC1, cv::Scalar(0)), 0.0);
+  frame.T_f_w_ = Sophus::SE3d(Eigen::Matrix3d::Identity(), Eigen::Vector3d(0.0, 0.0, 1.0));
+  const Eigen::Vector3d f(0.0, 0.0, 1.0);
+  frame.addFeature(new svo::Feature(&frame, &point, Eigen::Vector2d(320, 240), f, 0));
+  frame.addFeature(new svo::Feature(&frame, Eigen::Vector2d(100, 100), f, 0)); // no point
+
+  svo::DepthPriorGrid::Samples samples;
+  svo::DepthPriorGrid::collect(frame, samples);
+  CHECK(samples.size() == 1);
+  CHECK(samples[0].x == 320.0f && samples[0].y == 240.0f);
+  CHECK(std::fabs(samples[0].inv_depth - 0.25) < 1e-6);
+
+  svo::DepthPriorGrid grid;
+  grid.build(samples, 640, 480, 32);
+  float mu, sigma2;
+  CHECK(grid.lookup(Eigen::Vector2d(330, 250), 1, mu, sigma2));
+  CHECK(std::fabs(mu - 0.25) < 1e-6);
+  CHECK(!grid.lookup(Eigen::Vector2d(100, 100), 1, mu, sigma2));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testLookup();
+  testCollect();
+  printf("test_depth_prior_grid passed\n");
+  return 0;
+}
@@ -0,0 +1,102 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <svo/epoch_reclaimer.h>
+#include "test_utils.h"
+
+namespace {
+
+std::atomic<int> g_n_alive(0);
+
+struct Tracked
+{
+  int value;
+  Tracked(int v) : value(v) { ++g_n_alive; }
+  ~Tracked() { value = -1; --g_n_alive; }
+};
+
+void testPinnedReaderBlocksFree()
+{
+  svo::EpochReclaimer reclaimer;
+  Tracked* obj = new Tracked(1);
+  {
+    svo::EpochReclaimer::Guard guard(reclaimer);
+    reclaimer.retire(obj);
+    reclaimer.reclaim();
+    CHECK(g_n_alive == 1);   // reader pinned before retire may still see it
+    CHECK(obj->value == 1);
+  }
+  reclaimer.reclaim();
+  CHECK(g_n_alive == 0);
+  CHECK(reclaimer.nPending() == 0);
+}
+
+void testLaterReaderDoesNotBlock()
+{
+  svo::EpochReclaimer reclaimer;
+  reclaimer.retire(new Tracked(2));
+  reclaimer.reclaim(); // advances the epoch
+  svo::EpochReclaimer::Guard guard(reclaimer);
+  reclaimer.reclaim();
+  CHECK(g_n_alive == 0);
+}
+
+void testConcurrentReaders()
+{
+  // a writer swaps a shared object and retires the old one, readers
+  // dereference it inside a critical section while the background thread frees.
+  svo::EpochReclaimer reclaimer;
+  reclaimer.startThread();
+  std::atomic<Tracked*> shared(new Tracked(0));
+  std::atomic<bool> stop(false);
+  std::atomic<bool> failed(false);
+  std::vector<std::thread> readers;
+  for(int i=0; i<4; ++i)
+    readers.emplace_back([&] {
+      while(!stop)
+      {
+        svo::EpochReclaimer::Guard guard(reclaimer);
+        if(shared.load()->value < 0)
+          failed = true;
+      }
+    });
+  for(int i=1; i<20000; ++i)
+    reclaimer.retire(shared.exchange(new Tracked(i)));
+  stop = true;
+  for(auto& t : readers)
+    t.join();
+  reclaimer.stopThread();
+  reclaimer.reclaim();
+  CHECK(!failed);
+  CHECK(g_n_alive == 1);
+  delete shared.load();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testPinnedReaderBlocksFree();
+  testLaterReaderDoesNotBlock();
+  testConcurrentReaders();
+  printf("EpochReclaimer tests passed.\n");
+  return 0;
+}
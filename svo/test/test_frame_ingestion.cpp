@@ -0,0 +1,186 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <svo/frame_ingestion.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+typedef std::chrono::steady_clock clock_t;
+
+double now()
+{
+  return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/// Building the frames of both cameras and tracking them take 20ms each.
+struct Pipeline
+{
+  std::vector<double> built;            //!< Timestamps in the order they were built.
+  std::vector<double> tracked;
+  std::vector<FrameIngestion::FrameStats> outputs;
+  size_t n_cameras_built = 0;
+  FrameIngestion ingestion;
+
+  Pipeline() :
+    ingestion(
+      [this](size_t cam_index, int frame_id, const cv::Mat& img, double timestamp) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ++n_cameras_built;
+        if(cam_index == 1)
+          built.push_back(timestamp);
+        return FramePtr();
+      },
+      [this](const std::vector<FramePtr>& frames, double timestamp) {
+        CHECK(frames.size() == 2);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        tracked.push_back(timestamp);
+      },
+      [this](const FrameIngestion::FrameStats& stats) {
+        outputs.push_back(stats);
+      })
+  {}
+};
+
+std::vector<cv::Mat> images()
+{
+  return std::vector<cv::Mat>(2, cv::Mat(4, 4, CV_8UC1));
+}
+
+void testBlock()
+{
+  Pipeline p;
+  p.ingestion.options_.drop_policy = FrameIngestion::BLOCK;
+  CHECK(!p.ingestion.addImages(images(), 0.0)); // not running
+  p.ingestion.startThreads();
+  const clock_t::time_point t_start = clock_t::now();
+  const size_t n_frames = 10;
+  for(size_t i=0; i<n_frames; ++i)
+    CHECK(p.ingestion.addImages(images(), now()));
+  p.ingestion.flush();
+  const double elapsed_ms = std::chrono::duration<double, std::milli>(clock_t::now()-t_start).count();
+
+  // all frames in order, building overlaps with tracking
+  const FrameIngestion::Stats stats = p.ingestion.stats();
+  CHECK(stats.n_received == n_frames);
+  CHECK(stats.n_dropped == 0);
+  CHECK(stats.n_tracked == n_frames);
+  CHECK(p.tracked == p.built);
+  CHECK(p.outputs.size() == n_frames);
+  CHECK(elapsed_ms < 0.8*n_frames*40.0);
+  for(const FrameIngestion::FrameStats& s : p.outputs)
+  {
+    CHECK(s.pyramid_ms >= 19.0);
+    CHECK(s.tracking_ms >= 19.0);
+    CHECK(s.total_ms >= s.queue_ms+s.pyramid_ms+s.tracking_ms-1e-6);
+    CHECK(s.latency_ms >= s.total_ms-1.0 && s.latency_ms < elapsed_ms+10.0);
+  }
+  p.ingestion.stopThreads();
+  CHECK(!p.ingestion.addImages(images(), 0.0));
+}
+
+void testLatestWins()
+{
+  Pipeline p;
+  p.ingestion.options_.drop_policy = FrameIngestion::DROP_OLDEST;
+  p.ingestion.options_.queue_size = 1;
+  p.ingestion.startThreads();
+  const size_t n_frames = 20;
+  for(size_t i=0; i<n_frames; ++i)
+  {
+    CHECK(p.ingestion.addImages(images(), i));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  p.ingestion.flush();
+
+  // images that came in faster than they could be tracked were dropped,
+  // the last image is always tracked
+  const FrameIngestion::Stats stats = p.ingestion.stats();
+  CHECK(stats.n_received == n_frames);
+  CHECK(stats.n_dropped > 0);
+  CHECK(stats.n_tracked+stats.n_dropped == n_frames);
+  CHECK(p.tracked.size() == stats.n_tracked);
+  for(size_t i=1; i<p.tracked.size(); ++i)
+    CHECK(p.tracked[i] > p.tracked[i-1]);
+  CHECK(p.tracked.back() == n_frames-1);
+  CHECK(p.n_cameras_built == 2*stats.n_tracked);
+}
+
+void testParallelBuild()
+{
+  // the cameras are built concurrently, each one takes 10ms
+  std::atomic<size_t> n_cameras_built(0);
+  std::vector<FrameIngestion::FrameStats> outputs;
+  std::mutex ids_mut;
+  std::map<int, size_t> cam_of_id;
+  FrameIngestion ingestion(
+      [&](size_t cam_index, int frame_id, const cv::Mat& img, double timestamp) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        ++n_cameras_built;
+        std::lock_guard<std::mutex> lock(ids_mut);
+        CHECK(cam_of_id.insert(std::make_pair(frame_id, cam_index)).second);
+        return FramePtr();
+      },
+      [&](const std::vector<FramePtr>& frames, double timestamp) {
+        CHECK(frames.size() == 2);
+      },
+      [&](const FrameIngestion::FrameStats& stats) {
+        outputs.push_back(stats);
+      });
+  ingestion.options_.drop_policy = FrameIngestion::BLOCK;
+  ingestion.options_.n_threads = 2;
+  ingestion.startThreads();
+  const size_t n_frames = 5;
+  for(size_t i=0; i<n_frames; ++i)
+    CHECK(ingestion.addImages(images(), now()));
+  ingestion.flush();
+  CHECK(n_cameras_built == 2*n_frames);
+  CHECK(outputs.size() == n_frames);
+  for(const FrameIngestion::FrameStats& s : outputs)
+    CHECK(s.pyramid_ms >= 9.0 && s.pyramid_ms < 19.0);
+
+  // the ids of a bundle are consecutive in camera order
+  CHECK(cam_of_id.size() == 2*n_frames);
+  for(auto it=cam_of_id.begin(); it!=cam_of_id.end(); ++it)
+  {
+    auto right = std::next(it);
+    CHECK(it->second == 0 && right->second == 1 && right->first == it->first+1);
+    it = right;
+  }
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testBlock();
+  testLatestWins();
+  testParallelBuild();
+  printf("test_frame_ingestion passed\n");
+  return 0;
+}
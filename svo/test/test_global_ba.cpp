@@ -0,0 +1,202 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+#include <vikit/math_utils.h>
+#include <svo/global_ba.h>
+#include <svo/map_snapshot.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+typedef std::vector<SE3d, Eigen::aligned_allocator<SE3d>> Poses;
+
+/// Keyframes on a line look at points on a wall 4m away, each point is seen
+/// by five consecutive keyframes. All but the first two keyframes and all
+/// points start with an error.
+void setupSnapshot(const size_t n_kfs, MapSnapshot& map, Poses& T_f_w_true)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 1.0);
+
+  map.clear();
+  map.error_multiplier2_ = 300.0;
+  T_f_w_true.clear();
+  for(size_t i=0; i<n_kfs; ++i)
+  {
+    const SE3d T_w_f(Eigen::AngleAxisd(0.01*i, Vector3d::UnitY()).toRotationMatrix(),
+                     Vector3d(0.1*i, 0.02*i, 0.0));
+    T_f_w_true.push_back(T_w_f.inverse());
+    Eigen::Matrix<double,6,1> delta;
+    for(int k=0; k<6; ++k)
+      delta[k] = 0.005*noise(rng);
+    map.kfs_.push_back(MapSnapshot::Keyframe{
+        static_cast<int>(i), 0.1*i, (i < 2) ? T_f_w_true.back() : SE3d::exp(delta)*T_f_w_true.back()});
+  }
+  for(size_t i=0; i+5<=n_kfs; ++i)
+  {
+    const Vector3d center = T_f_w_true[i+2].inverse().translation();
+    for(int n=0; n<40; ++n)
+    {
+      const Vector3d pos = center + Vector3d(1.5*uniform(rng), 1.0*uniform(rng), 4.0+0.5*uniform(rng));
+      const uint32_t j = map.points_.size();
+      map.points_.push_back(MapSnapshot::Landmark{
+          static_cast<int>(j), pos + 0.02*Vector3d(noise(rng), noise(rng), noise(rng))});
+      for(size_t k=i; k<i+5; ++k)
+        map.obs_.push_back(MapSnapshot::Observation{
+            static_cast<uint32_t>(k), j, vk::project2d(T_f_w_true[k]*pos), 0});
+    }
+  }
+}
+
+double maxRotationError(const MapSnapshot& map, const Poses& T_f_w_true)
+{
+  double max_error = 0.0;
+  for(size_t i=0; i<map.kfs_.size(); ++i)
+    max_error = std::max(max_error, (map.kfs_[i].T_f_w.so3()*T_f_w_true[i].so3().inverse()).log().norm());
+  return max_error;
+}
+
+void testSaveLoad()
+{
+  MapSnapshot map, loaded;
+  Poses T_f_w_true;
+  setupSnapshot(10, map, T_f_w_true);
+  const std::string path = "/tmp/svo_test_map_snapshot.bin";
+  CHECK(map.save(path));
+  CHECK(loaded.load(path));
+  CHECK(loaded.error_multiplier2_ == map.error_multiplier2_);
+  CHECK(loaded.kfs_.size() == map.kfs_.size());
+  CHECK(loaded.points_.size() == map.points_.size());
+  CHECK(loaded.obs_.size() == map.obs_.size());
+  for(size_t i=0; i<map.kfs_.size(); ++i)
+  {
+    CHECK(loaded.kfs_[i].id == map.kfs_[i].id);
+    CHECK(loaded.kfs_[i].timestamp == map.kfs_[i].timestamp);
+    CHECK((loaded.kfs_[i].T_f_w.matrix()-map.kfs_[i].T_f_w.matrix()).norm() < 1e-12);
+  }
+  for(size_t j=0; j<map.points_.size(); ++j)
+    CHECK(loaded.points_[j].id == map.points_[j].id && loaded.points_[j].pos == map.points_[j].pos);
+  for(size_t k=0; k<map.obs_.size(); ++k)
+  {
+    CHECK(loaded.obs_[k].kf == map.obs_[k].kf && loaded.obs_[k].point == map.obs_[k].point);
+    CHECK(loaded.obs_[k].uv == map.obs_[k].uv && loaded.obs_[k].level == map.obs_[k].level);
+  }
+  CHECK(!loaded.load("/tmp/svo_test_map_snapshot_missing.bin"));
+  std::remove(path.c_str());
+}
+
+void testCorruptFile()
+{
+  MapSnapshot map, loaded;
+  Poses T_f_w_true;
+  setupSnapshot(10, map, T_f_w_true);
+  const std::string path = "/tmp/svo_test_map_snapshot_corrupt.bin";
+  CHECK(map.save(path));
+  std::string bytes;
+  {
+    std::ifstream ifs(path, std::ios::binary);
+    bytes.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  }
+  auto writeFile = [&](const std::string& data) {
+    std::ofstream ofs(path, std::ios::binary);
+    ofs.write(data.data(), data.size());
+  };
+
+  // the counts follow the magic and the focal length, a corrupt count must
+  // not be allocated
+  const size_t count_offset[3] = {16, 24, 32};
+  for(size_t c=0; c<3; ++c)
+  {
+    for(const uint64_t count : {uint64_t(1) << 60, ~uint64_t(0), uint64_t(1)})
+    {
+      std::string corrupt = bytes;
+      std::memcpy(&corrupt[count_offset[c]], &count, sizeof(count));
+      writeFile(corrupt);
+      CHECK(!loaded.load(path));
+      CHECK(loaded.kfs_.empty() && loaded.points_.empty() && loaded.obs_.empty());
+    }
+  }
+
+  // truncated files and trailing bytes
+  writeFile(bytes.substr(0, bytes.size()/2));
+  CHECK(!loaded.load(path) && loaded.kfs_.empty());
+  writeFile(bytes.substr(0, 20));
+  CHECK(!loaded.load(path));
+  writeFile(bytes + "x");
+  CHECK(!loaded.load(path));
+  writeFile(bytes);
+  CHECK(loaded.load(path) && loaded.obs_.size() == map.obs_.size());
+  std::remove(path.c_str());
+}
+
+void testBundleAdjustment()
+{
+  MapSnapshot map;
+  Poses T_f_w_true;
+  setupSnapshot(20, map, T_f_w_true);
+  GlobalBA ba;
+  ba.options_.n_threads = 3;
+  GlobalBA::Stats stats;
+  ba.optimize(map, stats);
+  CHECK(!stats.pose_graph);
+  CHECK(stats.n_kfs == 20 && stats.n_edges == map.obs_.size());
+  CHECK(stats.estimated_bytes <= ba.options_.max_bytes);
+  CHECK(stats.final_error < 1e-3 && stats.final_error < stats.init_error);
+  for(size_t i=0; i<map.kfs_.size(); ++i)
+    CHECK((map.kfs_[i].T_f_w.matrix()-T_f_w_true[i].matrix()).norm() < 1e-4);
+}
+
+void testPoseGraph()
+{
+  // the same problem does not fit a small budget
+  MapSnapshot map;
+  Poses T_f_w_true;
+  setupSnapshot(20, map, T_f_w_true);
+  const double init_rotation_error = maxRotationError(map, T_f_w_true);
+  GlobalBA ba;
+  ba.options_.n_threads = 3;
+  ba.options_.max_bytes = GlobalBA::estimateBytes(20, map.points_.size(), map.obs_.size(), 1) - 1;
+  GlobalBA::Stats stats;
+  ba.optimize(map, stats);
+  CHECK(stats.pose_graph);
+  CHECK(stats.n_edges >= 19);
+  CHECK(stats.final_error < 0.5*stats.init_error);
+  CHECK(maxRotationError(map, T_f_w_true) < 0.2*init_rotation_error);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testSaveLoad();
+  testCorruptFile();
+  testBundleAdjustment();
+  testPoseGraph();
+  printf("test_global_ba passed\n");
+  return 0;
+}
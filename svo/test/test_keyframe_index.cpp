@@ -0,0 +1,188 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <vikit/pinhole_camera.h>
+#include <svo/keyframe_index.h>
+#include <svo/frame.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+vk::PinholeCamera cam(640, 480, 300.0, 300.0, 320.0, 240.0);
+
+FramePtr createFrame(const Vector3d& pos)
+{
+  FramePtr frame(new Frame(&cam, cv::Mat(480, 640, CV_8UC1, cv::Scalar(0)), 0.0));
+  frame->T_f_w_ = SE3d(Matrix3d::Identity(), -pos);
+  return frame;
+}
+
+/// Keyframes sorted by distance to pos, ties in insertion order.
+std::vector<FramePtr> bruteForce(const std::vector<FramePtr>& kfs, const Vector3d& pos)
+{
+  std::vector<FramePtr> sorted(kfs);
+  std::stable_sort(sorted.begin(), sorted.end(), [&](const FramePtr& a, const FramePtr& b) {
+    return (a->pos()-pos).squaredNorm() < (b->pos()-pos).squaredNorm();
+  });
+  return sorted;
+}
+
+/// Compare all queries against a linear scan over the alive keyframes.
+void checkQueries(const KeyframeIndex& index, const std::vector<FramePtr>& kfs, std::mt19937& rng)
+{
+  std::uniform_real_distribution<double> uniform(-12.0, 12.0);
+  CHECK(index.size() == kfs.size());
+  for(const FramePtr& kf : kfs)
+    CHECK(index.find(kf->id_) == kf);
+  for(int q=0; q<50; ++q)
+  {
+    const Vector3d pos(uniform(rng), uniform(rng), 0.2*uniform(rng));
+    const std::vector<FramePtr> sorted = bruteForce(kfs, pos);
+
+    // furthest: the older keyframe wins ties
+    const double max_d2 = (sorted.back()->pos()-pos).squaredNorm();
+    FramePtr furthest;
+    for(const FramePtr& kf : kfs)
+      if((kf->pos()-pos).squaredNorm() == max_d2)
+      {
+        furthest = kf;
+        break;
+      }
+    CHECK(index.furthest(pos) == furthest);
+
+    std::vector<FramePtr> result;
+    for(size_t k : {size_t(1), size_t(5), kfs.size()+3})
+    {
+      index.nearest(pos, k, result);
+      CHECK(result.size() == std::min(k, kfs.size()));
+      for(size_t i=0; i<result.size(); ++i)
+        CHECK(result[i] == sorted[i]);
+    }
+
+    const double radius = 4.0;
+    index.withinRadius(pos, radius, result);
+    size_t n_inside = 0;
+    while(n_inside < sorted.size() && (sorted[n_inside]->pos()-pos).norm() <= radius)
+      ++n_inside;
+    CHECK(result.size() == n_inside);
+    for(size_t i=0; i<result.size(); ++i)
+      CHECK(result[i] == sorted[i]);
+  }
+}
+
+void testQueries()
+{
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<double> uniform(-10.0, 10.0);
+  KeyframeIndex index;
+  std::vector<FramePtr> kfs;
+  FramePtr none;
+  CHECK(index.furthest(Vector3d::Zero()) == none);
+
+  // a trajectory with some keyframes at the same position, such that ties occur
+  for(int i=0; i<200; ++i)
+  {
+    const Vector3d pos = (i % 10 == 9) ? kfs[i-5]->pos() : Vector3d(uniform(rng), uniform(rng), 0.1*uniform(rng));
+    kfs.push_back(createFrame(pos));
+    index.push_back(kfs.back());
+  }
+  checkQueries(index, kfs, rng);
+
+  // removed keyframes are not returned anymore, also after the tree was rebuilt
+  for(int round=0; round<2; ++round)
+  {
+    for(size_t i=0; i<kfs.size(); i+=2)
+      CHECK(index.erase(kfs[i]));
+    CHECK(!index.erase(kfs[0]));
+    std::vector<FramePtr> alive;
+    for(size_t i=1; i<kfs.size(); i+=2)
+      alive.push_back(kfs[i]);
+    kfs.swap(alive);
+    checkQueries(index, kfs, rng);
+  }
+
+  // the poses changed, e.g. after bundle adjustment
+  for(const FramePtr& kf : kfs)
+    kf->T_f_w_ = SE3d(Matrix3d::Identity(), -Vector3d(uniform(rng), uniform(rng), 0.1*uniform(rng)));
+  index.invalidatePositions();
+  checkQueries(index, kfs, rng);
+
+  // and inserted after the change
+  for(int i=0; i<20; ++i)
+  {
+    kfs.push_back(createFrame(Vector3d(uniform(rng), uniform(rng), 0.0)));
+    index.push_back(kfs.back());
+  }
+  checkQueries(index, kfs, rng);
+
+  index.clear();
+  CHECK(index.empty() && index.furthest(Vector3d::Zero()) == none);
+}
+
+void testConcurrentQueries()
+{
+  // queries do not modify the index, several threads may run them at once
+  std::mt19937 rng(5);
+  std::uniform_real_distribution<double> uniform(-10.0, 10.0);
+  KeyframeIndex index;
+  std::vector<FramePtr> kfs;
+  for(int i=0; i<100; ++i)
+  {
+    kfs.push_back(createFrame(Vector3d(uniform(rng), uniform(rng), 0.0)));
+    index.push_back(kfs.back());
+  }
+  for(size_t i=0; i<kfs.size(); i+=3)
+    index.erase(kfs[i]);
+  index.invalidatePositions();
+
+  const Vector3d pos(1.0, 2.0, 0.0);
+  std::vector<FramePtr> expected;
+  index.nearest(pos, 10, expected);
+  std::vector<std::thread> threads;
+  bool ok[4] = {true, true, true, true};
+  for(int t=0; t<4; ++t)
+    threads.emplace_back([&, t]{
+      std::vector<FramePtr> result;
+      for(int q=0; q<200; ++q)
+      {
+        index.nearest(pos, 10, result);
+        ok[t] = ok[t] && (result == expected) && (index.furthest(pos) != NULL);
+      }
+    });
+  for(std::thread& t : threads)
+    t.join();
+  for(int t=0; t<4; ++t)
+    CHECK(ok[t]);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testQueries();
+  testConcurrentQueries();
+  printf("KeyframeIndex tests passed.\n");
+  return 0;
+}
@@ -0,0 +1,147 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <svo/klt.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+/// Smooth, non-periodic texture of Gaussian blobs, shifted by (dx, dy).
+cv::Mat texture(const int width, const int height, const double dx, const double dy)
+{
+  std::vector<double> intensity(width*height, 128.0);
+  unsigned int seed = 1;
+  auto rand01 = [&seed]() { seed = seed*1103515245u+12345u; return ((seed>>8)&0xffff)/65535.0; };
+  for(int i=0; i<3000; ++i)
+  {
+    const double u = rand01()*width+dx;
+    const double v = rand01()*height+dy;
+    const double sigma = 2.0+rand01()*6.0;
+    const double amplitude = rand01()*120.0-60.0;
+    const int r = std::ceil(4.0*sigma);
+    for(int y=std::max(0, int(v)-r); y<std::min(height, int(v)+r+1); ++y)
+      for(int x=std::max(0, int(u)-r); x<std::min(width, int(u)+r+1); ++x)
+        intensity[y*width+x] += amplitude*std::exp(-0.5*((x-u)*(x-u)+(y-v)*(y-v))/(sigma*sigma));
+  }
+  cv::Mat img(height, width, CV_8UC1);
+  for(int y=0; y<height; ++y)
+    for(int x=0; x<width; ++x)
+      img.at<uint8_t>(y, x) = static_cast<uint8_t>(std::max(0.0, std::min(255.0, intensity[y*width+x]+0.5)));
+  return img;
+}
+
+/// Pyramid by averaging 2x2 pixels.
+ImgPyr pyramid(const cv::Mat& img, const int n_levels)
+{
+  ImgPyr pyr(1, img);
+  for(int l=1; l<n_levels; ++l)
+  {
+    const cv::Mat& prev = pyr.back();
+    cv::Mat half(prev.rows/2, prev.cols/2, CV_8UC1);
+    for(int y=0; y<half.rows; ++y)
+      for(int x=0; x<half.cols; ++x)
+        half.at<uint8_t>(y, x) = (prev.at<uint8_t>(2*y, 2*x) + prev.at<uint8_t>(2*y, 2*x+1)
+                                  + prev.at<uint8_t>(2*y+1, 2*x) + prev.at<uint8_t>(2*y+1, 2*x+1) + 2) / 4;
+    pyr.push_back(half);
+  }
+  return pyr;
+}
+
+void gridPoints(std::vector<cv::Point2f>& px)
+{
+  px.clear();
+  for(int y=120; y<=360; y+=40)
+    for(int x=160; x<=480; x+=40)
+      px.push_back(cv::Point2f(x, y));
+}
+
+void testShift(const double dx, const double dy, const double max_error)
+{
+  const ImgPyr pyr_ref = pyramid(texture(640, 480, 0.0, 0.0), 4);
+  const ImgPyr pyr_cur = pyramid(texture(640, 480, dx, dy), 4);
+  std::vector<cv::Point2f> px_ref, px_cur;
+  gridPoints(px_ref);
+  px_cur = px_ref;
+  std::vector<uint8_t> status;
+  klt::trackPoints(pyr_ref, pyr_cur, px_ref, px_cur, status);
+  CHECK(status.size() == px_ref.size());
+  size_t n_tracked = 0;
+  for(size_t i=0; i<px_ref.size(); ++i)
+  {
+    if(!status[i])
+      continue;
+    ++n_tracked;
+    CHECK(std::fabs(px_cur[i].x-px_ref[i].x-dx) < max_error);
+    CHECK(std::fabs(px_cur[i].y-px_ref[i].y-dy) < max_error);
+  }
+  CHECK(n_tracked > 0.9*px_ref.size());
+}
+
+void testInitialFlow()
+{
+  // a shift beyond the search range of a single level is found from the estimate
+  const ImgPyr pyr_ref = pyramid(texture(640, 480, 0.0, 0.0), 1);
+  const ImgPyr pyr_cur = pyramid(texture(640, 480, 40.4, -30.3), 1);
+  std::vector<cv::Point2f> px_ref, px_cur;
+  gridPoints(px_ref);
+  for(const cv::Point2f& px : px_ref)
+    px_cur.push_back(cv::Point2f(px.x+39.0f, px.y-29.0f));
+  std::vector<uint8_t> status;
+  klt::trackPoints(pyr_ref, pyr_cur, px_ref, px_cur, status);
+  size_t n_tracked = 0;
+  for(size_t i=0; i<px_ref.size(); ++i)
+  {
+    if(!status[i])
+      continue;
+    ++n_tracked;
+    CHECK(std::fabs(px_cur[i].x-px_ref[i].x-40.4) < 0.05);
+    CHECK(std::fabs(px_cur[i].y-px_ref[i].y+30.3) < 0.05);
+  }
+  CHECK(n_tracked > 0.9*px_ref.size());
+}
+
+void testLost()
+{
+  const ImgPyr pyr_tex = pyramid(texture(640, 480, 0.0, 0.0), 4);
+  const ImgPyr pyr_flat = pyramid(cv::Mat(480, 640, CV_8UC1, cv::Scalar(100)), 4);
+  std::vector<cv::Point2f> px_ref(1, cv::Point2f(5.0f, 240.0f)), px_cur(px_ref);
+  std::vector<uint8_t> status;
+  klt::trackPoints(pyr_tex, pyr_tex, px_ref, px_cur, status);
+  CHECK(!status[0]); // at the border
+
+  px_ref[0] = px_cur[0] = cv::Point2f(320.0f, 240.0f);
+  klt::trackPoints(pyr_flat, pyr_flat, px_ref, px_cur, status);
+  CHECK(!status[0]); // no texture
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testShift(2.3, -1.7, 0.05);
+  testShift(13.6, 9.2, 0.1);
+  testInitialFlow();
+  testLost();
+  printf("test_klt passed\n");
+  return 0;
+}
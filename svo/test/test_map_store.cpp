@@ -0,0 +1,166 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include <svo/map_store.h>
+#include "test_utils.h"
+
+namespace {
+
+struct Dummy { int id; };
+
+void testStaleHandles()
+{
+  svo::HandleStore<Dummy> store;
+  Dummy a{0}, b{1};
+  svo::Handle ha = store.insert(&a);
+  svo::Handle hb = store.insert(&b);
+  CHECK(store.get(ha) == &a);
+  CHECK(store.get(hb) == &b);
+  CHECK(store.size() == 2);
+
+  CHECK(store.erase(ha) == &a);
+  CHECK(store.get(ha) == NULL);
+  CHECK(store.erase(ha) == NULL); // erasing twice is a no-op
+
+  // the slot is not reused right away
+  Dummy c{2};
+  svo::Handle hc = store.insert(&c);
+  CHECK(hc.index() != ha.index());
+  CHECK(store.get(ha) == NULL);
+  CHECK(store.get(hc) == &c);
+  CHECK(!store.get(svo::Handle()));
+
+  // only the owner may erase its handle
+  CHECK(store.erase(hc, &a) == NULL);
+  CHECK(store.get(hc) == &c);
+  CHECK(store.erase(hc, &c) == &c);
+}
+
+void testDelayedReuse()
+{
+  typedef svo::HandleStore<Dummy> Store;
+  Store store;
+  Dummy a{0};
+  const svo::Handle h0 = store.insert(&a);
+  store.erase(h0);
+
+  // a slot is reused once every kMinFreeSlots erasures, hence its generation
+  // wraps only after about a million erasures
+  std::vector<svo::Handle> handles;
+  size_t n_reused = 0;
+  const size_t n_erasures = 100*Store::kMinFreeSlots;
+  for(size_t i=0; i<n_erasures; ++i)
+  {
+    svo::Handle h = store.insert(&a);
+    if(h.index() == h0.index())
+      ++n_reused;
+    CHECK(store.get(h0) == NULL);
+    handles.push_back(h);
+    if(handles.size() > 10)
+    {
+      store.erase(handles.front());
+      handles.erase(handles.begin());
+    }
+  }
+  CHECK(n_reused > 0 && n_reused <= n_erasures/Store::kMinFreeSlots);
+  CHECK(store.capacity() <= Store::kMinFreeSlots+12);
+
+  // the destructor of an object must not erase another object, which reuses
+  // its slot after the generation wrapped
+  Dummy b{1};
+  const svo::Handle hb = store.insert(&b);
+  const svo::Handle h_wrapped(hb.index(), hb.generation());
+  CHECK(store.erase(h_wrapped, &a) == NULL);
+  CHECK(store.get(hb) == &b);
+}
+
+void testCompact()
+{
+  typedef svo::HandleStore<Dummy> Store;
+  Store store;
+  std::vector<Dummy> objs(2*Store::kChunkSize);
+  std::vector<svo::Handle> handles;
+  for(size_t i=0; i<objs.size(); ++i)
+    handles.push_back(store.insert(&objs[i]));
+  for(size_t i=objs.size()-1; i>0; --i)
+    store.erase(handles[i]);
+
+  // a pinned reader may still look up handles in the released chunk
+  svo::EpochReclaimer reclaimer;
+  {
+    svo::EpochReclaimer::Guard guard(reclaimer);
+    store.compact(&reclaimer);
+    CHECK(reclaimer.nPending() == 1);
+    CHECK(store.get(handles.back()) == NULL);
+    CHECK(reclaimer.reclaim() == 0);
+  }
+  CHECK(reclaimer.reclaim() == 1);
+  CHECK(store.size() == 1);
+  CHECK(store.capacity() == Store::kMinFreeSlots+1); // the last freed slots still wait
+  CHECK(store.get(handles[0]) == &objs[0]);
+
+  // handles into the released chunk remain stale when it is allocated again
+  for(size_t i=1; i<objs.size(); ++i)
+    store.insert(&objs[i]);
+  for(size_t i=1; i<objs.size(); ++i)
+    CHECK(store.get(handles[i]) == NULL);
+
+  size_t n = 0;
+  store.forEach([&](svo::Handle, Dummy*) { ++n; });
+  CHECK(n == objs.size());
+}
+
+void testCompactDelaysReuse()
+{
+  // the map compacts the store after every frame, a slot freed during the
+  // frame must not be trimmed and handed out again right away
+  typedef svo::HandleStore<Dummy> Store;
+  Store store;
+  svo::EpochReclaimer reclaimer;
+  Dummy a{0};
+  std::vector<svo::Handle> stale;
+  std::vector<size_t> n_reused(Store::kMinFreeSlots+2, 0);
+  const size_t n_frames = 4*Store::kMinFreeSlots;
+  for(size_t i=0; i<n_frames; ++i)
+  {
+    const svo::Handle h = store.insert(&a);
+    CHECK(h.index() < n_reused.size());
+    ++n_reused[h.index()];
+    for(const svo::Handle& h_stale : stale)
+      CHECK(store.get(h_stale) == NULL);
+    store.erase(h);
+    stale.push_back(h);
+    store.compact(&reclaimer);
+    reclaimer.reclaim();
+  }
+  for(size_t n : n_reused)
+    CHECK(n <= n_frames/Store::kMinFreeSlots);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testStaleHandles();
+  testDelayedReuse();
+  testCompact();
+  testCompactDelaysReuse();
+  printf("HandleStore tests passed.\n");
+  return 0;
+}
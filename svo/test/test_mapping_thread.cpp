@@ -0,0 +1,211 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <set>
+#include <thread>
+#include <vector>
+#include <vikit/pinhole_camera.h>
+#include <svo/mapping_thread.h>
+#include <svo/sparse_ba.h>
+#include <svo/config.h>
+#include <svo/map.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+vk::PinholeCamera cam(640, 480, 300.0, 300.0, 320.0, 240.0);
+
+/// Four keyframes on a line look at points on a wall 4m away, every keyframe
+/// observes every point. The last two keyframes are the core keyframes, they
+/// and the points start with an error.
+struct Scene
+{
+  svo::Map map;
+  std::vector<FramePtr> kfs;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w_init;
+  std::vector<Point*> points;       //!< NULL if deleted by the test.
+  std::set<FramePtr> core_kfs;
+
+  Scene()
+  {
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 1.0);
+    std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w_true;
+    for(int i=0; i<4; ++i)
+    {
+      T_f_w_true.push_back(SE3d(Matrix3d::Identity(), Vector3d(-0.2*i, 0.0, 0.0)));
+      Eigen::Matrix<double,6,1> delta;
+      for(int k=0; k<6; ++k)
+        delta[k] = (i < 2) ? 0.0 : 0.005*noise(rng);
+      kfs.push_back(FramePtr(new Frame(&cam, cv::Mat(480, 640, CV_8UC1, cv::Scalar(0)), 0.1*i)));
+      kfs.back()->T_f_w_ = SE3d::exp(delta)*T_f_w_true.back();
+      T_f_w_init.push_back(kfs.back()->T_f_w_);
+      map.addKeyframe(kfs.back());
+      if(i >= 2)
+        core_kfs.insert(kfs.back());
+    }
+    for(int j=0; j<100; ++j)
+    {
+      const Vector3d pos(0.3+2.0*uniform(rng), 1.5*uniform(rng), 4.0+0.5*uniform(rng));
+      points.push_back(new Point(pos + 0.02*Vector3d(noise(rng), noise(rng), noise(rng))));
+      for(int i=0; i<4; ++i)
+      {
+        const Vector3d f = (T_f_w_true[i]*pos).normalized();
+        Feature* ftr = new Feature(kfs[i].get(), points.back(), cam.world2cam(f), f, 0);
+        kfs[i]->addFeature(ftr);
+        points.back()->addFrameRef(ftr);
+      }
+    }
+  }
+
+  ~Scene()
+  {
+    EpochReclaimer::Guard guard(map.reclaimer_);
+    for(Point* pt : points)
+      if(pt != NULL)
+        map.safeDeletePoint(pt);
+  }
+};
+
+void waitForMapping(const MappingThread& mapping)
+{
+  while(mapping.nPending() > 0)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+void testAsyncMatchesInline()
+{
+  Config::lobaNumIter() = 10;
+  Scene ref;
+  size_t n_incorrect_edges_1, n_incorrect_edges_2;
+  double init_error, final_error;
+  SparseBA ba;
+  ba.localBA(ref.kfs[3].get(), &ref.core_kfs, &ref.map,
+             n_incorrect_edges_1, n_incorrect_edges_2, init_error, final_error);
+  CHECK(n_incorrect_edges_2 == 0 && final_error < 0.01*init_error);
+
+  // the tracking thread sets up the problem and applies the result at a safe
+  // point, the mapping thread only optimizes
+  Scene scene;
+  MappingThread mapping;
+  mapping.options_.n_threads = 2;
+  mapping.startThread();
+  mapping.addKeyframe(scene.kfs[3].get(), &scene.core_kfs, &scene.map);
+  waitForMapping(mapping);
+  size_t n_incorrect_edges;
+  {
+    EpochReclaimer::Guard guard(scene.map.reclaimer_);
+    CHECK(mapping.applyResults(&scene.map, n_incorrect_edges, init_error, final_error) == 1);
+  }
+  CHECK(n_incorrect_edges == 0 && final_error < 0.01*init_error);
+  CHECK(mapping.applyResults(&scene.map, n_incorrect_edges, init_error, final_error) == 0);
+
+  // the points are added in a different order, the results agree up to rounding
+  for(size_t i=0; i<scene.kfs.size(); ++i)
+    CHECK((scene.kfs[i]->T_f_w_.matrix()-ref.kfs[i]->T_f_w_.matrix()).norm() < 1e-9);
+  for(size_t j=0; j<scene.points.size(); ++j)
+    CHECK((scene.points[j]->pos_-ref.points[j]->pos_).norm() < 1e-9);
+}
+
+void testConflicts()
+{
+  Config::lobaNumIter() = 10;
+  Scene ref;
+  size_t n_incorrect_edges_1, n_incorrect_edges_2;
+  double init_error, final_error;
+  SparseBA ba;
+  ba.localBA(ref.kfs[3].get(), &ref.core_kfs, &ref.map,
+             n_incorrect_edges_1, n_incorrect_edges_2, init_error, final_error);
+
+  Scene scene;
+  MappingThread mapping;
+  mapping.addKeyframe(scene.kfs[3].get(), &scene.core_kfs, &scene.map);
+
+  // the tracking thread changes the map before the result is applied
+  {
+    EpochReclaimer::Guard guard(scene.map.reclaimer_);
+    scene.map.safeDeletePoint(scene.points[0]);
+    scene.points[0] = NULL;
+  }
+  scene.map.safeDeleteFrame(scene.kfs[2]);
+  Eigen::Matrix<double,6,1> delta;
+  delta << 0.01, -0.02, 0.0, 0.001, 0.0, -0.002;
+  const SE3d T_moved = SE3d::exp(delta)*scene.kfs[3]->T_f_w_;
+  scene.kfs[3]->T_f_w_ = T_moved;
+
+  mapping.startThread();
+  waitForMapping(mapping);
+  size_t n_incorrect_edges;
+  {
+    EpochReclaimer::Guard guard(scene.map.reclaimer_);
+    CHECK(mapping.applyResults(&scene.map, n_incorrect_edges, init_error, final_error) == 1);
+  }
+
+  // the removed keyframe keeps its pose, the moved one gets the correction
+  // of the optimization and the deleted point is skipped
+  CHECK(scene.kfs[2]->T_f_w_.matrix() == scene.T_f_w_init[2].matrix());
+  const SE3d T_expected = ref.kfs[3]->T_f_w_ * ref.T_f_w_init[3].inverse() * T_moved;
+  CHECK((scene.kfs[3]->T_f_w_.matrix()-T_expected.matrix()).norm() < 1e-9);
+  for(size_t j=1; j<scene.points.size(); ++j)
+    CHECK((scene.points[j]->pos_-ref.points[j]->pos_).norm() < 1e-9);
+}
+
+void testReset()
+{
+  Config::lobaNumIter() = 10;
+  Scene scene;
+  MappingThread mapping;
+
+  // a new keyframe replaces the one which waits
+  mapping.addKeyframe(scene.kfs[2].get(), &scene.core_kfs, &scene.map);
+  mapping.addKeyframe(scene.kfs[3].get(), &scene.core_kfs, &scene.map);
+  CHECK(mapping.nPending() == 1);
+  mapping.reset();
+  CHECK(mapping.nPending() == 0);
+
+  // finished optimizations are discarded on reset
+  mapping.startThread();
+  mapping.addKeyframe(scene.kfs[3].get(), &scene.core_kfs, &scene.map);
+  waitForMapping(mapping);
+  mapping.reset();
+  size_t n_incorrect_edges;
+  double init_error, final_error;
+  CHECK(mapping.applyResults(&scene.map, n_incorrect_edges, init_error, final_error) == 0);
+  for(size_t i=0; i<scene.kfs.size(); ++i)
+    CHECK(scene.kfs[i]->T_f_w_.matrix() == scene.T_f_w_init[i].matrix());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testAsyncMatchesInline();
+  testConflicts();
+  testReset();
+  printf("Mapping thread tests passed.\n");
+  return 0;
+}
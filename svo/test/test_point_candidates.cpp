@@ -0,0 +1,188 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <vikit/pinhole_camera.h>
+#include <svo/map.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+vk::PinholeCamera cam(640, 480, 300.0, 300.0, 320.0, 240.0);
+
+FramePtr createFrame()
+{
+  return FramePtr(new Frame(&cam, cv::Mat(480, 640, CV_8UC1, cv::Scalar(0)), 0.0));
+}
+
+/// Converged seed of the keyframe, as created by the depth filter.
+Point* createCandidate(const FramePtr& kf, double x)
+{
+  Feature* ftr = new Feature(kf.get(), Vector2d(x, 240.0), 0);
+  Point* point = new Point(kf->f2w(ftr->f*2.0), ftr);
+  ftr->point = point;
+  return point;
+}
+
+void testBuckets()
+{
+  svo::Map map;
+  MapPointCandidates& candidates = map.point_candidates_;
+  FramePtr kf1 = createFrame();
+  FramePtr kf2 = createFrame();
+  map.addKeyframe(kf1);
+  map.addKeyframe(kf2);
+  std::vector<Point*> pts1, pts2;
+  for(int i=0; i<4; ++i)
+  {
+    pts1.push_back(createCandidate(kf1, 100.0+10*i));
+    candidates.newCandidatePoint(pts1.back(), 1.0);
+    pts2.push_back(createCandidate(kf2, 100.0+10*i));
+    candidates.newCandidatePoint(pts2.back(), 1.0);
+  }
+
+  // handed over points only show up after the queue is processed
+  CHECK(candidates.size() == 0);
+  CHECK(pts1[0]->type_ == Point::TYPE_CANDIDATE);
+  candidates.processHandoffQueue();
+  CHECK(candidates.size() == 8);
+  CHECK(candidates.buckets_.size() == 2);
+  const MapPointCandidates::Bucket& bucket1 = candidates.buckets_[kf1->id_];
+  CHECK(bucket1.size() == 4);
+  for(size_t i=0; i<4; ++i) // in the order of convergence
+    CHECK(bucket1[i].first == pts1[i] && bucket1[i].second == pts1[i]->obs_.front());
+
+  // the last candidate of the bucket takes the slot of a deleted one
+  CHECK(candidates.deleteCandidatePoint(pts1[1]));
+  CHECK(!candidates.deleteCandidatePoint(pts1[1]));
+  CHECK(candidates.size() == 7);
+  CHECK(bucket1.size() == 3 && bucket1[1].first == pts1[3]);
+  CHECK(candidates.deleteCandidatePoint(pts1[3]));
+  CHECK(bucket1.size() == 2 && bucket1[0].first == pts1[0] && bucket1[1].first == pts1[2]);
+
+  // a bucket is removed with its keyframe
+  candidates.removeFrameCandidates(kf1);
+  CHECK(candidates.size() == 4);
+  CHECK(candidates.buckets_.count(kf1->id_) == 0);
+  CHECK(!candidates.deleteCandidatePoint(pts1[0]));
+
+  // the candidates of a new keyframe become its features
+  candidates.addCandidatePointToFrame(kf2);
+  CHECK(candidates.size() == 0);
+  CHECK(candidates.buckets_.empty());
+  CHECK(kf2->fts_.size() == 4);
+  for(size_t i=0; i<4; ++i)
+  {
+    CHECK(kf2->fts_[i]->point == pts2[i]);
+    CHECK(pts2[i]->type_ == Point::TYPE_UNKNOWN);
+    CHECK(!candidates.deleteCandidatePoint(pts2[i]));
+  }
+}
+
+void testConcurrentHandoff()
+{
+  // the depth-filter thread hands over points while the tracker takes them
+  svo::Map map;
+  MapPointCandidates& candidates = map.point_candidates_;
+  std::vector<FramePtr> kfs;
+  for(int i=0; i<4; ++i)
+  {
+    kfs.push_back(createFrame());
+    map.addKeyframe(kfs.back());
+  }
+  const size_t n_points = 4000;
+  std::vector<Point*> pts(n_points);
+  for(size_t i=0; i<n_points; ++i)
+    pts[i] = createCandidate(kfs[i%kfs.size()], 100.0+(i%400));
+
+  std::thread producer([&]{
+    for(size_t i=0; i<n_points; ++i)
+      candidates.newCandidatePoint(pts[i], 1.0);
+  });
+  size_t n_deleted = 0;
+  while(candidates.size()+n_deleted < n_points)
+  {
+    candidates.processHandoffQueue();
+    // delete some of them, the tracker does so if they fail to reproject
+    for(auto& bucket : candidates.buckets_)
+      if(bucket.second.size() > 100 && candidates.deleteCandidatePoint(bucket.second[50].first))
+        ++n_deleted;
+  }
+  producer.join();
+  candidates.processHandoffQueue();
+  CHECK(candidates.size()+n_deleted == n_points);
+
+  // every point is in the bucket of its keyframe
+  size_t n = 0;
+  for(size_t k=0; k<kfs.size(); ++k)
+  {
+    const MapPointCandidates::Bucket& bucket = candidates.buckets_[kfs[k]->id_];
+    n += bucket.size();
+    for(const MapPointCandidates::PointCandidate& c : bucket)
+      CHECK(c.second->frame == kfs[k].get() && c.first->obs_.front() == c.second);
+  }
+  CHECK(n == candidates.size());
+
+  candidates.reset();
+  CHECK(candidates.size() == 0 && candidates.buckets_.empty());
+}
+
+void testRemovedKeyframe()
+{
+  svo::Map map;
+  MapPointCandidates& candidates = map.point_candidates_;
+  FramePtr kf = createFrame();
+  map.addKeyframe(kf);
+  candidates.newCandidatePoint(createCandidate(kf, 100.0), 1.0);
+  map.safeDeleteFrame(kf);
+  CHECK(candidates.size() == 0);
+
+  // a seed of the keyframe converges before the depth-filter removes its
+  // seeds and releases the keyframe, the candidate must not be accepted
+  candidates.newCandidatePoint(createCandidate(kf, 110.0), 1.0);
+  std::weak_ptr<Frame> removed_kf = kf;
+  kf.reset();
+  CHECK(removed_kf.expired());
+  candidates.processHandoffQueue();
+  CHECK(candidates.size() == 0 && candidates.buckets_.empty());
+
+  // candidates of the keyframes in the map are accepted
+  FramePtr kf2 = createFrame();
+  map.addKeyframe(kf2);
+  candidates.newCandidatePoint(createCandidate(kf2, 100.0), 1.0);
+  candidates.processHandoffQueue();
+  CHECK(candidates.size() == 1 && candidates.buckets_.count(kf2->id_) == 1);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testBuckets();
+  testConcurrentHandoff();
+  testRemovedKeyframe();
+  printf("MapPointCandidates tests passed.\n");
+  return 0;
+}
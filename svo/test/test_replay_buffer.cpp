@@ -0,0 +1,88 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <opencv2/opencv.hpp>
+#include <svo/replay_buffer.h>
+#include "test_utils.h"
+
+namespace {
+
+svo::ImgPyr makePyramid(int width, int height, uint8_t value)
+{
+  svo::ImgPyr pyr;
+  for(int l=0; l<4; ++l)
+    pyr.push_back(cv::Mat((height>>l), (width>>l), CV_8UC1, cv::Scalar(value+l)));
+  return pyr;
+}
+
+void testHistoryLength()
+{
+  svo::ReplayBuffer buffer;
+  buffer.options_.max_frames = 3;
+  buffer.options_.n_levels = 2;
+  for(int i=0; i<5; ++i)
+    CHECK(buffer.push(i, NULL, Sophus::SE3d(), makePyramid(64, 32, 10*i)));
+  CHECK(buffer.records().size() == 3);
+  CHECK(buffer.records().front()->id_ == 2);
+  CHECK(buffer.records().back()->id_ == 4);
+
+  // only the requested levels are copied, the blocks of dropped records are reused
+  const svo::ReplayFramePtr& r = buffer.records().back();
+  CHECK(r->pyramid_.size() == 2);
+  CHECK(r->pyramid_[1].cols == 32 && r->pyramid_[1].rows == 16);
+  CHECK(r->pyramid_[0].at<uint8_t>(5, 7) == 40);
+  CHECK(r->pyramid_[1].at<uint8_t>(5, 7) == 41);
+  CHECK(buffer.allocatedBytes() == 3*(64*32+32*16));
+}
+
+void testByteBudget()
+{
+  svo::ReplayBuffer buffer;
+  buffer.options_.max_frames = 10;
+  buffer.options_.n_levels = 1;
+  buffer.options_.max_bytes = 2*64*32;
+  CHECK(buffer.push(0, NULL, Sophus::SE3d(), makePyramid(64, 32, 0)));
+  CHECK(buffer.push(1, NULL, Sophus::SE3d(), makePyramid(64, 32, 0)));
+
+  // a record which is still used keeps its block, the budget drops the others
+  svo::ReplayFramePtr in_use = buffer.records().front();
+  CHECK(buffer.push(2, NULL, Sophus::SE3d(), makePyramid(64, 32, 0)));
+  CHECK(buffer.records().size() == 1);
+
+  // no block can be freed while both are in use, the frame is not recorded
+  svo::ReplayFramePtr in_use_2 = buffer.records().front();
+  CHECK(!buffer.push(3, NULL, Sophus::SE3d(), makePyramid(64, 32, 0)));
+  CHECK(buffer.nDropped() == 1);
+  CHECK(buffer.records().empty());
+  CHECK(in_use->id_ == 0 && in_use->pyramid_[0].at<uint8_t>(0, 0) == 0);
+
+  in_use.reset();
+  CHECK(buffer.push(4, NULL, Sophus::SE3d(), makePyramid(64, 32, 0)));
+  CHECK(buffer.allocatedBytes() == 2*64*32);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testHistoryLength();
+  testByteBudget();
+  printf("test_replay_buffer passed\n");
+  return 0;
+}
@@ -0,0 +1,222 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <vector>
+#include <vikit/pinhole_camera.h>
+#include <svo/reprojector.h>
+#include <svo/map.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+vk::PinholeCamera cam(640, 480, 300.0, 300.0, 320.0, 240.0);
+
+FramePtr createFrame(double x)
+{
+  FramePtr frame(new Frame(&cam, cv::Mat(480, 640, CV_8UC1, cv::Scalar(0)), 0.0));
+  frame->T_f_w_ = SE3d(Matrix3d::Identity(), Vector3d(-x, 0.0, 0.0));
+  return frame;
+}
+
+/// One keyframe observes a wall of points 4m away, one point per grid cell.
+/// There is a candidate in the field of view and one outside. The keyframe
+/// is either at the origin or behind the wall looking back, then no point
+/// has a close observation for the direct matcher and all matches fail.
+struct Scene
+{
+  svo::Map map;
+  FramePtr kf;
+  std::vector<Point*> points;       //!< NULL if deleted.
+  std::vector<PointRef> candidates; //!< In the field of view, outside.
+
+  Scene(bool kf_behind)
+  {
+    kf = createFrame(0.0);
+    if(kf_behind)
+    {
+      const Matrix3d R = Vector3d(-1.0, 1.0, -1.0).asDiagonal();
+      kf->T_f_w_ = SE3d(R, Vector3d(0.0, 0.0, 8.0));
+    }
+    for(int i=0; i<6; ++i)
+    {
+      for(int j=0; j<5; ++j)
+      {
+        const Vector3d pos(-2.0+0.8*i, -1.5+0.75*j, 4.0);
+        points.push_back(new Point(pos));
+        const Vector3d f = (kf->T_f_w_*pos).normalized();
+        Feature* ftr = new Feature(kf.get(), points.back(), cam.world2cam(f), f, 0);
+        kf->addFeature(ftr);
+        points.back()->addFrameRef(ftr);
+      }
+    }
+    kf->setKeyframe();
+    map.addKeyframe(kf);
+
+    // converged seeds of the keyframe
+    const Vector3d pos_candidates[2] = { Vector3d(0.1, 0.1, 3.0), Vector3d(20.0, 0.0, 4.0) };
+    for(const Vector3d& pos : pos_candidates)
+    {
+      const Vector3d f = (kf->T_f_w_*pos).normalized();
+      Feature* ftr = new Feature(kf.get(), cam.world2cam(f), f, 0);
+      Point* point = new Point(pos, ftr);
+      ftr->point = point;
+      map.point_candidates_.newCandidatePoint(point, 1.0);
+      candidates.push_back(point);
+    }
+  }
+
+  ~Scene()
+  {
+    EpochReclaimer::Guard guard(map.reclaimer_);
+    for(Point* pt : points)
+      if(pt != NULL)
+        map.safeDeletePoint(pt);
+  }
+
+  /// Index of the point, candidates follow the points.
+  int index(const Point* pt) const
+  {
+    for(size_t i=0; i<points.size(); ++i)
+      if(points[i] == pt)
+        return i;
+    for(size_t i=0; i<candidates.size(); ++i)
+      if(candidates[i].get() == pt)
+        return points.size()+i;
+    return -1;
+  }
+
+  /// All points and candidates with their counters, -1 if deleted.
+  std::vector<std::tuple<int, int, int>> state() const
+  {
+    std::vector<std::tuple<int, int, int>> s;
+    for(Point* pt : points)
+      s.push_back(pt == NULL ? std::make_tuple(-1, -1, -1)
+                             : std::make_tuple(int(pt->type_), pt->n_failed_reproj_, pt->n_succeeded_reproj_));
+    for(const PointRef& c : candidates)
+      s.push_back(c.get() == NULL ? std::make_tuple(-1, -1, -1)
+                                  : std::make_tuple(int(c->type_), c->n_failed_reproj_, c->n_succeeded_reproj_));
+    return s;
+  }
+};
+
+/// The matched points and their positions, in a fixed order.
+std::vector<std::tuple<int, double, double>> matches(const Scene& scene, const FramePtr& frame)
+{
+  std::vector<std::tuple<int, double, double>> m;
+  for(const auto& ftr : frame->fts_)
+    m.push_back(std::make_tuple(scene.index(ftr->point), ftr->px[0], ftr->px[1]));
+  std::sort(m.begin(), m.end());
+  return m;
+}
+
+void testSplitMatchesReprojectMap()
+{
+  Scene ref(false), scene(false);
+  Reprojector ref_reprojector(&cam, ref.map);
+  Reprojector reprojector(&cam, scene.map);
+  ref_reprojector.options_.find_match_direct = false;
+  reprojector.options_.find_match_direct = false;
+  for(int k=0; k<12; ++k)
+  {
+    FramePtr ref_frame = createFrame(0.02*k);
+    FramePtr frame = createFrame(0.02*k);
+    std::vector< std::pair<FramePtr,std::size_t> > ref_overlap_kfs, overlap_kfs;
+    {
+      EpochReclaimer::Guard guard(ref.map.reclaimer_);
+      ref_reprojector.reprojectMap(ref_frame, ref_overlap_kfs);
+    }
+    {
+      EpochReclaimer::Guard guard(scene.map.reclaimer_);
+      reprojector.prepare();
+      reprojector.project(frame, overlap_kfs);
+      reprojector.commit();
+    }
+
+    CHECK(reprojector.n_matches_ == ref_reprojector.n_matches_);
+    CHECK(reprojector.n_trials_ == ref_reprojector.n_trials_);
+    CHECK(overlap_kfs.size() == 1 && ref_overlap_kfs.size() == 1);
+    CHECK(overlap_kfs[0].second == ref_overlap_kfs[0].second);
+    CHECK(matches(scene, frame) == matches(ref, ref_frame));
+    CHECK(scene.state() == ref.state());
+    CHECK(scene.map.point_candidates_.size() == ref.map.point_candidates_.size());
+  }
+
+  // every point matched in every frame, the candidate outside of the field of
+  // view failed too often
+  CHECK(reprojector.n_matches_ == scene.points.size()+1);
+  for(Point* pt : scene.points)
+    CHECK(pt->type_ == Point::TYPE_GOOD && pt->n_succeeded_reproj_ == 12);
+  CHECK(scene.candidates[0]->n_succeeded_reproj_ == 12);
+  CHECK(scene.candidates[1].get() == NULL);
+  CHECK(scene.map.point_candidates_.size() == 1);
+}
+
+void testCommitSkipsDeletedPoints()
+{
+  // two cameras see the same points, all matches fail
+  Scene scene(true);
+  Reprojector reprojector_left(&cam, scene.map);
+  Reprojector reprojector_right(&cam, scene.map);
+  Point* unknown = scene.points[0];
+  const int unknown_id = unknown->id_;
+  const PointRef unknown_ref(unknown);
+  unknown->n_failed_reproj_ = 15;
+  scene.map.point_candidates_.processHandoffQueue();
+  scene.candidates[1]->n_failed_reproj_ = 28;
+
+  FramePtr frame_left = createFrame(0.0);
+  FramePtr frame_right = createFrame(0.1);
+  std::vector< std::pair<FramePtr,std::size_t> > overlap_kfs_left, overlap_kfs_right;
+  EpochReclaimer::Guard guard(scene.map.reclaimer_);
+  reprojector_left.prepare();
+  reprojector_left.project(frame_left, overlap_kfs_left);
+  reprojector_right.project(frame_right, overlap_kfs_right);
+  CHECK(reprojector_left.n_matches_ == 0 && reprojector_right.n_matches_ == 0);
+  CHECK(reprojector_left.n_trials_ == scene.points.size()+1);
+  CHECK(reprojector_right.n_trials_ == scene.points.size()+1);
+
+  // the commit of the left camera deletes both points, the right one skips them
+  reprojector_left.commit();
+  CHECK(unknown_ref.get() == NULL);
+  CHECK(scene.candidates[1].get() == NULL);
+  scene.points[0] = NULL;
+  reprojector_right.commit();
+  CHECK(scene.map.deleted_point_ids_ == std::vector<int>(1, unknown_id));
+  CHECK(scene.map.point_candidates_.size() == 1);
+  CHECK(scene.candidates[0]->n_failed_reproj_ == 2);
+  for(size_t i=1; i<scene.points.size(); ++i)
+    CHECK(scene.points[i]->n_failed_reproj_ == 2 && scene.points[i]->type_ == Point::TYPE_UNKNOWN);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testSplitMatchesReprojectMap();
+  testCommitSkipsDeletedPoints();
+  printf("Reprojector tests passed.\n");
+  return 0;
+}
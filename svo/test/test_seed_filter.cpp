@@ -0,0 +1,544 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <vikit/pinhole_camera.h>
+#include <svo/depth_filter.h>
+#include <svo/map.h>
+#include <svo/frame.h>
+#include <svo/point.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+vk::PinholeCamera cam(640, 480, 300.0, 300.0, 320.0, 240.0);
+const double kPlaneDepth = 2.0;
+
+/// Frame at position x on the x-axis, looking along the z-axis.
+FramePtr createFrame(double x)
+{
+  FramePtr frame(new Frame(&cam, cv::Mat(480, 640, CV_8UC1, cv::Scalar(0)), 0.0));
+  frame->T_f_w_ = SE3d(Matrix3d::Identity(), Vector3d(-x, 0.0, 0.0));
+  return frame;
+}
+
+/// Points handed over by the filter, deleted with their feature.
+struct ConvergedPoints
+{
+  std::vector<Point*> points;
+  DepthFilter::callback_t callback() { return [this](Point* point, double){ points.push_back(point); }; }
+  ~ConvergedPoints()
+  {
+    for(Point* point : points)
+    {
+      delete point->obs_.front();
+      delete point;
+    }
+  }
+};
+
+/// Depth filter which measures the seeds on a plane in front of the keyframe
+/// instead of searching the epipolar line in the images. It has no feature
+/// detector, the seeds are added directly.
+class SyntheticDepthFilter : public DepthFilter
+{
+public:
+  int measure_cost_us;  //!< Time a measurement takes.
+  bool nan_bounds;      //!< Some measurements have a NaN lower bound of the inverse depth.
+
+  SyntheticDepthFilter(callback_t seed_converged_cb, int n_threads) :
+    DepthFilter(std::shared_ptr<vilib::DetectorBaseGPU>(), seed_converged_cb),
+    measure_cost_us(0),
+    nan_bounds(false)
+  {
+    options_.n_threads = n_threads;
+  }
+
+  /// Add a batch of seeds in the keyframe, as initializeSeeds() does with the
+  /// detected features.
+  void addSeeds(const FramePtr& kf, int n_seeds)
+  {
+    lock_t lock(seeds_mut_);
+    ++SeedBatch::counter;
+    seed_batches_.emplace_back();
+    SeedBatch& batch = seed_batches_.back();
+    batch.id = SeedBatch::counter;
+    batch.frame = kf;
+    for(int i=0; i<n_seeds; ++i)
+    {
+      const Vector2d px(200.0 + (i%40)*6.0, 160.0 + (i/40)*6.0);
+      batch.seeds.add(std::unique_ptr<Feature>(new Feature(kf.get(), px, 0)), kPlaneDepth, 0.5*kPlaneDepth, n_frames_);
+    }
+    publishSeedCount();
+  }
+
+  /// Number of seeds read while the filter holds the seeds, as the tracking
+  /// thread does while the filter updates them.
+  size_t nSeedsWhileLocked()
+  {
+    lock_t lock(seeds_mut_);
+    return nSeeds();
+  }
+
+  using DepthFilter::addReplayTask;
+  using DepthFilter::replaySeedsStep;
+  using DepthFilter::removeSeeds;
+
+  /// Update only the seeds of the keyframe with the frame.
+  void updateKeyframeSeeds(const ReplayFrame& frame, const FramePtr& kf) { updateSeeds(frame, kf); }
+
+  /// Frames of the newest replay task which are not replayed yet.
+  size_t nPendingReplayFrames() const
+  {
+    return replay_tasks_.empty() ? 0 : replay_tasks_.front().frames.size()-replay_tasks_.front().next_frame;
+  }
+
+  /// Priorities of the seeds which were measured and of the ones which were
+  /// skipped in the last update.
+  void getPriorities(std::vector<double>& measured, std::vector<double>& skipped) const
+  {
+    for(const SeedUpdate& u : seed_updates_)
+    {
+      if(u.status == SeedUpdate::SCHEDULED)
+        skipped.push_back(u.priority);
+      else if(u.status != SeedUpdate::INVISIBLE)
+        measured.push_back(u.priority);
+    }
+  }
+
+  /// Number of different seeds which were measured so far.
+  size_t nMeasuredSeeds() const
+  {
+    std::lock_guard<std::mutex> lock(measured_mut_);
+    return measured_.size();
+  }
+
+protected:
+  mutable std::mutex measured_mut_;
+  mutable std::set<const Feature*> measured_;
+
+  virtual void measureSeed(
+      const ReplayFrame& frame,
+      const SE3d& T_ref_cur,
+      Matcher& matcher,
+      const Vector2d& px_error,
+      const SeedStore& seeds,
+      size_t i,
+      SeedUpdate& update) const
+  {
+    if(measure_cost_us > 0)
+      std::this_thread::sleep_for(std::chrono::microseconds(measure_cost_us));
+    {
+      std::lock_guard<std::mutex> lock(measured_mut_);
+      measured_.insert(seeds.ftr[i].get());
+    }
+
+    // some searches fail, the others have a small error. Both depend only on
+    // the pixel and the frame, not on the order of the measurements.
+    const Feature& ftr = *seeds.ftr[i];
+    const double h = sin(ftr.px[0]*12.9898 + ftr.px[1]*78.233 + frame.id_*2.7);
+    if(h > 0.9)
+    {
+      update.status = SeedUpdate::NO_MATCH;
+      return;
+    }
+    const double z = kPlaneDepth/ftr.f.z()*(1.0 + 0.01*h);
+    const double tau = computeTau(T_ref_cur.translation(), ftr.f, z, px_error[0], px_error[1]);
+    const double tau_inverse = 0.5 * (1.0/std::max(0.0000001, z-tau) - 1.0/(z+tau));
+    update.status = SeedUpdate::MEASURED;
+    update.px_cur = frame.f2c(T_ref_cur.inverse()*(ftr.f*z));
+    update.x = 1.0/z;
+    update.tau2 = tau_inverse*tau_inverse;
+    update.z_inv_min_nan = nan_bounds && h < -0.95;
+  }
+};
+
+/// States of the seeds in order and the converged points, of all keyframes
+/// or only of kf.
+struct FilterState
+{
+  std::vector<float> mu, sigma2, a, b;
+  std::vector<uint16_t> n_failed;
+  std::vector<Vector3d> converged;
+
+  FilterState(SyntheticDepthFilter& filter, const ConvergedPoints& converged_points, const Frame* kf = NULL)
+  {
+    for(const SeedBatch& batch : filter.getSeeds())
+    {
+      if(kf != NULL && batch.frame.get() != kf)
+        continue;
+      const SeedStore& seeds = batch.seeds;
+      mu.insert(mu.end(), seeds.mu.begin(), seeds.mu.end());
+      sigma2.insert(sigma2.end(), seeds.sigma2.begin(), seeds.sigma2.end());
+      a.insert(a.end(), seeds.a.begin(), seeds.a.end());
+      b.insert(b.end(), seeds.b.begin(), seeds.b.end());
+      n_failed.insert(n_failed.end(), seeds.n_failed.begin(), seeds.n_failed.end());
+    }
+    for(const Point* point : converged_points.points)
+      if(kf == NULL || point->obs_.front()->frame == kf)
+        converged.push_back(point->pos_);
+    // the order of convergence within a frame depends on the replay steps
+    std::sort(converged.begin(), converged.end(), [](const Vector3d& lhs, const Vector3d& rhs) {
+      return std::lexicographical_compare(lhs.data(), lhs.data()+3, rhs.data(), rhs.data()+3);
+    });
+  }
+
+  bool operator==(const FilterState& other) const
+  {
+    return mu == other.mu && sigma2 == other.sigma2 && a == other.a && b == other.b
+        && n_failed == other.n_failed && converged == other.converged;
+  }
+};
+
+void testParallelUpdate()
+{
+  std::vector<FramePtr> kfs, frames;
+  for(int k=0; k<3; ++k)
+    kfs.push_back(createFrame(0.1*k));
+  for(int k=1; k<=8; ++k)
+    frames.push_back(createFrame(0.1*k+0.05));
+
+  // the measurements are committed in seed order, the result does not depend
+  // on how the seeds are split among the workers
+  std::vector<FilterState> states;
+  for(int n_threads : {1, 2, 5})
+  {
+    ConvergedPoints converged;
+    SyntheticDepthFilter filter(converged.callback(), n_threads);
+    for(const FramePtr& kf : kfs)
+      filter.addSeeds(kf, 400);
+    for(const FramePtr& frame : frames)
+    {
+      filter.addFrame(frame);
+      CHECK(filter.getUpdateStats().n_updated > 0 && filter.getUpdateStats().n_skipped == 0);
+    }
+    states.push_back(FilterState(filter, converged));
+    CHECK(!states.back().converged.empty() && !states.back().mu.empty());
+  }
+  for(size_t k=1; k<states.size(); ++k)
+    CHECK(states[k] == states[0]);
+}
+
+void testScheduler()
+{
+  ConvergedPoints converged;
+  SyntheticDepthFilter filter(converged.callback(), 1);
+  filter.measure_cost_us = 200;
+  filter.options_.seed_update_budget_ms = 4.0;
+  FramePtr kf = createFrame(0.0);
+  const size_t n_seeds = 300;
+  filter.addSeeds(kf, n_seeds);
+  SeedStore& seeds = filter.getSeeds().front().seeds;
+  for(size_t i=0; i<n_seeds; ++i)
+    seeds.sigma2[i] *= 0.01 + (i%10)*0.1;
+
+  // the budget runs out after a few measurements, the seeds with the largest
+  // expected information gain are measured first
+  filter.addFrame(createFrame(0.3));
+  DepthFilter::UpdateStats stats = filter.getUpdateStats();
+  CHECK(stats.n_invisible == 0);
+  CHECK(stats.n_skipped > 0 && stats.n_updated > 0);
+  CHECK(stats.n_updated + stats.n_failed + stats.n_skipped == n_seeds);
+  std::vector<double> measured, skipped;
+  filter.getPriorities(measured, skipped);
+  CHECK(measured.size() == stats.n_updated + stats.n_failed && skipped.size() == stats.n_skipped);
+  CHECK(*std::min_element(measured.begin(), measured.end()) >= *std::max_element(skipped.begin(), skipped.end()));
+
+  // the deterministic mode ignores the budget
+  filter.setDeterministic(true);
+  filter.addFrame(createFrame(0.25));
+  stats = filter.getUpdateStats();
+  CHECK(stats.n_skipped == 0 && stats.n_updated > 0);
+
+  // equal seeds lose priority when they are measured, such that the seeds at
+  // the end are not starved
+  SyntheticDepthFilter equal_filter(converged.callback(), 1);
+  equal_filter.measure_cost_us = 200;
+  equal_filter.options_.seed_update_budget_ms = 4.0;
+  equal_filter.addSeeds(kf, n_seeds);
+  size_t n_measurements = 0;
+  for(int k=0; k<1000 && n_measurements<3*n_seeds && equal_filter.nMeasuredSeeds()<n_seeds; ++k)
+  {
+    equal_filter.addFrame(createFrame(0.3+0.01*(k%50)));
+    n_measurements += equal_filter.getUpdateStats().n_updated + equal_filter.getUpdateStats().n_failed;
+  }
+  CHECK(equal_filter.nMeasuredSeeds() == n_seeds);
+}
+
+/// Every candidate is in the bucket of a keyframe in the map.
+void checkCandidates(svo::Map& map)
+{
+  map.point_candidates_.processHandoffQueue();
+  for(const auto& bucket : map.point_candidates_.buckets_)
+  {
+    FramePtr kf = map.keyframes_.find(bucket.first);
+    CHECK(kf != nullptr);
+    for(const MapPointCandidates::PointCandidate& c : bucket.second)
+      CHECK(c.second->frame == kf.get());
+  }
+}
+
+void testRemoveKeyframeWhileConverging()
+{
+  using namespace std::placeholders;
+  svo::Map map;
+  SyntheticDepthFilter filter(std::bind(&MapPointCandidates::newCandidatePoint, &map.point_candidates_, _1, _2), 2);
+  filter.setReclaimer(&map.reclaimer_);
+  filter.setDeterministic(true);
+  std::vector<FramePtr> kfs = {createFrame(0.0), createFrame(0.1)};
+  for(const FramePtr& kf : kfs)
+  {
+    map.addKeyframe(kf);
+    filter.addSeeds(kf, 400);
+  }
+
+  // the tracker removes the keyframe from the map and queues the removal in
+  // the filter, which converges seeds of the keyframe before it gets there
+  std::weak_ptr<Frame> removed_kf = kfs[0];
+  map.safeDeleteFrame(kfs[0]);
+  for(int k=1; k<=8; ++k)
+    filter.addFrame(createFrame(0.1*k+0.05));
+  filter.removeKeyframe(kfs[0]);
+  kfs[0].reset();
+  CHECK(removed_kf.expired());
+  checkCandidates(map);
+  const size_t n_converged = filter.getSeedHistogram().total(DepthFilter::SeedHistogram::CONVERGED);
+  CHECK(map.point_candidates_.size() > 0 && map.point_candidates_.size() < n_converged);
+  CHECK(map.point_candidates_.buckets_.size() == 1 && map.point_candidates_.buckets_.count(kfs[1]->id_) == 1);
+
+  // the same with the filter thread, the tracker replaces the oldest keyframe
+  // while the seeds converge
+  filter.setDeterministic(false);
+  for(int k=0; k<60; ++k)
+  {
+    if(k%6 == 0)
+    {
+      FramePtr kf = createFrame(0.1*(k/6));
+      map.addKeyframe(kf);
+      filter.addSeeds(kf, 200);
+      FramePtr oldest = *map.keyframes_.begin();
+      filter.removeKeyframe(oldest);
+      map.safeDeleteFrame(oldest);
+    }
+    filter.addFrame(createFrame(0.1*(k/6)+0.01*(k%6)+0.05));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    checkCandidates(map);
+  }
+  filter.stopThread();
+  checkCandidates(map);
+}
+
+void testSeedBatches()
+{
+  ConvergedPoints converged;
+  SyntheticDepthFilter filter(converged.callback(), 2);
+  filter.options_.max_n_kfs = 1;
+  std::vector<FramePtr> kfs = {createFrame(0.0), createFrame(0.05), createFrame(0.1)};
+  std::vector<std::weak_ptr<Frame>> weak_kfs(kfs.begin(), kfs.end());
+  for(const FramePtr& kf : kfs)
+    filter.addSeeds(kf, 100);
+  CHECK(filter.getSeeds().size() == 3 && filter.nSeeds() == 300);
+  CHECK(filter.nSeedsWhileLocked() == 300);
+
+  // removing a keyframe drops its batch and releases the keyframe
+  filter.removeKeyframe(kfs[1]);
+  kfs[1].reset();
+  CHECK(weak_kfs[1].expired());
+  CHECK(filter.getSeeds().size() == 2 && filter.nSeeds() == 200);
+  CHECK(filter.getSeeds()[0].frame == kfs[0] && filter.getSeeds()[1].frame == kfs[2]);
+  CHECK(filter.getSeedHistogram().total(DepthFilter::SeedHistogram::REMOVED) == 100);
+
+  // the batch of the old keyframe ages out with the next frame
+  kfs[0].reset();
+  CHECK(!weak_kfs[0].expired());
+  filter.addFrame(createFrame(0.4));
+  CHECK(weak_kfs[0].expired());
+  CHECK(filter.getSeeds().size() == 1 && filter.getSeeds()[0].frame == kfs[2]);
+  CHECK(filter.getSeedHistogram().total(DepthFilter::SeedHistogram::AGED_OUT) == 100);
+
+  // the keyframe is released when all seeds of its batch left the filter
+  kfs[2].reset();
+  for(int k=0; k<50 && !weak_kfs[2].expired(); ++k)
+    filter.addFrame(createFrame(0.4+0.02*(k%20)));
+  CHECK(weak_kfs[2].expired() && filter.getSeeds().empty());
+  const DepthFilter::SeedHistogram hist = filter.getSeedHistogram();
+  CHECK(hist.total(DepthFilter::SeedHistogram::CONVERGED) == converged.points.size());
+  CHECK(converged.points.size() + hist.total(DepthFilter::SeedHistogram::DIVERGED) == 100);
+}
+
+void testReplay()
+{
+  FramePtr kf = createFrame(0.0);
+  std::vector<ReplayFramePtr> history;
+  for(int k=0; k<7; ++k)
+    history.push_back(std::make_shared<ReplayFrame>(createFrame(0.1+0.07*k)));
+
+  // reference: the seeds are updated with one frame after the other
+  ConvergedPoints ref_converged;
+  SyntheticDepthFilter ref_filter(ref_converged.callback(), 1);
+  ref_filter.addSeeds(kf, 400);
+  for(const ReplayFramePtr& frame : history)
+    ref_filter.updateKeyframeSeeds(*frame, kf);
+  const FilterState ref_state(ref_filter, ref_converged);
+  CHECK(!ref_state.converged.empty() && !ref_state.mu.empty());
+
+  // the replay runs in steps of two frames, the workers share the seeds
+  ConvergedPoints converged;
+  SyntheticDepthFilter filter(converged.callback(), 3);
+  filter.options_.replay_frames_per_step = 2;
+  filter.addSeeds(kf, 400);
+  filter.addReplayTask(history);
+  CHECK(filter.nPendingReplayFrames() == 7);
+  CHECK(filter.replaySeedsStep() && filter.nPendingReplayFrames() == 5);
+
+  // a new keyframe interrupts the replay, its seeds are replayed first
+  FramePtr new_kf = createFrame(0.05);
+  std::vector<ReplayFramePtr> new_history(history.begin(), history.begin()+3);
+  filter.addSeeds(new_kf, 100);
+  filter.addReplayTask(new_history);
+  CHECK(filter.nPendingReplayFrames() == 3);
+  CHECK(filter.replaySeedsStep() && filter.nPendingReplayFrames() == 1);
+
+  // the replay of a removed keyframe stops, the interrupted replay continues
+  filter.removeSeeds(new_kf);
+  CHECK(filter.replaySeedsStep() && filter.nPendingReplayFrames() == 5);
+  size_t n_steps = 0;
+  while(filter.replaySeedsStep())
+    ++n_steps;
+  CHECK(n_steps == 3 && filter.nPendingReplayFrames() == 0);
+
+  // every seed saw the frames in order, as in the reference
+  CHECK(FilterState(filter, converged, kf.get()) == ref_state);
+}
+
+void testReplayNanBound()
+{
+  // a seed with a NaN bound is dropped only if the measurement does not make
+  // it converge, in the live update as in the replay
+  FramePtr kf = createFrame(0.0);
+  std::vector<ReplayFramePtr> history;
+  for(int k=0; k<7; ++k)
+    history.push_back(std::make_shared<ReplayFrame>(createFrame(0.1+0.07*k)));
+
+  ConvergedPoints ref_converged;
+  SyntheticDepthFilter ref_filter(ref_converged.callback(), 1);
+  ref_filter.nan_bounds = true;
+  ref_filter.addSeeds(kf, 400);
+  for(const ReplayFramePtr& frame : history)
+    ref_filter.updateKeyframeSeeds(*frame, kf);
+
+  ConvergedPoints converged;
+  SyntheticDepthFilter filter(converged.callback(), 3);
+  filter.nan_bounds = true;
+  filter.addSeeds(kf, 400);
+  filter.addReplayTask(history);
+  while(filter.replaySeedsStep());
+
+  const DepthFilter::SeedHistogram ref_hist = ref_filter.getSeedHistogram();
+  const DepthFilter::SeedHistogram hist = filter.getSeedHistogram();
+  CHECK(ref_hist.total(DepthFilter::SeedHistogram::CONVERGED) > 0);
+  CHECK(ref_hist.total(DepthFilter::SeedHistogram::DIVERGED) > 0);
+  CHECK(hist.total(DepthFilter::SeedHistogram::CONVERGED) == ref_hist.total(DepthFilter::SeedHistogram::CONVERGED));
+  CHECK(hist.total(DepthFilter::SeedHistogram::DIVERGED) == ref_hist.total(DepthFilter::SeedHistogram::DIVERGED));
+  CHECK(FilterState(filter, converged) == FilterState(ref_filter, ref_converged));
+}
+
+/// Run the keyframes, each with its history, and the frames in between
+/// through a filter in deterministic mode.
+FilterState runDeterministic(
+    int n_threads,
+    const std::vector<FramePtr>& kfs,
+    const std::vector<std::vector<ReplayFramePtr>>& histories,
+    const std::vector<FramePtr>& frames,
+    DepthFilter::SeedHistogram& hist)
+{
+  ConvergedPoints converged;
+  SyntheticDepthFilter filter(converged.callback(), n_threads);
+  filter.measure_cost_us = 20;
+  filter.options_.seed_update_budget_ms = 0.5;
+  filter.startThread();
+  filter.setDeterministic(true);
+  CHECK(filter.isDeterministic());
+  for(size_t k=0; k<kfs.size(); ++k)
+  {
+    // as the keyframe command, which runs the replay to completion
+    filter.addFrame(kfs[k]);
+    filter.addSeeds(kfs[k], 300);
+    filter.addReplayTask(histories[k]);
+    while(filter.replaySeedsStep());
+    for(size_t i=0; i<frames.size()/kfs.size(); ++i)
+    {
+      filter.addFrame(frames[k*frames.size()/kfs.size()+i]);
+      CHECK(filter.getUpdateStats().n_skipped == 0);
+    }
+  }
+  CHECK(filter.getQueueStats().n_dropped == 0);
+  hist = filter.getSeedHistogram();
+  return FilterState(filter, converged);
+}
+
+void testDeterministic()
+{
+  std::vector<FramePtr> kfs, frames;
+  std::vector<std::vector<ReplayFramePtr>> histories(3);
+  for(int k=0; k<3; ++k)
+  {
+    kfs.push_back(createFrame(0.3*k));
+    for(int i=0; i<4; ++i)
+    {
+      frames.push_back(createFrame(0.3*k+0.07*(i+1)));
+      histories[k].push_back(std::make_shared<ReplayFrame>(createFrame(0.3*k-0.05*(i+1))));
+    }
+  }
+
+  // the same sequence gives bitwise the same seeds, whatever the number of
+  // workers, the time budget and the timing of the threads
+  DepthFilter::SeedHistogram hist1, hist4;
+  const FilterState state1 = runDeterministic(1, kfs, histories, frames, hist1);
+  const FilterState state4 = runDeterministic(4, kfs, histories, frames, hist4);
+  CHECK(!state1.converged.empty() && !state1.mu.empty());
+  CHECK(state1 == state4);
+  for(int o=0; o<DepthFilter::SeedHistogram::N_OUTCOMES; ++o)
+    for(int k=0; k<DepthFilter::SeedHistogram::kNumBins; ++k)
+      CHECK(hist1.counts[o][k] == hist4.counts[o][k]);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testParallelUpdate();
+  testScheduler();
+  testRemoveKeyframeWhileConverging();
+  testSeedBatches();
+  testReplay();
+  testReplayNanBound();
+  testDeterministic();
+  printf("Seed filter tests passed.\n");
+  return 0;
+}
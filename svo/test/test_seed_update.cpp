@@ -0,0 +1,204 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <random>
+#include <vector>
+#include <vikit/timer.h>
+#include <svo/depth_filter.h>
+#include <svo/feature.h>
+#include "test_utils.h"
+
+namespace {
+
+/// Scalar Beta-Gaussian update of a single seed, as the filter did it before the
+/// seed states were stored in arrays. Used as reference and baseline.
+void updateSeedReference(float x, float tau2, float& a, float& b, float& mu, float& sigma2, float z_range)
+{
+  float norm_scale = sqrt(sigma2 + tau2);
+  if(std::isnan(norm_scale))
+    return;
+  float pdf = exp(-(x-mu)*(x-mu)/(2*norm_scale*norm_scale)) / (norm_scale*sqrt(2*M_PI));
+  float s2 = 1./(1./sigma2 + 1./tau2);
+  float m = s2*(mu/sigma2 + x/tau2);
+  float C1 = a/(a+b) * pdf;
+  float C2 = b/(a+b) * 1./z_range;
+  float normalization_constant = C1 + C2;
+  C1 /= normalization_constant;
+  C2 /= normalization_constant;
+  float f = C1*(a+1.)/(a+b+1.) + C2*a/(a+b+1.);
+  float e = C1*(a+1.)*(a+2.)/((a+b+1.)*(a+b+2.))
+          + C2*a*(a+1.0f)/((a+b+1.0f)*(a+b+2.0f));
+  float mu_new = C1*m+C2*mu;
+  sigma2 = C1*(s2 + m*m) + C2*(sigma2 + mu*mu) - mu_new*mu_new;
+  mu = mu_new;
+  a = (e-f)/(f-e/f);
+  b = a*(1.0f-f)/f;
+}
+
+double computeTauReference(const Eigen::Vector3d& t, const Eigen::Vector3d& f, double z, double px_error_angle)
+{
+  Eigen::Vector3d a = f*z-t;
+  double t_norm = t.norm();
+  double a_norm = a.norm();
+  double alpha = acos(f.dot(t)/t_norm);
+  double beta = acos(a.dot(-t)/(t_norm*a_norm));
+  double beta_plus = beta + px_error_angle;
+  double gamma_plus = M_PI-alpha-beta_plus;
+  double z_plus = t_norm*sin(beta_plus)/sin(gamma_plus);
+  return (z_plus - z);
+}
+
+void testSeedUpdate(size_t n_seeds, size_t n_iter)
+{
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<float> depth(1.0f, 5.0f);
+  std::normal_distribution<float> noise(0.0f, 0.05f);
+
+  svo::SeedStore seeds;
+  std::vector<float> true_depth(n_seeds);
+  for(size_t i=0; i<n_seeds; ++i)
+  {
+    seeds.add(std::unique_ptr<svo::Feature>(), 2.0f, 0.5f);
+    true_depth[i] = depth(gen);
+  }
+  svo::SeedStore ref_seeds;
+  for(size_t i=0; i<n_seeds; ++i)
+    ref_seeds.add(std::unique_ptr<svo::Feature>(), 2.0f, 0.5f);
+
+  std::vector<uint32_t> idx(n_seeds);
+  for(size_t i=0; i<n_seeds; ++i)
+    idx[i] = i;
+  std::vector<std::vector<float>> x(n_iter, std::vector<float>(n_seeds));
+  std::vector<float> tau2(n_seeds, 0.01f*0.01f);
+  for(size_t k=0; k<n_iter; ++k)
+    for(size_t i=0; i<n_seeds; ++i)
+      x[k][i] = 1.0f/(true_depth[i] + noise(gen));
+
+  // a single update must agree with the reference, over many iterations the
+  // variance drifts since its update is badly conditioned in float.
+  svo::DepthFilter::updateSeedBatch(idx, x[0], tau2, seeds);
+  for(size_t i=0; i<n_seeds; ++i)
+  {
+    updateSeedReference(x[0][i], tau2[i], ref_seeds.a[i], ref_seeds.b[i],
+                        ref_seeds.mu[i], ref_seeds.sigma2[i], ref_seeds.z_range[i]);
+    CHECK(std::abs(seeds.mu[i] - ref_seeds.mu[i]) < 1e-4f*ref_seeds.mu[i]);
+    CHECK(std::abs(seeds.sigma2[i] - ref_seeds.sigma2[i]) < 1e-3f*ref_seeds.sigma2[i]);
+    CHECK(std::abs(seeds.a[i] - ref_seeds.a[i]) < 1e-3f*ref_seeds.a[i]);
+    CHECK(std::abs(seeds.b[i] - ref_seeds.b[i]) < 1e-3f*ref_seeds.b[i]);
+  }
+
+  vk::Timer t;
+  for(size_t k=1; k<n_iter; ++k)
+    for(size_t i=0; i<n_seeds; ++i)
+      updateSeedReference(x[k][i], tau2[i], ref_seeds.a[i], ref_seeds.b[i],
+                          ref_seeds.mu[i], ref_seeds.sigma2[i], ref_seeds.z_range[i]);
+  const double t_ref = t.stop();
+
+  t.start();
+  for(size_t k=1; k<n_iter; ++k)
+    svo::DepthFilter::updateSeedBatch(idx, x[k], tau2, seeds);
+  const double t_batch = t.stop();
+
+  const double n_updates = static_cast<double>(n_seeds*(n_iter-1));
+  printf("%zu seed updates: scalar %f ms (%.1f M/s), batch %f ms (%.1f M/s)\n",
+         n_seeds*(n_iter-1), t_ref*1000, n_updates/t_ref*1e-6, t_batch*1000, n_updates/t_batch*1e-6);
+}
+
+void testComputeTau(size_t n)
+{
+  std::mt19937 gen(7);
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  const double px_error_angle = atan(1.0/(2.0*300.0))*2.0;
+  const double c = cos(px_error_angle), s = sin(px_error_angle);
+  std::vector<Eigen::Vector3d, Eigen::aligned_allocator<Eigen::Vector3d>> t(n), f(n);
+  std::vector<double> z(n);
+  for(size_t i=0; i<n; ++i)
+  {
+    t[i] = Eigen::Vector3d(u(gen), u(gen), u(gen))*0.2;
+    f[i] = Eigen::Vector3d(u(gen)*0.5, u(gen)*0.5, 1.0).normalized();
+    z[i] = 2.0+u(gen);
+  }
+
+  double sum_ref = 0.0, sum = 0.0;
+  vk::Timer timer;
+  for(size_t i=0; i<n; ++i)
+    sum_ref += computeTauReference(t[i], f[i], z[i], px_error_angle);
+  const double t_ref = timer.stop();
+  timer.start();
+  for(size_t i=0; i<n; ++i)
+  {
+    const double tau = svo::DepthFilter::computeTau(t[i], f[i], z[i], c, s);
+    const double tau_ref = computeTauReference(t[i], f[i], z[i], px_error_angle);
+    CHECK(std::abs(tau - tau_ref) < 1e-6 + 1e-6*std::abs(tau_ref));
+    sum += tau;
+  }
+  timer.stop();
+  timer.start();
+  for(size_t i=0; i<n; ++i)
+    sum += svo::DepthFilter::computeTau(t[i], f[i], z[i], c, s);
+  const double t_tau = timer.stop();
+  printf("%zu tau computations: trigonometric %f ms, angle sum identities %f ms\n",
+         n, t_ref*1000, t_tau*1000);
+}
+
+void testSeedQuality()
+{
+  // equal seeds apart from one property each, all of them rank below the good seed
+  svo::SeedStore seeds;
+  for(int i=0; i<4; ++i)
+    seeds.add(std::unique_ptr<svo::Feature>(), 2.0f, 0.5f);
+  seeds.b[1] = 40;                            // outlier
+  seeds.sigma2[2] *= 100;                     // far from convergence
+  seeds.n_failed[3] = 5;                      // not found repeatedly
+  const double thresh = 200.0;
+  for(int i=1; i<4; ++i)
+    CHECK(seeds.quality(i, thresh) < seeds.quality(0, thresh));
+
+  // the new fields are compacted with the others
+  seeds.removeIf([](size_t i){ return i == 0 || i == 2; });
+  CHECK(seeds.size() == 2 && seeds.b[0] == 40 && seeds.n_failed[1] == 5);
+}
+
+void testSeedHistogram()
+{
+  svo::DepthFilter::SeedHistogram hist;
+  hist.add(svo::DepthFilter::SeedHistogram::CONVERGED, 0);
+  hist.add(svo::DepthFilter::SeedHistogram::CONVERGED, 1);
+  hist.add(svo::DepthFilter::SeedHistogram::CONVERGED, 2);
+  hist.add(svo::DepthFilter::SeedHistogram::CONVERGED, 3);
+  hist.add(svo::DepthFilter::SeedHistogram::EVICTED, 100000);
+  CHECK(hist.counts[svo::DepthFilter::SeedHistogram::CONVERGED][0] == 1);
+  CHECK(hist.counts[svo::DepthFilter::SeedHistogram::CONVERGED][1] == 2);
+  CHECK(hist.counts[svo::DepthFilter::SeedHistogram::CONVERGED][2] == 1);
+  CHECK(hist.counts[svo::DepthFilter::SeedHistogram::EVICTED][svo::DepthFilter::SeedHistogram::kNumBins-1] == 1);
+  CHECK(hist.total(svo::DepthFilter::SeedHistogram::CONVERGED) == 4);
+  CHECK(hist.total(svo::DepthFilter::SeedHistogram::AGED_OUT) == 0);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testSeedUpdate(5000, 100);
+  testComputeTau(100000);
+  testSeedQuality();
+  testSeedHistogram();
+  printf("Seed update tests passed.\n");
+  return 0;
+}
@@ -0,0 +1,173 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vikit/math_utils.h>
+#include <svo/sparse_ba.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+/// Five cameras on a line look at points on a wall 4m away. The first two
+/// poses are fixed, the others and all points start with an error.
+void setupProblem(
+    SparseBA& ba,
+    std::vector<SE3d, Eigen::aligned_allocator<SE3d>>& T_f_w_true,
+    std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>>& points_true)
+{
+  std::mt19937 rng(42);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 1.0);
+
+  ba.clear();
+  T_f_w_true.clear();
+  points_true.clear();
+  for(int i=0; i<5; ++i)
+  {
+    const SE3d T_w_f(Eigen::AngleAxisd(0.02*i, Vector3d::UnitY()).toRotationMatrix(),
+                     Vector3d(0.2*i, 0.05*i, 0.0));
+    T_f_w_true.push_back(T_w_f.inverse());
+    Eigen::Matrix<double,6,1> delta;
+    for(int k=0; k<6; ++k)
+      delta[k] = 0.01*noise(rng);
+    ba.addPose((i < 2) ? T_f_w_true.back() : SE3d::exp(delta)*T_f_w_true.back(), i < 2);
+  }
+  for(int j=0; j<100; ++j)
+  {
+    points_true.push_back(Vector3d(2.0*uniform(rng), 1.5*uniform(rng), 4.0+0.5*uniform(rng)));
+    ba.addPoint(points_true.back() + 0.05*Vector3d(noise(rng), noise(rng), noise(rng)));
+    for(size_t i=0; i<T_f_w_true.size(); ++i)
+      ba.addObservation(i, j, vk::project2d(T_f_w_true[i]*points_true.back()), 1.0);
+  }
+}
+
+void testConvergence(const int n_threads)
+{
+  SparseBA ba;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w_true;
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> points_true;
+  setupProblem(ba, T_f_w_true, points_true);
+  ba.options_.n_iter = 20;
+  ba.options_.n_threads = n_threads;
+  SparseBA::Stats stats;
+  ba.optimize(stats);
+
+  CHECK(stats.n_poses == 3);
+  CHECK(stats.n_points == 100);
+  CHECK(stats.n_edges == 500);
+  CHECK(stats.n_iter > 0);
+  CHECK(stats.final_chi2 < 1e-6*stats.init_chi2);
+  for(size_t i=0; i<2; ++i)
+    CHECK((ba.pose(i).matrix()-T_f_w_true[i].matrix()).norm() == 0.0); // fixed
+  for(size_t i=2; i<T_f_w_true.size(); ++i)
+    CHECK((ba.pose(i).matrix()-T_f_w_true[i].matrix()).norm() < 1e-4);
+  for(size_t j=0; j<points_true.size(); ++j)
+    CHECK((ba.point(j)-points_true[j]).norm() < 1e-3);
+  for(size_t k=0; k<ba.nObservations(); ++k)
+    CHECK(ba.chi2(k) < 1e-8);
+}
+
+void testOutlier()
+{
+  // a wrong observation is down-weighted by the Huber kernel and keeps a large error
+  SparseBA ba;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w_true;
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> points_true;
+  setupProblem(ba, T_f_w_true, points_true);
+  const size_t k = ba.addObservation(4, 0, vk::project2d(T_f_w_true[4]*points_true[0]) + Vector2d(0.05, -0.05), 1.0);
+  ba.options_.n_iter = 20;
+  SparseBA::Stats stats;
+  ba.optimize(stats);
+  CHECK(ba.chi2(k) > 0.5*0.005);
+  CHECK((ba.pose(4).matrix()-T_f_w_true[4].matrix()).norm() < 1e-2);
+}
+
+void testSchurComplement()
+{
+  // the reduced system has the same solution for the remaining blocks
+  std::mt19937 rng(7);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  Eigen::MatrixXd A(18, 18);
+  Eigen::VectorXd g(18);
+  for(int r=0; r<18; ++r)
+  {
+    g[r] = noise(rng);
+    for(int c=0; c<18; ++c)
+      A(r, c) = noise(rng);
+  }
+  Eigen::MatrixXd H = A*A.transpose() + Eigen::MatrixXd::Identity(18, 18);
+  const Eigen::VectorXd x = H.ldlt().solve(g);
+  SparseBA::schurComplement(1, H, g);
+  CHECK(H.rows() == 12 && g.rows() == 12);
+  const Eigen::VectorXd x_r = H.ldlt().solve(g);
+  CHECK((x_r.head(6)-x.head(6)).norm() < 1e-8);
+  CHECK((x_r.tail(6)-x.tail(6)).norm() < 1e-8);
+}
+
+void testMarginalization()
+{
+  // A prior from marginalizing a pose must move the remaining poses as the
+  // first Gauss-Newton step of the full problem does.
+  SparseBA ba;
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T_f_w_true;
+  std::vector<Vector3d, Eigen::aligned_allocator<Vector3d>> points_true;
+  setupProblem(ba, T_f_w_true, points_true);
+  std::vector<size_t> poses;
+  Eigen::MatrixXd H;
+  Eigen::VectorXd g;
+  ba.marginalize(4, poses, H, g);
+  CHECK(poses.size() == 2 && poses[0] == 2 && poses[1] == 3);
+  CHECK(H.rows() == 12 && g.rows() == 12);
+
+  SparseBA prior_ba;
+  for(size_t i=0; i<4; ++i)
+    prior_ba.addPose(ba.pose(i), i < 2);
+  std::vector<SE3d, Eigen::aligned_allocator<SE3d>> T0;
+  for(size_t i : poses)
+    T0.push_back(ba.pose(i));
+  prior_ba.setPrior(poses, T0, H, g);
+  prior_ba.options_.n_iter = 20;
+  SparseBA::Stats stats;
+  prior_ba.optimize(stats);
+  CHECK(stats.n_iter > 0);
+  CHECK(stats.final_chi2 < stats.init_chi2);
+
+  ba.options_.n_iter = 1;
+  ba.options_.lambda_init = 1e-9;
+  ba.optimize(stats);
+  CHECK(stats.n_iter == 1);
+  for(size_t i=2; i<4; ++i)
+    CHECK((prior_ba.pose(i).matrix()-ba.pose(i).matrix()).norm() < 1e-6);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testConvergence(1);
+  testConvergence(3);
+  testOutlier();
+  testSchurComplement();
+  testMarginalization();
+  printf("test_sparse_ba passed\n");
+  return 0;
+}
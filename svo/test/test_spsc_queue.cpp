@@ -0,0 +1,83 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <svo/spsc_queue.h>
+#include "test_utils.h"
+
+namespace {
+
+void testBounded()
+{
+  svo::SpscQueue<std::unique_ptr<int>> queue(3);
+  CHECK(queue.capacity() == 4);
+  for(int i=0; i<4; ++i)
+    CHECK(queue.tryPush(std::unique_ptr<int>(new int(i))));
+  std::unique_ptr<int> rejected(new int(4));
+  CHECK(!queue.tryPush(std::move(rejected)));
+  CHECK(rejected && *rejected == 4); // a rejected item is not moved from
+  CHECK(queue.size() == 4);
+
+  std::unique_ptr<int> item;
+  for(int i=0; i<4; ++i)
+  {
+    CHECK(queue.tryPop(item));
+    CHECK(*item == i);
+  }
+  CHECK(!queue.tryPop(item));
+  CHECK(queue.empty());
+}
+
+void testThreaded()
+{
+  const size_t n = 1000000;
+  svo::SpscQueue<size_t> queue(16);
+  std::thread producer([&]() {
+    for(size_t i=0; i<n; ++i)
+    {
+      size_t item = i;
+      while(!queue.tryPush(std::move(item)))
+        std::this_thread::yield();
+    }
+  });
+  size_t expected = 0;
+  while(expected < n)
+  {
+    size_t item;
+    if(!queue.tryPop(item))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    CHECK(item == expected); // items arrive complete and in order
+    ++expected;
+  }
+  producer.join();
+  CHECK(queue.empty());
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testBounded();
+  testThreaded();
+  printf("SpscQueue tests passed.\n");
+  return 0;
+}
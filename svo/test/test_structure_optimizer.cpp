@@ -0,0 +1,68 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vikit/math_utils.h>
+#include <svo/structure_optimizer.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+structure_optimizer::Observation observe(const SE3d& T_f_w, const Vector3d& pos)
+{
+  structure_optimizer::Observation o;
+  o.R_f_w = T_f_w.rotationMatrix();
+  o.t_f_w = T_f_w.translation();
+  o.uv = vk::project2d(T_f_w*pos);
+  return o;
+}
+
+void testOptimizePoint()
+{
+  // three frames on a baseline looking at a point 3m away
+  const Vector3d pos(0.2, -0.1, 3.0);
+  std::vector<structure_optimizer::Observation,
+              Eigen::aligned_allocator<structure_optimizer::Observation>> obs;
+  for(int i=-1; i<=1; ++i)
+  {
+    const SE3d T_w_f(Eigen::AngleAxisd(0.05*i, Vector3d::UnitY()).toRotationMatrix(),
+                     Vector3d(0.3*i, 0.0, 0.0));
+    obs.push_back(observe(T_w_f.inverse(), pos));
+  }
+
+  Vector3d p = pos + Vector3d(0.05, 0.05, -0.2);
+  structure_optimizer::optimizePoint(obs.data(), obs.size(), 10, p);
+  CHECK((p-pos).norm() < 1e-6);
+
+  // no iteration leaves the point untouched
+  p = pos + Vector3d(0.05, 0.05, -0.2);
+  structure_optimizer::optimizePoint(obs.data(), obs.size(), 0, p);
+  CHECK((p-pos-Vector3d(0.05, 0.05, -0.2)).norm() < 1e-12);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testOptimizePoint();
+  printf("test_structure_optimizer passed\n");
+  return 0;
+}
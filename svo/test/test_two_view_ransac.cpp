@@ -0,0 +1,152 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <svo/two_view_ransac.h>
+#include "test_utils.h"
+
+namespace {
+
+using namespace svo;
+
+const double kFocalLength = 300.0;
+
+/// Points in front of the reference camera observed after the motion T_cur_ref
+/// with pixel noise. The first n_outliers correspondences are random.
+void setupScene(
+    const SE3d& T_cur_ref,
+    const bool planar,
+    const size_t n_points,
+    const size_t n_outliers,
+    std::vector<Vector3d>& f_ref,
+    std::vector<Vector3d>& f_cur)
+{
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<double> uniform(-1.0, 1.0);
+  std::normal_distribution<double> noise(0.0, 0.5/kFocalLength);
+  f_ref.clear();
+  f_cur.clear();
+  for(size_t i=0; i<n_points; ++i)
+  {
+    Vector3d xyz_ref(1.5*uniform(rng), 1.0*uniform(rng), 0.0);
+    xyz_ref[2] = planar ? 4.0 + 0.3*xyz_ref[0] : 4.0 + 2.0*uniform(rng);
+    Vector3d xyz_cur = T_cur_ref*xyz_ref;
+    if(i < n_outliers)
+      xyz_cur = Vector3d(uniform(rng), uniform(rng), 2.0);
+    f_ref.push_back(Vector3d(xyz_ref[0]/xyz_ref[2] + noise(rng), xyz_ref[1]/xyz_ref[2] + noise(rng), 1.0).normalized());
+    f_cur.push_back(Vector3d(xyz_cur[0]/xyz_cur[2] + noise(rng), xyz_cur[1]/xyz_cur[2] + noise(rng), 1.0).normalized());
+  }
+}
+
+void checkPose(const SE3d& T_est, const SE3d& T_true)
+{
+  CHECK((T_est.so3()*T_true.so3().inverse()).log().norm() < 0.01);
+  CHECK(T_est.translation().normalized().dot(T_true.translation().normalized()) > 0.99);
+}
+
+SE3d motion()
+{
+  return SE3d(Eigen::AngleAxisd(0.1, Vector3d(0.2, 0.3, 1.0).normalized()).toRotationMatrix(),
+              Vector3d(-0.4, 0.05, 0.1));
+}
+
+void testDecomposition()
+{
+  // the true pose is one of the candidates of the exact models
+  const SE3d T = motion();
+  const Matrix3d R = T.rotationMatrix();
+  const Vector3d t = T.translation();
+  Matrix3d t_hat;
+  t_hat << 0.0, -t[2], t[1], t[2], 0.0, -t[0], -t[1], t[0], 0.0;
+  std::vector<SE3d> poses;
+  TwoViewRansac::decomposeEssential(t_hat*R, poses);
+  CHECK(poses.size() == 4);
+  bool found = false;
+  for(const SE3d& T_est : poses)
+    found |= (T_est.so3()*T.so3().inverse()).log().norm() < 1e-6
+             && T_est.translation().dot(t.normalized()) > 1.0-1e-6;
+  CHECK(found);
+
+  const Vector3d n(0.0, 0.0, 1.0); // plane z=4 in the reference frame
+  TwoViewRansac::decomposeHomography(R + t*n.transpose()/4.0, poses);
+  CHECK(poses.size() == 8);
+  found = false;
+  for(const SE3d& T_est : poses)
+    found |= (T_est.so3()*T.so3().inverse()).log().norm() < 1e-6
+             && T_est.translation().dot(t.normalized()) > 1.0-1e-6;
+  CHECK(found);
+}
+
+void testModel(const bool planar)
+{
+  const SE3d T_true = motion();
+  std::vector<Vector3d> f_ref, f_cur;
+  setupScene(T_true, planar, 300, 90, f_ref, f_cur);
+
+  TwoViewRansac ransac;
+  TwoViewRansac::Stats stats;
+  CHECK(ransac.compute(f_ref, f_cur, kFocalLength, stats));
+  CHECK(stats.model == (planar ? TwoViewRansac::HOMOGRAPHY : TwoViewRansac::ESSENTIAL));
+  checkPose(ransac.T_cur_ref_, T_true);
+  size_t n_outliers = 0;
+  for(int i : ransac.inliers_)
+    n_outliers += (i < 90);
+  CHECK(ransac.inliers_.size() > 190);
+  CHECK(n_outliers < 5);
+  CHECK(stats.n_hypotheses[stats.model] < ransac.options_.max_iter);
+  CHECK(stats.n_rejected[stats.model] > 0);
+}
+
+void testThreads()
+{
+  // the samples do not depend on the number of threads
+  std::vector<Vector3d> f_ref, f_cur;
+  setupScene(motion(), false, 300, 90, f_ref, f_cur);
+  TwoViewRansac ransac_1, ransac_4;
+  ransac_4.options_.n_threads = 4;
+  TwoViewRansac::Stats stats_1, stats_4;
+  CHECK(ransac_1.compute(f_ref, f_cur, kFocalLength, stats_1));
+  CHECK(ransac_4.compute(f_ref, f_cur, kFocalLength, stats_4));
+  CHECK(stats_1.model == stats_4.model);
+  CHECK(stats_1.n_hypotheses[0] == stats_4.n_hypotheses[0]);
+  CHECK(stats_1.n_hypotheses[1] == stats_4.n_hypotheses[1]);
+  CHECK(ransac_1.inliers_ == ransac_4.inliers_);
+}
+
+void testNoModel()
+{
+  std::vector<Vector3d> f_ref(5, Vector3d::UnitZ()), f_cur(5, Vector3d::UnitZ());
+  TwoViewRansac ransac;
+  TwoViewRansac::Stats stats;
+  CHECK(!ransac.compute(f_ref, f_cur, kFocalLength, stats));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+  testDecomposition();
+  testModel(false);
+  testModel(true);
+  testThreads();
+  testNoModel();
+  printf("test_two_view_ransac passed\n");
+  return 0;
+}
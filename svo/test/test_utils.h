@@ -18,12 +18,18 @@
 #define TEST_UTILS_H_
 
 #include <string.h>
+#include <string>
+#include <cstdio>
 #include <cstdlib> // for getenv
 #ifdef SVO_USE_ROS
 # include <ros/package.h>
 # include <vikit/params_helper.h>
 #endif
 
+/// Abort the test if the condition does not hold.
+#define CHECK(cond) \
+  do { if(!(cond)) { printf("FAILED %s:%i: %s\n", __FILE__, __LINE__, #cond); exit(1); } } while(0)
+
 namespace svo {
 namespace test_utils {
 
@@ -0,0 +1,88 @@
+// This file is part of SVO - Semi-direct Visual Odometry.
+//
+// Copyright (C) 2014 Christian Forster <forster at ifi dot uzh dot ch>
+// (Robotics and Perception Group, University of Zurich, Switzerland).
+//
+// SVO is free software: you can redistribute it and/or modify it under the
+// terms of the GNU General Public License as published by the Free Software
+// Foundation, either version 3 of the License, or any later version.
+//
+// SVO is distributed in the hope that it will be useful, but WITHOUT ANY
+// WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+// FOR A PARTICULAR PURPOSE. See the GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <svo/config.h>
+#include <svo/global_ba.h>
+#include <svo/map_snapshot.h>
+
+/// Offline refinement of a map that was saved with MapSnapshot::save().
+///
+/// usage: svo_global_ba <map> <trajectory> [--map-out <map>] [--threads <n>]
+///                      [--max-mb <n>] [--iter <n>]
+///
+/// Writes the refined keyframe poses to <trajectory>, one line per keyframe
+/// as "timestamp tx ty tz qx qy qz qw" of T_w_f.
+int main(int argc, char** argv)
+{
+  if(argc < 3)
+  {
+    printf("usage: %s <map> <trajectory> [--map-out <map>] [--threads <n>] [--max-mb <n>] [--iter <n>]\n", argv[0]);
+    return 1;
+  }
+  svo::GlobalBA ba;
+  std::string map_out;
+  for(int i=3; i+1<argc; i+=2)
+  {
+    if(std::strcmp(argv[i], "--map-out") == 0)
+      map_out = argv[i+1];
+    else if(std::strcmp(argv[i], "--threads") == 0)
+      ba.options_.n_threads = std::atoi(argv[i+1]);
+    else if(std::strcmp(argv[i], "--max-mb") == 0)
+      ba.options_.max_bytes = std::strtoull(argv[i+1], NULL, 10) << 20;
+    else if(std::strcmp(argv[i], "--iter") == 0)
+      ba.options_.n_iter = std::atoi(argv[i+1]);
+    else
+    {
+      printf("unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  svo::MapSnapshot map;
+  if(!map.load(argv[1]))
+  {
+    printf("could not load the map %s\n", argv[1]);
+    return 1;
+  }
+  printf("loaded %zu keyframes, %zu points and %zu observations\n",
+         map.kfs_.size(), map.points_.size(), map.obs_.size());
+
+  // same robust kernel as the local bundle adjustment
+  ba.options_.huber_width = svo::Config::lobaThresh() / map.error_multiplier2_ * svo::Config::lobaRobustHuberWidth();
+  svo::GlobalBA::Stats stats;
+  ba.optimize(map, stats);
+  printf("%s with %i threads, estimated %.1f MB: %zu edges, median error %.3f -> %.3f px in %.1f ms\n",
+         stats.pose_graph ? "pose graph" : "bundle adjustment", stats.n_threads,
+         stats.estimated_bytes / double(1<<20), stats.n_edges,
+         stats.init_error, stats.final_error, stats.time_ms);
+
+  if(!map.saveTrajectory(argv[2]))
+  {
+    printf("could not write the trajectory %s\n", argv[2]);
+    return 1;
+  }
+  if(!map_out.empty() && !map.save(map_out))
+  {
+    printf("could not write the map %s\n", map_out.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -15,6 +15,9 @@ public:
     FHMWrapper(std::shared_ptr<vk::AbstractCamera> cam, std::shared_ptr<vilib::DetectorBaseGPU> detector, size_t pyramidLevels);
 
     void addImage(torch::Tensor tensor, double timestamp);
+
+    /// Save the keyframes and points for an offline optimization, see svo_global_ba.
+    bool saveMap(const std::string& path) const;
 private:
     size_t pyramidLevels;
     std::shared_ptr<vk::AbstractCamera> camera;
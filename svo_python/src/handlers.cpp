@@ -1,5 +1,6 @@
 #include <svo/feature.h>
 #include <svo/frame_handler_base.h>
+#include <svo/map_snapshot.h>
 #include <vikit/abstract_camera.h>
 #include <vilib/cuda_common.h>
 #include "handlers.h"
@@ -17,7 +18,9 @@ void initHandlers(py::module &m)
               py::arg("camera"), py::arg("detector"), py::arg("levels") = 4)
          .def("add_image", &FHMWrapper::addImage,
               py::arg("tensor"), py::arg("timestamp") = 0)
-         .def("start", &FHMWrapper::start);
+         .def("start", &FHMWrapper::start)
+         .def("save_map", &FHMWrapper::saveMap,
+              py::arg("path"));
 }
 
 FHMWrapper::FHMWrapper(std::shared_ptr<vk::AbstractCamera> cam, std::shared_ptr<vilib::DetectorBaseGPU> detector, size_t pyramidLevels):
@@ -52,3 +55,9 @@ void FHMWrapper::addImage(at::Tensor tensor, double timestamp) {
     }
     FrameHandlerMono::addImage(move(frame), timestamp);
 }
+
+bool FHMWrapper::saveMap(const std::string& path) const {
+    svo::MapSnapshot snapshot;
+    snapshot.fromMap(map());
+    return snapshot.save(path);
+}
@@ -217,7 +217,11 @@ void Visualizer::visualizeMarkers(
         pub_points_, T_world_from_vision_*frame->pos(), "trajectory",
         ros::Time::now(), trace_id_, 0, 0.06, Vector3d(0.,0.,0.5));
     if(frame->isKeyframe() || publish_map_every_frame_)
+    {
+      // points are freed in the background, keep them alive while we publish
+      EpochReclaimer::Guard epoch_guard(map.reclaimer_);
       publishMapRegion(core_kfs);
+    }
     removeDeletedPts(map);
   }
 }
@@ -236,8 +240,8 @@ void Visualizer::removeDeletedPts(const Map& map)
 {
   if(pub_points_.getNumSubscribers() > 0)
   {
-    for(list<Point*>::const_iterator it=map.trash_points_.begin(); it!=map.trash_points_.end(); ++it)
-      vk::output_helper::publishPointMarker(pub_points_, Vector3d(), "pts", ros::Time::now(), (*it)->id_, 2, 0.06, Vector3d());
+    for(vector<int>::const_iterator it=map.deleted_point_ids_.begin(); it!=map.deleted_point_ids_.end(); ++it)
+      vk::output_helper::publishPointMarker(pub_points_, Vector3d(), "pts", ros::Time::now(), *it, 2, 0.06, Vector3d());
   }
 }
 
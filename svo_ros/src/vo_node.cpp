@@ -109,7 +109,10 @@ void VoNode::processImgLR(const cv::Mat& imgl, const cv::Mat& imgr, double times
       visualizer_.visualizeMarkers(vo_->lastFrames()->at(0), vo_->coreKeyframes(), vo_->map());
 
     if(publish_dense_input_)
+    {
+      svo::EpochReclaimer::Guard epoch_guard(vo_->map().reclaimer_);
       visualizer_.exportToDense(vo_->lastFrames()->at(0));
+    }
   }
 }
 